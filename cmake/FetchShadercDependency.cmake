@@ -1,5 +1,9 @@
 include(FetchContent)
 
+set(WUNDER_SPIRV_TOOLS_GIT_TAG vulkan-sdk-1.4.313.0)
+set(WUNDER_GLSLANG_GIT_TAG 15.3.0)
+set(WUNDER_SHADERC_GIT_TAG v2025.2)
+
 #spirv-headers (NEEDED ONLY FOR SPIRV-TOOLS)
 FetchContent_Declare(
         spirv-headers
@@ -11,23 +15,27 @@ FetchContent_Declare(
 FetchContent_Declare(
         spirv-tools
         GIT_REPOSITORY git@github.com:KhronosGroup/SPIRV-Tools
-        GIT_TAG vulkan-sdk-1.4.313.0
+        GIT_TAG ${WUNDER_SPIRV_TOOLS_GIT_TAG}
 )
 
 #spirv-tools (NEEDED ONLY FOR SHADERC)
 FetchContent_Declare(
         glslang
         GIT_REPOSITORY git@github.com:KhronosGroup/glslang
-        GIT_TAG 15.3.0
+        GIT_TAG ${WUNDER_GLSLANG_GIT_TAG}
 )
 
 FetchContent_Declare(
         shaderc
         GIT_REPOSITORY git@github.com:google/shaderc.git
-        GIT_TAG v2025.2
+        GIT_TAG ${WUNDER_SHADERC_GIT_TAG}
 )
 
 set(SHADERC_SKIP_INSTALL ON CACHE BOOL "" FORCE)
 set(SHADERC_SKIP_TESTS ON CACHE BOOL "" FORCE)
 
 FetchContent_MakeAvailable(spirv-headers spirv-tools glslang shaderc)
+
+#Keys the runtime SPIR-V cache, a compiler update must not reuse stale binaries
+set(WUNDER_SHADER_COMPILER_IDENTITY
+        "shaderc-${WUNDER_SHADERC_GIT_TAG}_glslang-${WUNDER_GLSLANG_GIT_TAG}_spirv-tools-${WUNDER_SPIRV_TOOLS_GIT_TAG}")
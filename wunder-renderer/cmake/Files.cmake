@@ -40,6 +40,10 @@ file(GLOB GLA_SOURCE ${GLA_SRC_DIR}/*.cpp)
 file(GLOB GLA_HEADER ${GLA_HDR_DIR}/*.h)
 file(GLOB GLA_INLINE ${GLA_HDR_DIR}/*.hpp)
 #
+file(GLOB GLA_CPU_SOURCE ${CPU_SRC_DIR}/*.cpp)
+file(GLOB GLA_CPU_HEADER ${CPU_HDR_DIR}/*.h)
+file(GLOB GLA_CPU_INLINE ${CPU_HDR_DIR}/*.hpp)
+#
 file(GLOB GLA_VULKAN_SOURCE ${VULKAN_SRC_DIR}/*.cpp)
 file(GLOB GLA_VULKAN_HEADER ${VULKAN_HDR_DIR}/*.h)
 file(GLOB GLA_VULKAN_INLINE ${VULKAN_HDR_DIR}/*.hpp)
@@ -81,6 +85,10 @@ file(GLOB WINDOW_INLINE ${WINDOW_HDR_DIR}/*.hpp)
 file(GLOB WINDOW_GLFW_SOURCE ${WINDOW_GLFW_SRC_DIR}/*.cpp)
 file(GLOB WINDOW_GLFW_HEADER ${WINDOW_GLFW_HDR_DIR}/*.h)
 file(GLOB WINDOW_GLFW_INLINE ${WINDOW_GLFW_HDR_DIR}/*.hpp)
+#
+file(GLOB WINDOW_NULL_SOURCE ${WINDOW_NULL_SRC_DIR}/*.cpp)
+file(GLOB WINDOW_NULL_HEADER ${WINDOW_NULL_HDR_DIR}/*.h)
+file(GLOB WINDOW_NULL_INLINE ${WINDOW_NULL_HDR_DIR}/*.hpp)
 
 source_group("Header Files/core" FILES ${CORE_HEADER})
 source_group("Inline Files/core" FILES ${CORE_INLINE})
@@ -115,6 +123,8 @@ set(WUNDER_RENDERER_HEADERS
         ${EVENT_INLINE}
         ${GLA_HEADER}
         ${GLA_INLINE}
+        ${GLA_CPU_HEADER}
+        ${GLA_CPU_INLINE}
         ${GLA_VULKAN_HEADER}
         ${GLA_VULKAN_INLINE}
         ${GLA_VULKAN_DESCRIPTORS_HEADER}
@@ -136,6 +146,8 @@ set(WUNDER_RENDERER_HEADERS
         ${WINDOW_INLINE}
         ${WINDOW_GLFW_HEADER}
         ${WINDOW_GLFW_INLINE}
+        ${WINDOW_NULL_HEADER}
+        ${WINDOW_NULL_INLINE}
 )
 
 set(WUNDER_RENDERER_SOURCES
@@ -148,6 +160,7 @@ set(WUNDER_RENDERER_SOURCES
         ${CORE_SOURCE}
         ${EVENT_SOURCE}
         ${GLA_SOURCE}
+        ${GLA_CPU_SOURCE}
         ${GLA_VULKAN_SOURCE}
         ${GLA_VULKAN_DESCRIPTORS_SOURCE}
         ${GLA_VULKAN_RAY_TRACE_SOURCE}
@@ -158,4 +171,5 @@ set(WUNDER_RENDERER_SOURCES
         ${TINY_GLTF_SOURCE}
         ${WINDOW_SOURCE}
         ${WINDOW_GLFW_SOURCE}
+        ${WINDOW_NULL_SOURCE}
 )
\ No newline at end of file
@@ -16,6 +16,7 @@ set(CORE_HDR_DIR ${HDR_DIR}/core)
 set(ENTITY_HDR_DIR ${HDR_DIR}/entity)
 set(EVENT_HDR_DIR ${HDR_DIR}/event)
 set(GLA_HDR_DIR ${HDR_DIR}/gla)
+set(CPU_HDR_DIR ${GLA_HDR_DIR}/cpu)
 set(VULKAN_HDR_DIR ${GLA_HDR_DIR}/vulkan)
 set(VULKAN_DESCRIPTORS_HDR_DIR ${VULKAN_HDR_DIR}/descriptors)
 set(VULKAN_RASTERIZE_HDR_DIR ${VULKAN_HDR_DIR}/rasterize)
@@ -26,6 +27,7 @@ set(SCENE_HDR_DIR ${HDR_DIR}/scene)
 set(TINY_GLTF_HDR_DIR ${HDR_DIR}/tinygltf)
 set(WINDOW_HDR_DIR ${HDR_DIR}/window)
 set(WINDOW_GLFW_HDR_DIR ${WINDOW_HDR_DIR}/glfw)
+set(WINDOW_NULL_HDR_DIR ${WINDOW_HDR_DIR}/null)
 
 ################################################################################################
 #Project source directory
@@ -42,6 +44,7 @@ set(CORE_SRC_DIR ${SRC_DIR}/core)
 set(EVENT_SRC_DIR ${SRC_DIR}/event)
 set(ECS_SRC_DIR ${SRC_DIR}/ecs)
 set(GLA_SRC_DIR ${SRC_DIR}/gla)
+set(CPU_SRC_DIR ${GLA_SRC_DIR}/cpu)
 set(VULKAN_SRC_DIR ${GLA_SRC_DIR}/vulkan)
 set(VULKAN_DESCRIPTORS_SRC_DIR ${VULKAN_SRC_DIR}/descriptors)
 set(VULKAN_RASTERIZE_SRC_DIR ${VULKAN_SRC_DIR}/rasterize)
@@ -52,6 +55,7 @@ set(SCENE_SRC_DIR ${SRC_DIR}/scene)
 set(TINY_GLTF_SRC_DIR ${SRC_DIR}/tinygltf)
 set(WINDOW_SRC_DIR ${SRC_DIR}/window)
 set(WINDOW_GLFW_SRC_DIR ${WINDOW_SRC_DIR}/glfw)
+set(WINDOW_NULL_SRC_DIR ${WINDOW_SRC_DIR}/null)
 
 ################################################################################################
 #Dependencies directory
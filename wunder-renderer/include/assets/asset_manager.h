@@ -52,6 +52,10 @@ class asset_manager : protected event_handler<event::file_dropped> {
   template <typename asset_type>
   [[nodiscard]] assets<asset_type> find_assets() const;
 
+  [[nodiscard]] const asset_storage& get_storage() const {
+    return m_asset_storage;
+  }
+
  protected:
   void on_event(const event::file_dropped&) override;
 
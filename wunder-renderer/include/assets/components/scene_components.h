@@ -5,16 +5,63 @@
 #ifndef WUNDER_SCENE_COMPONENTS_H
 #define WUNDER_SCENE_COMPONENTS_H
 
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
 #include "assets/asset_types.h"
 #include "glm/vec3.hpp"
 #include "glm/mat4x4.hpp"
 
 namespace wunder {
+/**
+ * How the acceleration structure of a mesh is built. automatic is resolved
+ * when the scene is loaded, from the size of the mesh.
+ */
+enum class acceleration_structure_build_policy : std::uint8_t {
+  automatic,
+  fast_trace,
+  fast_build,
+  allow_update,
+  allow_compaction,
+  low_memory,
+  count
+};
+
+inline constexpr std::array<std::string_view,
+                            static_cast<std::size_t>(
+                                acceleration_structure_build_policy::count)>
+    k_acceleration_structure_build_policy_names = {
+        "automatic",    "fast_trace",       "fast_build",
+        "allow_update", "allow_compaction", "low_memory"};
+
+inline std::string_view to_string(acceleration_structure_build_policy policy) {
+  const auto idx = static_cast<std::size_t>(policy);
+  return idx < k_acceleration_structure_build_policy_names.size()
+             ? k_acceleration_structure_build_policy_names[idx]
+             : "invalid";
+}
+
+inline std::optional<acceleration_structure_build_policy>
+acceleration_structure_build_policy_from_string(std::string_view name) {
+  for (std::size_t i = 0; i < k_acceleration_structure_build_policy_names.size();
+       ++i) {
+    if (k_acceleration_structure_build_policy_names[i] == name) {
+      return static_cast<acceleration_structure_build_policy>(i);
+    }
+  }
+
+  return std::nullopt;
+}
+
 struct base_asset_referencing_component {
   asset_handle m_handle = asset_handle::invalid();
 };
 
 struct mesh_component : public base_asset_referencing_component {
+  acceleration_structure_build_policy m_build_policy =
+      acceleration_structure_build_policy::automatic;
 };
 
 struct material_component : public base_asset_referencing_component {
@@ -0,0 +1,92 @@
+#ifndef WUNDER_OPACITY_MICROMAP_BAKER_H
+#define WUNDER_OPACITY_MICROMAP_BAKER_H
+
+#include <glm/vec2.hpp>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace wunder {
+struct material_asset;
+struct mesh_asset;
+struct texture_asset;
+
+// Values match VkOpacityMicromapFormatEXT
+enum class opacity_micromap_format : std::uint16_t {
+  two_state = 1,
+  four_state = 2
+};
+
+// Values match VkOpacityMicromapStateEXT
+enum class opacity_micromap_state : std::uint8_t {
+  transparent = 0,
+  opaque = 1,
+  unknown_transparent = 2,
+  unknown_opaque = 3
+};
+
+struct baked_opacity_micromap {
+  // Triangles whose micro-triangles all end up in the same known state don't
+  // get any micromap data, their index is one of these. Values match
+  // VkOpacityMicromapSpecialIndexEXT.
+  static constexpr std::int32_t k_fully_transparent_index = -1;
+  static constexpr std::int32_t k_fully_opaque_index = -2;
+
+  opacity_micromap_format m_format = opacity_micromap_format::four_state;
+  std::uint32_t m_subdivision_level = 0;
+  // Bytes per micromap triangle in m_data
+  std::uint32_t m_triangle_size = 0;
+  // Packed states of the unique micromap triangles, micro-triangles in bird
+  // curve order, 1 or 2 bits each starting from the lowest bit
+  std::vector<std::uint8_t> m_data;
+  // One per triangle of the mesh, a micromap triangle or a special index
+  std::vector<std::int32_t> m_indices;
+
+  [[nodiscard]] std::uint32_t get_triangles_count() const;
+  // Triangles referencing micromap data, they're the only ones running any-hit
+  [[nodiscard]] std::uint32_t get_referencing_triangles_count() const;
+  [[nodiscard]] bool is_fully_opaque() const;
+};
+
+/**
+ * Rasterizes the base colour alpha of a mesh into opacity micromaps, one per
+ * triangle, with 4^subdivision_level micro-triangles each. A micro-triangle is
+ * opaque or transparent only if every texel its footprint touches, bilinear
+ * neighbours included, passes or fails the material alpha test the same way
+ * pathtrace.rahit does. Otherwise it's unknown in 4-state micromaps, which
+ * keeps any-hit running for it, and resolved from its centre in 2-state ones.
+ * Identical micromap triangles are stored once.
+ */
+class opacity_micromap_baker final {
+ public:
+  static constexpr std::uint32_t s_max_subdivision_level = 12;
+  // Micro-triangles covering more texels than this are left unknown, instead
+  // of walking a huge footprint
+  static constexpr std::uint32_t s_max_footprint_texels = 1u << 16;
+
+ public:
+  using micro_triangle = std::array<glm::vec2, 3>;
+
+ public:
+  [[nodiscard]] static std::optional<baked_opacity_micromap> bake(
+      const mesh_asset& mesh, const material_asset& material,
+      const texture_asset& base_color_texture,
+      std::uint32_t subdivision_level, opacity_micromap_format format);
+
+  /**
+   * Corners of the micro-triangle at the given bird curve position, as the
+   * barycentrics of the base triangle's second and third vertices.
+   */
+  [[nodiscard]] static micro_triangle get_micro_triangle(
+      std::uint32_t micro_triangle_idx, std::uint32_t subdivision_level);
+
+ private:
+  static opacity_micromap_state classify(float min_alpha, float max_alpha,
+                                         float centre_alpha,
+                                         const material_asset& material,
+                                         opacity_micromap_format format);
+};
+}  // namespace wunder
+#endif  // WUNDER_OPACITY_MICROMAP_BAKER_H
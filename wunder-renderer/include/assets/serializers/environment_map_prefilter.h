@@ -0,0 +1,46 @@
+#ifndef WUNDER_ENVIRONMENT_MAP_PREFILTER_H
+#define WUNDER_ENVIRONMENT_MAP_PREFILTER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace wunder {
+struct environment_texture_asset;
+
+/**
+ * Import time precomputation of the ambient lighting terms of an equirect
+ * environment map: SH9 irradiance and a GGX prefiltered specular mip chain.
+ * Both are cheap to look up, so shading paths which can't afford importance
+ * sampling the environment get an ambient term from a single fetch.
+ */
+class environment_map_prefilter final {
+ public:
+  // Width of the first level of the prefiltered chain, the chain uses a 2:1
+  // aspect ratio like the source map
+  static constexpr std::uint32_t s_prefiltered_base_width = 512;
+  // Smallest height of the last level of the prefiltered chain
+  static constexpr std::uint32_t s_prefiltered_min_height = 4;
+  static constexpr std::uint32_t s_specular_samples_count = 64;
+
+ public:
+  static void prefilter(environment_texture_asset& asset);
+
+ private:
+  struct equirect_image {
+    std::uint32_t m_width = 0;
+    std::uint32_t m_height = 0;
+    std::vector<float> m_pixels;  // rgba
+  };
+
+ private:
+  static equirect_image downsample(const std::vector<float>& pixels,
+                                   std::uint32_t width, std::uint32_t height,
+                                   std::uint32_t target_width,
+                                   std::uint32_t target_height);
+  static void project_irradiance_sh(const equirect_image& image,
+                                    environment_texture_asset& out_asset);
+  static void prefilter_specular(const equirect_image& base_image,
+                                 environment_texture_asset& out_asset);
+};
+}  // namespace wunder
+#endif  // WUNDER_ENVIRONMENT_MAP_PREFILTER_H
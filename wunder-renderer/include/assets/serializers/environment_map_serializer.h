@@ -11,6 +11,7 @@ class environment_map_serializer final {
   struct input_data {
     uint32_t m_width, m_height, m_components;
     float* m_pixels_ptr;
+    uint64_t m_source_hash = 0;
   };
 
  public:
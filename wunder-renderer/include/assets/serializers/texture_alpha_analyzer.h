@@ -0,0 +1,31 @@
+#ifndef WUNDER_TEXTURE_ALPHA_ANALYZER_H
+#define WUNDER_TEXTURE_ALPHA_ANALYZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wunder {
+struct texture_asset;
+
+/**
+ * Import time scan of the alpha channel of base colour textures. Many assets
+ * are exported with MASK or BLEND materials over fully opaque textures, the
+ * per tile ranges let the renderer trace them as opaque, without any-hit.
+ */
+class texture_alpha_analyzer final {
+ public:
+  static constexpr std::uint32_t s_max_tiles_per_side = 16;
+
+ public:
+  static void analyze(texture_asset& asset);
+
+ private:
+  static void scan_rgba8(const std::uint8_t* texels, std::size_t count,
+                         std::uint8_t& in_out_min_alpha,
+                         std::uint8_t& in_out_max_alpha);
+  static void scan_rgba32f(const float* texels, std::size_t count,
+                           std::uint8_t& in_out_min_alpha,
+                           std::uint8_t& in_out_max_alpha);
+};
+}  // namespace wunder
+#endif  // WUNDER_TEXTURE_ALPHA_ANALYZER_H
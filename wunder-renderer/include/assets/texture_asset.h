@@ -4,6 +4,10 @@
 #include <glad/vulkan.h>
 #include <vk_mem_alloc.h>
 
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
 #include <cstdint>
 #include <limits>
 #include <optional>
@@ -47,17 +51,66 @@ struct texture_data {
 
   bool is_empty() const;
   size_t size() const;
-  void copy_to(VmaAllocation& stagingBufferAllocation) const;
+  const void* data() const;
   VkFormat get_image_format() const;
 };
 
+enum class alpha_coverage : std::uint8_t {
+  unknown,
+  opaque,
+  transparent,
+  mixed
+};
+
+/**
+ * Alpha of the base level summarized per tile, base colour textures are
+ * scanned at import. Empty when the texture wasn't scanned.
+ */
+struct texture_alpha_coverage {
+  struct alpha_range {
+    float m_min = 0.0f;
+    float m_max = 1.0f;
+  };
+
+  std::uint32_t m_tiles_x = 0;
+  std::uint32_t m_tiles_y = 0;
+  // Smallest and largest alpha of every tile, row major
+  std::vector<std::uint8_t> m_min_alpha;
+  std::vector<std::uint8_t> m_max_alpha;
+
+  [[nodiscard]] bool is_empty() const;
+  [[nodiscard]] alpha_coverage get_coverage() const;
+  /**
+   * Range of the alpha a uv rectangle may sample, bilinear neighbours
+   * included. Rectangles reaching outside [0, 1] depend on the sampler, they
+   * get the range of the whole texture.
+   */
+  [[nodiscard]] alpha_range get_alpha_range(const glm::vec2& uv_min,
+                                            const glm::vec2& uv_max) const;
+};
+
 struct texture_asset {
   texture_data m_texture_data;
   uint32_t m_width, m_height;
   std::optional<texture_sampler> m_sampler;
   std::uint32_t m_max_lod = std::numeric_limits<uint32_t>::max();
+  // Optional precomputed mip levels 1..n, each level is half the size of the
+  // previous one. When empty, the texture is created with a single level.
+  std::vector<texture_data> m_mip_chain;
+  texture_alpha_coverage m_alpha_coverage;
 };
 
-struct environment_texture_asset : public texture_asset {};
+struct environment_texture_asset : public texture_asset {
+  // Hash of the source file, keys the importance sampling tables cache. Zero
+  // when the asset doesn't come from a file.
+  std::uint64_t m_source_hash = 0;
+
+  // Irradiance projected on the first 9 SH basis functions and convolved with
+  // the clamped cosine lobe, rgb per coefficient, w is unused.
+  std::array<glm::vec4, 9> m_irradiance_sh{};
+  // Radiance prefiltered with GGX lobes, roughness grows linearly from 0 at
+  // the first level to 1 at the last one.
+  texture_asset m_prefiltered_specular{};
+};
 }  // namespace wunder
 #endif  // WUNDER_TEXTURE_ASSET_H
@@ -13,9 +13,15 @@ struct aabb {
   aabb(const glm::vec3& min, const glm::vec3& max) : m_min(min), m_max(max) {}
   aabb(const std::vector<glm::vec3>& corners);
 
+  /** Inverted box, inserting anything into it results in exactly its bounds. */
+  [[nodiscard]] static aabb empty();
+
  public:
   [[nodiscard]] glm::vec3 size() const { return m_max - m_min; }
   [[nodiscard]] glm::vec3 center() const { return m_min + size() * 0.5f; }
+  [[nodiscard]] bool is_empty() const;
+  [[nodiscard]] float surface_area() const;
+  [[nodiscard]] bool overlaps(const aabb& other) const;
 
   void insert(const glm::vec3& vertex);
   void insert(const aabb& box);
@@ -0,0 +1,499 @@
+#ifndef WUNDER_BVH_H
+#define WUNDER_BVH_H
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "assets/asset_types.h"
+#include "core/aabb.h"
+#include "core/wunder_macros.h"
+#include "core/wunder_memory.h"
+
+namespace wunder {
+class asset_storage;
+class scene_asset;
+struct mesh_asset;
+
+struct ray {
+  glm::vec3 m_origin{0.0f};
+  glm::vec3 m_direction{0.0f, 0.0f, 1.0f};
+  float m_t_min = 0.0f;
+  float m_t_max = std::numeric_limits<float>::max();
+};
+
+struct ray_hit {
+  static constexpr std::uint32_t k_invalid_idx =
+      std::numeric_limits<std::uint32_t>::max();
+
+  float m_t = std::numeric_limits<float>::max();
+  // Barycentrics of the second and the third vertex of the triangle
+  float m_u = 0.0f;
+  float m_v = 0.0f;
+  // Triangle of the mesh, in the order of its indices
+  std::uint32_t m_primitive_idx = k_invalid_idx;
+  std::uint32_t m_instance_idx = k_invalid_idx;
+
+  [[nodiscard]] bool is_valid() const {
+    return m_primitive_idx != k_invalid_idx;
+  }
+};
+
+/**
+ * Rays traced together, in SoA layout so a node or a triangle is tested
+ * against all of them at once. Every lane keeps its own interval, which the
+ * closest hit queries shrink as they find hits.
+ */
+struct ray_packet {
+  static constexpr std::uint32_t k_size = 4;
+  static constexpr std::uint32_t k_all_lanes = (1u << k_size) - 1;
+
+  alignas(16) std::array<float, k_size> m_origin_x{};
+  alignas(16) std::array<float, k_size> m_origin_y{};
+  alignas(16) std::array<float, k_size> m_origin_z{};
+  alignas(16) std::array<float, k_size> m_direction_x{};
+  alignas(16) std::array<float, k_size> m_direction_y{};
+  alignas(16) std::array<float, k_size> m_direction_z{};
+  alignas(16) std::array<float, k_size> m_inverse_direction_x{};
+  alignas(16) std::array<float, k_size> m_inverse_direction_y{};
+  alignas(16) std::array<float, k_size> m_inverse_direction_z{};
+  alignas(16) std::array<float, k_size> m_t_min{};
+  alignas(16) std::array<float, k_size> m_t_max{};
+  // Lanes holding a ray, the others are never traced
+  std::uint32_t m_lanes = 0;
+
+  void set_ray(std::uint32_t lane, const ray& lane_ray);
+  [[nodiscard]] ray get_ray(std::uint32_t lane) const;
+};
+
+struct bvh_node {
+  aabb m_bounds;
+  // Inner nodes point to their first child, the second one follows it. Leaves
+  // point to their first primitive reference.
+  std::uint32_t m_first = 0;
+  // Primitive references of a leaf, 0 for inner nodes
+  std::uint32_t m_count = 0;
+
+  [[nodiscard]] bool is_leaf() const { return m_count > 0; }
+};
+
+/**
+ * Bounding volume hierarchy over the bounds of arbitrary primitives, built
+ * with binned SAH. The first levels are split with every thread binning a
+ * part of the node, the subtrees below them are then built in parallel. Each
+ * subtree owns a disjoint range of primitive references and its nodes are
+ * taken from one preallocated array, so the build doesn't need any locking.
+ * Leaves point to references, get_primitive_idx maps them to primitives.
+ */
+class bvh {
+ public:
+  static constexpr std::uint32_t s_bins_count = 16;
+  static constexpr std::uint32_t s_max_leaf_size = 8;
+  // Nodes this deep are leaves whatever their size, bounds traversal stacks
+  static constexpr std::uint32_t s_max_depth = 64;
+  // Smaller nodes are split by a single thread
+  static constexpr std::uint32_t s_parallel_build_min_size = 4096;
+  // Cost of visiting a node relative to intersecting a primitive
+  static constexpr float s_traversal_cost = 1.0f;
+
+ public:
+  void build(const std::vector<aabb>& primitives_bounds);
+
+  [[nodiscard]] bool is_empty() const { return m_nodes.empty(); }
+  [[nodiscard]] aabb get_bounds() const;
+  [[nodiscard]] std::uint32_t get_nodes_count() const;
+  [[nodiscard]] std::uint32_t get_primitive_idx(
+      std::uint32_t reference_idx) const {
+    return m_references[reference_idx];
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& get_references() const {
+    return m_references;
+  }
+
+  /**
+   * Visits the leaves the ray hits, nearest first, and calls
+   * intersect_reference(reference_idx) for every reference they hold. The
+   * callback shrinks t_max when it finds a hit and returns true to stop the
+   * traversal.
+   */
+  template <typename intersect_function>
+  void traverse(const glm::vec3& origin, const glm::vec3& inverse_direction,
+                float t_min, const float& t_max,
+                intersect_function&& intersect_reference) const;
+
+  /**
+   * Packet variant, a node is visited when any of lanes hits it.
+   * intersect_reference(reference_idx, lanes) tests the lanes still traced and
+   * returns the ones which are done, those are dropped from the traversal.
+   */
+  template <typename intersect_function>
+  void traverse(const ray_packet& packet, std::uint32_t lanes,
+                intersect_function&& intersect_reference) const;
+
+  /**
+   * Calls on_reference(reference_idx) for every reference of the leaves whose
+   * bounds overlap box.
+   */
+  template <typename overlap_function>
+  void overlap(const aabb& box, overlap_function&& on_reference) const;
+
+ private:
+  struct build_task {
+    std::uint32_t m_node_idx = 0;
+    std::uint32_t m_first = 0;
+    std::uint32_t m_count = 0;
+    std::uint32_t m_depth = 0;
+  };
+
+  struct bin {
+    aabb m_bounds = aabb::empty();
+    std::uint32_t m_count = 0;
+  };
+
+  using axis_bins = std::array<bin, s_bins_count>;
+
+  struct build_context;
+
+ private:
+  std::uint32_t split(build_context& context, const build_task& task,
+                      std::size_t chunks_count,
+                      std::array<build_task, 2>& out_children);
+  void build_subtree(build_context& context, const build_task& task);
+
+  static bool intersect(const aabb& bounds, const glm::vec3& origin,
+                        const glm::vec3& inverse_direction, float t_min,
+                        float t_max, float& out_t_entry);
+  static std::uint32_t intersect(const aabb& bounds, const ray_packet& packet,
+                                 std::uint32_t lanes, float& out_t_entry);
+
+ private:
+  std::vector<bvh_node> m_nodes;
+  std::vector<std::uint32_t> m_references;
+};
+
+/**
+ * Bottom level hierarchy, over the triangles of a mesh in object space. The
+ * triangle positions are copied in leaf order, hits report the triangle
+ * index in the mesh.
+ */
+class triangle_bvh {
+ public:
+  void build(const mesh_asset& mesh);
+
+  /**
+   * Closest hit closer than both ray.m_t_max and in_out_hit.m_t, in_out_hit is
+   * only updated when one is found.
+   */
+  bool intersect(const ray& query_ray, ray_hit& in_out_hit) const;
+  [[nodiscard]] bool occluded(const ray& query_ray) const;
+
+  /**
+   * Lanes which hit a triangle shrink their m_t_max to the hit distance and
+   * fill their hit. Returns the lanes which hit anything.
+   */
+  std::uint32_t intersect(ray_packet& packet,
+                          std::array<ray_hit, ray_packet::k_size>& hits) const;
+  // Returns the occluded lanes
+  [[nodiscard]] std::uint32_t occluded(const ray_packet& packet) const;
+
+  // Triangles whose bounds overlap box
+  void overlap(const aabb& box,
+               const std::function<void(std::uint32_t triangle_idx)>&
+                   on_triangle) const;
+
+  [[nodiscard]] aabb get_bounds() const { return m_bvh.get_bounds(); }
+  [[nodiscard]] std::uint32_t get_triangles_count() const;
+  [[nodiscard]] std::uint32_t get_nodes_count() const {
+    return m_bvh.get_nodes_count();
+  }
+
+ private:
+  using triangle = std::array<glm::vec3, 3>;
+
+ private:
+  static bool intersect_triangle(const triangle& positions,
+                                 const glm::vec3& origin,
+                                 const glm::vec3& direction, float t_min,
+                                 float t_max, float& out_t, float& out_u,
+                                 float& out_v);
+  static std::uint32_t intersect_triangle(
+      const triangle& positions, const ray_packet& packet, std::uint32_t lanes,
+      std::array<float, ray_packet::k_size>& out_t,
+      std::array<float, ray_packet::k_size>& out_u,
+      std::array<float, ray_packet::k_size>& out_v);
+
+ private:
+  bvh m_bvh;
+  std::vector<triangle> m_triangles;
+};
+
+struct bvh_instance {
+  shared_ptr<const triangle_bvh> m_bvh;
+  asset_handle m_mesh_handle = asset_handle::invalid();
+  glm::mat4 m_world_matrix{1.0f};
+  glm::mat4 m_inverse_world_matrix{1.0f};
+};
+
+/**
+ * Top level hierarchy, over the instances of mesh hierarchies placed in the
+ * world. Rays are moved into the object space of every instance they reach,
+ * directions aren't renormalized, so hit distances stay in world space.
+ */
+class scene_bvh {
+ public:
+  /**
+   * Builds one triangle_bvh per mesh the scene references, meshes in
+   * parallel, and the top level hierarchy over the mesh nodes.
+   */
+  void build(const scene_asset& scene, const asset_storage& storage);
+
+  std::uint32_t add_instance(shared_ptr<const triangle_bvh> mesh_bvh,
+                             asset_handle mesh_handle,
+                             const glm::mat4& world_matrix);
+  void set_world_matrix(std::uint32_t instance_idx,
+                        const glm::mat4& world_matrix);
+  // Rebuilds the top level over the instances, mesh hierarchies are kept
+  void build_top_level();
+
+  bool intersect(const ray& query_ray, ray_hit& in_out_hit) const;
+  [[nodiscard]] bool occluded(const ray& query_ray) const;
+  std::uint32_t intersect(ray_packet& packet,
+                          std::array<ray_hit, ray_packet::k_size>& hits) const;
+  [[nodiscard]] std::uint32_t occluded(const ray_packet& packet) const;
+
+  /**
+   * Triangles whose object space bounds overlap box moved into the object
+   * space of their instance, a conservative test for rotated instances.
+   */
+  void overlap(const aabb& box,
+               const std::function<void(std::uint32_t instance_idx,
+                                        std::uint32_t triangle_idx)>&
+                   on_triangle) const;
+
+  [[nodiscard]] const std::vector<bvh_instance>& get_instances() const {
+    return m_instances;
+  }
+  [[nodiscard]] aabb get_bounds() const { return m_bvh.get_bounds(); }
+
+ private:
+  static ray to_object_space(const bvh_instance& instance,
+                             const ray& world_ray);
+  static void to_object_space(const bvh_instance& instance,
+                              const ray_packet& world_packet,
+                              ray_packet& out_object_packet);
+
+ private:
+  bvh m_bvh;
+  std::vector<bvh_instance> m_instances;
+};
+
+inline bool bvh::intersect(const aabb& bounds, const glm::vec3& origin,
+                           const glm::vec3& inverse_direction, float t_min,
+                           float t_max, float& out_t_entry) {
+  const glm::vec3 t_to_min = (bounds.m_min - origin) * inverse_direction;
+  const glm::vec3 t_to_max = (bounds.m_max - origin) * inverse_direction;
+  const glm::vec3 t_entry = glm::min(t_to_min, t_to_max);
+  const glm::vec3 t_exit = glm::max(t_to_min, t_to_max);
+
+  out_t_entry = std::max({t_entry.x, t_entry.y, t_entry.z, t_min});
+  return out_t_entry <= std::min({t_exit.x, t_exit.y, t_exit.z, t_max});
+}
+
+inline std::uint32_t bvh::intersect(const aabb& bounds,
+                                    const ray_packet& packet,
+                                    std::uint32_t lanes, float& out_t_entry) {
+  alignas(16) std::array<float, ray_packet::k_size> t_entries{};
+  std::uint32_t hit_lanes = 0;
+
+#if defined(__SSE2__)
+  __m128 t_entry = _mm_load_ps(packet.m_t_min.data());
+  __m128 t_exit = _mm_load_ps(packet.m_t_max.data());
+  auto clip_slab = [&t_entry, &t_exit](float min, float max, const float* origin,
+                                       const float* inverse_direction) {
+    const __m128 origins = _mm_load_ps(origin);
+    const __m128 inverse_directions = _mm_load_ps(inverse_direction);
+    const __m128 t_to_min = _mm_mul_ps(
+        _mm_sub_ps(_mm_set1_ps(min), origins), inverse_directions);
+    const __m128 t_to_max = _mm_mul_ps(
+        _mm_sub_ps(_mm_set1_ps(max), origins), inverse_directions);
+    t_entry = _mm_max_ps(t_entry, _mm_min_ps(t_to_min, t_to_max));
+    t_exit = _mm_min_ps(t_exit, _mm_max_ps(t_to_min, t_to_max));
+  };
+  clip_slab(bounds.m_min.x, bounds.m_max.x, packet.m_origin_x.data(),
+            packet.m_inverse_direction_x.data());
+  clip_slab(bounds.m_min.y, bounds.m_max.y, packet.m_origin_y.data(),
+            packet.m_inverse_direction_y.data());
+  clip_slab(bounds.m_min.z, bounds.m_max.z, packet.m_origin_z.data(),
+            packet.m_inverse_direction_z.data());
+
+  hit_lanes =
+      static_cast<std::uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t_entry, t_exit))) &
+      lanes;
+  _mm_store_ps(t_entries.data(), t_entry);
+#else
+  for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+    ContinueUnless(lanes & (1u << lane));
+
+    const glm::vec3 origin(packet.m_origin_x[lane], packet.m_origin_y[lane],
+                           packet.m_origin_z[lane]);
+    const glm::vec3 inverse_direction(packet.m_inverse_direction_x[lane],
+                                      packet.m_inverse_direction_y[lane],
+                                      packet.m_inverse_direction_z[lane]);
+    if (intersect(bounds, origin, inverse_direction, packet.m_t_min[lane],
+                  packet.m_t_max[lane], t_entries[lane])) {
+      hit_lanes |= 1u << lane;
+    }
+  }
+#endif
+
+  out_t_entry = std::numeric_limits<float>::max();
+  for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+    if (hit_lanes & (1u << lane)) {
+      out_t_entry = std::min(out_t_entry, t_entries[lane]);
+    }
+  }
+
+  return hit_lanes;
+}
+
+template <typename intersect_function>
+void bvh::traverse(const glm::vec3& origin, const glm::vec3& inverse_direction,
+                   float t_min, const float& t_max,
+                   intersect_function&& intersect_reference) const {
+  struct stack_entry {
+    std::uint32_t m_node_idx;
+    float m_t_entry;
+  };
+
+  ReturnIf(m_nodes.empty());
+  float root_t_entry = 0.0f;
+  ReturnUnless(intersect(m_nodes.front().m_bounds, origin, inverse_direction,
+                         t_min, t_max, root_t_entry));
+
+  std::array<stack_entry, s_max_depth> stack;
+  std::uint32_t stack_size = 0;
+  std::uint32_t node_idx = 0;
+  while (true) {
+    const bvh_node& node = m_nodes[node_idx];
+    if (node.is_leaf()) {
+      for (std::uint32_t reference_idx = node.m_first;
+           reference_idx < node.m_first + node.m_count; ++reference_idx) {
+        ReturnIf(intersect_reference(reference_idx));
+      }
+    } else {
+      float left_t_entry = 0.0f;
+      float right_t_entry = 0.0f;
+      const bool hits_left =
+          intersect(m_nodes[node.m_first].m_bounds, origin, inverse_direction,
+                    t_min, t_max, left_t_entry);
+      const bool hits_right =
+          intersect(m_nodes[node.m_first + 1].m_bounds, origin,
+                    inverse_direction, t_min, t_max, right_t_entry);
+
+      if (hits_left && hits_right) {
+        const bool left_is_nearer = left_t_entry <= right_t_entry;
+        stack[stack_size++] =
+            left_is_nearer ? stack_entry{node.m_first + 1, right_t_entry}
+                           : stack_entry{node.m_first, left_t_entry};
+        node_idx = left_is_nearer ? node.m_first : node.m_first + 1;
+        continue;
+      }
+      if (hits_left || hits_right) {
+        node_idx = hits_left ? node.m_first : node.m_first + 1;
+        continue;
+      }
+    }
+
+    // Nodes pushed before a closer hit was found may be behind it by now
+    do {
+      ReturnIf(stack_size == 0);
+      --stack_size;
+    } while (stack[stack_size].m_t_entry > t_max);
+    node_idx = stack[stack_size].m_node_idx;
+  }
+}
+
+template <typename intersect_function>
+void bvh::traverse(const ray_packet& packet, std::uint32_t lanes,
+                   intersect_function&& intersect_reference) const {
+  ReturnIf(m_nodes.empty());
+  float root_t_entry = 0.0f;
+  lanes = intersect(m_nodes.front().m_bounds, packet, lanes, root_t_entry);
+  ReturnIf(lanes == 0);
+
+  std::array<std::uint32_t, s_max_depth> stack;
+  std::uint32_t stack_size = 0;
+  std::uint32_t node_idx = 0;
+  while (true) {
+    const bvh_node& node = m_nodes[node_idx];
+    if (node.is_leaf()) {
+      for (std::uint32_t reference_idx = node.m_first;
+           reference_idx < node.m_first + node.m_count; ++reference_idx) {
+        lanes &= ~intersect_reference(reference_idx, lanes);
+        ReturnIf(lanes == 0);
+      }
+    } else {
+      float left_t_entry = 0.0f;
+      float right_t_entry = 0.0f;
+      const std::uint32_t left_lanes = intersect(
+          m_nodes[node.m_first].m_bounds, packet, lanes, left_t_entry);
+      const std::uint32_t right_lanes = intersect(
+          m_nodes[node.m_first + 1].m_bounds, packet, lanes, right_t_entry);
+
+      if (left_lanes != 0 && right_lanes != 0) {
+        const bool left_is_nearer = left_t_entry <= right_t_entry;
+        stack[stack_size++] = left_is_nearer ? node.m_first + 1 : node.m_first;
+        node_idx = left_is_nearer ? node.m_first : node.m_first + 1;
+        continue;
+      }
+      if (left_lanes != 0 || right_lanes != 0) {
+        node_idx = left_lanes != 0 ? node.m_first : node.m_first + 1;
+        continue;
+      }
+    }
+
+    // Lanes shrink their intervals on hits, pushed nodes are tested again
+    float t_entry = 0.0f;
+    do {
+      ReturnIf(stack_size == 0);
+      node_idx = stack[--stack_size];
+    } while (intersect(m_nodes[node_idx].m_bounds, packet, lanes, t_entry) ==
+             0);
+  }
+}
+
+template <typename overlap_function>
+void bvh::overlap(const aabb& box, overlap_function&& on_reference) const {
+  ReturnIf(m_nodes.empty());
+
+  std::array<std::uint32_t, s_max_depth + 1> stack;
+  std::uint32_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    const bvh_node& node = m_nodes[stack[--stack_size]];
+    ContinueUnless(node.m_bounds.overlaps(box));
+
+    if (node.is_leaf()) {
+      for (std::uint32_t reference_idx = node.m_first;
+           reference_idx < node.m_first + node.m_count; ++reference_idx) {
+        on_reference(reference_idx);
+      }
+    } else {
+      stack[stack_size++] = node.m_first + 1;
+      stack[stack_size++] = node.m_first;
+    }
+  }
+}
+}  // namespace wunder
+#endif  // WUNDER_BVH_H
@@ -0,0 +1,41 @@
+#ifndef WUNDER_FILE_WATCHER_H
+#define WUNDER_FILE_WATCHER_H
+
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "core/non_copyable.h"
+
+namespace wunder {
+
+/**
+ * Watches a directory tree for files which were written or moved into it.
+ * Backed by inotify, on other platforms the watcher never reports changes.
+ * Polling doesn't block, so it can be done once per frame.
+ */
+class file_watcher : public non_copyable {
+ public:
+  explicit file_watcher(std::filesystem::path root_directory);
+  ~file_watcher() override;
+
+ public:
+  [[nodiscard]] bool is_watching() const { return m_inotify_fd >= 0; }
+
+  /**
+   * Returns the files changed since the last poll, each of them once, no
+   * matter how many events the editor generated while saving it.
+   */
+  [[nodiscard]] std::vector<std::filesystem::path> poll_changes();
+
+ private:
+  void add_watch_recursive(const std::filesystem::path& directory);
+  void add_watch(const std::filesystem::path& directory);
+
+ private:
+  std::filesystem::path m_root_directory;
+  int m_inotify_fd = -1;
+  std::unordered_map<int, std::filesystem::path> m_watched_directories;
+};
+}  // namespace wunder
+#endif  // WUNDER_FILE_WATCHER_H
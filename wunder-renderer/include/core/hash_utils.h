@@ -0,0 +1,30 @@
+#ifndef WUNDER_HASH_UTILS_H
+#define WUNDER_HASH_UTILS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace wunder::hash::utils {
+
+constexpr std::uint64_t k_fnv_offset_basis = 0xcbf29ce484222325ull;
+
+/**
+ * 64-bit FNV-1a, stable across runs and platforms so it can be used as a key
+ * for on-disk caches.
+ */
+std::uint64_t fnv1a_64(const void* data, std::size_t size,
+                       std::uint64_t seed = k_fnv_offset_basis);
+
+std::uint64_t fnv1a_64(const std::string& data,
+                       std::uint64_t seed = k_fnv_offset_basis);
+
+std::optional<std::uint64_t> hash_file(const std::filesystem::path& path);
+
+std::string hash_to_string(std::uint64_t hash);
+
+}  // namespace wunder::hash::utils
+
+#endif  // WUNDER_HASH_UTILS_H
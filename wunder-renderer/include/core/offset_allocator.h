@@ -0,0 +1,92 @@
+#ifndef WUNDER_OFFSET_ALLOCATOR_H
+#define WUNDER_OFFSET_ALLOCATOR_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace wunder {
+
+/**
+ * Hands out ranges of an externally owned storage, e.g. a GPU buffer. Sizes
+ * and offsets are in abstract units chosen by the owner (vertices, indices,
+ * bytes...). Free ranges are kept in two level segregated fit bins (TLSF), so
+ * allocation and free are O(1) and freed neighbours are merged right away.
+ */
+class offset_allocator {
+ public:
+  static constexpr std::uint32_t s_invalid_offset = 0xffffffffu;
+
+  struct allocation {
+    std::uint32_t m_offset = s_invalid_offset;
+    std::uint32_t m_size = 0;
+    std::uint32_t m_node = s_invalid_offset;
+
+    [[nodiscard]] bool is_valid() const { return m_offset != s_invalid_offset; }
+  };
+
+  struct storage_report {
+    std::uint32_t m_free_size = 0;
+    std::uint32_t m_largest_free_region = 0;
+    std::uint32_t m_free_regions_count = 0;
+
+    /**
+     * 0 when all the free space is one region, close to 1 when it's split in
+     * many small ones.
+     */
+    [[nodiscard]] float fragmentation() const;
+  };
+
+ public:
+  explicit offset_allocator(std::uint32_t size);
+
+ public:
+  [[nodiscard]] allocation allocate(std::uint32_t size);
+  void free(const allocation& allocation);
+
+  [[nodiscard]] std::uint32_t get_size() const { return m_size; }
+  [[nodiscard]] storage_report get_storage_report() const;
+
+ private:
+  static constexpr std::uint32_t s_second_level_bits = 3;
+  static constexpr std::uint32_t s_second_level_count = 1u
+                                                        << s_second_level_bits;
+  static constexpr std::uint32_t s_first_level_count =
+      32 - s_second_level_bits + 1;
+  static constexpr std::uint32_t s_bins_count =
+      s_first_level_count * s_second_level_count;
+
+  struct node {
+    std::uint32_t m_offset = 0;
+    std::uint32_t m_size = 0;
+    std::uint32_t m_bin_previous = s_invalid_offset;
+    std::uint32_t m_bin_next = s_invalid_offset;
+    std::uint32_t m_neighbour_previous = s_invalid_offset;
+    std::uint32_t m_neighbour_next = s_invalid_offset;
+    bool m_is_used = false;
+  };
+
+ private:
+  [[nodiscard]] static std::uint32_t bin_round_down(std::uint32_t size);
+  [[nodiscard]] static std::uint32_t bin_round_up(std::uint32_t size);
+  [[nodiscard]] std::uint32_t find_free_bin(std::uint32_t min_bin) const;
+
+  std::uint32_t insert_free_node(std::uint32_t offset, std::uint32_t size);
+  void insert_into_bin(std::uint32_t node_index);
+  void remove_from_bin(std::uint32_t node_index);
+  void release_node(std::uint32_t node_index);
+
+ private:
+  std::uint32_t m_size;
+  std::uint32_t m_free_size = 0;
+  std::uint32_t m_free_regions_count = 0;
+
+  std::uint32_t m_first_level_mask = 0;
+  std::array<std::uint8_t, s_first_level_count> m_second_level_masks{};
+  std::array<std::uint32_t, s_bins_count> m_bin_heads{};
+
+  std::vector<node> m_nodes;
+  std::vector<std::uint32_t> m_unused_nodes;
+};
+}  // namespace wunder
+#endif  // WUNDER_OFFSET_ALLOCATOR_H
@@ -0,0 +1,66 @@
+#ifndef WUNDER_PARALLEL_FOR_H
+#define WUNDER_PARALLEL_FOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace wunder {
+
+/**
+ * Number of chunks a range of [count] elements is split into, so that every
+ * chunk holds at least [min_chunk_size] elements.
+ */
+inline std::size_t get_parallel_chunks_count(std::size_t count,
+                                             std::size_t min_chunk_size) {
+  std::size_t hardware_threads =
+      std::max<std::size_t>(1, std::thread::hardware_concurrency());
+  std::size_t max_chunks =
+      std::max<std::size_t>(1, count / std::max<std::size_t>(1, min_chunk_size));
+
+  return std::min(hardware_threads, max_chunks);
+}
+
+/**
+ * Splits [0, count) into [chunks_count] contiguous chunks and invokes
+ * function(chunk_idx, begin, end) for each of them. The last chunk is run on
+ * the calling thread. Chunk boundaries depend only on count and chunks_count,
+ * so two passes with the same arguments see the same split.
+ */
+template <typename function_type>
+void parallel_for_chunks(std::size_t count, std::size_t chunks_count,
+                         function_type&& function) {
+  if (count == 0) {
+    return;
+  }
+
+  chunks_count = std::clamp<std::size_t>(chunks_count, 1, count);
+  const std::size_t chunk_size = (count + chunks_count - 1) / chunks_count;
+
+  std::vector<std::jthread> workers;
+  workers.reserve(chunks_count - 1);
+  for (std::size_t chunk_idx = 0; chunk_idx + 1 < chunks_count; ++chunk_idx) {
+    const std::size_t begin = std::min(count, chunk_idx * chunk_size);
+    const std::size_t end = std::min(count, begin + chunk_size);
+    workers.emplace_back(
+        [&function, chunk_idx, begin, end]() { function(chunk_idx, begin, end); });
+  }
+
+  const std::size_t last_begin =
+      std::min(count, (chunks_count - 1) * chunk_size);
+  function(chunks_count - 1, last_begin, count);
+}
+
+template <typename function_type>
+void parallel_for(std::size_t count, function_type&& function,
+                  std::size_t min_chunk_size = 4096) {
+  parallel_for_chunks(
+      count, get_parallel_chunks_count(count, min_chunk_size),
+      [&function](std::size_t /*chunk_idx*/, std::size_t begin,
+                  std::size_t end) { function(begin, end); });
+}
+
+}  // namespace wunder
+
+#endif  // WUNDER_PARALLEL_FOR_H
@@ -4,5 +4,12 @@
 #define PRINT_STATE_FRAME 0
 #define PRINT_ALLOCATED_SCENE_SIZE 0
 #define PRINT_CAMERA_ANGLES 0
+#define SHADER_HOT_RELOAD 1
+#define COMPACT_BOTTOM_LEVEL_ACCELERATION_STRUCTURES 1
+#define OPACITY_MICROMAPS 1
+// 4^level micro-triangles per triangle
+#define OPACITY_MICROMAP_SUBDIVISION_LEVEL 4
+// 2 for 4-state micromaps, 1 for 2-state ones, which never run any-hit
+#define OPACITY_MICROMAP_FORMAT 2
 
 #endif //WUNDER_FEATURES_H
@@ -17,6 +17,20 @@ class wunder_filesystem {
   void set_work_dir(std::filesystem::path work_dir);
 
   std::filesystem::path resolve_path(const std::filesystem::path& resource_path);
+
+  /**
+   * Directory for data derived from assets (environment tables, shader
+   * binaries, pipeline caches), created on demand. [sub_directory] is
+   * appended to the cache root.
+   */
+  std::filesystem::path get_cache_dir(
+      const std::filesystem::path& sub_directory = {});
+
+  /**
+   * Directory of the running executable, the current directory where the
+   * platform can't tell.
+   */
+  std::filesystem::path get_executable_dir() const;
  private:
   std::filesystem::path m_work_dir;
 };
@@ -1,13 +1,35 @@
-
 #ifndef VULKAN_EVENTS_H
 #define VULKAN_EVENTS_H
 
+#include <cstdint>
+#include <vector>
+
+#include "assets/components/scene_components.h"
+
 namespace wunder::event::vulkan {
 
 class renderer_shutdown {
 
 };
 
+/**
+ * Sent by the scene loading thread once the bottom level acceleration
+ * structures of a scene are built, one entry per build policy used.
+ */
+struct bottom_level_acceleration_structures_built {
+  struct policy_statistics {
+    acceleration_structure_build_policy m_policy =
+        acceleration_structure_build_policy::automatic;
+    std::uint32_t m_structures_count = 0;
+    std::uint64_t m_build_size = 0;
+    std::uint64_t m_compacted_size = 0;
+    // 0 when the device can't time compute queues
+    double m_build_time_ms = 0.0;
+  };
+
+  std::vector<policy_statistics> m_policies;
+};
+
 }
 
 #endif //VULKAN_EVENTS_H
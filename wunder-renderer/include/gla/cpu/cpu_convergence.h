@@ -0,0 +1,69 @@
+#ifndef WUNDER_CPU_CONVERGENCE_H
+#define WUNDER_CPU_CONVERGENCE_H
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "gla/cpu/cpu_render_target.h"
+
+namespace wunder::cpu {
+// convergenceLuminance of convergence.glsl
+float convergence_luminance(const glm::vec3& color);
+
+// convergenceError of convergence.glsl
+float convergence_error(const glm::vec4& moments, int frames);
+
+/**
+ * Adaptive sampling of pathtrace.rgen and convergence.glsl. Fed with the
+ * estimate every frame traced per pixel, accumulates them and the luminance
+ * moments as the ray generation shader does and stops accumulating a tile
+ * once all its pixels reached the threshold, so the image is the one the
+ * adaptively sampled dispatches leave behind for the same frames.
+ */
+class convergence_tracker {
+ public:
+  convergence_tracker(std::uint32_t width, std::uint32_t height,
+                      float threshold, int min_frames);
+
+ public:
+  // frame is the RtxState::frame the estimate was traced with, 0 restarts
+  void add_frame(const render_target& estimate, int frame);
+
+  [[nodiscard]] bool is_converged() const;
+  [[nodiscard]] const render_target& get_image() const { return m_image; }
+
+  // Estimated relative error of the accumulated pixel
+  [[nodiscard]] float get_pixel_error(std::uint32_t x, std::uint32_t y) const;
+
+  [[nodiscard]] std::uint32_t get_tiles_count() const;
+  [[nodiscard]] std::uint32_t get_tile_idx(std::uint32_t x,
+                                           std::uint32_t y) const;
+  // Frames accumulated once it stopped, 0 while it's still traced
+  [[nodiscard]] int get_tile_converged_frames(std::uint32_t tile_idx) const {
+    return m_tile_converged_frames[tile_idx];
+  }
+
+  // Pixels traced by all frames so far, to compare with tracing every one
+  [[nodiscard]] std::uint64_t get_traced_pixels_count() const {
+    return m_traced_pixels_count;
+  }
+
+ private:
+  std::uint32_t m_tiles_x;
+  std::uint32_t m_tiles_y;
+  float m_threshold;
+  int m_min_frames;
+
+  render_target m_image;
+  std::vector<glm::vec4> m_moments;
+  std::vector<int> m_tile_converged_frames;
+  std::uint32_t m_unconverged_tiles_count = 0;
+  std::uint64_t m_traced_pixels_count = 0;
+  int m_frames_count = 0;
+};
+}  // namespace wunder::cpu
+
+#endif  // WUNDER_CPU_CONVERGENCE_H
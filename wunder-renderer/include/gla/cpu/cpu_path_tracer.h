@@ -0,0 +1,40 @@
+#ifndef WUNDER_CPU_PATH_TRACER_H
+#define WUNDER_CPU_PATH_TRACER_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "resources/shaders/host_device.h"
+
+namespace wunder::cpu {
+class scene;
+class render_target;
+
+struct render_statistics {
+  // Closest and any hit rays, primary ones included
+  std::uint64_t m_rays_count = 0;
+  std::uint64_t m_samples_count = 0;
+  std::chrono::duration<double> m_duration{0.0};
+
+  [[nodiscard]] double get_mrays_per_second() const;
+  [[nodiscard]] double get_msamples_per_second() const;
+};
+
+/**
+ * Reference implementation of the ray tracing pipeline, pathtrace.rgen and
+ * the shaders it includes traced against the CPU bounding volume hierarchy.
+ * A frame gives the image one dispatch with the same RtxState writes, so the
+ * two can be compared for the same seeds. 2x2 pixel quads trace their
+ * primary rays as one packet, every pixel keeps its own random sequence and
+ * continues its path alone. Rows of quads are spread over the threads.
+ *
+ * Debug modes aren't supported, every frame renders radiance.
+ */
+class path_tracer {
+ public:
+  render_statistics render(const scene& scene, const SceneCamera& camera,
+                           const RtxState& state, render_target& target) const;
+};
+}  // namespace wunder::cpu
+
+#endif  // WUNDER_CPU_PATH_TRACER_H
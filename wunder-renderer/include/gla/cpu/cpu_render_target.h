@@ -0,0 +1,42 @@
+#ifndef WUNDER_CPU_RENDER_TARGET_H
+#define WUNDER_CPU_RENDER_TARGET_H
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace wunder::cpu {
+/**
+ * Linear radiance the CPU path tracer accumulates into, the counterpart of
+ * the rtxGeneratedImage storage image.
+ */
+class render_target {
+ public:
+  render_target(std::uint32_t width, std::uint32_t height);
+
+ public:
+  [[nodiscard]] std::uint32_t get_width() const { return m_width; }
+  [[nodiscard]] std::uint32_t get_height() const { return m_height; }
+
+  [[nodiscard]] const glm::vec3& get_pixel(std::uint32_t x,
+                                           std::uint32_t y) const;
+  void set_pixel(std::uint32_t x, std::uint32_t y, const glm::vec3& radiance);
+
+  /**
+   * Uncompressed 32 bit float scanline OpenEXR, for comparisons against the
+   * golden images.
+   */
+  bool write_exr(const std::filesystem::path& path) const;
+  // 8 bit sRGB approximation, clamped, for looking at
+  bool write_png(const std::filesystem::path& path) const;
+
+ private:
+  std::uint32_t m_width;
+  std::uint32_t m_height;
+  std::vector<glm::vec3> m_pixels;
+};
+}  // namespace wunder::cpu
+
+#endif  // WUNDER_CPU_RENDER_TARGET_H
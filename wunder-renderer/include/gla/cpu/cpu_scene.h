@@ -0,0 +1,90 @@
+#ifndef WUNDER_CPU_SCENE_H
+#define WUNDER_CPU_SCENE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "assets/asset_types.h"
+#include "core/bvh.h"
+#include "core/non_copyable.h"
+#include "core/wunder_memory.h"
+#include "resources/shaders/host_device.h"
+
+namespace wunder {
+class asset_storage;
+class scene_asset;
+struct environment_texture_asset;
+struct texture_asset;
+}  // namespace wunder
+
+namespace wunder::cpu {
+/**
+ * Inputs of the CPU reference path tracer. Materials, lights and environment
+ * tables are the host structures vulkan::scene uploads, built by the same
+ * resource creators. Vertices and indices of all meshes are concatenated the
+ * way the geometry arenas hold them, InstanceData offsets point into them and
+ * the instances follow the order of the bounding volume hierarchy instances.
+ * Textures and the environment are referenced, the storage outlives the scene.
+ */
+class scene : public non_copyable {
+ public:
+  bool load_scene(const scene_asset& asset, const asset_storage& storage);
+
+ public:
+  [[nodiscard]] const scene_bvh& get_bvh() const { return m_bvh; }
+  [[nodiscard]] const std::vector<InstanceData>& get_instances() const {
+    return m_instances;
+  }
+  [[nodiscard]] const std::vector<vertex>& get_vertices() const {
+    return m_vertices;
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& get_indices() const {
+    return m_indices;
+  }
+  [[nodiscard]] const std::vector<GltfShadeMaterial>& get_materials() const {
+    return m_materials;
+  }
+  // Indexed by the texture indices of the materials
+  [[nodiscard]] const std::vector<const_ref<texture_asset>>& get_textures()
+      const {
+    return m_textures;
+  }
+  [[nodiscard]] const std::vector<Light>& get_lights() const {
+    return m_lights;
+  }
+
+  // Null when the storage has no environment map
+  [[nodiscard]] const environment_texture_asset* get_environment_texture()
+      const {
+    return m_environment_texture;
+  }
+  [[nodiscard]] const std::vector<EnvAccel>& get_environment_accel() const {
+    return m_environment_accel;
+  }
+  // Seeds RtxState::fireflyClampThreshold, as the ray tracing renderer does
+  [[nodiscard]] float get_environment_integral() const {
+    return m_environment_integral;
+  }
+
+ private:
+  void load_geometry(const asset_storage& storage,
+                     const assets<material_asset>& material_assets);
+  bool load_environment(const asset_storage& storage);
+
+ private:
+  scene_bvh m_bvh;
+  std::vector<InstanceData> m_instances;
+  std::vector<vertex> m_vertices;
+  std::vector<std::uint32_t> m_indices;
+
+  std::vector<GltfShadeMaterial> m_materials;
+  std::vector<const_ref<texture_asset>> m_textures;
+  std::vector<Light> m_lights;
+
+  const environment_texture_asset* m_environment_texture = nullptr;
+  std::vector<EnvAccel> m_environment_accel;
+  float m_environment_integral = 0.f;
+};
+}  // namespace wunder::cpu
+
+#endif  // WUNDER_CPU_SCENE_H
@@ -0,0 +1,96 @@
+#ifndef WUNDER_CPU_SHADING_H
+#define WUNDER_CPU_SHADING_H
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+
+namespace wunder::cpu {
+/**
+ * Material of globals.glsl, the GltfShadeMaterial after its textures were
+ * applied at the hit.
+ */
+struct shading_material {
+  glm::vec3 m_albedo{0.f};
+  float m_specular = 0.f;
+  glm::vec3 m_emission{0.f};
+  float m_anisotropy = 0.f;
+  float m_metallic = 0.f;
+  float m_roughness = 0.f;
+  float m_subsurface = 0.f;
+  float m_specular_tint = 0.f;
+  float m_sheen = 0.f;
+  glm::vec3 m_sheen_tint{0.f};
+  float m_clearcoat = 0.f;
+  float m_clearcoat_roughness = 0.f;
+  float m_transmission = 0.f;
+  float m_ior = 0.f;
+  glm::vec3 m_attenuation_color{0.f};
+  float m_attenuation_distance = 0.f;
+
+  // Roughness along the tangent and the bitangent
+  float m_ax = 0.f;
+  float m_ay = 0.f;
+
+  glm::vec3 m_f0{0.f};
+  float m_alpha = 0.f;
+  bool m_unlit = false;
+  bool m_thin_walled = false;
+};
+
+// State of globals.glsl, what the BSDF evaluation needs of the hit
+struct shading_state {
+  float m_eta = 0.f;
+
+  glm::vec3 m_position{0.f};
+  glm::vec3 m_normal{0.f};
+  // Normal facing against the incoming ray
+  glm::vec3 m_ffnormal{0.f};
+  glm::vec3 m_tangent{0.f};
+  glm::vec3 m_bitangent{0.f};
+  glm::vec2 m_texcoord{0.f};
+
+  bool m_is_subsurface = false;
+
+  std::uint32_t m_material_idx = 0;
+  shading_material m_material;
+};
+
+/**
+ * Random numbers of random.glsl, the same seed gives the same sequence as the
+ * ray generation shader.
+ */
+class shader_random {
+ public:
+  // initRandom, one sequence per pixel and frame
+  shader_random(std::uint32_t pixel_idx, std::uint32_t frame);
+
+ public:
+  // rand, uniform in [0, 1)
+  float next();
+
+ private:
+  static std::uint32_t tea(std::uint32_t value0, std::uint32_t value1);
+
+ private:
+  std::uint32_t m_seed;
+};
+
+/**
+ * DisneySample of pbr_disney.glsl. Picks the direction the path continues
+ * in, returns the BSDF value for it and its pdf, zero when no lobe was
+ * picked.
+ */
+glm::vec3 disney_sample(shading_state& state, const glm::vec3& V,
+                        const glm::vec3& N, glm::vec3& out_L, float& out_pdf,
+                        shader_random& random);
+
+// DisneyEval of pbr_disney.glsl
+glm::vec3 disney_eval(const shading_state& state, const glm::vec3& V,
+                      const glm::vec3& N, const glm::vec3& L, float& out_pdf);
+
+float power_heuristic(float a, float b);
+}  // namespace wunder::cpu
+
+#endif  // WUNDER_CPU_SHADING_H
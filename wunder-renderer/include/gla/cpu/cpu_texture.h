@@ -0,0 +1,20 @@
+#ifndef WUNDER_CPU_TEXTURE_H
+#define WUNDER_CPU_TEXTURE_H
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+namespace wunder {
+struct texture_asset;
+}
+
+namespace wunder::cpu {
+/**
+ * textureLod of the base level, filtered and wrapped the way the sampler
+ * vulkan creates for the asset does, repeat and linear when it has none.
+ * 8 bit textures are normalized, as their UNORM images are.
+ */
+glm::vec4 sample_texture(const texture_asset& texture, const glm::vec2& uv);
+}  // namespace wunder::cpu
+
+#endif  // WUNDER_CPU_TEXTURE_H
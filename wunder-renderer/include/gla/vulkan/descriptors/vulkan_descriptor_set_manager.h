@@ -2,7 +2,10 @@
 #define WUNDER_VULKAN_DESCRIPTOR_SET_MANAGER_H
 #include <cstdint>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -17,6 +20,26 @@ class shader;
 class base_pipeline;
 
 class descriptor_set_manager : public non_copyable {
+ private:
+  struct dynamic_binding {
+    vulkan_descriptor_set_identifier m_set;
+    vulkan_descriptor_set_bind_identifier m_binding;
+    std::uint32_t m_descriptors_count;
+  };
+
+  struct update_after_bind_binding {
+    std::uint32_t m_capacity = 0;
+    std::vector<std::uint32_t> m_free_elements;
+    // element and the swap chain's submitted frames count it was released at
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> m_released_elements;
+  };
+
+  using binding_key = std::pair<vulkan_descriptor_set_identifier,
+                                vulkan_descriptor_set_bind_identifier>;
+
+  // descriptors reserved for runtime sized arrays, e.g. texturesMap[]
+  static constexpr std::uint32_t s_runtime_array_capacity = 512;
+
  public:
   enum build_error_code {
     SUCCESS = 0,
@@ -29,13 +52,30 @@ class descriptor_set_manager : public non_copyable {
  public:
   build_error_code build();
 
-  void bind(const base_pipeline& pipeline) const;
+  void bind(const base_pipeline& pipeline);
  public:
   void clear_resources();
   void clear_resource(const vulkan_resource_identifier& resource_identifier);
   void add_resource(const vulkan_resource_identifier& resource_identifier,
                     shader_resource::instance::element resource);
 
+  /**
+   * Incremental updates of a built descriptor set, a single descriptor write
+   * instead of clear_resources() and build(). Only bindings in update after
+   * bind sets, i.e. sets without dynamic uniform buffers, support them.
+   * Elements in use by frames in flight must not be overwritten, append the
+   * new resource and release the old element instead. Released elements are
+   * recycled once all frames in flight are done with them.
+   */
+  bool update_resource(const vulkan_resource_identifier& resource_identifier,
+                       std::uint32_t array_element,
+                       shader_resource::instance::element resource);
+  std::optional<std::uint32_t> append_resource(
+      const vulkan_resource_identifier& resource_identifier,
+      shader_resource::instance::element resource);
+  void release_resource(const vulkan_resource_identifier& resource_identifier,
+                        std::uint32_t array_element);
+
   optional_const_ref<shader_resource::declaration::base>
   find_resource_declaration(
       const vulkan_resource_identifier& resource_identifier) const;
@@ -51,16 +91,34 @@ class descriptor_set_manager : public non_copyable {
 
  private:
   std::vector<VkDescriptorSetLayout>& create_descriptor_set_layout();
+  void collect_dynamic_offsets(std::vector<std::uint32_t>& out_offsets) const;
+  void recycle_released_elements();
+
+  [[nodiscard]] static bool is_update_after_bind_supported(
+      VkDescriptorType descriptor_type);
+  update_after_bind_binding* find_update_after_bind_binding(
+      const shader_resource::declaration::base& resource_declaration);
+  bool write_resource(
+      const shader_resource::declaration::base& resource_declaration,
+      std::uint32_t array_element,
+      const shader_resource::instance::element& resource);
   void create_descriptors_set();
   void write_descriptors_data();
 
  private:
   std::map<vulkan_descriptor_set_identifier, vulkan_descriptor_bindings>
       m_input_resources;
-  const vulkan_shader_reflection_data& m_shader_reflection_data;
+  // copied, the declaring shader is replaced when shaders are hot reloaded
+  const vulkan_shader_reflection_data m_shader_reflection_data;
 
   std::vector<VkDescriptorSetLayout> m_descriptor_set_layout;
   std::vector<VkDescriptorSet> m_descriptor_sets;
+  // ordered by set and binding, as vkCmdBindDescriptorSets consumes them
+  std::vector<dynamic_binding> m_dynamic_bindings;
+
+  std::mutex m_update_after_bind_mutex;
+  std::map<binding_key, update_after_bind_binding>
+      m_update_after_bind_bindings;
   VkDescriptorPool m_descriptor_pool;
 };
 }  // namespace wunder::vulkan
@@ -2,7 +2,9 @@
 #define WUNDER_VULKAN_SWAP_CHAIN_H
 
 #include <glad/vulkan.h>
+#include <vk_mem_alloc.h>
 
+#include <atomic>
 #include <cstdint>
 #include <optional>
 #include <vector>
@@ -31,6 +33,8 @@ private:
 
    public:
     VkImage m_image = VK_NULL_HANDLE;
+    // Only offscreen images are owned, the swap chain ones belong to it
+    VmaAllocation m_image_allocation = VK_NULL_HANDLE;
     VkImageView m_image_view = VK_NULL_HANDLE;
     VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
 
@@ -61,6 +65,20 @@ private:
     return m_current_queue_element;
   }
 
+  /**
+   * Frames submitted so far, a frame submitted at count n has finished once
+   * the count passed n + get_image_count(), its fence was waited for by then.
+   */
+  [[nodiscard]] std::uint64_t get_submitted_frames_count() const {
+    return m_submitted_frames_count;
+  }
+
+  /**
+   * Headless windows have no surface, the queue elements then render into
+   * images of their own, which are never presented.
+   */
+  [[nodiscard]] bool is_offscreen() const { return m_surface == VK_NULL_HANDLE; }
+
 public:
   std::optional<std::uint32_t> acquire();
 
@@ -73,6 +91,7 @@ public:
 
   void initialize_queue_elements();
   void create_image_for_each_queue_element();
+  VkImage allocate_offscreen_image(queue_element& element) const;
   void create_image_barrier_for_each_queue_element();
   void create_semaphores_for_each_queue_element();
   void create_fence_for_each_queue_element();
@@ -88,6 +107,8 @@ public:
   uint32_t m_width, m_height;
 
   uint32_t m_current_queue_element;
+  // read by threads releasing resources while the frames are submitted
+  std::atomic<std::uint64_t> m_submitted_frames_count;
 
   std::vector<queue_element> m_queue_elements;
   VkSurfaceKHR m_surface;
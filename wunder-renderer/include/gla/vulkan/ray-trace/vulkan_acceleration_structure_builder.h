@@ -2,6 +2,8 @@
 #ifndef VULKAN_ACCELERATION_STRUCTURE_BUILDER_H
 #define VULKAN_ACCELERATION_STRUCTURE_BUILDER_H
 
+#include <span>
+
 #include "core/wunder_macros.h"
 #include "gla/vulkan/ray-trace/vulkan_acceleration_structure_build_info.h"
 #include "gla/vulkan/vulkan_buffer_fwd.h"
@@ -15,8 +17,14 @@ class acceleration_structure_builder {
   virtual ~acceleration_structure_builder();
 
  protected:
-  void create_scratch_buffer(std::uint32_t scratch_buffer_size);
+  void create_scratch_buffer(VkDeviceSize scratch_buffer_size);
+  void build_acceleration_structure(
+      std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>&
+          as_build_offset_info,
+      std::vector<VkAccelerationStructureBuildGeometryInfoKHR>&
+          as_build_geometry_info);
   void build_acceleration_structure(
+      std::span<const build_info_type> build_infos,
       std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>&
           as_build_offset_info,
       std::vector<VkAccelerationStructureBuildGeometryInfoKHR>&
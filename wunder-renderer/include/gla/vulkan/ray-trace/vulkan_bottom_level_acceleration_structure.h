@@ -17,6 +17,7 @@ class bottom_level_acceleration_structure : public acceleration_structure {
 
  private:
   void create(const bottom_level_acceleration_structure_build_info& build_info);
+  void create_compacted(VkDeviceSize compacted_size);
 };
 }  // namespace vulkan
 }  // namespace wunder
@@ -13,18 +13,29 @@ class bottom_level_acceleration_structure_build_info
     : public acceleration_structure_build_info {
  public:
   bottom_level_acceleration_structure_build_info(
-      const vulkan_mesh& vulkan_mesh);
+      const vulkan_mesh& vulkan_mesh,
+      VkBuildAccelerationStructureFlagsKHR build_flags);
+
+  bottom_level_acceleration_structure_build_info(
+      bottom_level_acceleration_structure_build_info&& other) noexcept;
+  bottom_level_acceleration_structure_build_info& operator=(
+      bottom_level_acceleration_structure_build_info&& other) noexcept;
 
  private:
+  void link_opacity_micromap();
   void create_geometry_data(std::uint32_t vertices_count,
-                            const storage_buffer& vertex_buffer,
-                            const storage_buffer& index_buffer);
+                            VkDeviceAddress vertex_address,
+                            VkDeviceAddress index_address);
 
  public:
   [[nodiscard]] VkAccelerationStructureTypeKHR get_acceleration_structure_type()
       const override {
     return VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
   }
+
+ private:
+  // Chained into the triangles of m_as_geometry when the mesh has a micromap
+  VkAccelerationStructureTrianglesOpacityMicromapEXT m_opacity_micromap{};
 };
 }  // namespace vulkan
 }  // namespace wunder
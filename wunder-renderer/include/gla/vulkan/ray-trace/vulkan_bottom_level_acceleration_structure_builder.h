@@ -1,8 +1,10 @@
 #ifndef VULKAN_BOTTOM_LEVEL_ACCELERATION_STRUCTURE_BUILDER_H
 #define VULKAN_BOTTOM_LEVEL_ACCELERATION_STRUCTURE_BUILDER_H
+#include <array>
 #include <vector>
 
 #include "assets/asset_types.h"
+#include "assets/components/scene_components.h"
 #include "core/vector_map.h"
 #include "gla/vulkan/ray-trace/vulkan_acceleration_structure_builder.h"
 #include "gla/vulkan/ray-trace/vulkan_bottom_level_acceleration_structure_build_info.h"
@@ -13,11 +15,38 @@ struct vulkan_mesh;
 }  // namespace wunder::vulkan
 
 namespace wunder::vulkan {
+/**
+ * Builds are split in batches whose scratch memory fits in scratch_budget, the
+ * batches share one scratch buffer and are submitted one after another, so
+ * peak scratch memory doesn't grow with the scene. A mesh needing more scratch
+ * memory than the budget is built alone.
+ *
+ * Every mesh is built with the flags of its build policy, automatic policies
+ * are resolved from the triangle count. Batches never mix policies, build
+ * time, memory and compacted memory are reported per policy once the build is
+ * complete, in the log and as an event.
+ */
 class bottom_level_acceleration_structure_builder final
     : protected acceleration_structure_builder<bottom_level_acceleration_structure_build_info> {
 public:
+  static constexpr VkDeviceSize k_default_scratch_budget = 256ull << 20;
+
+  // compaction doesn't pay off the copy below, above the build memory counts
+  // more than the trace speed
+  static constexpr std::uint32_t k_small_mesh_triangles = 4096;
+  static constexpr std::uint32_t k_large_mesh_triangles = 1u << 20;
+
+ public:
+  /**
+   * With allow_compaction the structures of policies allowing compaction are
+   * built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR, their
+   * compacted size is read back once the build is complete and every structure
+   * is copied into a right-sized allocation, the worst-case build allocations
+   * are freed. Without it, no structure is compacted.
+   */
   bottom_level_acceleration_structure_builder(
-      std::vector<vulkan_mesh_scene_node>& mesh_nodes);
+      std::vector<vulkan_mesh_scene_node>& mesh_nodes, bool allow_compaction,
+      VkDeviceSize scratch_budget = k_default_scratch_budget);
 
  public:
   void build();
@@ -27,17 +56,63 @@ protected:
         get_build_infos() const override {
     return m_build_infos;
   }
+
  private:
-  void build_info_set_scratch_buffer();
+  struct batch {
+    std::size_t m_first = 0;
+    std::size_t m_count = 0;
+    VkDeviceSize m_scratch_size = 0;
+    acceleration_structure_build_policy m_policy =
+        acceleration_structure_build_policy::automatic;
+  };
+
+  struct policy_statistics {
+    std::uint32_t m_structures_count = 0;
+    VkDeviceSize m_build_size = 0;
+    VkDeviceSize m_compacted_size = 0;
+    double m_build_time_ms = 0.0;
+  };
+
+ private:
+  void collect_meshes();
+  [[nodiscard]] acceleration_structure_build_policy resolve_build_policy(
+      const vulkan_mesh& mesh) const;
+  [[nodiscard]] VkBuildAccelerationStructureFlagsKHR get_build_flags(
+      acceleration_structure_build_policy policy) const;
+  [[nodiscard]] bool is_compactable(std::size_t structure_idx) const;
+
+  void split_in_batches();
+  void build_info_set_scratch_buffer(const batch& build_batch);
   void create_acceleration_structures();
+  void record_batch(std::size_t batch_idx);
   void flush_commands();
 
+  void create_query_pools();
+  void destroy_query_pools();
+  void write_compacted_sizes(const batch& build_batch);
+  void read_build_times();
+  void compact_acceleration_structures();
+
+  // Logs them and sends bottom_level_acceleration_structures_built
+  void report_statistics() const;
+
  private:
   std::vector<bottom_level_acceleration_structure_build_info>
       m_build_infos;
   std::vector<vulkan_mesh_scene_node>& m_mesh_nodes;
+  // meshes are shared between nodes, each one is built once
+  std::vector<vulkan_mesh*> m_meshes;
+  std::vector<acceleration_structure_build_policy> m_policies;
+  std::vector<batch> m_batches;
+  std::array<policy_statistics,
+             static_cast<std::size_t>(acceleration_structure_build_policy::count)>
+      m_statistics{};
   uint32_t m_min_alignment ; /*VkPhysicalDeviceAccelerationStructurePropertiesKHR.minAccelerationStructureScratchOffsetAlignment*/
-
+  bool m_allow_compaction;
+  VkDeviceSize m_scratch_budget;
+  VkQueryPool m_compacted_size_query_pool = VK_NULL_HANDLE;
+  // two timestamps per batch, null when the device can't time compute queues
+  VkQueryPool m_timestamp_query_pool = VK_NULL_HANDLE;
 };
 }  // namespace wunder::vulkan
 #endif  // VULKAN_BOTTOM_LEVEL_ACCELERATION_STRUCTURE_BUILDER_H
@@ -0,0 +1,68 @@
+#ifndef WUNDER_VULKAN_OPACITY_MICROMAP_H
+#define WUNDER_VULKAN_OPACITY_MICROMAP_H
+
+#include <glad/vulkan.h>
+
+#include <string>
+
+#include "core/non_copyable.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/vulkan_buffer_fwd.h"
+
+namespace wunder {
+struct baked_opacity_micromap;
+
+namespace vulkan {
+/**
+ * Opacity micromap of a mesh, built on the GPU from the CPU baked states and
+ * referenced by the triangles of its bottom level acceleration structure.
+ * Micro-triangles known to be opaque or transparent skip any-hit, triangles
+ * uniform as a whole don't have micromap data at all, only a special index.
+ */
+class opacity_micromap : public non_copyable {
+ public:
+  opacity_micromap();
+  ~opacity_micromap() override;
+
+  opacity_micromap(opacity_micromap&&) noexcept;
+  opacity_micromap& operator=(opacity_micromap&&) noexcept;
+
+ public:
+  /**
+   * Uploads the baked micromap and records its build into command_buffer. The
+   * input and scratch buffers stay alive until free_build_data is called,
+   * once the command buffer has completed.
+   */
+  void create(VkCommandBuffer command_buffer,
+              const baked_opacity_micromap& baked_micromap,
+              const std::string& name);
+  void free_build_data();
+
+  [[nodiscard]] bool is_valid() const { return m_indices_buffer != nullptr; }
+
+  /**
+   * Chained into the triangles of the bottom level acceleration structure,
+   * points into this object, which must outlive the structure builds.
+   */
+  [[nodiscard]] VkAccelerationStructureTrianglesOpacityMicromapEXT
+  get_geometry_info() const;
+
+ private:
+  void build(VkCommandBuffer command_buffer,
+             const baked_opacity_micromap& baked_micromap,
+             const std::string& name);
+
+ private:
+  VkMicromapEXT m_micromap = VK_NULL_HANDLE;
+  unique_ptr<storage_buffer> m_micromap_buffer;
+  // One per triangle, read by every build of the bottom level structure
+  unique_ptr<storage_buffer> m_indices_buffer;
+  VkMicromapUsageEXT m_geometry_usage_count{};
+
+  unique_ptr<storage_buffer> m_data_buffer;
+  unique_ptr<storage_buffer> m_triangles_buffer;
+  unique_ptr<storage_buffer> m_scratch_buffer;
+};
+}  // namespace vulkan
+}  // namespace wunder
+#endif  // WUNDER_VULKAN_OPACITY_MICROMAP_H
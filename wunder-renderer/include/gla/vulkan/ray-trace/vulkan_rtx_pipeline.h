@@ -3,6 +3,9 @@
 
 #include <glad/vulkan.h>
 
+#include <array>
+#include <cstdint>
+
 #include "core/non_copyable.h"
 #include "core/vector_map.h"
 #include "core/wunder_memory.h"
@@ -12,16 +15,31 @@ namespace wunder::vulkan {
 class shader;
 
 class rtx_pipeline : public base_pipeline, public non_copyable {
+ public:
+  /**
+   * RtxState values baked into the pipeline as specialization constants, see
+   * SpecializationConstants. Every combination is a separate pipeline.
+   */
+  struct variant {
+    std::int32_t m_debugging_mode = 0;
+    std::int32_t m_max_depth = 0;
+
+    bool operator==(const variant& other) const = default;
+  };
+
  private:
-  rtx_pipeline();
+  explicit rtx_pipeline(const variant& pipeline_variant);
 
  public:
   static std::unique_ptr<rtx_pipeline> create(
       const descriptor_set_manager& descriptor_set_manager,
       const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
-          shaders);
+          shaders,
+      const variant& pipeline_variant);
 
  public:
+  [[nodiscard]] const variant& get_variant() const { return m_variant; }
+
   [[nodiscard]] const VkRayTracingPipelineCreateInfoKHR&
   get_pipeline_create_info() const {
     return m_pipeline_create_info;
@@ -32,6 +50,7 @@ class rtx_pipeline : public base_pipeline, public non_copyable {
 
  private:
   void create_shader_group_info();
+  void create_specialization_info();
 
   void initialize_pipeline(
       const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
@@ -40,6 +59,10 @@ class rtx_pipeline : public base_pipeline, public non_copyable {
  private:
   VkRayTracingPipelineCreateInfoKHR m_pipeline_create_info;
   std::vector<VkRayTracingShaderGroupCreateInfoKHR> m_shader_stage_groups;
+
+  variant m_variant;
+  std::array<VkSpecializationMapEntry, 2> m_specialization_entries{};
+  VkSpecializationInfo m_specialization_info{};
 };
 }  // namespace wunder::vulkan
 
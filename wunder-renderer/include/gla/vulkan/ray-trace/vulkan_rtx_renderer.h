@@ -1,7 +1,9 @@
 #ifndef VULKAN_RENDERER_H
 #define VULKAN_RENDERER_H
 
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -10,8 +12,12 @@
 #include "core/vector_map.h"
 #include "core/wunder_memory.h"
 #include "event/event_handler.h"
+#include "gla/vulkan/ray-trace/vulkan_rtx_tile_scheduler.h"
 #include "gla/vulkan/vulkan_base_renderer.h"
+#include "gla/vulkan/vulkan_buffer_fwd.h"
+#include "gla/vulkan/vulkan_texture_fwd.h"
 #include "glad/vulkan.h"
+#include "gla/vulkan/vulkan_shader_hot_reloader.h"
 #include "scene/scene_types.h"
 
 struct RtxState;
@@ -29,16 +35,38 @@ class shader;
 class rtx_pipeline;
 class shader_binding_table;
 class rasterize_renderer;
+class frame_storage_buffer;
 
 class rtx_renderer : public base_renderer,
                      public event_handler<wunder::event::camera_moved>,
                      public non_copyable {
+ private:
+  struct pipeline_variant {
+    unique_ptr<rtx_pipeline> m_pipeline;
+    unique_ptr<shader_binding_table> m_shader_binding_table;
+  };
+
  public:
   explicit rtx_renderer(const renderer_properties& properties);
   ~rtx_renderer() override;
 
  public:
   RtxState& mutable_rtx_config() { return *m_state; }
+  // Applies from the next pass, reset_frames starts one
+  rtx_tile_scheduler::properties& mutable_tiling_config() {
+    return m_tiling_properties;
+  }
+
+  /**
+   * Every tile reached RtxState::convergenceThreshold, nothing is traced
+   * until the frames restart.
+   */
+  [[nodiscard]] bool is_converged() const { return m_is_converged; }
+
+  // Null until a scene was initialized
+  [[nodiscard]] const rtx_tile_scheduler* get_tile_scheduler() const {
+    return m_tile_scheduler.get();
+  }
 
  public:
   void update(time_unit dt) override;
@@ -53,6 +81,18 @@ class rtx_renderer : public base_renderer,
 
   void create_descriptor_manager(const shader& shader);
 
+ private:
+  optional_ref<pipeline_variant> select_pipeline_variant();
+
+  void create_convergence_resources(std::uint32_t width, std::uint32_t height);
+  void update_convergence();
+  void record_convergence_reset(VkCommandBuffer command_buffer) const;
+  void record_convergence_read_back(VkCommandBuffer command_buffer);
+
+  void initialize_shader_hot_reload();
+  void on_shaders_reloaded(
+      std::vector<shader_hot_reloader::reloaded_shader>& reloaded_shaders);
+
  private:
   void on_event(const wunder::event::camera_moved&) override;
 
@@ -61,9 +101,24 @@ class rtx_renderer : public base_renderer,
   void log_current_sate_frame();
 
  private:
-  unique_ptr<rtx_pipeline> m_rtx_pipeline;
-  unique_ptr<shader_binding_table> m_shader_binding_table;
+  // built on first use, one per combination of the specialized RtxState
+  // values, so switching between them doesn't compile anything
+  std::vector<pipeline_variant> m_pipeline_variants;
+  std::optional<scene_id> m_scene_id;
   unique_ptr<RtxState> m_state;
+  rtx_tile_scheduler::properties m_tiling_properties;
+  unique_ptr<rtx_tile_scheduler> m_tile_scheduler;
+
+  // Adaptive sampling, see convergence.glsl
+  unique_ptr<storage_texture> m_moments_image;
+  unique_ptr<storage_device_buffer> m_convergence_buffer;
+  // unconvergedTiles of the last frame each swap chain image traced, and
+  // which frame that was, -1 for none since the frames restarted
+  unique_ptr<frame_storage_buffer> m_unconverged_tiles_read_back;
+  std::vector<int> m_read_back_frames;
+  VkDeviceSize m_convergence_tiles_count = 0;
+  bool m_is_converged = false;
+  unique_ptr<shader_hot_reloader> m_shader_hot_reloader;
 };
 }  // namespace wunder::vulkan
 #endif /* VULKAN_RENDERER_H */
@@ -0,0 +1,100 @@
+#ifndef WUNDER_VULKAN_RTX_TILE_SCHEDULER_H
+#define WUNDER_VULKAN_RTX_TILE_SCHEDULER_H
+
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "core/non_copyable.h"
+
+namespace wunder::vulkan {
+/**
+ * Splits the trace of a frame into tiles, so huge outputs don't trace for
+ * seconds in one dispatch. A pass traces every tile once and is spread over
+ * as many frames as the per frame GPU time budget needs, the time the tiles
+ * of earlier frames took is measured with timestamps. Without timestamp
+ * support a frame traces a single tile. A tile size of 0 traces the whole
+ * image in one dispatch, a pass per frame.
+ */
+class rtx_tile_scheduler : public non_copyable {
+ public:
+  enum class tile_order : std::int32_t { scanline, hilbert, center_out };
+
+  struct properties {
+    // Pixels square of a tile, 0 disables tiling
+    std::uint32_t m_tile_size = 0;
+    tile_order m_order = tile_order::scanline;
+    // GPU time the tiles of one frame are given
+    float m_frame_budget_ms = 8.f;
+  };
+
+ public:
+  rtx_tile_scheduler(std::uint32_t width, std::uint32_t height,
+                     std::uint32_t frames_count);
+  ~rtx_tile_scheduler() override;
+
+ public:
+  // Starts the pass over, changed properties apply from there on
+  void reset();
+
+  /**
+   * Tiles the frame of the given swap chain image dispatches. The image's
+   * fence was waited for, so the time its previous tiles took is read.
+   */
+  std::span<const VkRect2D> next_tiles(std::uint32_t frame,
+                                       const properties& tiling_properties);
+
+  // Of the tiles next_tiles returned last
+  [[nodiscard]] bool is_pass_beginning() const { return m_first_tile == 0; }
+  [[nodiscard]] bool is_pass_complete() const {
+    return m_next_tile == m_tiles.size();
+  }
+
+  /**
+   * Totals of the timed dispatches since the scheduler was created, for
+   * benchmarks. Only tiled passes are timed, frames still in flight aren't
+   * read yet.
+   */
+  [[nodiscard]] std::uint64_t get_timed_pixels_count() const {
+    return m_total_timed_pixels;
+  }
+  [[nodiscard]] double get_timed_trace_ms() const {
+    return m_total_trace_time_ns * 1e-6;
+  }
+
+  // Around the dispatches of the tiles next_tiles returned
+  void write_begin_timestamp(VkCommandBuffer command_buffer,
+                             std::uint32_t frame) const;
+  void write_end_timestamp(VkCommandBuffer command_buffer,
+                           std::uint32_t frame) const;
+
+ private:
+  void create_tiles(const properties& tiling_properties);
+  [[nodiscard]] std::size_t get_budget_tiles_count() const;
+  void read_timestamps(std::uint32_t frame);
+
+ private:
+  // the ones the tiles were created with
+  properties m_tiles_properties;
+  std::uint32_t m_width;
+  std::uint32_t m_height;
+
+  std::vector<VkRect2D> m_tiles;
+  std::size_t m_first_tile = 0;
+  std::size_t m_next_tile = 0;
+
+  // two timestamps per swap chain image, null when the device can't time
+  // graphics queues
+  VkQueryPool m_timestamp_query_pool = VK_NULL_HANDLE;
+  double m_timestamp_period_ns = 0.0;
+  // pixels timed by each image's timestamps, 0 for none
+  std::vector<std::uint64_t> m_timed_pixels;
+  // smoothed over frames, 0 until the first tiles were timed
+  double m_ns_per_pixel = 0.0;
+  std::uint64_t m_total_timed_pixels = 0;
+  double m_total_trace_time_ns = 0.0;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_RTX_TILE_SCHEDULER_H
@@ -1,6 +1,8 @@
 #ifndef WUNDER_VULKAN_TOP_LEVEL_ACCELERATION_STRUCTURE_BUILD_INFO_H
 #define WUNDER_VULKAN_TOP_LEVEL_ACCELERATION_STRUCTURE_BUILD_INFO_H
 
+#include <glm/glm.hpp>
+
 #include <cstdint>
 #include <vector>
 
@@ -11,13 +13,19 @@
 namespace wunder::vulkan {
 
 class bottom_level_acceleration_structure;
+class frame_storage_buffer;
 struct vulkan_mesh_scene_node;
 
+/**
+ * The structure is built with ALLOW_UPDATE and its instances are kept in a
+ * persistent host visible buffer, one copy per frame in flight, so moving
+ * instances only rewrites the copy of the current frame before a refit.
+ */
 class top_level_acceleration_structure_build_info
     : public acceleration_structure_build_info {
  public:
-  top_level_acceleration_structure_build_info(
-      VkCommandBuffer command_buffer, const std::vector<vulkan_mesh_scene_node>& mesh_nodes);
+  explicit top_level_acceleration_structure_build_info(
+      const std::vector<vulkan_mesh_scene_node>& mesh_nodes);
   ~top_level_acceleration_structure_build_info() override;
 
 
@@ -25,8 +33,22 @@ class top_level_acceleration_structure_build_info
       top_level_acceleration_structure_build_info&& other) noexcept;
   top_level_acceleration_structure_build_info& operator=(
       top_level_acceleration_structure_build_info&& other) noexcept;
-public:
-  void free_staging_data();
+
+ public:
+  void set_instance_transform(std::uint32_t instance_idx,
+                              const glm::mat4& model_matrix);
+  [[nodiscard]] const std::vector<VkAccelerationStructureInstanceKHR>&
+  get_instances() const {
+    return m_instances;
+  }
+
+  /**
+   * Copies the instances into the buffer of the frame and points the build
+   * at it.
+   */
+  void write_instances(std::uint32_t frame);
+  [[nodiscard]] std::uint32_t get_current_frame() const;
+
  public:
   [[nodiscard]] VkAccelerationStructureTypeKHR get_acceleration_structure_type()
       const override {
@@ -42,15 +64,13 @@ public:
       VkAccelerationStructureInstanceKHR& out_acceleration_structure_instance);
 
  private:
-  void create_acceleration_structures_buffer(
-      std::vector<VkAccelerationStructureInstanceKHR>&
-          acceleration_structures_instances);
+  void create_acceleration_structures_buffer();
   void create_geometry_data(
       std::uint32_t acceleration_structure_instances_count);
 
  private:
-  VkCommandBuffer m_command_buffer;
-  unique_ptr<storage_buffer> m_acceleration_structures_buffer;
+  std::vector<VkAccelerationStructureInstanceKHR> m_instances;
+  unique_ptr<frame_storage_buffer> m_acceleration_structures_buffer;
 };
 }  // namespace wunder::vulkan
 #endif  // WUNDER_VULKAN_TOP_LEVEL_ACCELERATION_STRUCTURE_BUILD_INFO_H
@@ -0,0 +1,55 @@
+#ifndef WUNDER_VULKAN_TOP_LEVEL_ACCELERATION_STRUCTURE_UPDATER_H
+#define WUNDER_VULKAN_TOP_LEVEL_ACCELERATION_STRUCTURE_UPDATER_H
+
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "core/non_copyable.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/vulkan_buffer_fwd.h"
+
+namespace wunder::vulkan {
+class top_level_acceleration_structure;
+class top_level_acceleration_structure_build_info;
+
+/**
+ * Records in place updates of the top level acceleration structure into the
+ * frame command buffer once instances moved. A refit keeps the hierarchy of
+ * the last build and only grows its bounds, so tracing gets slower the further
+ * instances travel from where they were built. The structure is rebuilt
+ * instead once an instance moved more than k_max_relative_displacement of the
+ * instances extent, or after k_max_refits refits.
+ */
+class top_level_acceleration_structure_updater : public non_copyable {
+ public:
+  static constexpr float k_max_relative_displacement = 0.1f;
+  static constexpr std::uint32_t k_max_refits = 256;
+
+ public:
+  explicit top_level_acceleration_structure_updater(
+      const top_level_acceleration_structure_build_info& build_info);
+  ~top_level_acceleration_structure_updater() override;
+
+ public:
+  void update(VkCommandBuffer command_buffer,
+              top_level_acceleration_structure& acceleration_structure,
+              top_level_acceleration_structure_build_info& build_info);
+
+ private:
+  [[nodiscard]] bool is_rebuild_needed(
+      const top_level_acceleration_structure_build_info& build_info) const;
+  void store_built_translations(
+      const top_level_acceleration_structure_build_info& build_info);
+
+ private:
+  // large enough for both updates and builds, allocated on the first update
+  unique_ptr<storage_buffer> m_scratch_buffer;
+  std::vector<glm::vec3> m_built_translations;
+  float m_built_extent = 1.f;
+  std::uint32_t m_refits_since_build = 0;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_TOP_LEVEL_ACCELERATION_STRUCTURE_UPDATER_H
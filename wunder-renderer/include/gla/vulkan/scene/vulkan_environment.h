@@ -27,6 +27,12 @@ struct vulkan_environment : public non_copyable {
   unique_ptr<sampled_texture> m_image;
   acceleration_data m_acceleration_data;
 
+  // Ambient terms for paths which can't afford importance sampling:
+  // SH9 irradiance coefficients and GGX prefiltered radiance, roughness
+  // mapped linearly over the mip chain
+  unique_ptr<storage_buffer> m_irradiance_sh;
+  unique_ptr<sampled_texture> m_prefiltered_specular;
+
 };
 }  // namespace wunder::vulkan
 
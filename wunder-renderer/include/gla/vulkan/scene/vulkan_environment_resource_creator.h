@@ -5,6 +5,7 @@
 
 #include "core/wunder_memory.h"
 #include "gla/vulkan/vulkan_buffer_fwd.h"
+#include "resources/shaders/host_device.h"
 
 namespace wunder {
 struct environment_texture_asset;
@@ -14,22 +15,59 @@ namespace wunder::vulkan {
 struct vulkan_environment;
 }
 
-struct EnvAccel;
-
 namespace wunder::vulkan {
 class vulkan_environment_resource_creator final {
+ public:
+  struct environment_accel_data {
+    std::vector<EnvAccel> m_env_accels;
+    float m_integral = 0.f;
+    float m_average_luminance = 0.f;
+  };
+
  public:
   static unique_ptr<vulkan_environment> create_environment_texture();
 
+  /**
+   * Importance sampling tables of the environment, read from the cache or
+   * built and cached. False when the texture doesn't hold 32 bit floats.
+   */
+  static bool create_environment_accel_data(
+      const environment_texture_asset& asset,
+      environment_accel_data& out_accel_data);
+
+  /**
+   * Builds the tables on worker threads, without the cache. pixels are the
+   * asset's rgba floats.
+   */
+  static void build_environment_accel(const environment_texture_asset& asset,
+                                      const std::vector<float>& pixels,
+                                      environment_accel_data& out_accel_data);
+  /**
+   * The single threaded builder the parallel one replaced, kept as the
+   * reference its tables must match bit for bit.
+   */
+  static void build_environment_accel_serial(
+      const environment_texture_asset& asset, const std::vector<float>& pixels,
+      environment_accel_data& out_accel_data);
+
  private:
   static float build_alias_map(const std::vector<float>& data,
                                std::vector<EnvAccel>& accel);
+  static float build_alias_map_serial(const std::vector<float>& data,
+                                      std::vector<EnvAccel>& accel);
   static void create_environment_accel(
       const environment_texture_asset& asset,
       vulkan_environment& out_environment_data);
-  static void create_environment_accel(const environment_texture_asset& asset,
-                                       vulkan_environment& out_environment_data,
-                                       const std::vector<float>& pixels);
+  static void create_environment_ambient(
+      const environment_texture_asset& asset,
+      vulkan_environment& out_environment_data);
+
+  static bool load_environment_accel_cache(
+      const environment_texture_asset& asset,
+      environment_accel_data& out_accel_data);
+  static void save_environment_accel_cache(
+      const environment_texture_asset& asset,
+      const environment_accel_data& accel_data);
 };
 }  // namespace wunder::vulkan
 #endif  // WUNDER_VULKAN_ENVIRONMENT_HELPER_H
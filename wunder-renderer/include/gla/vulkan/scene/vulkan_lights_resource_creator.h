@@ -10,6 +10,7 @@
 struct Light;
 
 namespace wunder {
+class asset_storage;
 struct light_asset;
 }  // namespace wunder
 
@@ -20,9 +21,18 @@ class lights_resource_creator {
       const std::vector<const_ref<scene_node>>& light_nodes,
       std::uint64_t& out_lights_count);
 
+  /**
+   * Lights as the shaders read them, placed by their nodes. A scene without
+   * lights gets a single black directional one.
+   */
+  [[nodiscard]] static std::vector<Light> create_host_lights(
+      const std::vector<const_ref<scene_node>>& light_nodes,
+      const asset_storage& storage);
+
  private:
   [[nodiscard]] static assets<light_asset> extract_scene_light_data(
       const std::vector<const_ref<scene_node>>& light_nodes,
+      const asset_storage& storage,
       vector_map<asset_handle, transform_component>& out_transformations);
   [[nodiscard]] static std::vector<Light> create_host_light_array(
       const vector_map<asset_handle, transform_component>& transformations,
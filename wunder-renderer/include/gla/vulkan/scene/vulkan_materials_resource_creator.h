@@ -1,10 +1,14 @@
 #ifndef WUNDER_VULKAN_MATERIALS_HELPER_H
 #define WUNDER_VULKAN_MATERIALS_HELPER_H
 
+#include <vector>
+
 #include "assets/asset_types.h"
 #include "gla/vulkan/vulkan_buffer_fwd.h"
 #include "include/assets/material_asset.h"
 
+struct GltfShadeMaterial;
+
 namespace wunder {
 struct mesh_asset;
 struct texture_asset;
@@ -18,7 +22,15 @@ class materials_resource_creator {
   [[nodiscard]] unique_ptr<storage_buffer> create_material_buffer(
       const assets<texture_asset>& texture_assets);
 
- private:
+  /**
+   * Materials as the shaders read them, texture handles are replaced by their
+   * index in texture_assets, -1 when the material has no such texture.
+   */
+  [[nodiscard]] static std::vector<GltfShadeMaterial> create_host_materials(
+      const assets<material_asset>& material_assets,
+      const assets<texture_asset>& texture_assets);
+
+  // Bright purple, used by meshes without a material
   static const material_asset& get_default_material();
 
  private:
@@ -3,19 +3,26 @@
 
 #include <cstdint>
 
+#include "assets/components/scene_components.h"
 #include "gla/vulkan/ray-trace/vulkan_bottom_level_acceleration_structure.h"
+#include "gla/vulkan/ray-trace/vulkan_opacity_micromap.h"
+#include "gla/vulkan/vulkan_geometry_arena.h"
 
 namespace wunder::vulkan {
 struct vulkan_mesh {
   std::uint32_t m_idx;
-  std::unique_ptr<storage_buffer> m_vertex_buffer;
+  geometry_arena::range m_vertices;
   std::uint32_t m_vertices_count;
-  std::unique_ptr<storage_buffer> m_index_buffer;
+  geometry_arena::range m_indices;
   std::uint32_t m_indices_count;
   bottom_level_acceleration_structure m_blas;
+  // Invalid unless the material is alpha tested with a base colour texture
+  opacity_micromap m_opacity_micromap;
   std::uint32_t m_material_idx;
   bool m_is_opaque;
   bool m_is_double_sided;
+  acceleration_structure_build_policy m_build_policy =
+      acceleration_structure_build_policy::automatic;
 };
 }  // namespace wunder::vulkan
 
@@ -40,6 +40,14 @@ class meshes_resource_creator {
       const assets<material_asset>& materials,
       vector_map<asset_handle, shared_ptr<vulkan_mesh>>& out_mesh_instances);
 
+  /**
+   * Bakes the base colour alpha of an alpha tested mesh and records the build
+   * of its micromap, returns false when the mesh doesn't need one.
+   */
+  bool create_opacity_micromap(const mesh_asset& mesh_asset,
+                               const material_asset& material,
+                               vulkan_mesh& out_mesh);
+
  private:
   std::vector<const_ref<scene_node>>& m_input_mesh_scene_nodes;
   std::vector<vulkan_mesh_scene_node>& m_out_vulkan_mesh_nodes;
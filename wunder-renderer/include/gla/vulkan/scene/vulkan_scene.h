@@ -5,6 +5,10 @@
 #ifndef WUNDER_VULKAN_SCENE_H
 #define WUNDER_VULKAN_SCENE_H
 
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <glm/glm.hpp>
 #include <vector>
 
 #include "core/non_copyable.h"
@@ -21,6 +25,7 @@ class top_level_acceleration_structure_build_info;
 class descriptor_set_manager;
 class vulkan_mesh_scene_node;
 class top_level_acceleration_structure;
+class top_level_acceleration_structure_updater;
 
 class scene : public non_copyable {
  public:
@@ -39,6 +44,25 @@ class scene : public non_copyable {
 
   [[nodiscard]] std::uint64_t get_lights_count() const { return m_lights_count; };
 
+  /**
+   * True once every upload issued by load_scene has landed on the GPU.
+   */
+  [[nodiscard]] bool is_resident() const;
+
+  /**
+   * Moves a mesh instance, instances are indexed in the order of the scene
+   * nodes. The top level acceleration structure picks the new transform up
+   * in the next update_acceleration_structure.
+   */
+  void set_instance_transform(std::uint32_t instance_idx,
+                              const glm::mat4& model_matrix);
+  [[nodiscard]] std::uint32_t get_instances_count() const;
+
+  /**
+   * Records the refit of the top level acceleration structure into the frame
+   * command buffer, false when no instance moved since the previous one.
+   */
+  bool update_acceleration_structure(VkCommandBuffer command_buffer);
 
  private:
   std::vector<unique_ptr<sampled_texture>> m_bound_textures;
@@ -51,8 +75,12 @@ class scene : public non_copyable {
   std::vector<vulkan_mesh_scene_node> m_mesh_nodes;
   unique_ptr<top_level_acceleration_structure> m_acceleration_structure;
   std::vector<top_level_acceleration_structure_build_info> m_acceleration_structure_build_info;
+  unique_ptr<top_level_acceleration_structure_updater>
+      m_acceleration_structure_updater;
+  bool m_have_instances_moved = false;
 
   std::uint64_t m_lights_count = 0;
+  std::uint64_t m_upload_timeline_value = 0;
 };
 }  // namespace vulkan
 }  // namespace wunder
@@ -3,6 +3,7 @@
 
 #include <glad/vulkan.h>
 
+#include <cstdint>
 #include <vector>
 
 #include "core/vector_map.h"
@@ -41,6 +42,11 @@ class base_pipeline {
       const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
           shaders_of_types);
 
+  // Identifies the pipeline in the pipeline cache
+  [[nodiscard]] static std::uint64_t get_shaders_hash(
+      const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
+          shaders_of_types);
+
  protected:
   VkPipeline m_vulkan_pipeline = VK_NULL_HANDLE;
   VkPipelineLayout m_vulkan_pipeline_layout = VK_NULL_HANDLE;
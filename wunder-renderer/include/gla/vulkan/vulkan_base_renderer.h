@@ -8,10 +8,12 @@
 #include <vector>
 
 #include "core/vector_map.h"
+#include "core/wunder_memory.h"
 #include "scene/scene_types.h"
 
 namespace wunder {
 struct renderer_capabilities;
+class task_executor;
 class time_unit;
 struct renderer_properties;
 }  // namespace wunder
@@ -54,6 +56,10 @@ public:
  protected:
   vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>> m_shaders;
   unique_ptr<descriptor_set_manager> m_descriptor_set_manager;
+
+ private:
+  // one worker per hardware thread, kept for the next scene's shaders
+  unique_ptr<task_executor> m_shader_compile_executor;
 };
 };  // namespace wunder::vulkan
 #endif  // WUNDER_VULKAN_BASE_RENDERER_H
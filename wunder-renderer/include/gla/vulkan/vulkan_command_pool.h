@@ -3,14 +3,31 @@
 
 #include <glad/vulkan.h>
 
+#include <array>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "core/non_copyable.h"
+#include "core/wunder_memory.h"
 
 namespace wunder::vulkan {
 class device;
 
+/**
+ * Command buffers for one time submissions. Every thread records into its own
+ * VkCommandPool, so scene loading workers don't share the current command
+ * buffers with the main thread. Fences and command buffers of finished
+ * submissions are recycled instead of being destroyed. Threads which are done
+ * recording give their pools back with release_thread_pools.
+ */
 class command_pool : public non_copyable {
+ public:
+  using submit_ticket = std::uint64_t;
+
  public:
   explicit command_pool();
   virtual ~command_pool();
@@ -22,30 +39,75 @@ class command_pool : public non_copyable {
   void flush_graphics_command_buffer();
   void flush_compute_command_buffer();
 
+  /**
+   * Submits the current command buffer of the calling thread and returns
+   * without waiting, the ticket tells when the work is done.
+   */
+  [[nodiscard]] submit_ticket submit_graphics_command_buffer();
+  [[nodiscard]] submit_ticket submit_compute_command_buffer();
+
+  [[nodiscard]] bool is_complete(submit_ticket ticket);
+  void wait(submit_ticket ticket);
+
+  /**
+   * The calling thread doesn't record anymore, e.g. at the end of a loading
+   * task. Its pools are destroyed without waiting, once their submissions
+   * retired. Recording again creates new ones.
+   */
+  void release_thread_pools();
+
  private:
-  [[nodiscard]] VkCommandPool get_graphics_command_pool() const {
-    return m_graphics_command_pool;
-  }
+  enum queue_type : std::uint8_t { graphics = 0, compute = 1, count = 2 };
 
-  [[nodiscard]] VkCommandPool get_compute_command_pool() const {
-    return m_compute_command_pool;
-  }
+  struct queue_command_buffers {
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    VkCommandBuffer m_current = VK_NULL_HANDLE;
+    // executed command buffers, given back by any thread
+    std::vector<VkCommandBuffer> m_free;
+  };
+
+  struct thread_command_pools {
+    std::array<queue_command_buffers, queue_type::count> m_queues;
+  };
+
+  struct in_flight_submission {
+    submit_ticket m_ticket = 0;
+    VkFence m_fence = VK_NULL_HANDLE;
+    VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+    queue_command_buffers* m_owner = nullptr;
+    // threads blocked on the fence, it's not recycled before they return
+    std::uint32_t m_waiters_count = 0;
+  };
 
  private:
-  VkCommandBuffer allocate_graphics_command_buffer(bool begin);
-  VkCommandBuffer allocate_compute_command_buffer(bool begin);
+  thread_command_pools& mutable_thread_command_pools();
+  VkCommandBuffer get_current_command_buffer(queue_type type);
+  submit_ticket submit_command_buffer(queue_type type);
+
+  VkCommandBuffer allocate_command_buffer(queue_type type,
+                                          queue_command_buffers& buffers);
+  VkFence acquire_fence();
 
-  VkCommandBuffer allocate_command_buffer(bool begin, VkCommandPool& out_pool,
-                                          VkCommandBuffer& out_buffer, std::string name);
-  void flush_command_buffer(VkCommandBuffer& command_buffer,
-                            VkCommandPool source_pool, VkQueue queue);
+  std::vector<in_flight_submission>::iterator find_submission(
+      submit_ticket ticket);
+  void retire_completed_submissions();
+  void destroy_released_thread_pools();
+  void destroy_thread_pools(thread_command_pools& pools) const;
+
+  [[nodiscard]] std::uint32_t get_queue_family(queue_type type) const;
+  [[nodiscard]] VkQueue get_queue(queue_type type) const;
 
  private:
-  VkCommandPool m_graphics_command_pool = VK_NULL_HANDLE;
-  VkCommandPool m_compute_command_pool = VK_NULL_HANDLE;
+  std::mutex m_mutex;
+
+  std::unordered_map<std::thread::id, unique_ptr<thread_command_pools>>
+      m_thread_command_pools;
+  // released by their threads, waiting for their submissions to retire
+  std::vector<unique_ptr<thread_command_pools>> m_released_thread_command_pools;
 
-  VkCommandBuffer m_current_graphics_command_buffer = VK_NULL_HANDLE;
-  VkCommandBuffer m_current_compute_command_buffer = VK_NULL_HANDLE;
+  std::vector<VkFence> m_free_fences;
+  std::vector<in_flight_submission> m_in_flight_submissions;
+  submit_ticket m_next_ticket = 1;
 };
 }  // namespace wunder::vulkan
 #endif  // WUNDER_WUNDER_RENDERER_INCLUDE_GLA_VULKAN_VULKAN_COMMAND_POOL_H_
@@ -20,6 +20,9 @@ class swap_chain;
 
 struct vulkan_extensions;
 class memory_allocator;
+class upload_manager;
+class geometry_arena;
+class pipeline_cache;
 }  // namespace wunder::vulkan
 
 namespace wunder::vulkan {
@@ -44,12 +47,18 @@ class context final : public non_copyable {
   [[nodiscard]] device& mutable_device();
   [[nodiscard]] memory_allocator& mutable_resource_allocator();
   [[nodiscard]] command_pool& mutable_command_pool() ;
+  [[nodiscard]] upload_manager& mutable_upload_manager();
+  [[nodiscard]] geometry_arena& mutable_vertex_arena();
+  [[nodiscard]] geometry_arena& mutable_index_arena();
+  [[nodiscard]] pipeline_cache& mutable_pipeline_cache();
 
  private:
   void create_vulkan_instance(const renderer_properties& properties);
   void select_physical_device();
   void select_logical_device();
   void create_allocator();
+  void create_upload_manager();
+  void create_geometry_arenas();
 
  private:
   unique_ptr<instance> m_vulkan;
@@ -57,6 +66,10 @@ class context final : public non_copyable {
   unique_ptr<device> m_logical_device;
   unique_ptr<command_pool> m_command_pool;
   unique_ptr<memory_allocator> m_resource_allocator;
+  unique_ptr<upload_manager> m_upload_manager;
+  unique_ptr<geometry_arena> m_vertex_arena;
+  unique_ptr<geometry_arena> m_index_arena;
+  unique_ptr<pipeline_cache> m_pipeline_cache;
 
   unique_ptr<renderer_capabilities> m_renderer_capabilities;
 };
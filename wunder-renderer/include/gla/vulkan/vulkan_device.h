@@ -3,7 +3,9 @@
 
 #include <glad/vulkan.h>
 
+#include <array>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "core/non_copyable.h"
@@ -33,6 +35,17 @@ class device : public non_copyable {
  public:
   [[nodiscard]] VkQueue get_graphics_queue() { return m_graphics_queue; }
   [[nodiscard]] VkQueue get_compute_queue() { return m_compute_queue; }
+  [[nodiscard]] VkQueue get_transfer_queue() { return m_transfer_queue; }
+
+  /**
+   * Submissions and presents to a VkQueue have to be externally synchronized,
+   * the scene loading thread submits too. Queue families without a queue of
+   * their own alias the same VkQueue, which then shares one mutex.
+   */
+  [[nodiscard]] std::mutex& mutable_queue_mutex(VkQueue queue);
+
+  // vkDeviceWaitIdle, with all queues locked as it requires
+  void wait_idle();
 
  private:
   void create_extensions_list();
@@ -48,6 +61,9 @@ class device : public non_copyable {
   VkDevice m_logical_device = VK_NULL_HANDLE;
   VkQueue m_graphics_queue = VK_NULL_HANDLE;
   VkQueue m_compute_queue = VK_NULL_HANDLE;
+  VkQueue m_transfer_queue = VK_NULL_HANDLE;
+  // graphics, compute and transfer, in this order
+  std::array<std::mutex, 3> m_queue_mutexes;
 
   std::vector<vulkan_extension_data> m_used_extensions;
   std::vector<vulkan_extension_data> m_requested_extensions;
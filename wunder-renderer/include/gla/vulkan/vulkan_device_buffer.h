@@ -5,6 +5,7 @@
 #include <utility>
 
 #include "gla/vulkan/vulkan_buffer.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
 
 namespace wunder::vulkan {
 class command_pool;
@@ -13,10 +14,12 @@ template <typename base_buffer_type>
 class device_buffer : public buffer<base_buffer_type> {
  public:
   device_buffer(descriptor_build_data descriptor_build_data, size_t data_size,
-                VkBufferUsageFlags usage_flags);
+                VkBufferUsageFlags usage_flags,
+                upload_destination owner = upload_destination::graphics);
 
   device_buffer(descriptor_build_data descriptor_build_data, const void* data,
-                size_t data_size, VkBufferUsageFlags usage_flags);
+                size_t data_size, VkBufferUsageFlags usage_flags,
+                upload_destination owner = upload_destination::graphics);
 
   device_buffer(VkCommandBuffer command_buffer,
                 descriptor_build_data descriptor_build_data, const void* data,
@@ -29,12 +32,13 @@ class device_buffer : public buffer<base_buffer_type> {
 
   void free_staging_data() override;
  private:
-  void allocate_device_buffer(size_t data_size, VkBufferUsageFlags usage_flags);
+  void allocate_device_buffer(size_t data_size, VkBufferUsageFlags usage_flags,
+                              upload_destination owner);
   void allocate_cpu_staging_buffer(size_t data_size);
 
  private:
-  VkBuffer m_staging_buffer;
-  VmaAllocation m_staging_buffer_allocation;
+  VkBuffer m_staging_buffer = VK_NULL_HANDLE;
+  VmaAllocation m_staging_buffer_allocation = VK_NULL_HANDLE;
 };
 
 }  // namespace wunder::vulkan
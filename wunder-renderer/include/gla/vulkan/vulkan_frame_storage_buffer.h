@@ -0,0 +1,60 @@
+#ifndef WUNDER_VULKAN_FRAME_STORAGE_BUFFER_H
+#define WUNDER_VULKAN_FRAME_STORAGE_BUFFER_H
+
+#include <glad/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gla/vulkan/vulkan_buffer.h"
+#include "gla/vulkan/vulkan_buffer_fwd.h"
+
+namespace wunder::vulkan {
+
+/**
+ * Storage data read by commands recorded every frame, e.g. the instances of
+ * an acceleration structure refit. Like frame_uniform_buffer the buffer is
+ * host visible, persistently mapped and holds one copy per swap chain image,
+ * the copy of the current frame is no longer read by the GPU once
+ * swap_chain::acquire returned, so it's written without any synchronization.
+ * Consumers address a copy directly via get_frame_address. The other way
+ * round, results the GPU copied into a frame are read once its swap chain
+ * image is acquired again. The memory isn't necessarily host coherent, so
+ * write_frame flushes the copy it wrote and read_frame invalidates the one it
+ * reads.
+ */
+class frame_storage_buffer : public storage_buffer {
+ public:
+  /**
+   * Buffers the host reads back from pass VMA_MEMORY_USAGE_GPU_TO_CPU, which
+   * is cached for reading rather than write combined.
+   */
+  frame_storage_buffer(
+      descriptor_build_data descriptor_build_data, const void* data,
+      size_t data_size, VkBufferUsageFlags usage_flags,
+      VmaMemoryUsage memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU);
+  ~frame_storage_buffer() override;
+
+ public:
+  void update_data(void* data, size_t data_size) override;
+  void write_frame(std::uint32_t frame, const void* data, size_t data_size);
+  void read_frame(std::uint32_t frame, void* out_data, size_t data_size) const;
+
+  [[nodiscard]] VkDeviceAddress get_frame_address(std::uint32_t frame) const;
+  [[nodiscard]] VkDeviceSize get_frame_offset(std::uint32_t frame) const {
+    return frame * m_frame_stride;
+  }
+  [[nodiscard]] std::uint32_t get_current_frame() const;
+  [[nodiscard]] std::uint32_t get_frames_count() const {
+    return m_frames_count;
+  }
+
+ private:
+  std::uint32_t m_frames_count = 0;
+  VkDeviceSize m_frame_stride = 0;
+  size_t m_data_size = 0;
+  std::uint8_t* m_mapped_data = nullptr;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_FRAME_STORAGE_BUFFER_H
@@ -0,0 +1,49 @@
+#ifndef WUNDER_VULKAN_FRAME_UNIFORM_BUFFER_H
+#define WUNDER_VULKAN_FRAME_UNIFORM_BUFFER_H
+
+#include <glad/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gla/vulkan/vulkan_buffer.h"
+#include "gla/vulkan/vulkan_buffer_fwd.h"
+
+namespace wunder::vulkan {
+
+/**
+ * Uniform data which changes every frame. The buffer is host visible,
+ * persistently mapped and holds one copy of the data per swap chain image,
+ * the descriptor selects the copy of the current frame via dynamic offset.
+ * Updates are a memcpy into the copy of the current frame, whose previous
+ * submission is already waited for by swap_chain::acquire, so no barriers or
+ * transfer commands are needed. The written copy is flushed, in case the
+ * memory isn't host coherent.
+ */
+class frame_uniform_buffer : public uniform_buffer {
+ public:
+  frame_uniform_buffer(descriptor_build_data descriptor_build_data,
+                       const void* data, size_t data_size);
+  ~frame_uniform_buffer() override;
+
+ public:
+  void update_data(void* data, size_t data_size) override;
+
+  [[nodiscard]] std::uint32_t get_dynamic_offset() override;
+
+ private:
+  [[nodiscard]] std::uint32_t get_current_frame() const;
+  void write_frame(std::uint32_t frame);
+
+ private:
+  std::uint32_t m_frames_count = 0;
+  VkDeviceSize m_frame_stride = 0;
+  std::uint8_t* m_mapped_data = nullptr;
+
+  // the latest data, written lazily to the copies of the other frames
+  std::vector<std::byte> m_data;
+  std::vector<bool> m_is_frame_outdated;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_FRAME_UNIFORM_BUFFER_H
@@ -0,0 +1,76 @@
+#ifndef WUNDER_VULKAN_GEOMETRY_ARENA_H
+#define WUNDER_VULKAN_GEOMETRY_ARENA_H
+
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "core/non_copyable.h"
+#include "core/offset_allocator.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/vulkan_buffer_fwd.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
+
+namespace wunder::vulkan {
+
+/**
+ * Shared storage for the geometry of all meshes. Instead of one allocation per
+ * mesh, meshes sub-allocate element ranges from a few big blocks, every block
+ * is one device buffer. Offsets and sizes are in elements, e.g. vertices.
+ */
+class geometry_arena : public non_copyable {
+ public:
+  struct range {
+    std::uint32_t m_block = offset_allocator::s_invalid_offset;
+    offset_allocator::allocation m_allocation;
+
+    [[nodiscard]] bool is_valid() const { return m_allocation.is_valid(); }
+    [[nodiscard]] std::uint32_t get_offset() const {
+      return m_allocation.m_offset;
+    }
+  };
+
+ public:
+  geometry_arena(std::string name, VkDeviceSize element_size,
+                 std::uint32_t block_elements_count);
+  ~geometry_arena() override;
+
+ public:
+  /**
+   * Sub-allocates a range for elements_count elements and uploads data to it.
+   * A new block is created when none of the existing ones has space. Blocks
+   * are built into acceleration structures on compute and read by the ray
+   * tracing shaders on graphics, so both families share them.
+   */
+  [[nodiscard]] range allocate(const void* data, std::uint32_t elements_count);
+  void free(range& geometry_range);
+
+  [[nodiscard]] VkDeviceAddress get_block_address(std::uint32_t block) const;
+  [[nodiscard]] VkDeviceAddress get_address(const range& geometry_range) const;
+
+  [[nodiscard]] offset_allocator::storage_report get_storage_report() const;
+
+ private:
+  struct block {
+    unique_ptr<storage_device_buffer> m_buffer;
+    VkDeviceAddress m_address = 0;
+    offset_allocator m_allocator;
+  };
+
+ private:
+  block& create_block(std::uint32_t elements_count);
+
+ private:
+  mutable std::mutex m_mutex;
+
+  std::string m_name;
+  VkDeviceSize m_element_size;
+  std::uint32_t m_block_elements_count;
+
+  std::vector<unique_ptr<block>> m_blocks;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_GEOMETRY_ARENA_H
@@ -2,10 +2,10 @@
 #ifndef WUNDER_VULKAN_INDEX_BUFFER_H
 #define WUNDER_VULKAN_INDEX_BUFFER_H
 
-#include "gla/vulkan/vulkan_buffer_fwd.h"
-#include "core/wunder_memory.h"
 #include <glad/vulkan.h>
 
+#include "gla/vulkan/vulkan_geometry_arena.h"
+
 namespace wunder{
 struct mesh_asset;
 }
@@ -14,7 +14,11 @@ namespace wunder::vulkan {
 
 class index_buffer {
  public:
-  static unique_ptr<storage_buffer> create(VkCommandBuffer command_buffer, const mesh_asset& asset);
+  /**
+   * Sub-allocates the mesh indices from the context index arena. Indices stay
+   * relative to the first vertex of the mesh.
+   */
+  static geometry_arena::range create(const mesh_asset& asset);
 };
 }  // namespace wunder::vulkan
 #endif  // WUNDER_VULKAN_INDEX_BUFFER_H
@@ -4,12 +4,39 @@
 #include <glad/vulkan.h>
 #include <vk_mem_alloc.h>
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
 
 #include "core/non_copyable.h"
 
 namespace wunder::vulkan {
+
+/**
+ * Resource classes, each class and memory type gets its own VMA pool so
+ * long living resources don't fragment the blocks of the short living ones.
+ */
+enum class memory_class : std::uint8_t {
+  generic = 0,
+  staging,
+  geometry,
+  acceleration_structure,
+  shader_binding_table,
+  texture,
+  count
+};
+
 class memory_allocator : public non_copyable{
+ public:
+  struct memory_class_usage {
+    std::uint64_t m_allocated_bytes = 0;
+    std::uint64_t m_allocations_count = 0;
+    std::uint64_t m_degraded_allocations_count = 0;
+  };
+
  public:
   memory_allocator() = default;
   explicit memory_allocator(std::string tag);
@@ -22,6 +49,12 @@ class memory_allocator : public non_copyable{
   // void Allocate(VkMemoryRequirements requirements, VkDeviceMemory* dest,
   // VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
+  /**
+   * Allocations stay within the heap budget reported by VK_EXT_memory_budget.
+   * When the preferred memory type is over budget, the allocation degrades to
+   * any other compatible memory type, e.g. device local to host visible,
+   * instead of failing.
+   */
   VmaAllocation allocate_buffer(VkBufferCreateInfo buffer_create_info,
                                 VmaMemoryUsage usage, VkBuffer& out_buffer);
   VmaAllocation allocate_image(VkImageCreateInfo image_create_info,
@@ -42,11 +75,53 @@ class memory_allocator : public non_copyable{
   void unmap_memory(VmaAllocation allocation);
   void dump_stats();
 
+  [[nodiscard]] memory_class_usage get_usage(memory_class type) const;
+
   VmaAllocator& get_vma_allocator();
 
+ private:
+  static constexpr std::size_t s_memory_classes_count =
+      static_cast<std::size_t>(memory_class::count);
+
+  struct memory_class_counters {
+    std::atomic<std::uint64_t> m_allocated_bytes{0};
+    std::atomic<std::uint64_t> m_allocations_count{0};
+    std::atomic<std::uint64_t> m_degraded_allocations_count{0};
+  };
+
+  using memory_class_pools =
+      std::array<std::atomic<VmaPool>, VK_MAX_MEMORY_TYPES>;
+
+ private:
+  [[nodiscard]] static memory_class get_buffer_memory_class(
+      VkBufferUsageFlags buffer_usage, VmaMemoryUsage usage);
+
+  VmaPool get_or_create_pool(memory_class type,
+                             std::uint32_t memory_type_index);
+
+  VmaAllocationCreateInfo create_allocation_info(
+      memory_class type, VmaMemoryUsage usage,
+      std::uint32_t memory_type_index);
+  [[nodiscard]] static VmaAllocationCreateInfo create_degraded_allocation_info(
+      const VmaAllocationCreateInfo& allocation_create_info,
+      VmaMemoryUsage usage);
+
+  VkResult allocate_within_budget(
+      const std::function<VkResult(const VmaAllocationCreateInfo&)>& allocate,
+      const VmaAllocationCreateInfo& allocation_create_info,
+      VmaMemoryUsage usage, bool& out_degraded);
+
+  void track_allocation(VmaAllocation allocation, bool degraded);
+  void untrack_allocation(VmaAllocation allocation);
+
  private:
   std::string m_tag;
   VmaAllocator m_resource_allocator;
+  bool m_is_budget_supported = false;
+
+  std::mutex m_pools_mutex;
+  std::array<memory_class_pools, s_memory_classes_count> m_pools{};
+  std::array<memory_class_counters, s_memory_classes_count> m_counters;
 };
 
 }  // namespace wunder
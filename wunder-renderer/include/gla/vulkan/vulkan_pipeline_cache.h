@@ -0,0 +1,69 @@
+#ifndef WUNDER_VULKAN_PIPELINE_CACHE_H
+#define WUNDER_VULKAN_PIPELINE_CACHE_H
+
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/non_copyable.h"
+
+namespace wunder::vulkan {
+
+/**
+ * Pipeline caches persisted in the cache directory. Every set of shaders gets
+ * its own file, keyed by the device, the driver version and the hash of the
+ * SPIR-V, so a driver update or a shader edit starts from an empty cache
+ * instead of handing stale data to the driver. Files are loaded on first use
+ * and written back when the cache is destroyed.
+ */
+class pipeline_cache : public non_copyable {
+ public:
+  struct statistics {
+    std::uint32_t m_hits = 0;
+    std::uint32_t m_misses = 0;
+  };
+
+ public:
+  pipeline_cache();
+  ~pipeline_cache() override;
+
+ public:
+  VkPipelineCache get_or_load(const std::string& name,
+                              std::uint64_t shaders_hash);
+
+  /**
+   * With pipelineCreationCacheControl a pipeline can be created with
+   * VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT first, which
+   * tells a cache hit from a miss before the driver compiles anything.
+   */
+  [[nodiscard]] bool is_miss_detection_supported() const;
+  void record_lookup(const std::string& name, bool hit);
+  [[nodiscard]] statistics get_statistics() const;
+
+  void save();
+
+ private:
+  struct entry {
+    VkPipelineCache m_vulkan_pipeline_cache = VK_NULL_HANDLE;
+    std::filesystem::path m_path;
+    std::uint64_t m_shaders_hash = 0;
+    std::uint64_t m_data_hash = 0;
+  };
+
+ private:
+  [[nodiscard]] std::uint64_t get_device_hash() const;
+  [[nodiscard]] std::vector<char> load_data(const entry& cache_entry) const;
+  void save_entry(entry& cache_entry) const;
+
+ private:
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::uint64_t, entry> m_entries;
+  statistics m_statistics;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_PIPELINE_CACHE_H
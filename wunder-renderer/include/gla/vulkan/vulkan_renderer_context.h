@@ -1,9 +1,12 @@
 #ifndef VULKAN_RENDERER_CONTEXT_H
 #define VULKAN_RENDERER_CONTEXT_H
 
+#include <optional>
+
 #include "core/non_copyable.h"
 #include "core/wunder_memory.h"
 #include "event/event_handler.h"
+#include "scene/scene_types.h"
 
 // forward declarations
 namespace wunder {
@@ -17,6 +20,10 @@ namespace wunder::event {
 struct scene_activated;
 }  // namespace wunder::event
 
+namespace wunder::cpu {
+class render_target;
+}  // namespace wunder::cpu
+
 namespace wunder::vulkan {
 class swap_chain;
 class rasterize_renderer;
@@ -42,12 +49,20 @@ class renderer_context : public non_copyable,
   [[nodiscard]] render_pass& mutable_render_pass();
   [[nodiscard]] rasterize_renderer& mutable_rasterize_renderer();
   [[nodiscard]] rtx_renderer& mutable_rtx_renderer();
+  [[nodiscard]] bool has_active_scene() const { return m_have_active_scene; }
 
  public:
   bool begin();
   void update(time_unit dt);
   void end();
 
+  /**
+   * Offscreen render target path of headless runs. Waits for the frames in
+   * flight and copies the accumulated, linear ray tracing output to the host.
+   * The target has to have the renderer's size.
+   */
+  bool read_output_image(cpu::render_target& out_target);
+
  private:
   void on_event(const wunder::event::scene_activated&) override;
 
@@ -55,8 +70,13 @@ class renderer_context : public non_copyable,
   void log_current_sate_frame();
   void log_loaded_scene_size();
 
+  void try_activate_pending_scene();
+
  private:
   bool m_have_active_scene;
+  // Activated scene whose uploads are still in flight, the previous scene
+  // keeps rendering until it becomes resident
+  std::optional<scene_id> m_pending_scene_id;
 
   const renderer_properties& m_renderer_properties;
   unique_ptr<swap_chain> m_swap_chain;
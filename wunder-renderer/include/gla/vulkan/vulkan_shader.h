@@ -3,6 +3,7 @@
 
 #include <glad/vulkan.h>
 
+#include <cstdint>
 #include <expected>
 #include <filesystem>
 #include <vector>
@@ -32,14 +33,22 @@ class shader : public non_copyable {
   static std::expected<unique_ptr<shader>, shader_operation_output_code>
   create(const std::filesystem::path& spirv, const VkShaderStageFlagBits stage);
 
-  static std::expected<std::vector<std::uint32_t>, shader_operation_output_code>
-  compile_shader(std::ifstream& spirv_istream,
-                 const std::filesystem::path& shader_parent_dir,
-                 const std::string& shader_name,
-                 const VkShaderStageFlagBits stage);
+  static unique_ptr<shader> create(const std::filesystem::path& spirv,
+                                   const VkShaderStageFlagBits stage,
+                                   const shader_binary& binary);
+
+  /**
+   * Returns the SPIR-V and reflection data of the shader. Compiled and
+   * reflected at runtime, or with WUNDER_PRECOMPILED_SHADERS loaded from the
+   * artifacts of the offline shader build. Doesn't touch the device, so
+   * shaders can be loaded in parallel.
+   */
+  static std::expected<shader_binary, shader_operation_output_code>
+  load_spirv(const std::filesystem::path& spirv,
+             const VkShaderStageFlagBits stage);
 
  public:
-  void initialize(const std::vector<std::uint32_t>& debug_spirv);
+  void initialize(const shader_binary& binary);
 
  public:
   const vulkan_shader_reflection_data& get_shader_reflection_data() const {
@@ -48,11 +57,9 @@ class shader : public non_copyable {
 
   VkShaderModule get_vulkan_shader_module() const { return m_shader_module; }
 
-  VkPipelineShaderStageCreateInfo get_shader_stage_info() const;
+  [[nodiscard]] std::uint64_t get_spirv_hash() const { return m_spirv_hash; }
 
- private:
-  void initialize_reflection_data(
-      const std::vector<std::uint32_t>& debug_spirv);
+  VkPipelineShaderStageCreateInfo get_shader_stage_info() const;
 
  private:
   std::string m_shader_name;
@@ -60,6 +67,7 @@ class shader : public non_copyable {
 
   const VkShaderStageFlagBits m_vulkan_shader_type;
   VkShaderModule m_shader_module = VK_NULL_HANDLE;
+  std::uint64_t m_spirv_hash = 0;
 };
 }  // namespace wunder::vulkan
 #endif  // WUNDER_VULKAN_SHADER_H
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef WUNDER_VULKAN_SHADER_ARTIFACT_H
+#define WUNDER_VULKAN_SHADER_ARTIFACT_H
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "gla/vulkan/vulkan_shader_types.h"
+
+/**
+ * Files produced by the offline shader build for every shader source:
+ * <name>.spv holds the SPIR-V, <name>.refl the reflection data, so loading
+ * them needs neither the compiler nor SPIRV-Cross.
+ */
+namespace wunder::vulkan::shader_artifact {
+
+std::filesystem::path get_spirv_path(const std::filesystem::path& directory,
+                                     const std::string& shader_name);
+std::filesystem::path get_reflection_path(
+    const std::filesystem::path& directory, const std::string& shader_name);
+
+bool save(const std::filesystem::path& directory,
+          const std::string& shader_name, const shader_binary& binary);
+
+std::optional<shader_binary> load(const std::filesystem::path& directory,
+                                  const std::string& shader_name);
+
+}  // namespace wunder::vulkan::shader_artifact
+#endif  // WUNDER_VULKAN_SHADER_ARTIFACT_H
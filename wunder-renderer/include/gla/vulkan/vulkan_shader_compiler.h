@@ -0,0 +1,39 @@
+#ifndef WUNDER_VULKAN_SHADER_COMPILER_H
+#define WUNDER_VULKAN_SHADER_COMPILER_H
+
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "gla/vulkan/vulkan_shader.h"
+#include "gla/vulkan/vulkan_shader_types.h"
+
+/**
+ * GLSL compilation and SPIR-V reflection. The only part of the renderer which
+ * depends on shaderc and SPIRV-Cross, it isn't built into the runtime when
+ * shaders are precompiled (WUNDER_PRECOMPILED_SHADERS) and doesn't touch the
+ * device, so the offline shader build links it on its own.
+ */
+namespace wunder::vulkan::shader_compiler {
+
+/**
+ * Returns the SPIR-V of the GLSL source, from the on-disk cache when the
+ * preprocessed source, with all includes resolved, the compile options and
+ * the compiler version match a previous compilation. [optimize] strips
+ * debug info and runs the performance passes.
+ */
+std::expected<std::vector<std::uint32_t>, shader_operation_output_code>
+compile(const std::filesystem::path& source_path,
+        const VkShaderStageFlagBits stage, bool optimize = false);
+
+vulkan_shader_reflection_data reflect(const std::vector<std::uint32_t>& spirv);
+
+std::optional<VkShaderStageFlagBits> get_stage_from_extension(
+    const std::filesystem::path& source_path);
+
+}  // namespace wunder::vulkan::shader_compiler
+#endif  // WUNDER_VULKAN_SHADER_COMPILER_H
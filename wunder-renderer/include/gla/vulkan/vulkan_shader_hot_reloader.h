@@ -0,0 +1,86 @@
+#ifndef WUNDER_VULKAN_SHADER_HOT_RELOADER_H
+#define WUNDER_VULKAN_SHADER_HOT_RELOADER_H
+
+#include <glad/vulkan.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "core/non_copyable.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/vulkan_shader_types.h"
+
+namespace wunder {
+class file_watcher;
+class task_executor;
+class time_unit;
+}  // namespace wunder
+
+namespace wunder::vulkan {
+
+/**
+ * Recompiles shaders whose source, or any file they include, changed on
+ * disk. Compilation runs on a worker thread, the results are handed to
+ * [on_reloaded] from update, so the owner can swap its pipeline at a frame
+ * boundary. Shaders which fail to compile are reported and the previous
+ * binaries stay in use.
+ */
+class shader_hot_reloader : public non_copyable {
+ public:
+  struct tracked_shader {
+    std::filesystem::path m_shader_path;
+    VkShaderStageFlagBits m_stage;
+    // position of the shader among the shaders of its stage
+    std::size_t m_index;
+  };
+
+  struct reloaded_shader {
+    tracked_shader m_shader;
+    shader_binary m_binary;
+  };
+
+  using reloaded_callback = std::function<void(std::vector<reloaded_shader>&)>;
+
+ public:
+  shader_hot_reloader(const std::filesystem::path& shaders_directory,
+                      reloaded_callback on_reloaded);
+  ~shader_hot_reloader() override;
+
+ public:
+  void track(tracked_shader shader);
+
+  void update(time_unit dt);
+
+ private:
+  void on_compiled(std::vector<reloaded_shader>& reloaded_shaders,
+                   bool succeeded);
+
+  void collect_affected_shaders();
+  void try_compile_affected_shaders();
+
+  void update_dependencies(std::size_t shader_idx);
+  void collect_includes(const std::filesystem::path& file,
+                        const std::filesystem::path& search_directory,
+                        std::unordered_set<std::string>& dependencies) const;
+
+ private:
+  std::vector<tracked_shader> m_tracked_shaders;
+  // file -> indices of the tracked shaders which compile it, directly or
+  // through an include
+  std::unordered_map<std::string, std::vector<std::size_t>> m_dependants;
+  std::vector<std::unordered_set<std::string>> m_dependencies;
+
+  std::unordered_set<std::size_t> m_affected_shaders;
+  bool m_is_compiling = false;
+
+  reloaded_callback m_on_reloaded;
+  unique_ptr<file_watcher> m_file_watcher;
+  unique_ptr<task_executor> m_compile_executor;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_SHADER_HOT_RELOADER_H
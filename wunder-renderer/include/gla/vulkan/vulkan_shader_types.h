@@ -4,6 +4,7 @@
 #include <glad/vulkan.h>
 
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <variant>
@@ -68,6 +69,12 @@ struct base {
 };
 
 struct uniform_buffer : public base {
+  /**
+   * Uniform buffers are bound as dynamic descriptors, the offset is added to
+   * m_descriptor.offset every time the descriptor set is bound.
+   */
+  [[nodiscard]] virtual std::uint32_t get_dynamic_offset() { return 0; }
+
   VkDescriptorBufferInfo m_descriptor;
 };
 
@@ -121,6 +128,12 @@ using resource_list =
 struct vulkan_descriptor_binding {
  public:
   void emplace_resource(const shader_resource::instance::element& resource);
+  /**
+   * Overwrites a single array element, an element right after the last one
+   * is appended.
+   */
+  bool replace_resource(std::uint32_t array_element,
+                        const shader_resource::instance::element& resource);
   void clear_resources();
 
   [[nodiscard]] size_t size() const;
@@ -132,6 +145,8 @@ struct vulkan_descriptor_binding {
  public:
   VkDescriptorType m_descriptor_type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
   shader_resource::instance::resource_list m_resources;
+  std::vector<std::reference_wrapper<shader_resource::instance::uniform_buffer>>
+      m_dynamic_resources;
 };
 
 struct vulkan_descriptor_bindings {
@@ -157,6 +172,15 @@ struct vulkan_shader_reflection_data {
   std::uint32_t m_descriptor_sets_count;
 };
 
+/**
+ * Everything a shader module is created from, either compiled and reflected
+ * at runtime or loaded from the artifacts of the offline shader build.
+ */
+struct shader_binary {
+  std::vector<std::uint32_t> m_spirv;
+  vulkan_shader_reflection_data m_reflection_data{};
+};
+
 struct vulkan_extension_data {
   std::string m_name;
   bool m_optional{false};
@@ -0,0 +1,203 @@
+#ifndef WUNDER_VULKAN_UPLOAD_MANAGER_H
+#define WUNDER_VULKAN_UPLOAD_MANAGER_H
+
+#include <glad/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "core/non_copyable.h"
+
+namespace wunder::vulkan {
+
+/**
+ * Queue family which consumes an uploaded resource. Resources are released by
+ * the transfer queue family and acquired by the consumer family, when both
+ * differ. Shared buffers are read by both, e.g. geometry built into
+ * acceleration structures on compute and traced on graphics. They are
+ * created with concurrent sharing, so uploads transfer no ownership and every
+ * consumer family waits for them.
+ */
+enum class upload_destination { graphics, compute, shared };
+
+/**
+ * Host to device uploads through a persistently mapped staging ring. Copies
+ * are recorded on the transfer queue and submitted as one batch, every batch
+ * signals the next value of a timeline semaphore. Ring space of a batch is
+ * given back, once the semaphore reaches its value.
+ *
+ * Consumers don't wait on the CPU, command_pool and swap_chain submissions
+ * wait for the uploads of their queue family on the GPU side and execute the
+ * ownership acquire barriers before their own commands.
+ *
+ * All public methods are thread safe, scenes are uploaded from a worker
+ * thread while the main thread keeps rendering.
+ */
+class upload_manager : public non_copyable {
+ public:
+  static constexpr VkDeviceSize s_default_ring_size = 64ull * 1024 * 1024;
+  static constexpr VkDeviceSize s_staging_alignment = 16;
+
+ public:
+  struct image_upload_region {
+    const void* m_data = nullptr;
+    VkDeviceSize m_size = 0;
+    std::uint32_t m_mip_level = 0;
+    VkExtent3D m_extent{};
+  };
+
+  /**
+   * Has to be added to a queue submission which uses uploaded resources. The
+   * acquire command buffer goes first in the submission, the signal semaphore
+   * tells the manager when the command buffer can be recycled.
+   */
+  struct submit_dependencies {
+    VkSemaphore m_wait_semaphore = VK_NULL_HANDLE;
+    std::uint64_t m_wait_value = 0;
+    VkCommandBuffer m_acquire_command_buffer = VK_NULL_HANDLE;
+    VkSemaphore m_signal_semaphore = VK_NULL_HANDLE;
+    std::uint64_t m_signal_value = 0;
+  };
+
+  // Calls vkQueueSubmit with the dependencies added to the submission
+  using queue_submit_function =
+      std::function<VkResult(VkQueue, const submit_dependencies&)>;
+
+ public:
+  explicit upload_manager(VkDeviceSize ring_size = s_default_ring_size);
+  ~upload_manager() override;
+
+ public:
+  void upload_buffer(
+      VkBuffer destination, VkDeviceSize destination_offset, const void* data,
+      VkDeviceSize data_size,
+      upload_destination owner = upload_destination::graphics);
+
+  /**
+   * Uploads the given mip levels and leaves all mip_levels of the image in
+   * target_layout.
+   */
+  void upload_image(VkImage destination, std::uint32_t mip_levels,
+                    const std::vector<image_upload_region>& regions,
+                    VkImageLayout target_layout,
+                    upload_destination owner = upload_destination::graphics);
+
+  /**
+   * Submits the pending batch, returns the timeline value that signals its
+   * completion.
+   */
+  std::uint64_t submit();
+  void wait(std::uint64_t timeline_value);
+  void flush();
+
+  [[nodiscard]] bool is_complete(std::uint64_t timeline_value);
+
+  /**
+   * Submits to queue, one of queue_family, with the upload dependencies of the
+   * family. The acquire signal value is reserved and submitted under the
+   * manager's lock, so values of a family's acquire timeline are signalled in
+   * submission order.
+   */
+  VkResult submit_with_dependencies(
+      std::uint32_t queue_family, VkQueue queue,
+      const queue_submit_function& submit_function);
+
+  // Distinct families a buffer of upload_destination::shared is created for
+  [[nodiscard]] std::vector<std::uint32_t> get_shared_queue_families() const;
+
+ private:
+  struct staging_allocation {
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    VmaAllocation m_allocation = VK_NULL_HANDLE;
+    VkDeviceSize m_offset = 0;
+    std::uint8_t* m_mapped_data = nullptr;
+  };
+
+  struct upload_batch {
+    VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+    std::uint64_t m_timeline_value = 0;
+    VkDeviceSize m_ring_end = 0;
+    VkDeviceSize m_ring_consumed = 0;
+    VkDeviceSize m_copied_bytes = 0;
+    std::vector<std::pair<VkBuffer, VmaAllocation>> m_dedicated_staging;
+  };
+
+  /**
+   * Every family signals its own acquire timeline, values signalled by
+   * different queues would complete out of order on a shared one.
+   */
+  struct queue_family_state {
+    VkCommandPool m_command_pool = VK_NULL_HANDLE;
+    VkSemaphore m_acquire_semaphore = VK_NULL_HANDLE;
+    std::uint64_t m_last_acquire_value = 0;
+    std::vector<VkBufferMemoryBarrier> m_buffer_acquires;
+    std::vector<VkImageMemoryBarrier> m_image_acquires;
+    bool m_has_pending_uploads = false;
+    std::uint64_t m_required_value = 0;
+    std::deque<std::pair<std::uint64_t, VkCommandBuffer>>
+        m_in_flight_command_buffers;
+    std::vector<VkCommandBuffer> m_free_command_buffers;
+  };
+
+ private:
+  void create_ring_buffer();
+  void create_command_pool();
+
+  [[nodiscard]] std::uint32_t get_queue_family(upload_destination owner) const;
+  queue_family_state& mutable_queue_family_state(std::uint32_t queue_family);
+  submit_dependencies get_submit_dependencies(std::uint32_t queue_family);
+
+  staging_allocation allocate_staging(VkDeviceSize size);
+  bool try_allocate_from_ring(VkDeviceSize size, VkDeviceSize& out_offset);
+  staging_allocation allocate_dedicated_staging(VkDeviceSize size);
+  void flush_staging(const staging_allocation& staging,
+                     VkDeviceSize size) const;
+
+  VkCommandBuffer begin_batch();
+  std::uint64_t submit_pending_batch();
+  void submit_batch_if_big();
+
+  VkCommandBuffer record_acquire_command_buffer(queue_family_state& state);
+
+  void retire_completed_batches();
+  void retire_batch(upload_batch& batch);
+  void wait_oldest_batch();
+  void wait_semaphore(VkSemaphore semaphore, std::uint64_t value) const;
+
+ private:
+  std::mutex m_mutex;
+
+  std::uint32_t m_transfer_family;
+  std::uint32_t m_graphics_family;
+  std::uint32_t m_compute_family;
+  VkQueue m_transfer_queue = VK_NULL_HANDLE;
+
+  VkDeviceSize m_ring_size;
+  VkBuffer m_ring_buffer = VK_NULL_HANDLE;
+  VmaAllocation m_ring_allocation = VK_NULL_HANDLE;
+  std::uint8_t* m_ring_mapped_data = nullptr;
+
+  VkDeviceSize m_ring_head = 0;
+  VkDeviceSize m_ring_tail = 0;
+  VkDeviceSize m_ring_used = 0;
+
+  VkCommandPool m_command_pool = VK_NULL_HANDLE;
+  std::vector<VkCommandBuffer> m_free_command_buffers;
+
+  VkSemaphore m_timeline_semaphore = VK_NULL_HANDLE;
+  std::uint64_t m_last_submitted_value = 0;
+  std::uint64_t m_last_completed_value = 0;
+
+  bool m_has_pending_batch = false;
+  upload_batch m_pending_batch;
+  std::deque<upload_batch> m_in_flight_batches;
+
+  std::unordered_map<std::uint32_t, queue_family_state> m_queue_families;
+};
+}  // namespace wunder::vulkan
+#endif  // WUNDER_VULKAN_UPLOAD_MANAGER_H
@@ -3,8 +3,7 @@
 
 #include <glad/vulkan.h>
 
-#include "core/wunder_memory.h"
-#include "gla/vulkan/vulkan_buffer_fwd.h"
+#include "gla/vulkan/vulkan_geometry_arena.h"
 
 namespace wunder {
 struct mesh_asset;
@@ -13,8 +12,10 @@ struct mesh_asset;
 namespace wunder::vulkan {
 class vertex_buffer {
  public:
-  static unique_ptr<storage_buffer> create(VkCommandBuffer command_buffer,
-                                           const mesh_asset& asset);
+  /**
+   * Sub-allocates the mesh vertices from the context vertex arena.
+   */
+  static geometry_arena::range create(const mesh_asset& asset);
 };
 }  // namespace wunder::vulkan
 #endif  // WUNDER_VULKAN_VERTEX_BUFFER_H
@@ -34,6 +34,8 @@ public:
   [[nodiscard]] optional_ref<vulkan::scene> mutable_api_scene(scene_id id);
   [[nodiscard]] optional_const_ref<scene_asset> get_scene_asset(
       scene_id id) const;
+  // Changes made before the scene is activated apply to its load
+  [[nodiscard]] optional_ref<scene_asset> mutable_scene_asset(scene_id id);
 
   bool activate_scene(scene_id id);
   bool deactivate_scene(scene_id id);
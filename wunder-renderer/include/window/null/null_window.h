@@ -0,0 +1,37 @@
+#ifndef NULL_WINDOW_H
+#define NULL_WINDOW_H
+
+#include <glad/vulkan.h>
+
+#include "window/window.h"
+
+namespace wunder {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Window of headless runs, render farm workers and batch jobs. It has no
+ * surface, so the swap chain renders into images it owns instead of presenting
+ * them.
+ */
+class null_window : public window {
+ public:
+  static constexpr window_type type = window_type::null;
+
+ public:
+  null_window();
+  ~null_window() override;
+
+ public:
+  void init(const window_properties& properties) override;
+  void update(time_unit dt) override;
+
+ public:
+  void fill_vulkan_extensions(
+      wunder::vulkan::vulkan_extensions& out_extensions) const override;
+
+  [[nodiscard]] VkSurfaceKHR create_vulkan_surface() const override;
+};
+}  // namespace wunder
+
+#endif
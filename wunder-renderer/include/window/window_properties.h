@@ -4,7 +4,7 @@
 #include <string>
 
 namespace wunder {
-enum class window_type : std::int32_t { glfw };
+enum class window_type : std::int32_t { glfw, null };
 
 /////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////
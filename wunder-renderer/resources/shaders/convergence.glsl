@@ -0,0 +1,88 @@
+//-------------------------------------------------------------------------------------------------
+// Adaptive sampling. Every pixel accumulates the moments of the luminance of
+// its frames next to its color, tiles whose pixels all reached the relative
+// error threshold stop tracing until the accumulation restarts.
+// wunder::cpu::convergence_tracker mirrors these for verification.
+
+
+#ifndef CONVERGENCE_GLSL
+#define CONVERGENCE_GLSL 1
+
+
+float convergenceLuminance(vec3 color)
+{
+  return 0.3 * color.x + 0.6 * color.y + 0.1 * color.z;  // luminance approx.
+}
+
+// Relative standard error of the mean of 'frames' estimates, moments.x is the
+// mean luminance and moments.y the mean of the squared luminance
+float convergenceError(vec4 moments, int frames)
+{
+  float variance = max(moments.y - moments.x * moments.x, 0.0);
+  return sqrt(variance / float(frames)) / (moments.x + ConvergenceDarkOffset);
+}
+
+uint convergenceTilesCount(ivec2 imageRes)
+{
+  ivec2 tiles = (imageRes + ConvergenceTileSize - 1) / ConvergenceTileSize;
+  return uint(tiles.x * tiles.y);
+}
+
+uint convergenceTile(ivec2 imageCoords, ivec2 imageRes)
+{
+  int tilesX = (imageRes.x + ConvergenceTileSize - 1) / ConvergenceTileSize;
+  ivec2 tile = imageCoords / ConvergenceTileSize;
+  return uint(tile.y * tilesX + tile.x);
+}
+
+// The flags of the previous frame are read, the ones of this frame written.
+// A tile not flagged by the previous frame traced nothing and flags nothing
+// again, so it stays converged until the frames restart.
+bool isTileConverged(ivec2 imageCoords)
+{
+  // The first frame reads the flags of the frames before the restart
+  if(rtxState.convergenceThreshold <= 0.0 || rtxState.frame < max(rtxState.minConvergenceFrames, 1))
+  {
+    return false;
+  }
+
+  uint readHalf = uint((rtxState.frame + 1) & 1) * convergenceTilesCount(rtxState.size);
+  return tileUnconverged[readHalf + convergenceTile(imageCoords, rtxState.size)] == 0;
+}
+
+// Accumulates the luminance moments the way the color is and flags the tile
+// while the pixel is above the threshold
+void updateConvergence(ivec2 imageCoords, vec3 pixelColor)
+{
+  if(rtxState.convergenceThreshold <= 0.0)
+  {
+    return;
+  }
+
+  float luminance = convergenceLuminance(pixelColor);
+  vec4  moments   = vec4(luminance, luminance * luminance, 0.0, 1.0);
+  if(rtxState.frame > 0)
+  {
+    vec4 old_moments = imageLoad(rtxMomentsImage, imageCoords);
+    moments.xy       = mix(old_moments.xy, moments.xy, 1.0f / float(rtxState.frame + 1));
+  }
+
+  // Kept for inspecting the error, e.g. in a capture
+  moments.z = convergenceError(moments, rtxState.frame + 1);
+  imageStore(rtxMomentsImage, imageCoords, moments);
+
+  if(moments.z <= rtxState.convergenceThreshold && rtxState.frame + 1 >= rtxState.minConvergenceFrames)
+  {
+    return;
+  }
+
+  uint writeHalf = uint(rtxState.frame & 1);
+  uint tile      = writeHalf * convergenceTilesCount(rtxState.size) + convergenceTile(imageCoords, rtxState.size);
+  if(atomicAdd(tileUnconverged[tile], 1) == 0)
+  {
+    atomicAdd(unconvergedTiles[writeHalf], 1);
+  }
+}
+
+
+#endif  // CONVERGENCE_GLSL
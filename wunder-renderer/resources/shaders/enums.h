@@ -9,7 +9,7 @@ START_ENUM(SetBindings)
   S_OUT   = 1,  // Offscreen output image
   S_SCENE = 2,  // Scene data
   S_ENV   = 3,  // Environment / Sun & Sky
-  S_WF    = 4   // Wavefront extra data
+  S_FRAME = 4   // Per frame uniforms, bound with dynamic offsets
 END_ENUM();
 
 // Acceleration Structure - Set 0
@@ -19,13 +19,14 @@ END_ENUM();
 
 // Output image - Set 1
 START_ENUM(OutputBindings)
-  eSampler = 0,  // As sampler
-  eStore   = 1   // As storage
+  eSampler     = 0,  // As sampler
+  eStore       = 1,  // As storage
+  eMoments     = 2,  // Luminance moments of the adaptive sampling
+  eConvergence = 3   // Unconverged tiles of the adaptive sampling
 END_ENUM();
 
-// Scene Data - Set 2
+// Scene Data - Set 2, update after bind
 START_ENUM(SceneBindings)
-  eCamera    = 0,
   eMaterials = 1,
   eInstData  = 2,
   eLights    = 3,
@@ -34,9 +35,16 @@ END_ENUM();
 
 // Environment - Set 3
 START_ENUM(EnvBindings)
-  eSunSky     = 0,
-  eHdr        = 1,
-  eImpSamples = 2
+  eSunSky         = 0,
+  eHdr            = 1,
+  eImpSamples     = 2,
+  eIrradianceSH   = 3,
+  ePrefilteredHdr = 4
+END_ENUM();
+
+// Per frame data - Set 4
+START_ENUM(FrameBindings)
+  eCamera = 0
 END_ENUM();
 
 START_ENUM(DebugMode)
@@ -54,6 +62,12 @@ START_ENUM(DebugMode)
   eRayDir    = 11,  //
   eHeatmap   = 12   //
 END_ENUM();
+
+// Specialization constants of the ray tracing pipeline variants
+START_ENUM(SpecializationConstants)
+  eSpecDebuggingMode = 0,
+  eSpecMaxDepth      = 1
+END_ENUM();
 // clang-format on
 
 #endif //ENUMS_H
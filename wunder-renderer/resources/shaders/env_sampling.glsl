@@ -92,5 +92,34 @@ vec4 EnvSample(inout vec3 radiance)
   return vec4(lightDir, pdf);
 }
 
+//-----------------------------------------------------------------------
+// Precomputed ambient lighting, see environment_map_prefilter.cpp
+//-----------------------------------------------------------------------
+// Irradiance reaching a surface with normal n, from the SH9 projection of the
+// environment. Diffuse radiance is albedo * M_1_OVER_PI * irradiance
+vec3 EnvIrradiance(vec3 n)
+{
+  vec3 irradiance = envIrradianceSH[0].rgb * 0.282095;
+  irradiance += envIrradianceSH[1].rgb * (0.488603 * n.y);
+  irradiance += envIrradianceSH[2].rgb * (0.488603 * n.z);
+  irradiance += envIrradianceSH[3].rgb * (0.488603 * n.x);
+  irradiance += envIrradianceSH[4].rgb * (1.092548 * n.x * n.y);
+  irradiance += envIrradianceSH[5].rgb * (1.092548 * n.y * n.z);
+  irradiance += envIrradianceSH[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0));
+  irradiance += envIrradianceSH[7].rgb * (1.092548 * n.x * n.z);
+  irradiance += envIrradianceSH[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+  return max(irradiance, vec3(0.0));
+}
+
+// GGX prefiltered radiance around the reflection direction r, roughness is
+// mapped linearly over the mip chain
+vec3 EnvPrefilteredRadiance(vec3 r, float roughness)
+{
+  float u   = (atan(r.z, r.x) + M_PI) * (0.5 * M_1_OVER_PI);
+  float v   = acos(clamp(r.y, -1.0, 1.0)) * M_1_OVER_PI;
+  float lod = roughness * float(textureQueryLevels(environmentPrefiltered) - 1);
+  return textureLod(environmentPrefiltered, vec2(u, v), lod).rgb;
+}
+
 
 #endif  // ENV_SAMPLING_GLSL
@@ -53,8 +53,16 @@ struct RtxState {
   ivec2 size;                   // rendering size
   int minHeatmap;               // Debug mode - heat map
   int maxHeatmap;
+  float convergenceThreshold;   // Relative error tiles stop at, 0 disables
+  int minConvergenceFrames;     // Frames accumulated before a tile can stop
+  ivec2 tileOffset;             // Of the dispatched tile, see rtx_tile_scheduler
 };
 
+// Pixels square sharing one convergence flag, see convergence.glsl
+const int ConvergenceTileSize = 16;
+// Keeps the relative error of dark pixels from never converging
+const float ConvergenceDarkOffset = 0.01f;
+
 
 // KHR_lights_punctual extension.
 // see
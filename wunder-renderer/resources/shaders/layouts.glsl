@@ -18,9 +18,10 @@
 layout(set = S_ACCEL, binding = eTlas)					uniform accelerationStructureEXT topLevelAS;
 //
 layout(set = S_OUT,   binding = eStore)					uniform image2D			rtxGeneratedImage;
+layout(set = S_OUT,   binding = eMoments)				uniform image2D			rtxMomentsImage;
+layout(set = S_OUT,   binding = eConvergence, scalar)	buffer _Convergence		{ uint unconvergedTiles[2]; uint tileUnconverged[]; };
 //
 layout(set = S_SCENE, binding = eInstData,	scalar)     buffer _InstanceInfo	{ InstanceData geoInfo[]; };
-layout(set = S_SCENE, binding = eCamera,	scalar)		uniform _SceneCamera	{ SceneCamera sceneCamera; };
 layout(set = S_SCENE, binding = eMaterials,	scalar)		buffer _MaterialBuffer	{ GltfShadeMaterial materials[]; };
 layout(set = S_SCENE, binding = eLights,	scalar)		buffer _Lights			{ Light lights[]; };
 layout(set = S_SCENE, binding = eTextures	      )		uniform sampler2D		texturesMap[];
@@ -28,6 +29,10 @@ layout(set = S_SCENE, binding = eTextures	      )		uniform sampler2D		texturesMa
 layout(set = S_ENV, binding = eSunSky,		scalar)		uniform _SSBuffer		{ SunAndSky _sunAndSky; };
 layout(set = S_ENV, binding = eHdr)						uniform sampler2D		environmentTexture;
 layout(set = S_ENV, binding = eImpSamples,  scalar)		buffer _EnvAccel		{ EnvAccel envSamplingData[]; };
+layout(set = S_ENV, binding = eIrradianceSH, scalar)	buffer _EnvIrradianceSH	{ vec4 envIrradianceSH[]; };
+layout(set = S_ENV, binding = ePrefilteredHdr)			uniform sampler2D		environmentPrefiltered;
+//
+layout(set = S_FRAME, binding = eCamera,	scalar)		uniform _SceneCamera	{ SceneCamera sceneCamera; };
 
 layout(buffer_reference, scalar) buffer Vertices { VertexAttributes v[]; };
 layout(buffer_reference, scalar) buffer Indices	 { uvec3 i[];            };
@@ -19,7 +19,7 @@
 //-----------------------------------------------------------------------
 vec3 DebugInfo(in State state)
 {
-  switch (rtxState.debugging_mode)
+  switch (c_debugging_mode)
   {
     case eMetallic:
           return vec3(state.mat.metallic);
@@ -155,22 +155,22 @@ vec3 PathTrace(Ray r)
   vec3 throughput = vec3(1.0);
   vec3 absorption = vec3(0.0);
 
-  for (int depth = 0; depth < rtxState.maxDepth; depth++)
+  for (int depth = 0; depth < c_max_depth; depth++)
   {
     ClosestHit(r);
 
     // Hitting the environment
     if (prd.hitT == INFINITY)
     {
-      if (rtxState.debugging_mode != eNoDebug)
+      if (c_debugging_mode != eNoDebug)
       {
-        if (depth != rtxState.maxDepth - 1)
+        if (depth != c_max_depth - 1)
         return vec3(0);
-        if (rtxState.debugging_mode == eRadiance)
+        if (c_debugging_mode == eRadiance)
         return radiance;
-        else if (rtxState.debugging_mode == eWeight)
+        else if (c_debugging_mode == eWeight)
         return throughput;
-        else if (rtxState.debugging_mode == eRayDir)
+        else if (c_debugging_mode == eRayDir)
         return (r.direction + vec3(1)) * 0.5;
       }
 
@@ -206,7 +206,7 @@ vec3 PathTrace(Ray r)
     state.mat.albedo *= sstate.color;
 
     // Debugging info
-    if (rtxState.debugging_mode != eNoDebug && rtxState.debugging_mode < eRadiance)
+    if (c_debugging_mode != eNoDebug && c_debugging_mode < eRadiance)
     {
       return DebugInfo(state);
     }
@@ -248,17 +248,17 @@ vec3 PathTrace(Ray r)
     }
 
     // Debugging info
-    if (rtxState.debugging_mode != eNoDebug && (depth == rtxState.maxDepth - 1))
+    if (c_debugging_mode != eNoDebug && (depth == c_max_depth - 1))
     {
-      if (rtxState.debugging_mode == eRadiance)
+      if (c_debugging_mode == eRadiance)
       {
         return vcontrib.radiance;
       }
-      else if (rtxState.debugging_mode == eWeight)
+      else if (c_debugging_mode == eWeight)
       {
         return throughput;
       }
-      else if (rtxState.debugging_mode == eRayDir)
+      else if (c_debugging_mode == eRayDir)
       {
         return (bsdfSampleRec.L + vec3(1)) * 0.5;
       }
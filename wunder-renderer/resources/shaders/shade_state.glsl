@@ -54,7 +54,7 @@ ShadeState GetShadeState(in PtPayload hstate)
   Vertices vertices = Vertices(geoInfo[idGeo].vertexAddress);
 
   // Indices of this triangle primitive.
-  uvec3 tri = indices.i[idPrim];
+  uvec3 tri = indices.i[geoInfo[idGeo].indexOffset / 3 + idPrim] + geoInfo[idGeo].vertexOffset;
 
   // All vertex attributes of the triangle.
   VertexAttributes attr0 = vertices.v[tri.x];
@@ -10,12 +10,15 @@ struct VertexAttributes {
 
 
 // Structure used for retrieving the primitive information in the closest hit
-// using gl_InstanceCustomIndexExt
+// using gl_InstanceCustomIndexExt. Meshes share the geometry arena blocks, the
+// addresses point to the block and the offsets to the mesh inside of it.
 struct InstanceData {
   uint64_t vertexAddress;
   uint64_t indexAddress;
+  uint vertexOffset;  // in vertices
+  uint indexOffset;   // in indices, always multiple of 3
   int materialIndex;
-  vec3 _pad;
+  uint _pad;
 };
 
 #endif //VERTEX_H
@@ -6,6 +6,7 @@
 #include "assets/asset_importer_task.h"
 #include "assets/serializers/environment_map_serializer.h"
 #include "assets/serializers/gltf/gltf_asset_importer.h"
+#include "core/hash_utils.h"
 #include "core/task_executor.h"
 #include "core/wunder_filesystem.h"
 #include "event/event_handler.hpp"
@@ -61,7 +62,9 @@ asset_serialization_result_codes asset_manager::import_environment_map(
       {.m_width = static_cast<uint32_t>(width),
        .m_height = static_cast<uint32_t>(height),
        .m_components = static_cast<uint32_t>(required_components),
-       .m_pixels_ptr = pixels},
+       .m_pixels_ptr = pixels,
+       .m_source_hash =
+           hash::utils::hash_file(environment_map_real_path).value_or(0)},
       m_asset_storage);
 }
 
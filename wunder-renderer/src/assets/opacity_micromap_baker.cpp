@@ -0,0 +1,454 @@
+#include "assets/opacity_micromap_baker.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <variant>
+
+#include "assets/material_asset.h"
+#include "assets/mesh_asset.h"
+#include "assets/texture_asset.h"
+#include "core/hash_utils.h"
+#include "core/parallel_for.h"
+#include "core/wunder_macros.h"
+#include "resources/shaders/material.h"
+
+namespace wunder {
+namespace {
+std::uint32_t extract_even_bits(std::uint32_t x) {
+  x &= 0x55555555;
+  x = (x | (x >> 1)) & 0x33333333;
+  x = (x | (x >> 2)) & 0x0f0f0f0f;
+  x = (x | (x >> 4)) & 0x00ff00ff;
+  x = (x | (x >> 8)) & 0x0000ffff;
+  return x;
+}
+
+std::uint32_t prefix_xor(std::uint32_t x) {
+  x ^= (x >> 1);
+  x ^= (x >> 2);
+  x ^= (x >> 4);
+  x ^= (x >> 8);
+  return x;
+}
+
+// Position of the micro-triangle along the bird curve to its discrete
+// barycentric coordinates, the order the Vulkan specification mandates
+void index_to_discrete_barycentrics(std::uint32_t index, std::uint32_t& out_u,
+                                    std::uint32_t& out_v,
+                                    std::uint32_t& out_w) {
+  const std::uint32_t b0 = extract_even_bits(index);
+  const std::uint32_t b1 = extract_even_bits(index >> 1);
+
+  const std::uint32_t fx = prefix_xor(b0);
+  const std::uint32_t fy = prefix_xor(b0 & ~b1);
+
+  const std::uint32_t t = fy ^ b1;
+
+  out_u = (fx & ~t) | (b0 & ~t) | (~b0 & ~fx & t);
+  out_v = fy ^ b0;
+  out_w = (~fx & ~t) | (b0 & ~t) | (~b0 & fx & t);
+}
+
+std::int64_t wrap_coordinate(std::int64_t coordinate, std::int64_t size,
+                             address_mode_type address_mode) {
+  switch (address_mode) {
+    case address_mode_type::REPEAT:
+      return ((coordinate % size) + size) % size;
+    case address_mode_type::MIRRORED_REPEAT: {
+      const std::int64_t period = 2 * size;
+      const std::int64_t wrapped = ((coordinate % period) + period) % period;
+      return wrapped < size ? wrapped : period - 1 - wrapped;
+    }
+    case address_mode_type::CLAMP_TO_EDGE:
+      break;
+  }
+
+  return std::clamp<std::int64_t>(coordinate, 0, size - 1);
+}
+
+/**
+ * Alpha of the base level, the only one ray tracing shaders sample. Textures
+ * are always rgba, see texture_data::get_image_format.
+ */
+class alpha_texture {
+ public:
+  alpha_texture(const texture_asset& texture, float alpha_factor)
+      : m_texture(texture),
+        m_width(static_cast<std::int64_t>(texture.m_width)),
+        m_height(static_cast<std::int64_t>(texture.m_height)),
+        m_alpha_factor(alpha_factor) {
+    // Samplerless textures get the default sampler, which repeats
+    if (texture.m_sampler.has_value()) {
+      m_address_mode_u = texture.m_sampler->m_address_mode_u;
+      m_address_mode_v = texture.m_sampler->m_address_mode_v;
+    }
+  }
+
+ public:
+  [[nodiscard]] bool is_valid() const {
+    const std::size_t texels_count = static_cast<std::size_t>(m_width) *
+                                     static_cast<std::size_t>(m_height);
+    return texels_count > 0 &&
+           std::visit(
+               [texels_count](const auto& pixels) {
+                 return pixels.size() >= texels_count * 4;
+               },
+               m_texture.m_texture_data.m_data);
+  }
+
+  [[nodiscard]] glm::vec2 get_size() const {
+    return {static_cast<float>(m_width), static_cast<float>(m_height)};
+  }
+
+  [[nodiscard]] float fetch(std::int64_t x, std::int64_t y) const {
+    const auto texel_idx = static_cast<std::size_t>(
+        wrap_coordinate(y, m_height, m_address_mode_v) * m_width +
+        wrap_coordinate(x, m_width, m_address_mode_u));
+
+    return m_alpha_factor *
+           std::visit(overloaded{[texel_idx](const std::vector<unsigned char>&
+                                                 pixels) {
+                                   return static_cast<float>(
+                                              pixels[texel_idx * 4 + 3]) /
+                                          255.0f;
+                                 },
+                                 [texel_idx](const std::vector<float>& pixels) {
+                                   return pixels[texel_idx * 4 + 3];
+                                 }},
+                      m_texture.m_texture_data.m_data);
+  }
+
+  // Nearest texel, for footprints too small to contain a texel centre
+  [[nodiscard]] float fetch(const glm::vec2& texel_position) const {
+    return fetch(static_cast<std::int64_t>(std::floor(texel_position.x + 0.5f)),
+                 static_cast<std::int64_t>(std::floor(texel_position.y + 0.5f)));
+  }
+
+ private:
+  const texture_asset& m_texture;
+  std::int64_t m_width;
+  std::int64_t m_height;
+  float m_alpha_factor;
+  address_mode_type m_address_mode_u = address_mode_type::REPEAT;
+  address_mode_type m_address_mode_v = address_mode_type::REPEAT;
+};
+
+struct alpha_range {
+  float m_min = 1.0f;
+  float m_max = 0.0f;
+
+  void add(float alpha) {
+    m_min = std::min(m_min, alpha);
+    m_max = std::max(m_max, alpha);
+  }
+};
+
+float edge_function(const glm::vec2& a, const glm::vec2& b,
+                    const glm::vec2& point) {
+  return (b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x);
+}
+
+/**
+ * Walks the texels whose centre is at most one texel away from the triangle,
+ * which covers every texel bilinear filtering may blend in. Positions are in
+ * texel space, texel centres on integer coordinates.
+ */
+bool rasterize_footprint(const alpha_texture& texture,
+                         const std::array<glm::vec2, 3>& triangle,
+                         alpha_range& out_range) {
+  const glm::vec2 min_corner =
+      glm::floor(glm::min(triangle[0], glm::min(triangle[1], triangle[2]))) -
+      1.0f;
+  const glm::vec2 max_corner =
+      glm::ceil(glm::max(triangle[0], glm::max(triangle[1], triangle[2]))) +
+      1.0f;
+  const glm::vec2 extent = max_corner - min_corner + 1.0f;
+  ReturnIf(extent.x * extent.y >
+               static_cast<float>(
+                   opacity_micromap_baker::s_max_footprint_texels),
+           false);
+
+  const float area = edge_function(triangle[0], triangle[1], triangle[2]);
+  const float orientation = area < 0.0f ? -1.0f : 1.0f;
+
+  // Signed distances are compared against one texel, edges are normalized
+  std::array<float, 3> inverse_edge_lengths{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    const float edge_length =
+        glm::length(triangle[(i + 1) % 3] - triangle[i]);
+    inverse_edge_lengths[i] = edge_length > 0.0f ? 1.0f / edge_length : 0.0f;
+  }
+
+  for (auto y = static_cast<std::int64_t>(min_corner.y);
+       y <= static_cast<std::int64_t>(max_corner.y); ++y) {
+    for (auto x = static_cast<std::int64_t>(min_corner.x);
+         x <= static_cast<std::int64_t>(max_corner.x); ++x) {
+      const glm::vec2 texel_centre{static_cast<float>(x),
+                                   static_cast<float>(y)};
+
+      bool is_inside = true;
+      for (std::size_t i = 0; i < 3 && is_inside; ++i) {
+        const float distance =
+            orientation *
+            edge_function(triangle[i], triangle[(i + 1) % 3], texel_centre) *
+            inverse_edge_lengths[i];
+        is_inside = distance >= -1.0f;
+      }
+      ContinueUnless(is_inside);
+
+      out_range.add(texture.fetch(x, y));
+    }
+  }
+
+  return true;
+}
+
+void write_state(std::uint8_t* triangle_data, std::uint32_t micro_triangle_idx,
+                 opacity_micromap_format format,
+                 opacity_micromap_state state) {
+  const std::uint32_t bits = format == opacity_micromap_format::two_state ? 1 : 2;
+  const std::uint32_t bit_offset = micro_triangle_idx * bits;
+
+  triangle_data[bit_offset / 8] |= static_cast<std::uint8_t>(
+      static_cast<std::uint32_t>(state) << (bit_offset % 8));
+}
+}  // namespace
+
+std::uint32_t baked_opacity_micromap::get_triangles_count() const {
+  return m_triangle_size == 0
+             ? 0
+             : static_cast<std::uint32_t>(m_data.size() / m_triangle_size);
+}
+
+std::uint32_t baked_opacity_micromap::get_referencing_triangles_count() const {
+  return static_cast<std::uint32_t>(std::ranges::count_if(
+      m_indices, [](std::int32_t index) { return index >= 0; }));
+}
+
+bool baked_opacity_micromap::is_fully_opaque() const {
+  return std::ranges::all_of(m_indices, [](std::int32_t index) {
+    return index == k_fully_opaque_index;
+  });
+}
+
+std::optional<baked_opacity_micromap> opacity_micromap_baker::bake(
+    const mesh_asset& mesh, const material_asset& material,
+    const texture_asset& base_color_texture, std::uint32_t subdivision_level,
+    opacity_micromap_format format) {
+  const alpha_texture texture(base_color_texture,
+                              material.m_pbr_base_color_factor.w);
+  AssertReturnUnless(texture.is_valid(), std::nullopt);
+  ReturnIf(mesh.m_indices.size() < 3, std::nullopt);
+
+  baked_opacity_micromap micromap;
+  micromap.m_format = format;
+  micromap.m_subdivision_level =
+      std::min(subdivision_level, s_max_subdivision_level);
+
+  const std::uint32_t micro_triangles_count =
+      1u << (2 * micromap.m_subdivision_level);
+  const std::uint32_t bits_per_state =
+      format == opacity_micromap_format::two_state ? 1 : 2;
+  micromap.m_triangle_size =
+      std::max(1u, (micro_triangles_count * bits_per_state + 7) / 8);
+
+  const std::size_t triangles_count = mesh.m_indices.size() / 3;
+  std::vector<micro_triangle> micro_triangles(micro_triangles_count);
+  for (std::uint32_t i = 0; i < micro_triangles_count; ++i) {
+    micro_triangles[i] = get_micro_triangle(i, micromap.m_subdivision_level);
+  }
+
+  // Every triangle is baked in place, uniform ones are folded into special
+  // indices and the others deduplicated afterwards
+  std::vector<std::uint8_t> triangles_data(triangles_count *
+                                           micromap.m_triangle_size);
+  micromap.m_indices.assign(triangles_count, 0);
+
+  const glm::vec2 texture_size = texture.get_size();
+  parallel_for(
+      triangles_count,
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t triangle_idx = begin; triangle_idx < end;
+             ++triangle_idx) {
+          std::array<glm::vec2, 3> triangle_uvs{};
+          for (std::size_t i = 0; i < 3; ++i) {
+            const auto vertex_idx = mesh.m_indices[triangle_idx * 3 + i];
+            AssertContinueUnless(vertex_idx < mesh.m_vertices.size());
+
+            // Same transform as pathtrace.rahit
+            const glm::vec2 texcoord = mesh.m_vertices[vertex_idx].m_texcoord;
+            triangle_uvs[i] = glm::vec2(glm::vec4(texcoord, 1.0f, 1.0f) *
+                                        material.m_uv_transform);
+          }
+
+          std::uint8_t* triangle_data =
+              triangles_data.data() + triangle_idx * micromap.m_triangle_size;
+          bool is_uniform = true;
+          opacity_micromap_state first_state{};
+
+          for (std::uint32_t micro_triangle_idx = 0;
+               micro_triangle_idx < micro_triangles_count;
+               ++micro_triangle_idx) {
+            std::array<glm::vec2, 3> texel_triangle;
+            for (std::size_t i = 0; i < 3; ++i) {
+              const glm::vec2& barycentrics =
+                  micro_triangles[micro_triangle_idx][i];
+              const glm::vec2 uv =
+                  triangle_uvs[0] * (1.0f - barycentrics.x - barycentrics.y) +
+                  triangle_uvs[1] * barycentrics.x +
+                  triangle_uvs[2] * barycentrics.y;
+              texel_triangle[i] = uv * texture_size - 0.5f;
+            }
+            const glm::vec2 centre =
+                (texel_triangle[0] + texel_triangle[1] + texel_triangle[2]) /
+                3.0f;
+
+            alpha_range range;
+            const bool is_rasterized =
+                rasterize_footprint(texture, texel_triangle, range);
+            const float centre_alpha = texture.fetch(centre);
+            for (const auto& corner : texel_triangle) {
+              range.add(texture.fetch(corner));
+            }
+            range.add(centre_alpha);
+
+            // A footprint too large to walk can't be proven uniform
+            if (!is_rasterized) {
+              range.add(0.0f);
+              range.add(1.0f);
+            }
+
+            const opacity_micromap_state state = classify(
+                range.m_min, range.m_max, centre_alpha, material, format);
+            write_state(triangle_data, micro_triangle_idx, format, state);
+
+            if (micro_triangle_idx == 0) {
+              first_state = state;
+            }
+            is_uniform = is_uniform && state == first_state;
+          }
+
+          if (is_uniform && first_state == opacity_micromap_state::opaque) {
+            micromap.m_indices[triangle_idx] =
+                baked_opacity_micromap::k_fully_opaque_index;
+          } else if (is_uniform &&
+                     first_state == opacity_micromap_state::transparent) {
+            micromap.m_indices[triangle_idx] =
+                baked_opacity_micromap::k_fully_transparent_index;
+          }
+        }
+      },
+      64);
+
+  // Tiled foliage cards share most of their micromaps
+  std::unordered_map<std::uint64_t, std::vector<std::int32_t>> unique_triangles;
+  for (std::size_t triangle_idx = 0; triangle_idx < triangles_count;
+       ++triangle_idx) {
+    auto& index = micromap.m_indices[triangle_idx];
+    ContinueIf(index < 0);
+
+    const std::uint8_t* triangle_data =
+        triangles_data.data() + triangle_idx * micromap.m_triangle_size;
+    const std::uint64_t hash =
+        hash::utils::fnv1a_64(triangle_data, micromap.m_triangle_size);
+
+    auto& candidates = unique_triangles[hash];
+    auto found_it = std::ranges::find_if(candidates, [&](std::int32_t candidate) {
+      return std::memcmp(micromap.m_data.data() +
+                             static_cast<std::size_t>(candidate) *
+                                 micromap.m_triangle_size,
+                         triangle_data, micromap.m_triangle_size) == 0;
+    });
+    if (found_it != candidates.end()) {
+      index = *found_it;
+      continue;
+    }
+
+    index = static_cast<std::int32_t>(micromap.get_triangles_count());
+    candidates.emplace_back(index);
+    micromap.m_data.insert(micromap.m_data.end(), triangle_data,
+                           triangle_data + micromap.m_triangle_size);
+  }
+
+  return micromap;
+}
+
+opacity_micromap_baker::micro_triangle
+opacity_micromap_baker::get_micro_triangle(std::uint32_t micro_triangle_idx,
+                                           std::uint32_t subdivision_level) {
+  if (subdivision_level == 0) {
+    return {glm::vec2{0.0f, 0.0f}, glm::vec2{1.0f, 0.0f},
+            glm::vec2{0.0f, 1.0f}};
+  }
+
+  std::uint32_t u = 0;
+  std::uint32_t v = 0;
+  std::uint32_t w = 0;
+  index_to_discrete_barycentrics(micro_triangle_idx, u, v, w);
+
+  const std::uint32_t level_mask = (1u << subdivision_level) - 1;
+  u &= level_mask;
+  v &= level_mask;
+  w &= level_mask;
+
+  // Every other micro-triangle points down, its origin is the opposite corner
+  const bool is_upright = ((u ^ v ^ w) & 1) != 0;
+  if (!is_upright) {
+    ++u;
+    ++v;
+  }
+
+  const float level_scale = 1.0f / static_cast<float>(1u << subdivision_level);
+  const float step = is_upright ? level_scale : -level_scale;
+  const glm::vec2 origin{static_cast<float>(u) * level_scale,
+                         static_cast<float>(v) * level_scale};
+
+  return {origin, origin + glm::vec2{step, 0.0f},
+          origin + glm::vec2{0.0f, step}};
+}
+
+opacity_micromap_state opacity_micromap_baker::classify(
+    float min_alpha, float max_alpha, float centre_alpha,
+    const material_asset& material, opacity_micromap_format format) {
+  opacity_micromap_state state = opacity_micromap_state::unknown_opaque;
+
+  if (material.m_alpha_mode == ALPHA_MASK) {
+    // pathtrace.rahit keeps the hit when the alpha is above the cutoff
+    if (min_alpha > material.m_alpha_cutoff) {
+      state = opacity_micromap_state::opaque;
+    } else if (max_alpha <= material.m_alpha_cutoff) {
+      state = opacity_micromap_state::transparent;
+    } else {
+      state = centre_alpha > material.m_alpha_cutoff
+                  ? opacity_micromap_state::unknown_opaque
+                  : opacity_micromap_state::unknown_transparent;
+    }
+  } else {
+    // Blended alpha is a hit probability, only 0 and 1 are certain
+    if (min_alpha >= 1.0f) {
+      state = opacity_micromap_state::opaque;
+    } else if (max_alpha <= 0.0f) {
+      state = opacity_micromap_state::transparent;
+    } else {
+      state = centre_alpha >= 0.5f
+                  ? opacity_micromap_state::unknown_opaque
+                  : opacity_micromap_state::unknown_transparent;
+    }
+  }
+
+  ReturnUnless(format == opacity_micromap_format::two_state, state);
+
+  return state == opacity_micromap_state::unknown_opaque
+             ? opacity_micromap_state::opaque
+             : state == opacity_micromap_state::unknown_transparent
+                   ? opacity_micromap_state::transparent
+                   : state;
+}
+}  // namespace wunder
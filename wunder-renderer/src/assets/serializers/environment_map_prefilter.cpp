@@ -0,0 +1,362 @@
+#include "assets/serializers/environment_map_prefilter.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "assets/texture_asset.h"
+#include "core/parallel_for.h"
+#include "core/wunder_macros.h"
+
+namespace wunder {
+namespace {
+constexpr float k_pi = 3.14159265358979323846f;
+
+// Same parametrization as Environment_sample in env_sampling.glsl
+glm::vec3 direction_from_uv(float u, float v) {
+  const float phi = u * (2.0f * k_pi) - k_pi;
+  const float theta = v * k_pi;
+  const float sin_theta = std::sin(theta);
+  return {std::cos(phi) * sin_theta, std::cos(theta),
+          std::sin(phi) * sin_theta};
+}
+
+void uv_from_direction(const glm::vec3& direction, float& out_u,
+                       float& out_v) {
+  out_u = (std::atan2(direction.z, direction.x) + k_pi) / (2.0f * k_pi);
+  out_v = std::acos(std::clamp(direction.y, -1.0f, 1.0f)) / k_pi;
+}
+
+// Real SH basis, band 0 to 2, must match EnvIrradiance in env_sampling.glsl
+std::array<float, 9> sh_basis(const glm::vec3& n) {
+  return {0.282095f,
+          0.488603f * n.y,
+          0.488603f * n.z,
+          0.488603f * n.x,
+          1.092548f * n.x * n.y,
+          1.092548f * n.y * n.z,
+          0.315392f * (3.0f * n.z * n.z - 1.0f),
+          1.092548f * n.x * n.z,
+          0.546274f * (n.x * n.x - n.y * n.y)};
+}
+
+float radical_inverse(std::uint32_t bits) {
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+float ggx_distribution(float n_dot_h, float alpha) {
+  const float alpha2 = alpha * alpha;
+  const float denominator = n_dot_h * n_dot_h * (alpha2 - 1.0f) + 1.0f;
+  return alpha2 / (k_pi * denominator * denominator);
+}
+
+glm::vec4 fetch(const std::vector<float>& pixels, std::uint32_t width,
+                std::uint32_t x, std::uint32_t y) {
+  const std::size_t idx4 = (std::size_t{y} * width + x) * 4;
+  return {pixels[idx4], pixels[idx4 + 1], pixels[idx4 + 2], pixels[idx4 + 3]};
+}
+
+// Bilinear lookup, u wraps around and v is clamped like the environment
+// sampler does
+glm::vec4 sample_bilinear(const std::vector<float>& pixels, std::uint32_t width,
+                          std::uint32_t height, float u, float v) {
+  const float fx = u * static_cast<float>(width) - 0.5f;
+  const float fy = std::clamp(v * static_cast<float>(height) - 0.5f, 0.0f,
+                              static_cast<float>(height - 1));
+  const float x0f = std::floor(fx);
+  const float y0f = std::floor(fy);
+  const float tx = fx - x0f;
+  const float ty = fy - y0f;
+
+  const auto signed_width = static_cast<std::int64_t>(width);
+  const auto wrap = [signed_width](std::int64_t x) {
+    return static_cast<std::uint32_t>(((x % signed_width) + signed_width) %
+                                      signed_width);
+  };
+  const std::uint32_t x0 = wrap(static_cast<std::int64_t>(x0f));
+  const std::uint32_t x1 = wrap(static_cast<std::int64_t>(x0f) + 1);
+  const auto y0 = static_cast<std::uint32_t>(y0f);
+  const std::uint32_t y1 = std::min(y0 + 1, height - 1);
+
+  const glm::vec4 top = glm::mix(fetch(pixels, width, x0, y0),
+                                 fetch(pixels, width, x1, y0), tx);
+  const glm::vec4 bottom = glm::mix(fetch(pixels, width, x0, y1),
+                                    fetch(pixels, width, x1, y1), tx);
+  return glm::mix(top, bottom, ty);
+}
+
+}  // namespace
+
+void environment_map_prefilter::prefilter(environment_texture_asset& asset) {
+  const auto* pixels = std::get_if<std::vector<float>>(
+      &asset.m_texture_data.m_data);
+  AssertReturnUnless(pixels);
+  AssertReturnIf(asset.m_width == 0 || asset.m_height == 0);
+
+  // Everything is computed at a fixed low resolution, the lobes we're
+  // integrating are wide enough that texel detail of the source map doesn't
+  // matter, while the cost becomes independent of the map size
+  const std::uint32_t base_width =
+      std::min(asset.m_width, s_prefiltered_base_width);
+  const std::uint32_t base_height = std::max(1u, base_width / 2);
+  equirect_image base_image = downsample(*pixels, asset.m_width,
+                                         asset.m_height, base_width,
+                                         base_height);
+
+  project_irradiance_sh(base_image, asset);
+  prefilter_specular(base_image, asset);
+}
+
+environment_map_prefilter::equirect_image environment_map_prefilter::downsample(
+    const std::vector<float>& pixels, std::uint32_t width, std::uint32_t height,
+    std::uint32_t target_width, std::uint32_t target_height) {
+  equirect_image result{.m_width = target_width,
+                        .m_height = target_height,
+                        .m_pixels = std::vector<float>(
+                            std::size_t{target_width} * target_height * 4)};
+
+  // Box filter, every target texel averages the source texels it covers
+  parallel_for(
+      target_height,
+      [&](std::size_t begin, std::size_t end) {
+        for (auto y = static_cast<std::uint32_t>(begin); y < end; ++y) {
+          const std::uint32_t y0 = static_cast<std::uint32_t>(
+              std::uint64_t{y} * height / target_height);
+          const std::uint32_t y1 = std::max(
+              y0 + 1, static_cast<std::uint32_t>(std::uint64_t{y + 1} *
+                                                 height / target_height));
+          for (std::uint32_t x = 0; x < target_width; ++x) {
+            const std::uint32_t x0 = static_cast<std::uint32_t>(
+                std::uint64_t{x} * width / target_width);
+            const std::uint32_t x1 = std::max(
+                x0 + 1, static_cast<std::uint32_t>(std::uint64_t{x + 1} *
+                                                   width / target_width));
+
+            glm::vec4 sum(0.0f);
+            for (std::uint32_t sy = y0; sy < y1; ++sy) {
+              for (std::uint32_t sx = x0; sx < x1; ++sx) {
+                sum += fetch(pixels, width, sx, sy);
+              }
+            }
+            sum /= static_cast<float>((y1 - y0) * (x1 - x0));
+
+            const std::size_t idx4 = (std::size_t{y} * target_width + x) * 4;
+            result.m_pixels[idx4] = sum.r;
+            result.m_pixels[idx4 + 1] = sum.g;
+            result.m_pixels[idx4 + 2] = sum.b;
+            result.m_pixels[idx4 + 3] = sum.a;
+          }
+        }
+      },
+      4);
+
+  return result;
+}
+
+void environment_map_prefilter::project_irradiance_sh(
+    const equirect_image& image, environment_texture_asset& out_asset) {
+  using sh_coefficients = std::array<glm::dvec3, 9>;
+
+  sh_coefficients zero_coefficients;
+  zero_coefficients.fill(glm::dvec3(0.0));
+
+  const std::size_t chunks_count = get_parallel_chunks_count(image.m_height, 4);
+  std::vector<sh_coefficients> chunk_coefficients(chunks_count,
+                                                  zero_coefficients);
+
+  const float step_phi = 2.0f * k_pi / static_cast<float>(image.m_width);
+  const float step_theta = k_pi / static_cast<float>(image.m_height);
+
+  // Radiance weighted by the solid angle of each texel, projected on the
+  // basis. Each chunk accumulates its own partial sums, which are then
+  // reduced in chunk order.
+  parallel_for_chunks(
+      image.m_height, chunks_count,
+      [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        sh_coefficients& coefficients = chunk_coefficients[chunk_idx];
+        for (auto y = static_cast<std::uint32_t>(begin); y < end; ++y) {
+          const float cos_theta0 = std::cos(static_cast<float>(y) * step_theta);
+          const float cos_theta1 =
+              std::cos(static_cast<float>(y + 1) * step_theta);
+          const float solid_angle = (cos_theta0 - cos_theta1) * step_phi;
+          const float v = (static_cast<float>(y) + 0.5f) /
+                          static_cast<float>(image.m_height);
+
+          for (std::uint32_t x = 0; x < image.m_width; ++x) {
+            const float u = (static_cast<float>(x) + 0.5f) /
+                            static_cast<float>(image.m_width);
+            const glm::vec3 radiance =
+                glm::vec3(fetch(image.m_pixels, image.m_width, x, y)) *
+                solid_angle;
+            const std::array<float, 9> basis =
+                sh_basis(direction_from_uv(u, v));
+            for (std::size_t i = 0; i < basis.size(); ++i) {
+              coefficients[i] += glm::dvec3(radiance * basis[i]);
+            }
+          }
+        }
+      });
+
+  // Convolution with the clamped cosine lobe is a per band scale
+  // See: Ramamoorthi, Hanrahan, An Efficient Representation for Irradiance
+  // Environment Maps
+  constexpr std::array<float, 9> k_cosine_lobe = {
+      k_pi,        2.0f * k_pi / 3.0f, 2.0f * k_pi / 3.0f,
+      2.0f * k_pi / 3.0f, k_pi / 4.0f, k_pi / 4.0f,
+      k_pi / 4.0f, k_pi / 4.0f,        k_pi / 4.0f};
+
+  for (std::size_t i = 0; i < out_asset.m_irradiance_sh.size(); ++i) {
+    glm::dvec3 coefficient(0.0);
+    for (const auto& coefficients : chunk_coefficients) {
+      coefficient += coefficients[i];
+    }
+    out_asset.m_irradiance_sh[i] =
+        glm::vec4(glm::vec3(coefficient) * k_cosine_lobe[i], 0.0f);
+  }
+}
+
+void environment_map_prefilter::prefilter_specular(
+    const equirect_image& base_image, environment_texture_asset& out_asset) {
+  // Box filtered pyramid of the base image, used as the source of filtered
+  // importance sampling so a handful of samples is enough even for rough
+  // lobes. See: GPU Gems 3, chapter 20
+  std::vector<equirect_image> pyramid;
+  pyramid.push_back(base_image);
+  while (pyramid.back().m_width > 1 || pyramid.back().m_height > 1) {
+    const equirect_image& previous = pyramid.back();
+    pyramid.push_back(downsample(previous.m_pixels, previous.m_width,
+                                 previous.m_height,
+                                 std::max(1u, previous.m_width / 2),
+                                 std::max(1u, previous.m_height / 2)));
+  }
+
+  const auto sample_pyramid = [&pyramid](float u, float v, float lod) {
+    lod = std::clamp(lod, 0.0f, static_cast<float>(pyramid.size() - 1));
+    const auto lower_level = static_cast<std::size_t>(lod);
+    const std::size_t upper_level =
+        std::min(lower_level + 1, pyramid.size() - 1);
+
+    const equirect_image& lower = pyramid[lower_level];
+    const equirect_image& upper = pyramid[upper_level];
+    return glm::mix(
+        sample_bilinear(lower.m_pixels, lower.m_width, lower.m_height, u, v),
+        sample_bilinear(upper.m_pixels, upper.m_width, upper.m_height, u, v),
+        lod - static_cast<float>(lower_level));
+  };
+
+  std::uint32_t levels_count = 1;
+  while ((base_image.m_height >> levels_count) >= s_prefiltered_min_height) {
+    ++levels_count;
+  }
+
+  texture_asset& prefiltered = out_asset.m_prefiltered_specular;
+  prefiltered.m_width = base_image.m_width;
+  prefiltered.m_height = base_image.m_height;
+  prefiltered.m_texture_data.m_data = base_image.m_pixels;
+  prefiltered.m_sampler =
+      texture_sampler{.m_mag_filter = texture_filter_type::LINEAR,
+                      .m_min_filter = texture_filter_type::LINEAR,
+                      .m_mipmap_mode = mipmap_mode_type::LINEAR,
+                      .m_address_mode_u = address_mode_type::REPEAT,
+                      .m_address_mode_v = address_mode_type::CLAMP_TO_EDGE};
+  prefiltered.m_mip_chain.clear();
+  prefiltered.m_mip_chain.reserve(levels_count - 1);
+
+  const float texel_solid_angle =
+      4.0f * k_pi /
+      static_cast<float>(base_image.m_width * base_image.m_height);
+
+  for (std::uint32_t level = 1; level < levels_count; ++level) {
+    const std::uint32_t width = std::max(1u, base_image.m_width >> level);
+    const std::uint32_t height = std::max(1u, base_image.m_height >> level);
+    const float roughness =
+        static_cast<float>(level) / static_cast<float>(levels_count - 1);
+    const float alpha = roughness * roughness;
+
+    std::vector<float> level_pixels(std::size_t{width} * height * 4);
+    parallel_for(
+        height,
+        [&](std::size_t begin, std::size_t end) {
+          for (auto y = static_cast<std::uint32_t>(begin); y < end; ++y) {
+            for (std::uint32_t x = 0; x < width; ++x) {
+              // Split sum approximation, view, normal and reflection
+              // directions are assumed to be the same
+              const glm::vec3 n = direction_from_uv(
+                  (static_cast<float>(x) + 0.5f) / static_cast<float>(width),
+                  (static_cast<float>(y) + 0.5f) / static_cast<float>(height));
+
+              // Orthonormal basis around n
+              // See: Duff et al., Building an Orthonormal Basis, Revisited
+              const float sign = std::copysign(1.0f, n.z);
+              const float a = -1.0f / (sign + n.z);
+              const float b = n.x * n.y * a;
+              const glm::vec3 tangent(1.0f + sign * n.x * n.x * a, sign * b,
+                                      -sign * n.x);
+              const glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+
+              glm::vec3 sum(0.0f);
+              float weight = 0.0f;
+              for (std::uint32_t i = 0; i < s_specular_samples_count; ++i) {
+                const float xi1 = static_cast<float>(i) /
+                                  static_cast<float>(s_specular_samples_count);
+                const float xi2 = radical_inverse(i);
+
+                const float phi = 2.0f * k_pi * xi1;
+                const float cos_theta = std::sqrt(
+                    (1.0f - xi2) / (1.0f + (alpha * alpha - 1.0f) * xi2));
+                const float sin_theta =
+                    std::sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+
+                const glm::vec3 h =
+                    glm::normalize(tangent * (std::cos(phi) * sin_theta) +
+                                   bitangent * (std::sin(phi) * sin_theta) +
+                                   n * cos_theta);
+                const float n_dot_h = std::max(glm::dot(n, h), 0.0f);
+                const glm::vec3 l = 2.0f * n_dot_h * h - n;
+                const float n_dot_l = glm::dot(n, l);
+                ContinueIf(n_dot_l <= 0.0f);
+
+                // With n == v the pdf of l reduces to D / 4
+                const float pdf =
+                    std::max(ggx_distribution(n_dot_h, alpha) / 4.0f, 1e-6f);
+                const float sample_solid_angle =
+                    1.0f /
+                    (static_cast<float>(s_specular_samples_count) * pdf);
+                const float lod =
+                    0.5f * std::log2(sample_solid_angle / texel_solid_angle) +
+                    1.0f;
+
+                float u = 0.0f;
+                float v = 0.0f;
+                uv_from_direction(l, u, v);
+                sum += glm::vec3(sample_pyramid(u, v, lod)) * n_dot_l;
+                weight += n_dot_l;
+              }
+
+              const glm::vec3 radiance =
+                  weight > 0.0f ? sum / weight : glm::vec3(0.0f);
+              const std::size_t idx4 = (std::size_t{y} * width + x) * 4;
+              level_pixels[idx4] = radiance.r;
+              level_pixels[idx4 + 1] = radiance.g;
+              level_pixels[idx4 + 2] = radiance.b;
+              level_pixels[idx4 + 3] = 1.0f;
+            }
+          }
+        },
+        1);
+
+    prefiltered.m_mip_chain.push_back(
+        texture_data{.m_data = std::move(level_pixels)});
+  }
+}
+}  // namespace wunder
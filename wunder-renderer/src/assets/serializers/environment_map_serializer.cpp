@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "assets/asset_storage.h"
+#include "assets/serializers/environment_map_prefilter.h"
 #include "assets/texture_asset.h"
 
 namespace wunder {
@@ -22,6 +23,7 @@ asset_serialization_result_codes environment_map_serializer::import_asset(
 
   environment_texture_asset texture{std::move(pixels), input.m_width,
                                     input.m_height, std::nullopt};
+  texture.m_source_hash = input.m_source_hash;
 
   texture.m_sampler =
       texture_sampler{.m_mag_filter = texture_filter_type::LINEAR,
@@ -30,6 +32,8 @@ asset_serialization_result_codes environment_map_serializer::import_asset(
                       .m_address_mode_u = address_mode_type::REPEAT,
                       .m_address_mode_v = address_mode_type::CLAMP_TO_EDGE};
 
+  environment_map_prefilter::prefilter(texture);
+
   out_storage.add_asset(std::move(texture));
 
   return asset_serialization_result_codes::ok;
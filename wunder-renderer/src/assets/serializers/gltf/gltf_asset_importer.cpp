@@ -10,6 +10,7 @@
 #include "assets/serializers/gltf/material_asset_builder.h"
 #include "assets/serializers/gltf/mesh/mesh_asset_builder.h"
 #include "assets/serializers/gltf/texture_asset_builder.h"
+#include "assets/serializers/texture_alpha_analyzer.h"
 #include "core/wunder_logger.h"
 #include "core/wunder_macros.h"
 #include "glm/mat4x4.hpp"
@@ -33,7 +34,39 @@ std::unordered_set<std::string> s_supported_extensions{
     KHR_TEXTURE_BASISU_EXTENSION_NAME,
   KHR_MATERIALS_SHEEN_EXTENSION_NAME
 };
+
+// Node extras may name the policy, e.g. "extras": {"wunder_build_policy":
+// "fast_build"}. Skinned and morphed meshes deform, they're refit every frame.
+acceleration_structure_build_policy get_build_policy(
+    const tinygltf::Model& gltf_root_node,
+    const tinygltf::Node& gltf_scene_node) {
+  const auto& extras = gltf_scene_node.extras;
+  if (extras.IsObject() && extras.Has("wunder_build_policy") &&
+      extras.Get("wunder_build_policy").IsString()) {
+    const auto& policy_name =
+        extras.Get("wunder_build_policy").Get<std::string>();
+    auto policy = acceleration_structure_build_policy_from_string(policy_name);
+    if (policy.has_value()) {
+      return *policy;
+    }
+
+    WUNDER_WARN_TAG("Asset", "Unknown acceleration structure build policy {0}",
+                    policy_name);
+  }
+
+  ReturnIf(gltf_scene_node.skin > -1,
+           acceleration_structure_build_policy::allow_update);
+
+  const auto& gltf_mesh = gltf_root_node.meshes[static_cast<std::size_t>(
+      gltf_scene_node.mesh)];
+  for (const auto& primitive : gltf_mesh.primitives) {
+    ReturnUnless(primitive.targets.empty(),
+                 acceleration_structure_build_policy::allow_update);
+  }
+
+  return acceleration_structure_build_policy::automatic;
 }
+}  // namespace
 
 gltf_asset_importer::gltf_asset_importer(asset_storage& storage)
     : m_storage(storage) {}
@@ -68,11 +101,22 @@ void gltf_asset_importer::check_required_extensions(
 std::unordered_map<std::uint32_t, asset_handle>
 gltf_asset_importer::import_textures(const tinygltf::Model& gltf_scene_root) {
   std::unordered_map<std::uint32_t, asset_handle> textures_map;
+
+  // Base colour alpha is the only one any-hit tests
+  std::unordered_set<int> base_color_textures;
+  for (const auto& gltf_material : gltf_scene_root.materials) {
+    base_color_textures.insert(
+        gltf_material.pbrMetallicRoughness.baseColorTexture.index);
+  }
+
   std::uint32_t i = 0;
   for (const auto& gltf_texture : gltf_scene_root.textures) {
     texture_asset_builder texture_builder(gltf_scene_root, gltf_texture);
     auto maybe_texture = texture_builder.build();
     AssertContinueUnless(maybe_texture.has_value());
+    if (base_color_textures.contains(static_cast<int>(i))) {
+      texture_alpha_analyzer::analyze(maybe_texture.value());
+    }
     textures_map.emplace(i, m_storage.add_asset(maybe_texture.value()));
     ++i;
   }
@@ -192,10 +236,16 @@ asset_serialization_result_codes gltf_asset_importer::import_scenes(
       if (gltf_scene_node.mesh > -1) {
         auto primitives_it = mesh_id_to_primitive.find(gltf_scene_node.mesh);
         AssertContinueIf(primitives_it == mesh_id_to_primitive.end());
+        AssertContinueUnless(static_cast<std::size_t>(gltf_scene_node.mesh) <
+                             gltf_root_node.meshes.size());
+
+        const auto build_policy =
+            get_build_policy(gltf_root_node, gltf_scene_node);
 
         for (auto mesh_handle : primitives_it->second) {
           mesh_component mesh_component;
           mesh_component.m_handle = mesh_handle;
+          mesh_component.m_build_policy = build_policy;
 
           auto maybe_mesh_asset = m_storage.find_asset<mesh_asset>(mesh_handle);
           AssertContinueUnless(maybe_mesh_asset);
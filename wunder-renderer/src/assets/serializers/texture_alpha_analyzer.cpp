@@ -0,0 +1,142 @@
+#include "assets/serializers/texture_alpha_analyzer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <variant>
+#include <vector>
+
+#include "assets/texture_asset.h"
+#include "core/parallel_for.h"
+#include "core/wunder_macros.h"
+
+namespace wunder {
+void texture_alpha_analyzer::analyze(texture_asset& asset) {
+  auto& coverage = asset.m_alpha_coverage;
+  coverage = texture_alpha_coverage{};
+
+  const std::size_t texels_count =
+      static_cast<std::size_t>(asset.m_width) * asset.m_height;
+  ReturnIf(texels_count == 0);
+  const bool has_all_texels = std::visit(
+      [texels_count](const auto& pixels) {
+        return pixels.size() >= texels_count * 4;
+      },
+      asset.m_texture_data.m_data);
+  AssertReturnUnless(has_all_texels);
+
+  coverage.m_tiles_x = std::min(s_max_tiles_per_side, asset.m_width);
+  coverage.m_tiles_y = std::min(s_max_tiles_per_side, asset.m_height);
+  const std::size_t tiles_count =
+      static_cast<std::size_t>(coverage.m_tiles_x) * coverage.m_tiles_y;
+  coverage.m_min_alpha.assign(tiles_count, 255);
+  coverage.m_max_alpha.assign(tiles_count, 0);
+
+  // Every worker owns whole rows of tiles, no two write the same tile
+  parallel_for(
+      coverage.m_tiles_y,
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t tile_y = begin; tile_y < end; ++tile_y) {
+          const std::size_t first_row =
+              tile_y * asset.m_height / coverage.m_tiles_y;
+          const std::size_t last_row =
+              (tile_y + 1) * asset.m_height / coverage.m_tiles_y;
+
+          for (std::size_t row = first_row; row < last_row; ++row) {
+            for (std::size_t tile_x = 0; tile_x < coverage.m_tiles_x;
+                 ++tile_x) {
+              const std::size_t first_column =
+                  tile_x * asset.m_width / coverage.m_tiles_x;
+              const std::size_t last_column =
+                  (tile_x + 1) * asset.m_width / coverage.m_tiles_x;
+              const std::size_t first_texel =
+                  row * asset.m_width + first_column;
+              const std::size_t tile_idx =
+                  tile_y * coverage.m_tiles_x + tile_x;
+
+              std::visit(
+                  overloaded{
+                      [&](const std::vector<unsigned char>& pixels) {
+                        scan_rgba8(pixels.data() + first_texel * 4,
+                                   last_column - first_column,
+                                   coverage.m_min_alpha[tile_idx],
+                                   coverage.m_max_alpha[tile_idx]);
+                      },
+                      [&](const std::vector<float>& pixels) {
+                        scan_rgba32f(pixels.data() + first_texel * 4,
+                                     last_column - first_column,
+                                     coverage.m_min_alpha[tile_idx],
+                                     coverage.m_max_alpha[tile_idx]);
+                      }},
+                  asset.m_texture_data.m_data);
+            }
+          }
+        }
+      },
+      1);
+}
+
+void texture_alpha_analyzer::scan_rgba8(const std::uint8_t* texels,
+                                        std::size_t count,
+                                        std::uint8_t& in_out_min_alpha,
+                                        std::uint8_t& in_out_max_alpha) {
+  std::size_t i = 0;
+
+#if defined(__SSE2__)
+  // Four texels per iteration, colour bytes are forced to values which never
+  // win: 0xff for the minimum and 0 for the maximum
+  const __m128i colour_mask = _mm_set1_epi32(0x00ffffff);
+  const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  __m128i min_alpha = _mm_set1_epi8(-1);
+  __m128i max_alpha = _mm_setzero_si128();
+  for (; i + 4 <= count; i += 4) {
+    const __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i * 4));
+    min_alpha = _mm_min_epu8(min_alpha, _mm_or_si128(pixels, colour_mask));
+    max_alpha = _mm_max_epu8(max_alpha, _mm_and_si128(pixels, alpha_mask));
+  }
+
+  alignas(16) std::array<std::uint8_t, 16> min_lanes{};
+  alignas(16) std::array<std::uint8_t, 16> max_lanes{};
+  _mm_store_si128(reinterpret_cast<__m128i*>(min_lanes.data()), min_alpha);
+  _mm_store_si128(reinterpret_cast<__m128i*>(max_lanes.data()), max_alpha);
+  for (std::size_t lane = 3; lane < 16; lane += 4) {
+    in_out_min_alpha = std::min(in_out_min_alpha, min_lanes[lane]);
+    in_out_max_alpha = std::max(in_out_max_alpha, max_lanes[lane]);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    in_out_min_alpha = std::min(in_out_min_alpha, texels[i * 4 + 3]);
+    in_out_max_alpha = std::max(in_out_max_alpha, texels[i * 4 + 3]);
+  }
+}
+
+void texture_alpha_analyzer::scan_rgba32f(const float* texels,
+                                          std::size_t count,
+                                          std::uint8_t& in_out_min_alpha,
+                                          std::uint8_t& in_out_max_alpha) {
+  float min_alpha = 1.0f;
+  float max_alpha = 0.0f;
+  for (std::size_t i = 0; i < count; ++i) {
+    min_alpha = std::min(min_alpha, texels[i * 4 + 3]);
+    max_alpha = std::max(max_alpha, texels[i * 4 + 3]);
+  }
+
+  // Rounded outwards, a quantized opaque tile is really opaque
+  auto quantize = [](float alpha, auto rounding) {
+    return static_cast<std::uint8_t>(
+        std::clamp(rounding(alpha * 255.0f), 0.0f, 255.0f));
+  };
+  in_out_min_alpha = std::min(
+      in_out_min_alpha,
+      quantize(min_alpha, [](float value) { return std::floor(value); }));
+  in_out_max_alpha = std::max(
+      in_out_max_alpha,
+      quantize(max_alpha, [](float value) { return std::ceil(value); }));
+}
+}  // namespace wunder
@@ -2,10 +2,10 @@
 
 #include <stb_image_write.h>
 
+#include <algorithm>
+#include <cmath>
+
 #include "core/wunder_macros.h"
-#include "gla/vulkan/vulkan_context.h"
-#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
-#include "gla/vulkan/vulkan_memory_allocator.h"
 
 namespace wunder {
 bool texture_data::is_empty() const {
@@ -39,26 +39,71 @@ VkFormat  texture_data::get_image_format() const {
 }
 
 
-void texture_data::copy_to(VmaAllocation& stagingBufferAllocation) const {
-  auto& vulkan_context =
-      vulkan::layer_abstraction_factory::instance().get_vulkan_context();
-  auto& allocator = vulkan_context.mutable_resource_allocator();
-
-  return std::visit(
-      overloaded{[&stagingBufferAllocation,
-                  &allocator](const std::vector<unsigned char>& pixels) {
-                   auto* dest_data =
-                       allocator.map_memory<uint8_t>(stagingBufferAllocation);
-                   memcpy(dest_data, pixels.data(), pixels.size() * sizeof(unsigned char));
-                 },
-                 [&stagingBufferAllocation,
-                  &allocator](const std::vector<float>& pixels) {
-                   auto* dest_data =
-                       allocator.map_memory<float_t>(stagingBufferAllocation);
-                   memcpy(dest_data, pixels.data(),
-                          pixels.size() * sizeof(float));
-                 }},
-      m_data);
+const void* texture_data::data() const {
+  return std::visit(overloaded{[](const std::vector<unsigned char>& pixels) {
+                                 return static_cast<const void*>(pixels.data());
+                               },
+                               [](const std::vector<float>& pixels) {
+                                 return static_cast<const void*>(pixels.data());
+                               }},
+                    m_data);
+}
+
+bool texture_alpha_coverage::is_empty() const {
+  return m_tiles_x == 0 || m_tiles_y == 0 || m_min_alpha.empty();
+}
+
+alpha_coverage texture_alpha_coverage::get_coverage() const {
+  ReturnIf(is_empty(), alpha_coverage::unknown);
+
+  const auto [min_alpha, max_alpha] =
+      get_alpha_range({0.0f, 0.0f}, {1.0f, 1.0f});
+  ReturnIf(min_alpha >= 1.0f, alpha_coverage::opaque);
+  ReturnIf(max_alpha <= 0.0f, alpha_coverage::transparent);
+
+  return alpha_coverage::mixed;
 }
 
+texture_alpha_coverage::alpha_range texture_alpha_coverage::get_alpha_range(
+    const glm::vec2& uv_min, const glm::vec2& uv_max) const {
+  ReturnIf(is_empty(), alpha_range{});
+
+  std::uint32_t first_tile_x = 0;
+  std::uint32_t last_tile_x = m_tiles_x - 1;
+  std::uint32_t first_tile_y = 0;
+  std::uint32_t last_tile_y = m_tiles_y - 1;
+
+  const bool is_inside = uv_min.x >= 0.0f && uv_min.y >= 0.0f &&
+                         uv_max.x <= 1.0f && uv_max.y <= 1.0f;
+  if (is_inside) {
+    // Half a tile of margin covers the texels bilinear filtering blends in,
+    // tiles are never smaller than a texel
+    auto to_tile = [](float uv, std::uint32_t tiles_count) {
+      const float tile = std::floor(uv * static_cast<float>(tiles_count));
+      return static_cast<std::uint32_t>(
+          std::clamp(tile, 0.0f, static_cast<float>(tiles_count - 1)));
+    };
+    const float margin_x = 0.5f / static_cast<float>(m_tiles_x);
+    const float margin_y = 0.5f / static_cast<float>(m_tiles_y);
+
+    first_tile_x = to_tile(uv_min.x - margin_x, m_tiles_x);
+    last_tile_x = to_tile(uv_max.x + margin_x, m_tiles_x);
+    first_tile_y = to_tile(uv_min.y - margin_y, m_tiles_y);
+    last_tile_y = to_tile(uv_max.y + margin_y, m_tiles_y);
+  }
+
+  std::uint8_t min_alpha = 255;
+  std::uint8_t max_alpha = 0;
+  for (std::uint32_t y = first_tile_y; y <= last_tile_y; ++y) {
+    for (std::uint32_t x = first_tile_x; x <= last_tile_x; ++x) {
+      const std::size_t tile_idx =
+          static_cast<std::size_t>(y) * m_tiles_x + x;
+      min_alpha = std::min(min_alpha, m_min_alpha[tile_idx]);
+      max_alpha = std::max(max_alpha, m_max_alpha[tile_idx]);
+    }
+  }
+
+  return {static_cast<float>(min_alpha) / 255.0f,
+          static_cast<float>(max_alpha) / 255.0f};
+}
 }  // namespace wunder
\ No newline at end of file
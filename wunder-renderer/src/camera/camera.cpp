@@ -16,7 +16,7 @@
 #include "gla/vulkan/ray-trace/vulkan_rtx_renderer.h"
 #include "gla/vulkan/scene/vulkan_scene.h"
 #include "gla/vulkan/vulkan_device.h"
-#include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_frame_uniform_buffer.h"
 #include "resources/shaders/host_device.h"
 #include "scene/scene_manager.h"
 
@@ -37,9 +37,9 @@ camera::camera()
   update_view_matrix();
   SceneCamera camera = create_host_camera();
 
-  m_camera_buffer.reset(new vulkan::uniform_device_buffer(
+  m_camera_buffer.reset(new vulkan::frame_uniform_buffer(
       {.m_enabled = true, .m_descriptor_name = "_SceneCamera"}, &camera,
-      sizeof(SceneCamera), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT));
+      sizeof(SceneCamera)));
 }
 
 camera::~camera() {
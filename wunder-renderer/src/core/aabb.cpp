@@ -2,8 +2,11 @@
 
 #include <algorithm>
 #include <glm/mat4x4.hpp>
+#include <limits>
 #include <vector>
 
+#include "core/wunder_macros.h"
+
 namespace wunder {
 aabb::aabb(const std::vector<glm::vec3>& corners)
   : m_min(std::numeric_limits<float>::max())
@@ -14,6 +17,29 @@ aabb::aabb(const std::vector<glm::vec3>& corners)
   }
 }
 
+aabb aabb::empty() {
+  return aabb(glm::vec3(std::numeric_limits<float>::max()),
+              glm::vec3(std::numeric_limits<float>::lowest()));
+}
+
+bool aabb::is_empty() const {
+  return m_min.x > m_max.x || m_min.y > m_max.y || m_min.z > m_max.z;
+}
+
+float aabb::surface_area() const {
+  ReturnIf(is_empty(), 0.0f);
+
+  const glm::vec3 extent = size();
+  return 2.0f * (extent.x * extent.y + extent.y * extent.z +
+                 extent.z * extent.x);
+}
+
+bool aabb::overlaps(const aabb& other) const {
+  return m_min.x <= other.m_max.x && other.m_min.x <= m_max.x &&
+         m_min.y <= other.m_max.y && other.m_min.y <= m_max.y &&
+         m_min.z <= other.m_max.z && other.m_min.z <= m_max.z;
+}
+
 void aabb::insert(const glm::vec3& vertex) {
   m_min = {std::min(m_min.x, vertex.x), std::min(m_min.y, vertex.y),
            std::min(m_min.z, vertex.z)};
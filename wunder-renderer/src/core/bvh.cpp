@@ -0,0 +1,769 @@
+#include "core/bvh.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+
+#include <atomic>
+#include <deque>
+#include <numeric>
+#include <unordered_map>
+
+#include "assets/asset_storage.h"
+#include "assets/mesh_asset.h"
+#include "assets/scene_asset.h"
+#include "core/parallel_for.h"
+
+namespace wunder {
+namespace {
+std::uint32_t get_bin_idx(float centroid, float centroids_min, float scale) {
+  return std::min(bvh::s_bins_count - 1,
+                  static_cast<std::uint32_t>((centroid - centroids_min) * scale));
+}
+
+#if defined(__SSE2__)
+__m128 dot(__m128 a_x, __m128 a_y, __m128 a_z, __m128 b_x, __m128 b_y,
+           __m128 b_z) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a_x, b_x), _mm_mul_ps(a_y, b_y)),
+                    _mm_mul_ps(a_z, b_z));
+}
+
+__m128 cross_component(__m128 a_first, __m128 a_second, __m128 b_first,
+                       __m128 b_second) {
+  return _mm_sub_ps(_mm_mul_ps(a_first, b_second),
+                    _mm_mul_ps(a_second, b_first));
+}
+#endif
+}  // namespace
+
+void ray_packet::set_ray(std::uint32_t lane, const ray& lane_ray) {
+  m_origin_x[lane] = lane_ray.m_origin.x;
+  m_origin_y[lane] = lane_ray.m_origin.y;
+  m_origin_z[lane] = lane_ray.m_origin.z;
+  m_direction_x[lane] = lane_ray.m_direction.x;
+  m_direction_y[lane] = lane_ray.m_direction.y;
+  m_direction_z[lane] = lane_ray.m_direction.z;
+  m_inverse_direction_x[lane] = 1.0f / lane_ray.m_direction.x;
+  m_inverse_direction_y[lane] = 1.0f / lane_ray.m_direction.y;
+  m_inverse_direction_z[lane] = 1.0f / lane_ray.m_direction.z;
+  m_t_min[lane] = lane_ray.m_t_min;
+  m_t_max[lane] = lane_ray.m_t_max;
+  m_lanes |= 1u << lane;
+}
+
+ray ray_packet::get_ray(std::uint32_t lane) const {
+  return ray{
+      .m_origin = glm::vec3(m_origin_x[lane], m_origin_y[lane],
+                            m_origin_z[lane]),
+      .m_direction = glm::vec3(m_direction_x[lane], m_direction_y[lane],
+                               m_direction_z[lane]),
+      .m_t_min = m_t_min[lane],
+      .m_t_max = m_t_max[lane]};
+}
+
+struct bvh::build_context {
+  const std::vector<aabb>& m_primitives_bounds;
+  std::vector<glm::vec3> m_centroids;
+  // The root is taken before the build starts
+  std::atomic<std::uint32_t> m_nodes_count = 1;
+};
+
+void bvh::build(const std::vector<aabb>& primitives_bounds) {
+  m_nodes.clear();
+  m_references.clear();
+  ReturnIf(primitives_bounds.empty());
+
+  const auto primitives_count =
+      static_cast<std::uint32_t>(primitives_bounds.size());
+  build_context context{.m_primitives_bounds = primitives_bounds};
+  context.m_centroids.resize(primitives_count);
+  parallel_for(primitives_count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      context.m_centroids[i] = primitives_bounds[i].center();
+    }
+  });
+
+  m_references.resize(primitives_count);
+  std::iota(m_references.begin(), m_references.end(), 0u);
+  // A binary tree never has more nodes than this, whatever its leaf sizes
+  m_nodes.resize(2 * static_cast<std::size_t>(primitives_count) - 1);
+
+  // The top of the tree is split breadth first, every node by all threads,
+  // until there are enough subtrees to give each thread a few of them
+  const std::size_t threads_count =
+      get_parallel_chunks_count(primitives_count, s_parallel_build_min_size);
+  const std::size_t subtrees_target = threads_count * 4;
+  std::deque<build_task> pending{build_task{.m_count = primitives_count}};
+  std::vector<build_task> subtrees;
+  while (!pending.empty()) {
+    const build_task task = pending.front();
+    pending.pop_front();
+
+    if (threads_count == 1 || task.m_count < s_parallel_build_min_size ||
+        subtrees.size() + pending.size() + 1 >= subtrees_target) {
+      subtrees.push_back(task);
+      continue;
+    }
+
+    std::array<build_task, 2> children;
+    const std::uint32_t children_count =
+        split(context, task,
+              get_parallel_chunks_count(task.m_count, s_parallel_build_min_size),
+              children);
+    pending.insert(pending.end(), children.begin(),
+                   children.begin() + children_count);
+  }
+
+  // Largest first, threads keep taking the next one until none is left
+  std::ranges::sort(subtrees, std::greater{}, &build_task::m_count);
+  std::atomic<std::size_t> next_subtree = 0;
+  parallel_for_chunks(
+      subtrees.size(), threads_count,
+      [&](std::size_t /*chunk_idx*/, std::size_t /*begin*/,
+          std::size_t /*end*/) {
+        for (std::size_t subtree_idx = next_subtree++;
+             subtree_idx < subtrees.size(); subtree_idx = next_subtree++) {
+          build_subtree(context, subtrees[subtree_idx]);
+        }
+      });
+
+  m_nodes.resize(context.m_nodes_count);
+}
+
+void bvh::build_subtree(build_context& context, const build_task& task) {
+  std::vector<build_task> stack{task};
+  std::array<build_task, 2> children;
+  while (!stack.empty()) {
+    const build_task current_task = stack.back();
+    stack.pop_back();
+
+    const std::uint32_t children_count = split(context, current_task, 1, children);
+    stack.insert(stack.end(), children.begin(),
+                 children.begin() + children_count);
+  }
+}
+
+std::uint32_t bvh::split(build_context& context, const build_task& task,
+                         std::size_t chunks_count,
+                         std::array<build_task, 2>& out_children) {
+  bvh_node& node = m_nodes[task.m_node_idx];
+  auto make_leaf = [&node, &task]() {
+    node.m_first = task.m_first;
+    node.m_count = task.m_count;
+    return 0u;
+  };
+
+  std::vector<aabb> chunks_bounds(chunks_count, aabb::empty());
+  std::vector<aabb> chunks_centroids_bounds(chunks_count, aabb::empty());
+  parallel_for_chunks(
+      task.m_count, chunks_count,
+      [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const std::uint32_t primitive_idx = m_references[task.m_first + i];
+          chunks_bounds[chunk_idx].insert(
+              context.m_primitives_bounds[primitive_idx]);
+          chunks_centroids_bounds[chunk_idx].insert(
+              context.m_centroids[primitive_idx]);
+        }
+      });
+
+  aabb bounds = aabb::empty();
+  aabb centroids_bounds = aabb::empty();
+  for (std::size_t chunk_idx = 0; chunk_idx < chunks_count; ++chunk_idx) {
+    ContinueIf(chunks_bounds[chunk_idx].is_empty());
+    bounds.insert(chunks_bounds[chunk_idx]);
+    centroids_bounds.insert(chunks_centroids_bounds[chunk_idx]);
+  }
+  node.m_bounds = bounds;
+
+  if (task.m_count == 1 || task.m_depth + 1 >= s_max_depth) {
+    return make_leaf();
+  }
+
+  // Axes along which all centroids coincide can't be split
+  const glm::vec3 centroids_extent = centroids_bounds.size();
+  glm::vec3 bin_scale(0.0f);
+  for (glm::length_t axis = 0; axis < 3; ++axis) {
+    if (centroids_extent[axis] > 0.0f) {
+      bin_scale[axis] = static_cast<float>(s_bins_count) / centroids_extent[axis];
+    }
+  }
+
+  std::vector<std::array<axis_bins, 3>> chunks_bins(chunks_count);
+  parallel_for_chunks(
+      task.m_count, chunks_count,
+      [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        auto& bins = chunks_bins[chunk_idx];
+        for (std::size_t i = begin; i < end; ++i) {
+          const std::uint32_t primitive_idx = m_references[task.m_first + i];
+          const glm::vec3& centroid = context.m_centroids[primitive_idx];
+          for (glm::length_t axis = 0; axis < 3; ++axis) {
+            ContinueIf(bin_scale[axis] == 0.0f);
+
+            bin& primitive_bin = bins[static_cast<std::size_t>(axis)]
+                                     [get_bin_idx(centroid[axis],
+                                                  centroids_bounds.m_min[axis],
+                                                  bin_scale[axis])];
+            primitive_bin.m_bounds.insert(
+                context.m_primitives_bounds[primitive_idx]);
+            ++primitive_bin.m_count;
+          }
+        }
+      });
+
+  auto& bins = chunks_bins.front();
+  for (std::size_t chunk_idx = 1; chunk_idx < chunks_count; ++chunk_idx) {
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      for (std::size_t bin_idx = 0; bin_idx < s_bins_count; ++bin_idx) {
+        const bin& chunk_bin = chunks_bins[chunk_idx][axis][bin_idx];
+        ContinueIf(chunk_bin.m_count == 0);
+
+        bins[axis][bin_idx].m_bounds.insert(chunk_bin.m_bounds);
+        bins[axis][bin_idx].m_count += chunk_bin.m_count;
+      }
+    }
+  }
+
+  // Bins below best_split go to the left child
+  float best_cost = std::numeric_limits<float>::max();
+  glm::length_t best_axis = 0;
+  std::uint32_t best_split = 0;
+  for (glm::length_t axis = 0; axis < 3; ++axis) {
+    ContinueIf(bin_scale[axis] == 0.0f);
+    const axis_bins& candidate_bins = bins[static_cast<std::size_t>(axis)];
+
+    std::array<float, s_bins_count> right_costs{};
+    aabb right_bounds = aabb::empty();
+    std::uint32_t right_count = 0;
+    for (std::uint32_t split_idx = s_bins_count - 1; split_idx > 0;
+         --split_idx) {
+      if (candidate_bins[split_idx].m_count > 0) {
+        right_bounds.insert(candidate_bins[split_idx].m_bounds);
+        right_count += candidate_bins[split_idx].m_count;
+      }
+      right_costs[split_idx] =
+          static_cast<float>(right_count) * right_bounds.surface_area();
+    }
+
+    aabb left_bounds = aabb::empty();
+    std::uint32_t left_count = 0;
+    for (std::uint32_t split_idx = 1; split_idx < s_bins_count; ++split_idx) {
+      if (candidate_bins[split_idx - 1].m_count > 0) {
+        left_bounds.insert(candidate_bins[split_idx - 1].m_bounds);
+        left_count += candidate_bins[split_idx - 1].m_count;
+      }
+      ContinueIf(left_count == 0 || left_count == task.m_count);
+
+      const float cost = static_cast<float>(left_count) *
+                             left_bounds.surface_area() +
+                         right_costs[split_idx];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split_idx;
+      }
+    }
+  }
+
+  const bool has_split = best_split > 0;
+  const float leaf_cost =
+      static_cast<float>(task.m_count) * bounds.surface_area();
+  const float split_cost = s_traversal_cost * bounds.surface_area() + best_cost;
+  if (task.m_count <= s_max_leaf_size && (!has_split || split_cost >= leaf_cost)) {
+    return make_leaf();
+  }
+
+  // Without a split the centroids coincide, halving the range is as good as
+  // anything else
+  std::uint32_t left_count = task.m_count / 2;
+  if (has_split) {
+    auto begin = m_references.begin() + task.m_first;
+    auto middle = std::partition(
+        begin, begin + task.m_count, [&](std::uint32_t primitive_idx) {
+          return get_bin_idx(context.m_centroids[primitive_idx][best_axis],
+                             centroids_bounds.m_min[best_axis],
+                             bin_scale[best_axis]) < best_split;
+        });
+    left_count = static_cast<std::uint32_t>(middle - begin);
+  }
+  if (left_count == 0 || left_count == task.m_count) {
+    left_count = task.m_count / 2;
+  }
+
+  const std::uint32_t first_child = context.m_nodes_count.fetch_add(2);
+  node.m_first = first_child;
+  node.m_count = 0;
+
+  out_children[0] = build_task{.m_node_idx = first_child,
+                               .m_first = task.m_first,
+                               .m_count = left_count,
+                               .m_depth = task.m_depth + 1};
+  out_children[1] = build_task{.m_node_idx = first_child + 1,
+                               .m_first = task.m_first + left_count,
+                               .m_count = task.m_count - left_count,
+                               .m_depth = task.m_depth + 1};
+  return 2;
+}
+
+aabb bvh::get_bounds() const {
+  ReturnIf(m_nodes.empty(), aabb::empty());
+
+  return m_nodes.front().m_bounds;
+}
+
+std::uint32_t bvh::get_nodes_count() const {
+  return static_cast<std::uint32_t>(m_nodes.size());
+}
+
+void triangle_bvh::build(const mesh_asset& mesh) {
+  const auto triangles_count =
+      static_cast<std::uint32_t>(mesh.m_indices.size() / 3);
+
+  std::vector<triangle> triangles(triangles_count);
+  std::vector<aabb> triangles_bounds(triangles_count, aabb::empty());
+  parallel_for(triangles_count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t triangle_idx = begin; triangle_idx < end;
+         ++triangle_idx) {
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        const std::uint32_t vertex_idx = mesh.m_indices[triangle_idx * 3 + corner];
+        AssertContinueUnless(vertex_idx < mesh.m_vertices.size());
+
+        triangles[triangle_idx][corner] = mesh.m_vertices[vertex_idx].m_position;
+        triangles_bounds[triangle_idx].insert(triangles[triangle_idx][corner]);
+      }
+    }
+  });
+
+  m_bvh.build(triangles_bounds);
+
+  // Stored in leaf order, a leaf reads one contiguous range of triangles
+  m_triangles.resize(triangles_count);
+  parallel_for(triangles_count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t reference_idx = begin; reference_idx < end;
+         ++reference_idx) {
+      m_triangles[reference_idx] = triangles[m_bvh.get_primitive_idx(
+          static_cast<std::uint32_t>(reference_idx))];
+    }
+  });
+}
+
+bool triangle_bvh::intersect(const ray& query_ray, ray_hit& in_out_hit) const {
+  float t_max = std::min(query_ray.m_t_max, in_out_hit.m_t);
+  bool has_hit = false;
+
+  m_bvh.traverse(
+      query_ray.m_origin, 1.0f / query_ray.m_direction, query_ray.m_t_min,
+      t_max, [&](std::uint32_t reference_idx) {
+        float t = 0.0f;
+        float u = 0.0f;
+        float v = 0.0f;
+        if (intersect_triangle(m_triangles[reference_idx], query_ray.m_origin,
+                               query_ray.m_direction, query_ray.m_t_min, t_max,
+                               t, u, v)) {
+          t_max = t;
+          in_out_hit.m_t = t;
+          in_out_hit.m_u = u;
+          in_out_hit.m_v = v;
+          in_out_hit.m_primitive_idx = m_bvh.get_primitive_idx(reference_idx);
+          has_hit = true;
+        }
+        return false;
+      });
+
+  return has_hit;
+}
+
+bool triangle_bvh::occluded(const ray& query_ray) const {
+  bool is_occluded = false;
+
+  m_bvh.traverse(
+      query_ray.m_origin, 1.0f / query_ray.m_direction, query_ray.m_t_min,
+      query_ray.m_t_max, [&](std::uint32_t reference_idx) {
+        float t = 0.0f;
+        float u = 0.0f;
+        float v = 0.0f;
+        is_occluded = intersect_triangle(
+            m_triangles[reference_idx], query_ray.m_origin,
+            query_ray.m_direction, query_ray.m_t_min, query_ray.m_t_max, t, u,
+            v);
+        return is_occluded;
+      });
+
+  return is_occluded;
+}
+
+std::uint32_t triangle_bvh::intersect(
+    ray_packet& packet, std::array<ray_hit, ray_packet::k_size>& hits) const {
+  std::uint32_t hit_lanes = 0;
+
+  m_bvh.traverse(
+      packet, packet.m_lanes,
+      [&](std::uint32_t reference_idx, std::uint32_t lanes) {
+        std::array<float, ray_packet::k_size> t{};
+        std::array<float, ray_packet::k_size> u{};
+        std::array<float, ray_packet::k_size> v{};
+        const std::uint32_t triangle_hit_lanes = intersect_triangle(
+            m_triangles[reference_idx], packet, lanes, t, u, v);
+
+        for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+          ContinueUnless(triangle_hit_lanes & (1u << lane));
+
+          packet.m_t_max[lane] = t[lane];
+          hits[lane].m_t = t[lane];
+          hits[lane].m_u = u[lane];
+          hits[lane].m_v = v[lane];
+          hits[lane].m_primitive_idx = m_bvh.get_primitive_idx(reference_idx);
+        }
+        hit_lanes |= triangle_hit_lanes;
+        return 0u;
+      });
+
+  return hit_lanes;
+}
+
+std::uint32_t triangle_bvh::occluded(const ray_packet& packet) const {
+  std::uint32_t occluded_lanes = 0;
+
+  m_bvh.traverse(packet, packet.m_lanes,
+                 [&](std::uint32_t reference_idx, std::uint32_t lanes) {
+                   std::array<float, ray_packet::k_size> t{};
+                   std::array<float, ray_packet::k_size> u{};
+                   std::array<float, ray_packet::k_size> v{};
+                   const std::uint32_t triangle_hit_lanes = intersect_triangle(
+                       m_triangles[reference_idx], packet, lanes, t, u, v);
+                   occluded_lanes |= triangle_hit_lanes;
+                   return triangle_hit_lanes;
+                 });
+
+  return occluded_lanes;
+}
+
+void triangle_bvh::overlap(
+    const aabb& box,
+    const std::function<void(std::uint32_t triangle_idx)>& on_triangle) const {
+  m_bvh.overlap(box, [&](std::uint32_t reference_idx) {
+    aabb triangle_bounds = aabb::empty();
+    for (const glm::vec3& position : m_triangles[reference_idx]) {
+      triangle_bounds.insert(position);
+    }
+    ReturnUnless(triangle_bounds.overlaps(box));
+
+    on_triangle(m_bvh.get_primitive_idx(reference_idx));
+  });
+}
+
+std::uint32_t triangle_bvh::get_triangles_count() const {
+  return static_cast<std::uint32_t>(m_triangles.size());
+}
+
+bool triangle_bvh::intersect_triangle(const triangle& positions,
+                                      const glm::vec3& origin,
+                                      const glm::vec3& direction, float t_min,
+                                      float t_max, float& out_t, float& out_u,
+                                      float& out_v) {
+  const glm::vec3 edge_1 = positions[1] - positions[0];
+  const glm::vec3 edge_2 = positions[2] - positions[0];
+  const glm::vec3 p = glm::cross(direction, edge_2);
+  const float determinant = glm::dot(edge_1, p);
+  // Parallel to the triangle, or the triangle is degenerate
+  ReturnIf(determinant == 0.0f, false);
+
+  const float inverse_determinant = 1.0f / determinant;
+  const glm::vec3 s = origin - positions[0];
+  out_u = glm::dot(s, p) * inverse_determinant;
+  ReturnIf(out_u < 0.0f || out_u > 1.0f, false);
+
+  const glm::vec3 q = glm::cross(s, edge_1);
+  out_v = glm::dot(direction, q) * inverse_determinant;
+  ReturnIf(out_v < 0.0f || out_u + out_v > 1.0f, false);
+
+  out_t = glm::dot(edge_2, q) * inverse_determinant;
+  return out_t > t_min && out_t < t_max;
+}
+
+std::uint32_t triangle_bvh::intersect_triangle(
+    const triangle& positions, const ray_packet& packet, std::uint32_t lanes,
+    std::array<float, ray_packet::k_size>& out_t,
+    std::array<float, ray_packet::k_size>& out_u,
+    std::array<float, ray_packet::k_size>& out_v) {
+#if defined(__SSE2__)
+  const glm::vec3 edge_1 = positions[1] - positions[0];
+  const glm::vec3 edge_2 = positions[2] - positions[0];
+  const __m128 edge_1_x = _mm_set1_ps(edge_1.x);
+  const __m128 edge_1_y = _mm_set1_ps(edge_1.y);
+  const __m128 edge_1_z = _mm_set1_ps(edge_1.z);
+  const __m128 edge_2_x = _mm_set1_ps(edge_2.x);
+  const __m128 edge_2_y = _mm_set1_ps(edge_2.y);
+  const __m128 edge_2_z = _mm_set1_ps(edge_2.z);
+
+  const __m128 direction_x = _mm_load_ps(packet.m_direction_x.data());
+  const __m128 direction_y = _mm_load_ps(packet.m_direction_y.data());
+  const __m128 direction_z = _mm_load_ps(packet.m_direction_z.data());
+
+  const __m128 p_x =
+      cross_component(direction_y, direction_z, edge_2_y, edge_2_z);
+  const __m128 p_y =
+      cross_component(direction_z, direction_x, edge_2_z, edge_2_x);
+  const __m128 p_z =
+      cross_component(direction_x, direction_y, edge_2_x, edge_2_y);
+  const __m128 determinant =
+      dot(edge_1_x, edge_1_y, edge_1_z, p_x, p_y, p_z);
+  // Parallel lanes divide by zero, the comparisons below reject them anyway
+  const __m128 inverse_determinant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+  const __m128 s_x = _mm_sub_ps(_mm_load_ps(packet.m_origin_x.data()),
+                                _mm_set1_ps(positions[0].x));
+  const __m128 s_y = _mm_sub_ps(_mm_load_ps(packet.m_origin_y.data()),
+                                _mm_set1_ps(positions[0].y));
+  const __m128 s_z = _mm_sub_ps(_mm_load_ps(packet.m_origin_z.data()),
+                                _mm_set1_ps(positions[0].z));
+  const __m128 u =
+      _mm_mul_ps(dot(s_x, s_y, s_z, p_x, p_y, p_z), inverse_determinant);
+
+  const __m128 q_x = cross_component(s_y, s_z, edge_1_y, edge_1_z);
+  const __m128 q_y = cross_component(s_z, s_x, edge_1_z, edge_1_x);
+  const __m128 q_z = cross_component(s_x, s_y, edge_1_x, edge_1_y);
+  const __m128 v = _mm_mul_ps(
+      dot(direction_x, direction_y, direction_z, q_x, q_y, q_z),
+      inverse_determinant);
+  const __m128 t = _mm_mul_ps(dot(edge_2_x, edge_2_y, edge_2_z, q_x, q_y, q_z),
+                              inverse_determinant);
+
+  const __m128 zero = _mm_setzero_ps();
+  __m128 hit = _mm_cmpneq_ps(determinant, zero);
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+  hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+  hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_load_ps(packet.m_t_min.data())));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_load_ps(packet.m_t_max.data())));
+
+  _mm_storeu_ps(out_t.data(), t);
+  _mm_storeu_ps(out_u.data(), u);
+  _mm_storeu_ps(out_v.data(), v);
+  return static_cast<std::uint32_t>(_mm_movemask_ps(hit)) & lanes;
+#else
+  std::uint32_t hit_lanes = 0;
+  for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+    ContinueUnless(lanes & (1u << lane));
+
+    const ray lane_ray = packet.get_ray(lane);
+    if (intersect_triangle(positions, lane_ray.m_origin, lane_ray.m_direction,
+                           lane_ray.m_t_min, lane_ray.m_t_max, out_t[lane],
+                           out_u[lane], out_v[lane])) {
+      hit_lanes |= 1u << lane;
+    }
+  }
+  return hit_lanes;
+#endif
+}
+
+void scene_bvh::build(const scene_asset& scene, const asset_storage& storage) {
+  m_instances.clear();
+
+  const auto mesh_nodes = scene.filter_nodes<mesh_component, transform_component>();
+  std::unordered_map<asset_handle, std::size_t> mesh_indices;
+  std::vector<asset_handle> mesh_handles;
+  for (const auto& mesh_node : mesh_nodes) {
+    const asset_handle mesh_handle =
+        mesh_node.get().get_component<mesh_component>()->get().m_handle;
+    if (mesh_indices.emplace(mesh_handle, mesh_handles.size()).second) {
+      mesh_handles.push_back(mesh_handle);
+    }
+  }
+
+  // One thread per mesh, large meshes split their builds further
+  std::vector<shared_ptr<triangle_bvh>> mesh_bvhs(mesh_handles.size());
+  parallel_for(
+      mesh_handles.size(),
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t mesh_idx = begin; mesh_idx < end; ++mesh_idx) {
+          const auto maybe_mesh =
+              storage.find_asset<mesh_asset>(mesh_handles[mesh_idx]);
+          AssertContinueUnless(maybe_mesh.has_value());
+          ContinueIf(maybe_mesh->get().m_indices.size() < 3);
+
+          mesh_bvhs[mesh_idx] = make_shared<triangle_bvh>();
+          mesh_bvhs[mesh_idx]->build(maybe_mesh->get());
+        }
+      },
+      1);
+
+  m_instances.reserve(mesh_nodes.size());
+  for (const auto& mesh_node : mesh_nodes) {
+    const asset_handle mesh_handle =
+        mesh_node.get().get_component<mesh_component>()->get().m_handle;
+    const auto& mesh_bvh = mesh_bvhs[mesh_indices[mesh_handle]];
+    ContinueUnless(mesh_bvh);
+
+    add_instance(
+        mesh_bvh, mesh_handle,
+        mesh_node.get().get_component<transform_component>()->get().m_world_matrix);
+  }
+
+  build_top_level();
+}
+
+std::uint32_t scene_bvh::add_instance(shared_ptr<const triangle_bvh> mesh_bvh,
+                                      asset_handle mesh_handle,
+                                      const glm::mat4& world_matrix) {
+  AssertReturnUnless(mesh_bvh && mesh_bvh->get_triangles_count() > 0,
+                     ray_hit::k_invalid_idx);
+
+  m_instances.emplace_back(
+      bvh_instance{.m_bvh = std::move(mesh_bvh),
+                   .m_mesh_handle = mesh_handle,
+                   .m_world_matrix = world_matrix,
+                   .m_inverse_world_matrix = glm::inverse(world_matrix)});
+  return static_cast<std::uint32_t>(m_instances.size() - 1);
+}
+
+void scene_bvh::set_world_matrix(std::uint32_t instance_idx,
+                                 const glm::mat4& world_matrix) {
+  AssertReturnUnless(instance_idx < m_instances.size());
+
+  m_instances[instance_idx].m_world_matrix = world_matrix;
+  m_instances[instance_idx].m_inverse_world_matrix = glm::inverse(world_matrix);
+}
+
+void scene_bvh::build_top_level() {
+  std::vector<aabb> instances_bounds(m_instances.size());
+  for (std::size_t instance_idx = 0; instance_idx < m_instances.size();
+       ++instance_idx) {
+    const bvh_instance& instance = m_instances[instance_idx];
+    instances_bounds[instance_idx] =
+        instance.m_bvh->get_bounds().transform(instance.m_world_matrix);
+  }
+
+  m_bvh.build(instances_bounds);
+}
+
+bool scene_bvh::intersect(const ray& query_ray, ray_hit& in_out_hit) const {
+  float t_max = std::min(query_ray.m_t_max, in_out_hit.m_t);
+  bool has_hit = false;
+
+  m_bvh.traverse(query_ray.m_origin, 1.0f / query_ray.m_direction,
+                 query_ray.m_t_min, t_max, [&](std::uint32_t reference_idx) {
+                   const std::uint32_t instance_idx =
+                       m_bvh.get_primitive_idx(reference_idx);
+                   const bvh_instance& instance = m_instances[instance_idx];
+
+                   ray object_ray = to_object_space(instance, query_ray);
+                   object_ray.m_t_max = t_max;
+                   if (instance.m_bvh->intersect(object_ray, in_out_hit)) {
+                     t_max = in_out_hit.m_t;
+                     in_out_hit.m_instance_idx = instance_idx;
+                     has_hit = true;
+                   }
+                   return false;
+                 });
+
+  return has_hit;
+}
+
+bool scene_bvh::occluded(const ray& query_ray) const {
+  bool is_occluded = false;
+
+  m_bvh.traverse(query_ray.m_origin, 1.0f / query_ray.m_direction,
+                 query_ray.m_t_min, query_ray.m_t_max,
+                 [&](std::uint32_t reference_idx) {
+                   const bvh_instance& instance =
+                       m_instances[m_bvh.get_primitive_idx(reference_idx)];
+                   is_occluded = instance.m_bvh->occluded(
+                       to_object_space(instance, query_ray));
+                   return is_occluded;
+                 });
+
+  return is_occluded;
+}
+
+std::uint32_t scene_bvh::intersect(
+    ray_packet& packet, std::array<ray_hit, ray_packet::k_size>& hits) const {
+  std::uint32_t hit_lanes = 0;
+  ray_packet object_packet;
+
+  m_bvh.traverse(
+      packet, packet.m_lanes,
+      [&](std::uint32_t reference_idx, std::uint32_t lanes) {
+        const std::uint32_t instance_idx = m_bvh.get_primitive_idx(reference_idx);
+        const bvh_instance& instance = m_instances[instance_idx];
+
+        to_object_space(instance, packet, object_packet);
+        object_packet.m_lanes = lanes;
+        const std::uint32_t instance_hit_lanes =
+            instance.m_bvh->intersect(object_packet, hits);
+
+        for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+          ContinueUnless(instance_hit_lanes & (1u << lane));
+
+          packet.m_t_max[lane] = object_packet.m_t_max[lane];
+          hits[lane].m_instance_idx = instance_idx;
+        }
+        hit_lanes |= instance_hit_lanes;
+        return 0u;
+      });
+
+  return hit_lanes;
+}
+
+std::uint32_t scene_bvh::occluded(const ray_packet& packet) const {
+  std::uint32_t occluded_lanes = 0;
+  ray_packet object_packet;
+
+  m_bvh.traverse(packet, packet.m_lanes,
+                 [&](std::uint32_t reference_idx, std::uint32_t lanes) {
+                   const bvh_instance& instance =
+                       m_instances[m_bvh.get_primitive_idx(reference_idx)];
+
+                   to_object_space(instance, packet, object_packet);
+                   object_packet.m_lanes = lanes;
+                   const std::uint32_t instance_occluded_lanes =
+                       instance.m_bvh->occluded(object_packet);
+                   occluded_lanes |= instance_occluded_lanes;
+                   return instance_occluded_lanes;
+                 });
+
+  return occluded_lanes;
+}
+
+void scene_bvh::overlap(
+    const aabb& box,
+    const std::function<void(std::uint32_t instance_idx,
+                             std::uint32_t triangle_idx)>& on_triangle) const {
+  m_bvh.overlap(box, [&](std::uint32_t reference_idx) {
+    const std::uint32_t instance_idx = m_bvh.get_primitive_idx(reference_idx);
+    const bvh_instance& instance = m_instances[instance_idx];
+    ReturnUnless(instance.m_bvh->get_bounds()
+                     .transform(instance.m_world_matrix)
+                     .overlaps(box));
+
+    instance.m_bvh->overlap(
+        box.transform(instance.m_inverse_world_matrix),
+        [&](std::uint32_t triangle_idx) {
+          on_triangle(instance_idx, triangle_idx);
+        });
+  });
+}
+
+ray scene_bvh::to_object_space(const bvh_instance& instance,
+                               const ray& world_ray) {
+  return ray{
+      .m_origin = glm::vec3(instance.m_inverse_world_matrix *
+                            glm::vec4(world_ray.m_origin, 1.0f)),
+      .m_direction = glm::vec3(instance.m_inverse_world_matrix *
+                               glm::vec4(world_ray.m_direction, 0.0f)),
+      .m_t_min = world_ray.m_t_min,
+      .m_t_max = world_ray.m_t_max};
+}
+
+void scene_bvh::to_object_space(const bvh_instance& instance,
+                                const ray_packet& world_packet,
+                                ray_packet& out_object_packet) {
+  out_object_packet.m_lanes = 0;
+  for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+    ContinueUnless(world_packet.m_lanes & (1u << lane));
+
+    out_object_packet.set_ray(
+        lane, to_object_space(instance, world_packet.get_ray(lane)));
+  }
+}
+}  // namespace wunder
@@ -0,0 +1,121 @@
+#include "core/file_watcher.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cerrno>
+#include <utility>
+
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace wunder {
+namespace {
+#if defined(__linux__)
+constexpr std::uint32_t k_watch_mask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF;
+#endif
+}  // namespace
+
+file_watcher::file_watcher(std::filesystem::path root_directory)
+    : m_root_directory(std::move(root_directory)) {
+#if defined(__linux__)
+  m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotify_fd < 0) {
+    WUNDER_WARN_TAG("Filesystem", "Failed to initialize inotify, errno {0}",
+                    errno);
+    return;
+  }
+
+  add_watch_recursive(m_root_directory);
+#else
+  WUNDER_WARN_TAG("Filesystem", "File watching isn't supported, {0} ignored",
+                  m_root_directory.string());
+#endif
+}
+
+file_watcher::~file_watcher() {
+#if defined(__linux__)
+  ReturnIf(m_inotify_fd < 0);
+
+  // closing the descriptor removes all of its watches
+  close(m_inotify_fd);
+#endif
+}
+
+std::vector<std::filesystem::path> file_watcher::poll_changes() {
+  std::vector<std::filesystem::path> changed_files;
+#if defined(__linux__)
+  ReturnIf(m_inotify_fd < 0, changed_files);
+
+  alignas(inotify_event) std::array<char, 4096> buffer;
+  while (true) {
+    const ssize_t read_bytes = read(m_inotify_fd, buffer.data(), buffer.size());
+    // EAGAIN, nothing left to read
+    ReturnIf(read_bytes <= 0, changed_files);
+
+    for (ssize_t offset = 0; offset < read_bytes;) {
+      const auto* event =
+          reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+      auto directory_it = m_watched_directories.find(event->wd);
+      ContinueIf(directory_it == m_watched_directories.end());
+
+      if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+        m_watched_directories.erase(directory_it);
+        continue;
+      }
+      ContinueIf(event->len == 0);
+
+      auto path = directory_it->second / event->name;
+      if (event->mask & IN_ISDIR) {
+        add_watch_recursive(path);
+        continue;
+      }
+
+      // IN_CREATE is followed by IN_CLOSE_WRITE once the file is written
+      ContinueIf(event->mask & IN_CREATE);
+      ContinueIf(std::find(changed_files.begin(), changed_files.end(), path) !=
+                 changed_files.end());
+      changed_files.emplace_back(std::move(path));
+    }
+  }
+#else
+  return changed_files;
+#endif
+}
+
+void file_watcher::add_watch_recursive(
+    const std::filesystem::path& directory) {
+  add_watch(directory);
+
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(directory, error)) {
+    ContinueUnless(entry.is_directory());
+    add_watch(entry.path());
+  }
+}
+
+void file_watcher::add_watch(const std::filesystem::path& directory) {
+#if defined(__linux__)
+  const int watch_descriptor =
+      inotify_add_watch(m_inotify_fd, directory.c_str(), k_watch_mask);
+  if (watch_descriptor < 0) {
+    WUNDER_WARN_TAG("Filesystem", "Failed to watch {0}, errno {1}",
+                    directory.string(), errno);
+    return;
+  }
+
+  m_watched_directories[watch_descriptor] = directory;
+#else
+  (void)directory;
+#endif
+}
+}  // namespace wunder
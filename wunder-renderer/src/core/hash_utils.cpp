@@ -0,0 +1,54 @@
+#include "core/hash_utils.h"
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+
+#include "core/wunder_macros.h"
+
+namespace wunder::hash::utils {
+
+std::uint64_t fnv1a_64(const void* data, std::size_t size,
+                       std::uint64_t seed) {
+  constexpr std::uint64_t k_fnv_prime = 0x100000001b3ull;
+
+  auto* bytes = static_cast<const unsigned char*>(data);
+  std::uint64_t hash = seed;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= k_fnv_prime;
+  }
+
+  return hash;
+}
+
+std::uint64_t fnv1a_64(const std::string& data, std::uint64_t seed) {
+  return fnv1a_64(data.data(), data.size(), seed);
+}
+
+std::optional<std::uint64_t> hash_file(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  ReturnUnless(file.is_open(), std::nullopt);
+
+  std::array<char, 64 * 1024> chunk{};
+  std::uint64_t hash = k_fnv_offset_basis;
+  while (file) {
+    file.read(chunk.data(), chunk.size());
+    auto read_bytes = static_cast<std::size_t>(file.gcount());
+    hash = fnv1a_64(chunk.data(), read_bytes, hash);
+  }
+
+  ReturnUnless(file.eof(), std::nullopt);
+
+  return hash;
+}
+
+std::string hash_to_string(std::uint64_t hash) {
+  char buffer[16 + 1]{};
+  snprintf(buffer, sizeof(buffer), "%016llx",
+           static_cast<unsigned long long>(hash));
+
+  return std::string(buffer);
+}
+
+}  // namespace wunder::hash::utils
@@ -0,0 +1,247 @@
+#include "core/offset_allocator.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "core/wunder_macros.h"
+
+namespace wunder {
+
+float offset_allocator::storage_report::fragmentation() const {
+  ReturnIf(m_free_size == 0, 0.f);
+
+  return 1.f - static_cast<float>(m_largest_free_region) /
+                   static_cast<float>(m_free_size);
+}
+
+offset_allocator::offset_allocator(std::uint32_t size) : m_size(size) {
+  m_bin_heads.fill(s_invalid_offset);
+  ReturnIf(size == 0);
+
+  insert_free_node(0, size);
+}
+
+offset_allocator::allocation offset_allocator::allocate(std::uint32_t size) {
+  ReturnIf(size == 0 || size > m_free_size, allocation{});
+
+  const std::uint32_t bin = find_free_bin(bin_round_up(size));
+  ReturnIf(bin == s_invalid_offset, allocation{});
+
+  const std::uint32_t node_index = m_bin_heads[bin];
+  remove_from_bin(node_index);
+
+  const std::uint32_t remainder = m_nodes[node_index].m_size - size;
+  m_nodes[node_index].m_size = size;
+  m_nodes[node_index].m_is_used = true;
+
+  if (remainder > 0) {
+    // Inserting may grow m_nodes, don't keep references across it
+    const std::uint32_t remainder_index =
+        insert_free_node(m_nodes[node_index].m_offset + size, remainder);
+    const std::uint32_t next_index = m_nodes[node_index].m_neighbour_next;
+
+    m_nodes[remainder_index].m_neighbour_previous = node_index;
+    m_nodes[remainder_index].m_neighbour_next = next_index;
+    if (next_index != s_invalid_offset) {
+      m_nodes[next_index].m_neighbour_previous = remainder_index;
+    }
+    m_nodes[node_index].m_neighbour_next = remainder_index;
+  }
+
+  return allocation{.m_offset = m_nodes[node_index].m_offset,
+                    .m_size = size,
+                    .m_node = node_index};
+}
+
+void offset_allocator::free(const allocation& allocation) {
+  AssertReturnUnless(allocation.is_valid());
+  AssertReturnUnless(allocation.m_node < m_nodes.size());
+  AssertReturnUnless(m_nodes[allocation.m_node].m_is_used);
+
+  const std::uint32_t node_index = allocation.m_node;
+  std::uint32_t offset = m_nodes[node_index].m_offset;
+  std::uint32_t size = m_nodes[node_index].m_size;
+  std::uint32_t previous_index = m_nodes[node_index].m_neighbour_previous;
+  std::uint32_t next_index = m_nodes[node_index].m_neighbour_next;
+
+  // Merge with the free neighbours, so the region can serve bigger requests
+  if (previous_index != s_invalid_offset &&
+      !m_nodes[previous_index].m_is_used) {
+    const std::uint32_t merged_index = previous_index;
+    remove_from_bin(merged_index);
+
+    offset = m_nodes[merged_index].m_offset;
+    size += m_nodes[merged_index].m_size;
+    previous_index = m_nodes[merged_index].m_neighbour_previous;
+    release_node(merged_index);
+  }
+
+  if (next_index != s_invalid_offset && !m_nodes[next_index].m_is_used) {
+    const std::uint32_t merged_index = next_index;
+    remove_from_bin(merged_index);
+
+    size += m_nodes[merged_index].m_size;
+    next_index = m_nodes[merged_index].m_neighbour_next;
+    release_node(merged_index);
+  }
+
+  node& freed_node = m_nodes[node_index];
+  freed_node.m_offset = offset;
+  freed_node.m_size = size;
+  freed_node.m_is_used = false;
+  freed_node.m_neighbour_previous = previous_index;
+  freed_node.m_neighbour_next = next_index;
+
+  if (previous_index != s_invalid_offset) {
+    m_nodes[previous_index].m_neighbour_next = node_index;
+  }
+  if (next_index != s_invalid_offset) {
+    m_nodes[next_index].m_neighbour_previous = node_index;
+  }
+
+  insert_into_bin(node_index);
+}
+
+offset_allocator::storage_report offset_allocator::get_storage_report() const {
+  storage_report report{.m_free_size = m_free_size,
+                        .m_largest_free_region = 0,
+                        .m_free_regions_count = m_free_regions_count};
+  ReturnIf(m_first_level_mask == 0, report);
+
+  // Only the highest non empty bin can hold the largest region
+  const auto first_level =
+      static_cast<std::uint32_t>(std::bit_width(m_first_level_mask)) - 1;
+  const auto second_level =
+      static_cast<std::uint32_t>(
+          std::bit_width(m_second_level_masks[first_level])) -
+      1;
+
+  for (std::uint32_t node_index =
+           m_bin_heads[first_level * s_second_level_count + second_level];
+       node_index != s_invalid_offset;
+       node_index = m_nodes[node_index].m_bin_next) {
+    report.m_largest_free_region =
+        std::max(report.m_largest_free_region, m_nodes[node_index].m_size);
+  }
+
+  return report;
+}
+
+std::uint32_t offset_allocator::bin_round_down(std::uint32_t size) {
+  ReturnIf(size < s_second_level_count, size);
+
+  const auto highest_bit = static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+  const std::uint32_t shift = highest_bit - s_second_level_bits;
+  const std::uint32_t second_level =
+      (size >> shift) & (s_second_level_count - 1);
+
+  return (shift + 1) * s_second_level_count + second_level;
+}
+
+std::uint32_t offset_allocator::bin_round_up(std::uint32_t size) {
+  ReturnIf(size < s_second_level_count, size);
+
+  // Every region of the next bin is big enough, the current one may not be
+  const auto highest_bit = static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+  const std::uint32_t shift = highest_bit - s_second_level_bits;
+  const std::uint32_t truncated_bits_mask = (1u << shift) - 1;
+
+  return bin_round_down(size) + ((size & truncated_bits_mask) != 0 ? 1u : 0u);
+}
+
+std::uint32_t offset_allocator::find_free_bin(std::uint32_t min_bin) const {
+  ReturnIf(min_bin >= s_bins_count, s_invalid_offset);
+
+  const std::uint32_t first_level = min_bin / s_second_level_count;
+  const std::uint32_t second_level = min_bin % s_second_level_count;
+
+  const std::uint32_t second_level_mask =
+      m_second_level_masks[first_level] & (0xffu << second_level);
+  if (second_level_mask != 0) {
+    return first_level * s_second_level_count +
+           static_cast<std::uint32_t>(std::countr_zero(second_level_mask));
+  }
+
+  const std::uint32_t first_level_mask =
+      m_first_level_mask & (0xffffffffu << (first_level + 1));
+  ReturnIf(first_level_mask == 0, s_invalid_offset);
+
+  const auto free_first_level =
+      static_cast<std::uint32_t>(std::countr_zero(first_level_mask));
+  return free_first_level * s_second_level_count +
+         static_cast<std::uint32_t>(std::countr_zero(
+             static_cast<std::uint32_t>(m_second_level_masks[free_first_level])));
+}
+
+std::uint32_t offset_allocator::insert_free_node(std::uint32_t offset,
+                                                 std::uint32_t size) {
+  std::uint32_t node_index = 0;
+  if (!m_unused_nodes.empty()) {
+    node_index = m_unused_nodes.back();
+    m_unused_nodes.pop_back();
+  } else {
+    node_index = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+  }
+
+  m_nodes[node_index] = node{.m_offset = offset, .m_size = size};
+  insert_into_bin(node_index);
+
+  return node_index;
+}
+
+void offset_allocator::insert_into_bin(std::uint32_t node_index) {
+  node& free_node = m_nodes[node_index];
+  const std::uint32_t bin = bin_round_down(free_node.m_size);
+  const std::uint32_t head_index = m_bin_heads[bin];
+
+  free_node.m_bin_previous = s_invalid_offset;
+  free_node.m_bin_next = head_index;
+  if (head_index != s_invalid_offset) {
+    m_nodes[head_index].m_bin_previous = node_index;
+  }
+  m_bin_heads[bin] = node_index;
+
+  const std::uint32_t first_level = bin / s_second_level_count;
+  m_second_level_masks[first_level] |=
+      static_cast<std::uint8_t>(1u << (bin % s_second_level_count));
+  m_first_level_mask |= 1u << first_level;
+
+  m_free_size += free_node.m_size;
+  ++m_free_regions_count;
+}
+
+void offset_allocator::remove_from_bin(std::uint32_t node_index) {
+  node& free_node = m_nodes[node_index];
+  const std::uint32_t bin = bin_round_down(free_node.m_size);
+
+  if (free_node.m_bin_previous != s_invalid_offset) {
+    m_nodes[free_node.m_bin_previous].m_bin_next = free_node.m_bin_next;
+  } else {
+    m_bin_heads[bin] = free_node.m_bin_next;
+  }
+  if (free_node.m_bin_next != s_invalid_offset) {
+    m_nodes[free_node.m_bin_next].m_bin_previous = free_node.m_bin_previous;
+  }
+  free_node.m_bin_previous = s_invalid_offset;
+  free_node.m_bin_next = s_invalid_offset;
+
+  if (m_bin_heads[bin] == s_invalid_offset) {
+    const std::uint32_t first_level = bin / s_second_level_count;
+    m_second_level_masks[first_level] &=
+        static_cast<std::uint8_t>(~(1u << (bin % s_second_level_count)));
+    if (m_second_level_masks[first_level] == 0) {
+      m_first_level_mask &= ~(1u << first_level);
+    }
+  }
+
+  m_free_size -= free_node.m_size;
+  --m_free_regions_count;
+}
+
+void offset_allocator::release_node(std::uint32_t node_index) {
+  m_nodes[node_index] = node{};
+  m_unused_nodes.push_back(node_index);
+}
+
+}  // namespace wunder
@@ -26,4 +26,28 @@ std::filesystem::path wunder_filesystem::resolve_path(
 
   return m_work_dir / resource_path;
 }
-}  // namespace wunder
\ No newline at end of file
+
+std::filesystem::path wunder_filesystem::get_cache_dir(
+    const std::filesystem::path& sub_directory) {
+  std::filesystem::path cache_dir = resolve_path(".wunder_cache");
+  if (!sub_directory.empty()) {
+    cache_dir /= sub_directory;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(cache_dir, error);
+  AssertLogIf(static_cast<bool>(error));
+
+  return cache_dir;
+}
+
+std::filesystem::path wunder_filesystem::get_executable_dir() const {
+#if defined(__linux__)
+  std::error_code error;
+  auto executable_path = std::filesystem::read_symlink("/proc/self/exe", error);
+  ReturnUnless(static_cast<bool>(error), executable_path.parent_path());
+#endif
+
+  return std::filesystem::current_path();
+}
+}  // namespace wunder
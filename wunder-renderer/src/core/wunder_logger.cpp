@@ -11,6 +11,11 @@ shared_ptr<spdlog::logger> log::s_logger;
 
 /////////////////////////////////////////////////////////////////////////////////////////
 void log::init() {
+  // Tools log before they initialize an application, which initializes it too
+  if (s_logger) {
+    return;
+  }
+
   std::vector<spdlog::sink_ptr> log_sinks;
   log_sinks.emplace_back(make_shared<spdlog::sinks::stdout_color_sink_mt>());
   log_sinks.emplace_back(
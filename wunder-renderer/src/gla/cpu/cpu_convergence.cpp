@@ -0,0 +1,118 @@
+#include "gla/cpu/cpu_convergence.h"
+
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/wunder_macros.h"
+#include "resources/shaders/host_device.h"
+
+namespace wunder::cpu {
+namespace {
+constexpr auto k_tile_size = static_cast<std::uint32_t>(ConvergenceTileSize);
+}  // namespace
+
+float convergence_luminance(const glm::vec3& color) {
+  return 0.3f * color.x + 0.6f * color.y + 0.1f * color.z;
+}
+
+float convergence_error(const glm::vec4& moments, int frames) {
+  const float variance = std::max(moments.y - moments.x * moments.x, 0.f);
+  return std::sqrt(variance / static_cast<float>(frames)) /
+         (moments.x + ConvergenceDarkOffset);
+}
+
+convergence_tracker::convergence_tracker(std::uint32_t width,
+                                         std::uint32_t height, float threshold,
+                                         int min_frames)
+    : m_tiles_x((width + k_tile_size - 1) / k_tile_size),
+      m_tiles_y((height + k_tile_size - 1) / k_tile_size),
+      m_threshold(threshold),
+      m_min_frames(min_frames),
+      m_image(width, height),
+      m_moments(static_cast<std::size_t>(width) * height, glm::vec4(0.f)),
+      m_tile_converged_frames(static_cast<std::size_t>(m_tiles_x) * m_tiles_y,
+                              0) {}
+
+void convergence_tracker::add_frame(const render_target& estimate, int frame) {
+  AssertReturnUnless(estimate.get_width() == m_image.get_width() &&
+                     estimate.get_height() == m_image.get_height());
+
+  if (frame == 0) {
+    std::fill(m_tile_converged_frames.begin(), m_tile_converged_frames.end(),
+              0);
+    m_traced_pixels_count = 0;
+  }
+
+  const float weight = 1.f / static_cast<float>(frame + 1);
+  const bool is_enabled = m_threshold > 0.f;
+  std::vector<bool> unconverged_tiles(m_tile_converged_frames.size(), false);
+
+  for (std::uint32_t y = 0; y < m_image.get_height(); ++y) {
+    for (std::uint32_t x = 0; x < m_image.get_width(); ++x) {
+      // isTileConverged, converged tiles stay so until the frames restart
+      const std::uint32_t tile_idx = get_tile_idx(x, y);
+      ContinueIf(m_tile_converged_frames[tile_idx] > 0);
+
+      const glm::vec3& pixel_color = estimate.get_pixel(x, y);
+      m_image.set_pixel(
+          x, y,
+          frame > 0 ? glm::mix(m_image.get_pixel(x, y), pixel_color, weight)
+                    : pixel_color);
+      ++m_traced_pixels_count;
+
+      // updateConvergence
+      ContinueUnless(is_enabled);
+
+      const float luminance = convergence_luminance(pixel_color);
+      glm::vec4& moments =
+          m_moments[static_cast<std::size_t>(y) * m_image.get_width() + x];
+      const glm::vec4 frame_moments(luminance, luminance * luminance, 0.f,
+                                    1.f);
+      moments = frame > 0 ? glm::vec4(glm::mix(glm::vec2(moments),
+                                               glm::vec2(frame_moments),
+                                               weight),
+                                      0.f, 1.f)
+                          : frame_moments;
+      moments.z = convergence_error(moments, frame + 1);
+
+      ContinueIf(moments.z <= m_threshold && frame + 1 >= m_min_frames);
+      unconverged_tiles[tile_idx] = true;
+    }
+  }
+
+  m_unconverged_tiles_count = 0;
+  for (std::size_t tile_idx = 0; tile_idx < unconverged_tiles.size();
+       ++tile_idx) {
+    ContinueIf(m_tile_converged_frames[tile_idx] > 0);
+
+    if (unconverged_tiles[tile_idx] || !is_enabled) {
+      ++m_unconverged_tiles_count;
+    } else {
+      m_tile_converged_frames[tile_idx] = frame + 1;
+    }
+  }
+
+  m_frames_count = frame + 1;
+}
+
+bool convergence_tracker::is_converged() const {
+  return m_frames_count > 0 && m_unconverged_tiles_count == 0;
+}
+
+float convergence_tracker::get_pixel_error(std::uint32_t x,
+                                           std::uint32_t y) const {
+  return m_moments[static_cast<std::size_t>(y) * m_image.get_width() + x].z;
+}
+
+std::uint32_t convergence_tracker::get_tiles_count() const {
+  return m_tiles_x * m_tiles_y;
+}
+
+std::uint32_t convergence_tracker::get_tile_idx(std::uint32_t x,
+                                                std::uint32_t y) const {
+  return (y / k_tile_size) * m_tiles_x + x / k_tile_size;
+}
+}  // namespace wunder::cpu
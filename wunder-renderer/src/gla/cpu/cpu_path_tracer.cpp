@@ -0,0 +1,779 @@
+#include "gla/cpu/cpu_path_tracer.h"
+
+#include <glm/common.hpp>
+#include <glm/exponential.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/mat3x3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+#include "assets/texture_asset.h"
+#include "core/bvh.h"
+#include "core/parallel_for.h"
+#include "core/wunder_macros.h"
+#include "gla/cpu/cpu_render_target.h"
+#include "gla/cpu/cpu_scene.h"
+#include "gla/cpu/cpu_shading.h"
+#include "gla/cpu/cpu_texture.h"
+
+/*
+ * Ports of pathtrace.glsl, shade_state.glsl, gltf_material.glsl,
+ * env_sampling.glsl, punctual.glsl and common.glsl, keep them in sync. Function
+ * bodies follow the shaders statement by statement, random numbers are drawn
+ * in the same order.
+ */
+namespace wunder::cpu {
+namespace {
+constexpr float k_pi = std::numbers::pi_v<float>;
+constexpr float k_two_pi = 2.f * std::numbers::pi_v<float>;
+constexpr float k_one_over_pi = std::numbers::inv_pi_v<float>;
+// Shadow rays towards the environment, as DirectLight sets them
+constexpr float k_infinite_light_distance = 1e32f;
+constexpr std::uint32_t k_quad_size = 2;
+
+struct shade_state {
+  glm::vec3 m_normal{0.f};
+  glm::vec3 m_geom_normal{0.f};
+  glm::vec3 m_position{0.f};
+  glm::vec2 m_texcoord{0.f};
+  glm::vec3 m_tangent_u{0.f};
+  glm::vec3 m_tangent_v{0.f};
+  glm::vec3 m_color{0.f};
+  std::uint32_t m_material_idx = 0;
+};
+
+struct visibility_contribution {
+  glm::vec3 m_radiance{0.f};
+  glm::vec3 m_light_dir{0.f};
+  float m_light_dist = k_infinite_light_distance;
+  bool m_visible = false;
+};
+
+glm::vec4 srgb_to_linear(const glm::vec4& srgb) {
+  return {glm::pow(glm::vec3(srgb), glm::vec3(2.2f)), srgb.w};
+}
+
+glm::vec2 get_spherical_uv(const glm::vec3& v) {
+  const float gamma = std::asin(-v.y);
+  const float theta = std::atan2(v.z, v.x);
+
+  return glm::vec2(theta * k_one_over_pi * 0.5f, gamma * k_one_over_pi) + 0.5f;
+}
+
+void create_coordinate_system(const glm::vec3& N, glm::vec3& out_Nt,
+                              glm::vec3& out_Nb) {
+  out_Nt = glm::normalize(
+      std::abs(N.z) > 0.99999f
+          ? glm::vec3(-N.x * N.y, 1.f - N.y * N.y, -N.y * N.z)
+          : glm::vec3(-N.x * N.z, -N.y * N.z, 1.f - N.z * N.z));
+  out_Nb = glm::cross(out_Nt, N);
+}
+
+float offset_ray_component(float p, float n) {
+  constexpr float int_scale = 256.f;
+  constexpr float float_scale = 1.f / 65536.f;
+  constexpr float origin = 1.f / 32.f;
+
+  ReturnIf(std::abs(p) < origin, p + float_scale * n);
+
+  const auto offset = static_cast<std::int32_t>(int_scale * n);
+  return std::bit_cast<float>(std::bit_cast<std::int32_t>(p) +
+                              (p < 0.f ? -offset : offset));
+}
+
+glm::vec3 offset_ray(const glm::vec3& p, const glm::vec3& n) {
+  return {offset_ray_component(p.x, n.x), offset_ray_component(p.y, n.y),
+          offset_ray_component(p.z, n.z)};
+}
+
+float get_range_attenuation(float range, float distance) {
+  ReturnIf(range <= 0.f, 1.f);
+
+  return std::max(std::min(1.f - std::pow(distance / range, 4.f), 1.f), 0.f) /
+         std::pow(distance, 2.f);
+}
+
+float get_spot_attenuation(const glm::vec3& point_to_light,
+                           const glm::vec3& spot_direction,
+                           float outer_cone_cos, float inner_cone_cos) {
+  const float actual_cos = glm::dot(glm::normalize(spot_direction),
+                                    glm::normalize(-point_to_light));
+  ReturnUnless(actual_cos > outer_cone_cos, 0.f);
+  ReturnUnless(actual_cos < inner_cone_cos, 1.f);
+
+  return glm::smoothstep(outer_cone_cos, inner_cone_cos, actual_cos);
+}
+
+/**
+ * One thread's view of the pipeline, the rays it traces are counted for the
+ * statistics.
+ */
+class path_kernel {
+ public:
+  path_kernel(const scene& scene, const SceneCamera& camera,
+              const RtxState& state)
+      : m_scene(scene), m_camera(camera), m_state(state) {}
+
+ public:
+  // The camera part of samplePixel, draws the jitter and the aperture sample
+  ray sample_camera_ray(std::uint32_t x, std::uint32_t y,
+                        shader_random& random) const;
+  // PathTrace from its first closest hit on, and the firefly clamp
+  glm::vec3 trace_sample(ray primary_ray, const ray_hit& primary_hit,
+                         shader_random& random);
+
+  void count_rays(std::uint64_t rays_count) { m_rays_count += rays_count; }
+  [[nodiscard]] std::uint64_t get_rays_count() const { return m_rays_count; }
+
+ private:
+  ray_hit closest_hit(const ray& query_ray);
+  bool any_hit(const ray& query_ray, float max_dist);
+
+  [[nodiscard]] glm::vec4 texture_at(int texture_idx,
+                                     const glm::vec2& uv) const;
+  [[nodiscard]] glm::vec3 environment_at(const glm::vec2& uv) const;
+
+  [[nodiscard]] shade_state get_shade_state(const ray_hit& hit) const;
+  void get_metallic_roughness(shading_state& state,
+                              const GltfShadeMaterial& material) const;
+  void get_materials_and_textures(shading_state& state,
+                                  const glm::vec3& direction) const;
+  glm::vec3 environment_sample(const glm::vec3& rand_val,
+                               glm::vec3& out_to_light, float& out_pdf) const;
+  visibility_contribution direct_light(const ray& query_ray,
+                                       const shading_state& state,
+                                       shader_random& random) const;
+
+ private:
+  const scene& m_scene;
+  const SceneCamera& m_camera;
+  const RtxState& m_state;
+  std::uint64_t m_rays_count = 0;
+};
+
+ray path_kernel::sample_camera_ray(std::uint32_t x, std::uint32_t y,
+                                   shader_random& random) const {
+  glm::vec2 subpixel_jitter(0.5f);
+  if (m_state.frame != 0) {
+    subpixel_jitter.x = random.next();
+    subpixel_jitter.y = random.next();
+  }
+
+  const glm::vec2 pixel_center =
+      glm::vec2(static_cast<float>(x), static_cast<float>(y)) +
+      subpixel_jitter;
+  const glm::vec2 in_uv = pixel_center / glm::vec2(m_state.size);
+  const glm::vec2 d = in_uv * 2.f - 1.f;
+
+  const glm::vec4 origin = m_camera.viewInverse * glm::vec4(0.f, 0.f, 0.f, 1.f);
+  const glm::vec4 target = m_camera.projInverse * glm::vec4(d.x, d.y, 1.f, 1.f);
+  const glm::vec4 direction =
+      m_camera.viewInverse * glm::vec4(glm::normalize(glm::vec3(target)), 0.f);
+
+  // Depth of field
+  const glm::vec3 focal_point = m_camera.focalDist * glm::vec3(direction);
+  const float cam_r1 = random.next() * k_two_pi;
+  const float cam_r2 = random.next() * m_camera.aperture;
+  const glm::vec4 cam_right = m_camera.viewInverse * glm::vec4(1.f, 0.f, 0.f, 0.f);
+  const glm::vec4 cam_up = m_camera.viewInverse * glm::vec4(0.f, 1.f, 0.f, 0.f);
+  const glm::vec3 random_aperture_pos =
+      (std::cos(cam_r1) * glm::vec3(cam_right) +
+       std::sin(cam_r1) * glm::vec3(cam_up)) *
+      std::sqrt(cam_r2);
+
+  return ray{.m_origin = glm::vec3(origin) + random_aperture_pos,
+             .m_direction = glm::normalize(focal_point - random_aperture_pos)};
+}
+
+glm::vec3 path_kernel::trace_sample(ray primary_ray,
+                                    const ray_hit& primary_hit,
+                                    shader_random& random) {
+  glm::vec3 radiance(0.f);
+  glm::vec3 throughput(1.f);
+  glm::vec3 absorption(0.f);
+
+  ray query_ray = primary_ray;
+  for (int depth = 0; depth < m_state.maxDepth; ++depth) {
+    const ray_hit hit = depth == 0 ? primary_hit : closest_hit(query_ray);
+
+    // Hitting the environment
+    if (!hit.is_valid()) {
+      const glm::vec3 env =
+          environment_at(get_spherical_uv(query_ray.m_direction));
+      radiance += env * m_state.hdrMultiplier * throughput;
+      break;
+    }
+
+    const shade_state sstate = get_shade_state(hit);
+
+    shading_state state;
+    state.m_position = sstate.m_position;
+    state.m_normal = sstate.m_normal;
+    state.m_tangent = sstate.m_tangent_u;
+    state.m_bitangent = sstate.m_tangent_v;
+    state.m_texcoord = sstate.m_texcoord;
+    state.m_material_idx = sstate.m_material_idx;
+    state.m_is_subsurface = false;
+    state.m_ffnormal = glm::dot(state.m_normal, query_ray.m_direction) <= 0.f
+                           ? state.m_normal
+                           : -state.m_normal;
+
+    get_materials_and_textures(state, query_ray.m_direction);
+
+    // Color at vertices
+    state.m_material.m_albedo *= sstate.m_color;
+
+    // KHR_materials_unlit
+    if (state.m_material.m_unlit) {
+      radiance += state.m_material.m_albedo * throughput;
+      break;
+    }
+
+    // Reset absorption when the ray is going out of the surface
+    if (glm::dot(state.m_normal, state.m_ffnormal) < 0.f) {
+      absorption = glm::vec3(0.f);
+    } else {
+      absorption = -glm::log(state.m_material.m_attenuation_color) /
+                   state.m_material.m_attenuation_distance;
+    }
+
+    radiance += state.m_material.m_emission * throughput;
+
+    // Transmission and volume absorption
+    throughput *= glm::exp(-absorption * hit.m_t);
+
+    visibility_contribution contribution =
+        direct_light(query_ray, state, random);
+    contribution.m_radiance *= throughput;
+
+    glm::vec3 sample_L(0.f);
+    float sample_pdf = 0.f;
+    const glm::vec3 sample_f =
+        disney_sample(state, -query_ray.m_direction, state.m_ffnormal,
+                      sample_L, sample_pdf, random);
+    if (sample_pdf <= 0.f) {
+      break;
+    }
+    throughput *=
+        sample_f * std::abs(glm::dot(state.m_ffnormal, sample_L)) / sample_pdf;
+
+    // Russian roulette
+    const float rr_pcont = std::min(
+        std::max(throughput.x, std::max(throughput.y, throughput.z)) *
+                state.m_eta * state.m_eta +
+            0.001f,
+        0.95f);
+
+    query_ray.m_direction = sample_L;
+    query_ray.m_origin = offset_ray(
+        sstate.m_position, glm::dot(sample_L, state.m_ffnormal) > 0.f
+                               ? state.m_ffnormal
+                               : -state.m_ffnormal);
+
+    // Added only when the light isn't occluded
+    if (contribution.m_visible &&
+        !any_hit(ray{.m_origin = query_ray.m_origin,
+                     .m_direction = contribution.m_light_dir},
+                 contribution.m_light_dist)) {
+      radiance += contribution.m_radiance;
+    }
+
+    if (random.next() >= rr_pcont) {
+      break;
+    }
+    throughput /= rr_pcont;
+  }
+
+  // Removing fireflies
+  const float lum =
+      glm::dot(radiance, glm::vec3(0.212671f, 0.715160f, 0.072169f));
+  if (lum > m_state.fireflyClampThreshold) {
+    radiance *= m_state.fireflyClampThreshold / lum;
+  }
+
+  return radiance;
+}
+
+ray_hit path_kernel::closest_hit(const ray& query_ray) {
+  ++m_rays_count;
+
+  ray_hit hit;
+  m_scene.get_bvh().intersect(query_ray, hit);
+  return hit;
+}
+
+bool path_kernel::any_hit(const ray& query_ray, float max_dist) {
+  ++m_rays_count;
+
+  ray shadow_ray = query_ray;
+  shadow_ray.m_t_max = max_dist;
+  return m_scene.get_bvh().occluded(shadow_ray);
+}
+
+glm::vec4 path_kernel::texture_at(int texture_idx, const glm::vec2& uv) const {
+  const auto& textures = m_scene.get_textures();
+  AssertReturnUnless(static_cast<std::size_t>(texture_idx) < textures.size(),
+                     glm::vec4(0.f));
+
+  return sample_texture(textures[static_cast<std::size_t>(texture_idx)].get(),
+                        uv);
+}
+
+glm::vec3 path_kernel::environment_at(const glm::vec2& uv) const {
+  const environment_texture_asset* environment =
+      m_scene.get_environment_texture();
+  ReturnUnless(environment, glm::vec3(0.f));
+
+  return glm::vec3(sample_texture(*environment, uv));
+}
+
+shade_state path_kernel::get_shade_state(const ray_hit& hit) const {
+  const bvh_instance& instance =
+      m_scene.get_bvh().get_instances()[hit.m_instance_idx];
+  const InstanceData& geo_info = m_scene.get_instances()[hit.m_instance_idx];
+  const glm::vec3 bary(1.f - hit.m_u - hit.m_v, hit.m_u, hit.m_v);
+
+  const auto& indices = m_scene.get_indices();
+  const auto& vertices = m_scene.get_vertices();
+  const std::size_t first_index =
+      geo_info.indexOffset + static_cast<std::size_t>(hit.m_primitive_idx) * 3;
+  const vertex& attr0 = vertices[geo_info.vertexOffset + indices[first_index]];
+  const vertex& attr1 =
+      vertices[geo_info.vertexOffset + indices[first_index + 1]];
+  const vertex& attr2 =
+      vertices[geo_info.vertexOffset + indices[first_index + 2]];
+
+  const auto material_idx =
+      static_cast<std::uint32_t>(std::max(0, geo_info.materialIndex));
+
+  const glm::mat3 object_to_world(instance.m_world_matrix);
+  // n * gl_WorldToObjectEXT, the inverse transpose
+  const glm::mat3 normal_to_world =
+      glm::transpose(glm::mat3(instance.m_inverse_world_matrix));
+
+  const glm::vec3& pos0 = attr0.m_position;
+  const glm::vec3& pos1 = attr1.m_position;
+  const glm::vec3& pos2 = attr2.m_position;
+  const glm::vec3 position = pos0 * bary.x + pos1 * bary.y + pos2 * bary.z;
+  const glm::vec3 world_position =
+      glm::vec3(instance.m_world_matrix * glm::vec4(position, 1.f));
+
+  const glm::vec3 normal =
+      glm::normalize(attr0.m_normal * bary.x + attr1.m_normal * bary.y +
+                     attr2.m_normal * bary.z);
+  const glm::vec3 world_normal = glm::normalize(normal_to_world * normal);
+  const glm::vec3 geom_normal =
+      glm::normalize(glm::cross(pos1 - pos0, pos2 - pos0));
+  const glm::vec3 wgeom_normal = glm::normalize(normal_to_world * geom_normal);
+
+  const glm::vec3 tangent = glm::normalize(
+      glm::vec3(attr0.m_tangent) * bary.x + glm::vec3(attr1.m_tangent) * bary.y +
+      glm::vec3(attr2.m_tangent) * bary.z);
+  glm::vec3 world_tangent = glm::normalize(object_to_world * tangent);
+  world_tangent = glm::normalize(
+      world_tangent - glm::dot(world_tangent, world_normal) * world_normal);
+  // Handedness of the first vertex, as the shader decodes it
+  const float handedness = attr0.m_tangent.w < 0.f ? -1.f : 1.f;
+  const glm::vec3 world_binormal =
+      glm::cross(world_normal, world_tangent) * handedness;
+
+  const glm::vec2 texcoord = attr0.m_texcoord * bary.x +
+                             attr1.m_texcoord * bary.y +
+                             attr2.m_texcoord * bary.z;
+  const glm::vec4 color =
+      attr0.m_color * bary.x + attr1.m_color * bary.y + attr2.m_color * bary.z;
+
+  shade_state sstate{.m_normal = world_normal,
+                     .m_geom_normal = wgeom_normal,
+                     .m_position = world_position,
+                     .m_texcoord = texcoord,
+                     .m_tangent_u = world_tangent,
+                     .m_tangent_v = world_binormal,
+                     .m_color = glm::vec3(color),
+                     .m_material_idx = material_idx};
+
+  if (glm::dot(sstate.m_normal, sstate.m_geom_normal) <= 0.f) {
+    sstate.m_normal *= -1.f;
+  }
+
+  return sstate;
+}
+
+void path_kernel::get_metallic_roughness(
+    shading_state& state, const GltfShadeMaterial& material) const {
+  float perceptual_roughness = material.pbrRoughnessFactor;
+  float metallic = material.pbrMetallicFactor;
+  if (material.pbrMetallicRoughnessTexture > -1) {
+    const glm::vec4 mr_sample =
+        texture_at(material.pbrMetallicRoughnessTexture, state.m_texcoord);
+    perceptual_roughness = mr_sample.g * perceptual_roughness;
+    metallic = mr_sample.b * metallic;
+  }
+
+  glm::vec4 base_color = material.pbrBaseColorFactor;
+  if (material.pbrBaseColorTexture > -1) {
+    base_color *= srgb_to_linear(
+        texture_at(material.pbrBaseColorTexture, state.m_texcoord));
+  }
+
+  glm::vec3 f0 = material.specularColourFactor;
+  if (material.specularColourTexture > -1) {
+    f0 *= glm::vec3(srgb_to_linear(
+        texture_at(material.specularColourTexture, state.m_texcoord)));
+  } else {
+    // The material isn't filled yet, albedo and metallic are still zero
+    const glm::vec3 cdlin = state.m_material.m_albedo;
+    const float cdlum = 0.3f * cdlin.x + 0.6f * cdlin.y + 0.1f * cdlin.z;
+    const glm::vec3 ctint = cdlum > 0.f ? cdlin / cdlum : glm::vec3(1.f);
+
+    f0 *= glm::mix(state.m_material.m_specular * 0.08f *
+                       glm::mix(glm::vec3(1.f), ctint,
+                                state.m_material.m_specular_tint),
+                   cdlin, state.m_material.m_metallic);
+  }
+
+  state.m_material.m_albedo = glm::vec3(base_color);
+  state.m_material.m_metallic = metallic;
+  state.m_material.m_roughness = perceptual_roughness;
+  state.m_material.m_f0 = f0;
+  state.m_material.m_alpha = base_color.a;
+}
+
+void path_kernel::get_materials_and_textures(
+    shading_state& state, const glm::vec3& direction) const {
+  const auto& materials = m_scene.get_materials();
+  AssertReturnIf(materials.empty());
+  const GltfShadeMaterial& material =
+      materials[std::min<std::size_t>(state.m_material_idx,
+                                      materials.size() - 1)];
+
+  shading_material& mat = state.m_material;
+  mat.m_specular = material.specularFactor;
+  mat.m_subsurface = material.thicknessFactor;
+  mat.m_specular_tint = 1.f;
+  mat.m_sheen = 0.f;
+  mat.m_sheen_tint = glm::vec3(0.f);
+
+  state.m_texcoord =
+      glm::vec2(glm::vec4(state.m_texcoord, 1.f, 1.f) * material.uvTransform);
+  const glm::mat3 TBN(state.m_tangent, state.m_bitangent, state.m_normal);
+
+  if (material.normalTexture > -1) {
+    glm::vec3 normal_vector =
+        glm::vec3(texture_at(material.normalTexture, state.m_texcoord));
+    normal_vector = glm::normalize(normal_vector * 2.f - 1.f);
+    normal_vector *= glm::vec3(material.normalTextureScale,
+                               material.normalTextureScale, 1.f);
+    state.m_normal = glm::normalize(TBN * normal_vector);
+    state.m_ffnormal = glm::dot(state.m_normal, direction) <= 0.f
+                           ? state.m_normal
+                           : -state.m_normal;
+    create_coordinate_system(state.m_ffnormal, state.m_tangent,
+                             state.m_bitangent);
+  }
+
+  mat.m_emission = material.emissiveFactor;
+  if (material.emissiveTexture > -1) {
+    mat.m_emission *= glm::vec3(srgb_to_linear(
+        texture_at(material.emissiveTexture, state.m_texcoord)));
+  }
+
+  if (material.specularTexture > -1) {
+    mat.m_specular *= texture_at(material.specularTexture, state.m_texcoord).a;
+  }
+
+  get_metallic_roughness(state, material);
+
+  mat.m_roughness = std::max(mat.m_roughness, 0.001f);
+
+  mat.m_transmission = material.transmissionFactor;
+  if (material.transmissionTexture > -1) {
+    mat.m_transmission *=
+        texture_at(material.transmissionTexture, state.m_texcoord).r;
+  }
+
+  mat.m_ior = material.ior;
+  state.m_eta = glm::dot(state.m_normal, state.m_ffnormal) > 0.f
+                    ? 1.f / mat.m_ior
+                    : mat.m_ior;
+
+  mat.m_unlit = material.unlit == 1;
+
+  mat.m_anisotropy = material.anisotropy;
+  const float aspect = std::sqrt(1.f - material.anisotropy * 0.9f);
+  mat.m_ax = std::max(0.001f, mat.m_roughness / aspect);
+  mat.m_ay = std::max(0.001f, mat.m_roughness * aspect);
+
+  if (material.anisotropy > 0.f) {
+    state.m_tangent = glm::normalize(TBN * material.anisotropyDirection);
+    state.m_bitangent =
+        glm::normalize(glm::cross(state.m_normal, state.m_tangent));
+  }
+
+  mat.m_attenuation_color = material.attenuationColor;
+  mat.m_attenuation_distance = material.attenuationDistance;
+  mat.m_thin_walled = material.thicknessFactor == 0.f;
+
+  mat.m_clearcoat = material.clearcoatFactor;
+  mat.m_clearcoat_roughness = material.clearcoatRoughness;
+  if (material.clearcoatTexture > -1) {
+    mat.m_clearcoat *= texture_at(material.clearcoatTexture, state.m_texcoord).r;
+  }
+  if (material.clearcoatRoughnessTexture > -1) {
+    mat.m_clearcoat_roughness *=
+        texture_at(material.clearcoatRoughnessTexture, state.m_texcoord).g;
+  }
+  mat.m_clearcoat_roughness = std::max(mat.m_clearcoat_roughness, 0.001f);
+
+  const glm::vec4 sheen = glm::unpackUnorm4x8(material.sheen);
+  mat.m_sheen_tint = glm::vec3(sheen);
+  mat.m_sheen = sheen.w;
+}
+
+glm::vec3 path_kernel::environment_sample(const glm::vec3& rand_val,
+                                          glm::vec3& out_to_light,
+                                          float& out_pdf) const {
+  const environment_texture_asset* environment =
+      m_scene.get_environment_texture();
+  const auto& accel = m_scene.get_environment_accel();
+  out_to_light = glm::vec3(0.f, 1.f, 0.f);
+  out_pdf = 0.f;
+  ReturnUnless(environment && !accel.empty(), glm::vec3(0.f));
+
+  glm::vec3 xi = rand_val;
+  const std::uint32_t width = environment->m_width;
+  const std::uint32_t height = environment->m_height;
+
+  const auto size = static_cast<std::uint32_t>(
+      std::min<std::size_t>(static_cast<std::size_t>(width) * height,
+                            accel.size()));
+  const std::uint32_t idx = std::min(
+      static_cast<std::uint32_t>(xi.x * static_cast<float>(size)), size - 1);
+
+  const EnvAccel& sample_data = accel[idx];
+
+  std::uint32_t env_idx = 0;
+  if (xi.y < sample_data.q) {
+    env_idx = idx;
+    xi.y /= sample_data.q;
+    out_pdf = sample_data.pdf;
+  } else {
+    env_idx = sample_data.alias;
+    xi.y = (xi.y - sample_data.q) / (1.f - sample_data.q);
+    out_pdf = sample_data.aliasPdf;
+  }
+
+  const std::uint32_t px = env_idx % width;
+  const std::uint32_t py = env_idx / width;
+
+  const float u = (static_cast<float>(px) + xi.y) / static_cast<float>(width);
+  const float phi = u * (2.f * k_pi) - k_pi;
+  const float sin_phi = std::sin(phi);
+  const float cos_phi = std::cos(phi);
+
+  const float step_theta = k_pi / static_cast<float>(height);
+  const float theta0 = static_cast<float>(py) * step_theta;
+  const float cos_theta = std::cos(theta0) * (1.f - xi.z) +
+                          std::cos(theta0 + step_theta) * xi.z;
+  const float theta = std::acos(cos_theta);
+  const float sin_theta = std::sin(theta);
+  const float v = theta * k_one_over_pi;
+
+  out_to_light =
+      glm::vec3(cos_phi * sin_theta, cos_theta, sin_phi * sin_theta);
+
+  return environment_at(glm::vec2(u, v));
+}
+
+visibility_contribution path_kernel::direct_light(
+    const ray& query_ray, const shading_state& state,
+    shader_random& random) const {
+  glm::vec3 light_contrib(0.f);
+  glm::vec3 light_dir(0.f);
+  float light_pdf = 0.f;
+  float light_dist = k_infinite_light_distance;
+  bool is_light = false;
+
+  visibility_contribution contribution;
+
+  // Either a punctual light or the environment, the environment isn't
+  // picked when its multiplier is zero
+  const float p_select_light = m_state.hdrMultiplier > 0.f ? 0.5f : 1.f;
+
+  const auto& lights = m_scene.get_lights();
+  if (m_camera.nbLights != 0 && !lights.empty() &&
+      random.next() <= p_select_light) {
+    is_light = true;
+
+    const auto lights_count = static_cast<float>(m_camera.nbLights);
+    const auto light_idx = static_cast<std::size_t>(
+        std::min(random.next() * lights_count, lights_count));
+    const Light& light = lights[std::min(light_idx, lights.size() - 1)];
+
+    glm::vec3 point_to_light = -light.direction;
+    float range_attenuation = 1.f;
+    float spot_attenuation = 1.f;
+
+    if (light.type != LightType_Directional) {
+      point_to_light = light.position - state.m_position;
+    }
+
+    light_dist = glm::length(point_to_light);
+
+    if (light.type != LightType_Directional) {
+      range_attenuation = get_range_attenuation(light.range, light_dist);
+    }
+    if (light.type == LightType_Spot) {
+      spot_attenuation =
+          get_spot_attenuation(point_to_light, light.direction,
+                               light.outerConeCos, light.innerConeCos);
+    }
+
+    light_contrib = range_attenuation * spot_attenuation * light.intensity *
+                    light.color;
+    light_dir = glm::normalize(point_to_light);
+    light_pdf = 1.f;
+  } else {
+    const float r1 = random.next();
+    const float r2 = random.next();
+    const float r3 = random.next();
+    light_contrib = environment_sample(glm::vec3(r1, r2, r3), light_dir,
+                                       light_pdf);
+    light_contrib *= m_state.hdrMultiplier;
+  }
+
+  ReturnUnless(
+      state.m_is_subsurface || glm::dot(light_dir, state.m_ffnormal) > 0.f,
+      contribution);
+
+  float bsdf_pdf = 0.f;
+  const glm::vec3 f = disney_eval(state, -query_ray.m_direction,
+                                  state.m_ffnormal, light_dir, bsdf_pdf);
+
+  const float mis_weight =
+      is_light ? 1.f : std::max(0.f, power_heuristic(light_pdf, bsdf_pdf));
+
+  contribution.m_radiance = mis_weight * f *
+                            std::abs(glm::dot(light_dir, state.m_ffnormal)) *
+                            light_contrib / light_pdf;
+  contribution.m_visible = true;
+  contribution.m_light_dir = light_dir;
+  contribution.m_light_dist = light_dist;
+  return contribution;
+}
+}  // namespace
+
+double render_statistics::get_mrays_per_second() const {
+  ReturnIf(m_duration.count() <= 0.0, 0.0);
+  return static_cast<double>(m_rays_count) / m_duration.count() * 1e-6;
+}
+
+double render_statistics::get_msamples_per_second() const {
+  ReturnIf(m_duration.count() <= 0.0, 0.0);
+  return static_cast<double>(m_samples_count) / m_duration.count() * 1e-6;
+}
+
+render_statistics path_tracer::render(const scene& scene,
+                                      const SceneCamera& camera,
+                                      const RtxState& state,
+                                      render_target& target) const {
+  const auto start = std::chrono::steady_clock::now();
+
+  const std::uint32_t width = target.get_width();
+  const std::uint32_t height = target.get_height();
+  const std::uint32_t quad_rows_count = (height + k_quad_size - 1) / k_quad_size;
+  const std::uint32_t quad_columns_count =
+      (width + k_quad_size - 1) / k_quad_size;
+  const auto samples_count =
+      static_cast<std::uint32_t>(std::max(state.maxSamples, 1));
+
+  std::atomic<std::uint64_t> rays_count = 0;
+  parallel_for(
+      quad_rows_count,
+      [&](std::size_t begin, std::size_t end) {
+        path_kernel kernel(scene, camera, state);
+
+        for (std::size_t quad_row = begin; quad_row < end; ++quad_row) {
+          for (std::uint32_t quad_column = 0; quad_column < quad_columns_count;
+               ++quad_column) {
+            std::array<std::uint32_t, ray_packet::k_size> lane_x{};
+            std::array<std::uint32_t, ray_packet::k_size> lane_y{};
+            std::array<shader_random, ray_packet::k_size> lane_random{
+                shader_random(0, 0), shader_random(0, 0), shader_random(0, 0),
+                shader_random(0, 0)};
+            std::array<glm::vec3, ray_packet::k_size> lane_color{};
+            std::uint32_t lanes = 0;
+
+            for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+              lane_x[lane] = quad_column * k_quad_size + lane % k_quad_size;
+              lane_y[lane] = static_cast<std::uint32_t>(quad_row) * k_quad_size +
+                             lane / k_quad_size;
+              ContinueIf(lane_x[lane] >= width || lane_y[lane] >= height);
+
+              lane_random[lane] =
+                  shader_random(lane_y[lane] * width + lane_x[lane],
+                                static_cast<std::uint32_t>(state.frame));
+              lanes |= 1u << lane;
+            }
+
+            for (std::uint32_t sample = 0; sample < samples_count; ++sample) {
+              ray_packet packet;
+              std::array<ray, ray_packet::k_size> primary_rays{};
+              for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+                ContinueUnless(lanes & (1u << lane));
+
+                primary_rays[lane] = kernel.sample_camera_ray(
+                    lane_x[lane], lane_y[lane], lane_random[lane]);
+                packet.set_ray(lane, primary_rays[lane]);
+              }
+
+              std::array<ray_hit, ray_packet::k_size> primary_hits;
+              scene.get_bvh().intersect(packet, primary_hits);
+              kernel.count_rays(
+                  static_cast<std::uint64_t>(std::popcount(lanes)));
+
+              for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+                ContinueUnless(lanes & (1u << lane));
+
+                lane_color[lane] += kernel.trace_sample(
+                    primary_rays[lane], primary_hits[lane], lane_random[lane]);
+              }
+            }
+
+            for (std::uint32_t lane = 0; lane < ray_packet::k_size; ++lane) {
+              ContinueUnless(lanes & (1u << lane));
+
+              const glm::vec3 pixel_color =
+                  lane_color[lane] / static_cast<float>(samples_count);
+              if (state.frame > 0) {
+                const glm::vec3& old_color =
+                    target.get_pixel(lane_x[lane], lane_y[lane]);
+                target.set_pixel(
+                    lane_x[lane], lane_y[lane],
+                    glm::mix(old_color, pixel_color,
+                             1.f / static_cast<float>(state.frame + 1)));
+              } else {
+                target.set_pixel(lane_x[lane], lane_y[lane], pixel_color);
+              }
+            }
+          }
+        }
+
+        rays_count += kernel.get_rays_count();
+      },
+      1);
+
+  return render_statistics{
+      .m_rays_count = rays_count,
+      .m_samples_count =
+          static_cast<std::uint64_t>(width) * height * samples_count,
+      .m_duration = std::chrono::steady_clock::now() - start};
+}
+}  // namespace wunder::cpu
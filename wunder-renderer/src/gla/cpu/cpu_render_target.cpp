@@ -0,0 +1,173 @@
+#include "gla/cpu/cpu_render_target.h"
+
+#include <stb_image_write.h>
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+
+namespace wunder::cpu {
+namespace {
+constexpr std::uint32_t k_png_components_count = 3;
+
+class exr_writer {
+ public:
+  explicit exr_writer(std::ofstream& stream) : m_stream(stream) {}
+
+ public:
+  template <typename value_type>
+  void write(value_type value) {
+    // OpenEXR is little endian, as are the platforms we build for
+    std::array<char, sizeof(value_type)> bytes;
+    std::memcpy(bytes.data(), &value, sizeof(value_type));
+    m_stream.write(bytes.data(), bytes.size());
+  }
+
+  void write_string(std::string_view value) {
+    m_stream.write(value.data(), static_cast<std::streamsize>(value.size()));
+    m_stream.put('\0');
+  }
+
+  void write_attribute_header(std::string_view name, std::string_view type,
+                              std::int32_t size) {
+    write_string(name);
+    write_string(type);
+    write(size);
+  }
+
+ private:
+  std::ofstream& m_stream;
+};
+}  // namespace
+
+render_target::render_target(std::uint32_t width, std::uint32_t height)
+    : m_width(width),
+      m_height(height),
+      m_pixels(static_cast<std::size_t>(width) * height, glm::vec3(0.f)) {}
+
+const glm::vec3& render_target::get_pixel(std::uint32_t x,
+                                          std::uint32_t y) const {
+  return m_pixels[static_cast<std::size_t>(y) * m_width + x];
+}
+
+void render_target::set_pixel(std::uint32_t x, std::uint32_t y,
+                              const glm::vec3& radiance) {
+  m_pixels[static_cast<std::size_t>(y) * m_width + x] = radiance;
+}
+
+bool render_target::write_exr(const std::filesystem::path& path) const {
+  std::ofstream stream(path, std::ios::binary);
+  if (!stream) {
+    WUNDER_ERROR_TAG("Render", "Failed to open {0}", path.string());
+    return false;
+  }
+
+  exr_writer writer(stream);
+  constexpr std::int32_t k_float_pixel_type = 2;
+  constexpr std::uint32_t k_channels_count = 3;
+
+  // Magic number and version 2, single part scanline
+  writer.write<std::uint32_t>(20000630);
+  writer.write<std::uint32_t>(2);
+
+  // Channels are sorted by name, the scanlines store them in that order
+  constexpr std::array<std::string_view, k_channels_count> channel_names{
+      "B", "G", "R"};
+  writer.write_attribute_header("channels", "chlist",
+                                static_cast<std::int32_t>(
+                                    k_channels_count * (2 + 16) + 1));
+  for (std::string_view channel_name : channel_names) {
+    writer.write_string(channel_name);
+    writer.write(k_float_pixel_type);
+    writer.write<std::uint8_t>(0);  // pLinear
+    writer.write<std::uint8_t>(0);  // reserved
+    writer.write<std::uint8_t>(0);
+    writer.write<std::uint8_t>(0);
+    writer.write<std::int32_t>(1);  // x sampling
+    writer.write<std::int32_t>(1);  // y sampling
+  }
+  writer.write<std::uint8_t>(0);
+
+  writer.write_attribute_header("compression", "compression", 1);
+  writer.write<std::uint8_t>(0);  // NO_COMPRESSION
+
+  const auto max_x = static_cast<std::int32_t>(m_width) - 1;
+  const auto max_y = static_cast<std::int32_t>(m_height) - 1;
+  for (std::string_view window_name : {"dataWindow", "displayWindow"}) {
+    writer.write_attribute_header(window_name, "box2i", 16);
+    writer.write<std::int32_t>(0);
+    writer.write<std::int32_t>(0);
+    writer.write(max_x);
+    writer.write(max_y);
+  }
+
+  writer.write_attribute_header("lineOrder", "lineOrder", 1);
+  writer.write<std::uint8_t>(0);  // INCREASING_Y
+
+  writer.write_attribute_header("pixelAspectRatio", "float", 4);
+  writer.write(1.f);
+
+  writer.write_attribute_header("screenWindowCenter", "v2f", 8);
+  writer.write(0.f);
+  writer.write(0.f);
+
+  writer.write_attribute_header("screenWindowWidth", "float", 4);
+  writer.write(1.f);
+
+  writer.write<std::uint8_t>(0);  // end of the header
+
+  // One scanline per block, the offset table follows the header
+  const auto line_size =
+      static_cast<std::uint64_t>(m_width) * k_channels_count * sizeof(float);
+  const auto block_size = sizeof(std::int32_t) * 2 + line_size;
+  const auto first_block_offset = static_cast<std::uint64_t>(stream.tellp()) +
+                                  sizeof(std::uint64_t) * m_height;
+  for (std::uint32_t y = 0; y < m_height; ++y) {
+    writer.write<std::uint64_t>(first_block_offset + y * block_size);
+  }
+
+  for (std::uint32_t y = 0; y < m_height; ++y) {
+    writer.write(static_cast<std::int32_t>(y));
+    writer.write(static_cast<std::int32_t>(line_size));
+    for (std::uint32_t channel_idx = k_channels_count; channel_idx-- > 0;) {
+      for (std::uint32_t x = 0; x < m_width; ++x) {
+        writer.write(get_pixel(x, y)[static_cast<glm::length_t>(channel_idx)]);
+      }
+    }
+  }
+
+  return static_cast<bool>(stream);
+}
+
+bool render_target::write_png(const std::filesystem::path& path) const {
+  std::vector<std::uint8_t> pixels;
+  pixels.reserve(m_pixels.size() * k_png_components_count);
+  for (const glm::vec3& radiance : m_pixels) {
+    const glm::vec3 display =
+        glm::pow(glm::clamp(radiance, 0.f, 1.f), glm::vec3(1.f / 2.2f));
+    for (glm::length_t component = 0; component < 3; ++component) {
+      pixels.push_back(
+          static_cast<std::uint8_t>(std::lround(display[component] * 255.f)));
+    }
+  }
+
+  const int result = stbi_write_png(
+      path.string().c_str(), static_cast<int>(m_width),
+      static_cast<int>(m_height), static_cast<int>(k_png_components_count),
+      pixels.data(), static_cast<int>(m_width * k_png_components_count));
+  if (result == 0) {
+    WUNDER_ERROR_TAG("Render", "Failed to write {0}", path.string());
+    return false;
+  }
+
+  return true;
+}
+}  // namespace wunder::cpu
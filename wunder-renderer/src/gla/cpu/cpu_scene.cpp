@@ -0,0 +1,151 @@
+#include "gla/cpu/cpu_scene.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "assets/asset_storage.h"
+#include "assets/mesh_asset.h"
+#include "assets/scene_asset.h"
+#include "assets/texture_asset.h"
+#include "core/wunder_macros.h"
+#include "gla/vulkan/scene/vulkan_environment_resource_creator.h"
+#include "gla/vulkan/scene/vulkan_lights_resource_creator.h"
+#include "gla/vulkan/scene/vulkan_materials_resource_creator.h"
+
+namespace wunder::cpu {
+namespace {
+template <typename asset_type>
+assets<asset_type> find_assets(const asset_storage& storage,
+                               const std::unordered_set<asset_handle>& ids) {
+  assets<asset_type> result;
+  for (asset_handle handle : ids) {
+    ContinueUnless(handle.is_valid());
+
+    auto maybe_asset = storage.find_asset<asset_type>(handle);
+    AssertContinueUnless(maybe_asset.has_value());
+
+    result.emplace_back(handle, *maybe_asset);
+  }
+
+  return result;
+}
+}  // namespace
+
+bool scene::load_scene(const scene_asset& asset, const asset_storage& storage) {
+  m_bvh.build(asset, storage);
+  AssertReturnIf(m_bvh.get_instances().empty(), false);  // nothing to render
+
+  // Same selection as materials_resource_creator::extract_material_assets
+  std::unordered_set<asset_handle> material_ids;
+  for (const auto& instance : m_bvh.get_instances()) {
+    auto maybe_mesh = storage.find_asset<mesh_asset>(instance.m_mesh_handle);
+    AssertContinueUnless(maybe_mesh.has_value());
+    material_ids.emplace(maybe_mesh->get().m_material_handle);
+  }
+
+  assets<material_asset> material_assets;
+  if (material_ids.empty()) {
+    material_assets.emplace_back(
+        asset_handle::invalid(),
+        std::cref(vulkan::materials_resource_creator::get_default_material()));
+  } else {
+    material_assets = find_assets<material_asset>(storage, material_ids);
+  }
+
+  // Same selection as texture_resource_creator::extract_texture_assets
+  std::unordered_set<asset_handle> texture_ids;
+  for (const auto& [_, material_ref] : material_assets) {
+    const material_asset& material = material_ref.get();
+    texture_ids.emplace(material.m_pbr_base_color_texture);
+    texture_ids.emplace(material.m_pbr_metallic_roughness_texture);
+    texture_ids.emplace(material.m_emissive_texture);
+    texture_ids.emplace(material.m_normal_texture);
+    texture_ids.emplace(material.m_transmission_texture);
+    texture_ids.emplace(material.m_thickness_texture);
+    texture_ids.emplace(material.m_clearcoat_texture);
+    texture_ids.emplace(material.m_clearcoat_roughness_texture);
+    texture_ids.emplace(material.m_specular_texture);
+    texture_ids.emplace(material.m_specular_colour_texture);
+  }
+  const assets<texture_asset> texture_assets =
+      find_assets<texture_asset>(storage, texture_ids);
+
+  m_textures.clear();
+  m_textures.reserve(texture_assets.size());
+  for (const auto& [_, texture_ref] : texture_assets) {
+    m_textures.push_back(texture_ref);
+  }
+
+  m_materials = vulkan::materials_resource_creator::create_host_materials(
+      material_assets, texture_assets);
+  m_lights = vulkan::lights_resource_creator::create_host_lights(
+      asset.filter_nodes<light_component, transform_component>(), storage);
+
+  load_geometry(storage, material_assets);
+
+  return load_environment(storage);
+}
+
+void scene::load_geometry(const asset_storage& storage,
+                          const assets<material_asset>& material_assets) {
+  m_vertices.clear();
+  m_indices.clear();
+  m_instances.clear();
+
+  // Instances of a mesh share its vertices, as they share the arena ranges
+  std::unordered_map<asset_handle, InstanceData> mesh_data;
+  m_instances.reserve(m_bvh.get_instances().size());
+  for (const auto& instance : m_bvh.get_instances()) {
+    auto mesh_data_it = mesh_data.find(instance.m_mesh_handle);
+    if (mesh_data_it == mesh_data.end()) {
+      auto maybe_mesh = storage.find_asset<mesh_asset>(instance.m_mesh_handle);
+      AssertContinueUnless(maybe_mesh.has_value());
+      const mesh_asset& mesh = maybe_mesh->get();
+
+      auto material_it = material_assets.find(mesh.m_material_handle);
+      const auto material_idx =
+          material_it == material_assets.end()
+              ? 0
+              : static_cast<int>(
+                    std::distance(material_assets.begin(), material_it));
+
+      InstanceData data{
+          .vertexAddress = 0,
+          .indexAddress = 0,
+          .vertexOffset = static_cast<std::uint32_t>(m_vertices.size()),
+          .indexOffset = static_cast<std::uint32_t>(m_indices.size()),
+          .materialIndex = material_idx,
+          ._pad = 0};
+      m_vertices.insert(m_vertices.end(), mesh.m_vertices.begin(),
+                        mesh.m_vertices.end());
+      m_indices.insert(m_indices.end(), mesh.m_indices.begin(),
+                       mesh.m_indices.end());
+
+      mesh_data_it = mesh_data.emplace(instance.m_mesh_handle, data).first;
+    }
+
+    m_instances.push_back(mesh_data_it->second);
+  }
+}
+
+bool scene::load_environment(const asset_storage& storage) {
+  // The first environment, as vulkan_environment_resource_creator picks it
+  auto environment_assets =
+      storage.find_assets_of<environment_texture_asset>();
+  AssertReturnIf(environment_assets.empty(), false);
+
+  m_environment_texture = &environment_assets.begin()->second.get();
+
+  vulkan::vulkan_environment_resource_creator::environment_accel_data
+      accel_data;
+  ReturnUnless(vulkan::vulkan_environment_resource_creator::
+                   create_environment_accel_data(*m_environment_texture,
+                                                 accel_data),
+               false);
+
+  m_environment_accel = std::move(accel_data.m_env_accels);
+  m_environment_integral = accel_data.m_integral;
+  return true;
+}
+}  // namespace wunder::cpu
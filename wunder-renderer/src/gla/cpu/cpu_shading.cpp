@@ -0,0 +1,470 @@
+#include "gla/cpu/cpu_shading.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+#include "core/wunder_macros.h"
+
+/*
+ * Line by line port of pbr_disney.glsl, keep both in sync. Differences with
+ * the shader are called out where they are.
+ */
+namespace wunder::cpu {
+namespace {
+constexpr float k_pi = std::numbers::pi_v<float>;
+constexpr float k_two_pi = 2.f * std::numbers::pi_v<float>;
+constexpr float k_one_over_pi = std::numbers::inv_pi_v<float>;
+
+glm::vec3 importance_sample_gtr1(float rgh, float r1, float r2) {
+  const float a = std::max(0.001f, rgh);
+  const float a2 = a * a;
+
+  const float phi = r1 * k_two_pi;
+
+  const float cos_theta =
+      std::sqrt((1.f - std::pow(a2, 1.f - r1)) / (1.f - a2));
+  const float sin_theta =
+      std::clamp(std::sqrt(1.f - (cos_theta * cos_theta)), 0.f, 1.f);
+
+  return {sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta};
+}
+
+// http://jcgt.org/published/0007/04/01/
+glm::vec3 importance_sample_ggx_vndf(const glm::vec3& V, float ax, float ay,
+                                     float r1, float r2) {
+  const glm::vec3 z_ellipsoid = glm::normalize(glm::vec3(ax * V.x, ay * V.y, V.z));
+  const float lensq =
+      z_ellipsoid.x * z_ellipsoid.x + z_ellipsoid.y * z_ellipsoid.y;
+  const glm::vec3 x_ellipsoid =
+      lensq > 0.f ? glm::vec3(-z_ellipsoid.y, z_ellipsoid.x, 0.f) /
+                        std::sqrt(lensq)
+                  : glm::vec3(1.f, 0.f, 0.f);
+  const glm::vec3 y_ellipsoid = glm::cross(z_ellipsoid, x_ellipsoid);
+
+  const float r = std::sqrt(r1);
+  const float phi = 2.f * k_pi * r2;
+
+  const float x = r * std::cos(phi);
+  float y = r * std::sin(phi);
+  const float s = 0.5f * (1.f + z_ellipsoid.z);
+  y = (1.f - s) * std::sqrt(1.f - x * x) + s * y;
+
+  const glm::vec3 nh = x * x_ellipsoid + y * y_ellipsoid +
+                       std::sqrt(std::max(0.f, 1.f - x * x - y * y)) *
+                           z_ellipsoid;
+  return glm::normalize(glm::vec3(ax * nh.x, ay * nh.y, std::max(0.f, nh.z)));
+}
+
+glm::vec3 importance_sample_gtr2(float rgh, float r1, float r2) {
+  const float a = std::max(0.001f, rgh);
+
+  const float phi = r1 * k_two_pi;
+
+  const float cos_theta = std::sqrt((1.f - r2) / (1.f + (a * a - 1.f) * r2));
+  const float sin_theta =
+      std::clamp(std::sqrt(1.f - (cos_theta * cos_theta)), 0.f, 1.f);
+
+  return {sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta};
+}
+
+float schlick_fresnel(float u) {
+  const float m = std::clamp(1.f - u, 0.f, 1.f);
+  const float m2 = m * m;
+  return m2 * m2 * m;
+}
+
+float dielectric_fresnel(float cos_theta_i, float eta) {
+  const float sin_theta_t_sq = eta * eta * (1.f - cos_theta_i * cos_theta_i);
+
+  // Total internal reflection
+  ReturnIf(sin_theta_t_sq > 1.f, 1.f);
+
+  const float cos_theta_t = std::sqrt(std::max(1.f - sin_theta_t_sq, 0.f));
+
+  const float rs = (eta * cos_theta_t - cos_theta_i) /
+                   (eta * cos_theta_t + cos_theta_i);
+  const float rp = (eta * cos_theta_i - cos_theta_t) /
+                   (eta * cos_theta_i + cos_theta_t);
+
+  return 0.5f * (rs * rs + rp * rp);
+}
+
+float gtr1(float n_dot_h, float a) {
+  ReturnIf(a >= 1.f, k_one_over_pi);
+
+  const float a2 = a * a;
+  const float t = 1.f + (a2 - 1.f) * n_dot_h * n_dot_h;
+  return (a2 - 1.f) / (k_pi * std::log(a2) * t);
+}
+
+float gtr2(float n_dot_h, float a) {
+  const float a2 = a * a;
+  const float t = 1.f + (a2 - 1.f) * n_dot_h * n_dot_h;
+  return a2 / (k_pi * t * t);
+}
+
+float gtr2_aniso(float n_dot_h, float h_dot_x, float h_dot_y, float ax,
+                 float ay) {
+  const float a = h_dot_x / ax;
+  const float b = h_dot_y / ay;
+  const float c = a * a + b * b + n_dot_h * n_dot_h;
+  return 1.f / (k_pi * ax * ay * c * c);
+}
+
+float smith_g_ggx(float n_dot_v, float alpha_g) {
+  const float a = alpha_g * alpha_g;
+  const float b = n_dot_v * n_dot_v;
+  return 1.f / (n_dot_v + std::sqrt(a + b - a * b));
+}
+
+float smith_g_ggx_aniso(float n_dot_v, float v_dot_x, float v_dot_y, float ax,
+                        float ay) {
+  const float a = v_dot_x * ax;
+  const float b = v_dot_y * ay;
+  const float c = n_dot_v;
+  return 1.f / (n_dot_v + std::sqrt(a * a + b * b + c * c));
+}
+
+glm::vec3 cosine_sample_hemisphere(float r1, float r2) {
+  const float r = std::sqrt(r1);
+  const float phi = k_two_pi * r2;
+  const float x = r * std::cos(phi);
+  const float y = r * std::sin(phi);
+  return {x, y, std::sqrt(std::max(0.f, 1.f - x * x - y * y))};
+}
+
+glm::vec3 uniform_sample_hemisphere(float r1, float r2) {
+  const float r = std::sqrt(std::max(0.f, 1.f - r1 * r1));
+  const float phi = k_two_pi * r2;
+  return {r * std::cos(phi), r * std::sin(phi), r1};
+}
+
+glm::vec3 to_world(const shading_state& state, const glm::vec3& N,
+                   const glm::vec3& local) {
+  return state.m_tangent * local.x + state.m_bitangent * local.y +
+         N * local.z;
+}
+
+glm::vec3 eval_dielectric_reflection(const shading_state& state,
+                                     const glm::vec3& V, const glm::vec3& N,
+                                     const glm::vec3& L, const glm::vec3& H,
+                                     float& in_out_pdf) {
+  // No reflection when they are on opposite sides of the surface
+  ReturnIf(glm::dot(N, L) < 0.f, glm::vec3(0.f));
+
+  const float v_dot_h = glm::dot(V, H);
+
+  const float F = dielectric_fresnel(v_dot_h, state.m_eta);
+  const float D = gtr2(glm::dot(N, H), state.m_material.m_roughness);
+
+  in_out_pdf = D * glm::dot(N, H) * F / (4.f * v_dot_h);
+
+  const float G =
+      smith_g_ggx(std::abs(glm::dot(N, L)), state.m_material.m_roughness) *
+      smith_g_ggx(glm::dot(N, V), state.m_material.m_roughness);
+  return state.m_material.m_albedo * F * D * G;
+}
+
+glm::vec3 eval_dielectric_refraction(const shading_state& state,
+                                     const glm::vec3& V, const glm::vec3& N,
+                                     const glm::vec3& L, const glm::vec3& H,
+                                     float& out_pdf) {
+  const float v_dot_h = glm::dot(V, H);
+  const float l_dot_h = glm::dot(L, H);
+
+  const float F = dielectric_fresnel(std::abs(v_dot_h), state.m_eta);
+  const float D = gtr2(glm::dot(N, H), state.m_material.m_roughness);
+  const float G =
+      smith_g_ggx(std::abs(glm::dot(N, L)), state.m_material.m_roughness) *
+      smith_g_ggx(glm::dot(N, V), state.m_material.m_roughness);
+
+  const float denom_sqrt = l_dot_h * state.m_eta + v_dot_h;
+  const float denom = denom_sqrt * denom_sqrt;
+
+  out_pdf = D * glm::dot(N, H) * (1.f - F) * std::abs(l_dot_h) / denom;
+
+  return state.m_material.m_albedo * (1.f - F) * D * G * std::abs(v_dot_h) *
+         std::abs(l_dot_h) * 4.f * state.m_eta * state.m_eta / denom;
+}
+
+glm::vec3 eval_specular(const shading_state& state, const glm::vec3& cspec0,
+                        const glm::vec3& V, const glm::vec3& N,
+                        const glm::vec3& L, const glm::vec3& H,
+                        float& in_out_pdf) {
+  ReturnIf(glm::dot(N, L) < 0.f, glm::vec3(0.f));
+
+  const shading_material& material = state.m_material;
+  const float D =
+      gtr2_aniso(glm::dot(N, H), glm::dot(H, state.m_tangent),
+                 glm::dot(H, state.m_bitangent), material.m_ax, material.m_ay);
+  in_out_pdf = D * glm::dot(N, H) / (4.f * glm::dot(V, H));
+
+  const float FH = schlick_fresnel(glm::dot(L, H));
+  const glm::vec3 F = glm::mix(cspec0, glm::vec3(1.f), FH);
+  float G = smith_g_ggx_aniso(glm::dot(N, L), glm::dot(L, state.m_tangent),
+                              glm::dot(L, state.m_bitangent), material.m_ax,
+                              material.m_ay);
+  G *= smith_g_ggx_aniso(glm::dot(N, V), glm::dot(V, state.m_tangent),
+                         glm::dot(V, state.m_bitangent), material.m_ax,
+                         material.m_ay);
+  return F * D * G;
+}
+
+glm::vec3 eval_clearcoat(const shading_state& state, const glm::vec3& V,
+                         const glm::vec3& N, const glm::vec3& L,
+                         const glm::vec3& H, float& in_out_pdf) {
+  ReturnIf(glm::dot(N, L) < 0.f, glm::vec3(0.f));
+
+  const float D =
+      gtr1(glm::dot(N, H), state.m_material.m_clearcoat_roughness);
+  in_out_pdf = D * glm::dot(N, H) / (4.f * glm::dot(V, H));
+
+  constexpr float scale = 0.25f;
+  const float FH = schlick_fresnel(glm::dot(L, H));
+  const float F = glm::mix(0.04f, 1.f, FH);
+  const float G =
+      smith_g_ggx(glm::dot(N, L), scale) * smith_g_ggx(glm::dot(N, V), scale);
+  return glm::vec3(scale * state.m_material.m_clearcoat * F * D * G);
+}
+
+glm::vec3 eval_diffuse(const shading_state& state, const glm::vec3& csheen,
+                       const glm::vec3& V, const glm::vec3& N,
+                       const glm::vec3& L, const glm::vec3& H,
+                       float& in_out_pdf) {
+  ReturnIf(glm::dot(N, L) < 0.f, glm::vec3(0.f));
+
+  const shading_material& material = state.m_material;
+  in_out_pdf = glm::dot(N, L) * k_one_over_pi;
+
+  const float FL = schlick_fresnel(glm::dot(N, L));
+  const float FV = schlick_fresnel(glm::dot(N, V));
+  const float FH = schlick_fresnel(glm::dot(-V, H));
+  const float fd90 =
+      0.5f + 2.f * glm::dot(L, H) * glm::dot(L, H) * material.m_roughness;
+  const float fd = glm::mix(1.f, fd90, FL) * glm::mix(1.f, fd90, FV);
+  const glm::vec3 fsheen = FH * material.m_sheen * csheen;
+  return (k_one_over_pi * fd * (1.f - material.m_subsurface) *
+              material.m_albedo +
+          fsheen) *
+         (1.f - material.m_metallic);
+}
+
+glm::vec3 eval_subsurface(const shading_state& state, const glm::vec3& V,
+                          const glm::vec3& N, const glm::vec3& L,
+                          float& out_pdf) {
+  const shading_material& material = state.m_material;
+  out_pdf = 1.f / k_two_pi;
+
+  const float FL = schlick_fresnel(std::abs(glm::dot(N, L)));
+  const float FV = schlick_fresnel(glm::dot(N, V));
+  const float fd = (1.f - 0.5f * FL) * (1.f - 0.5f * FV);
+  return glm::sqrt(material.m_albedo) * material.m_subsurface *
+         k_one_over_pi * fd * (1.f - material.m_metallic) *
+         (1.f - material.m_transmission);
+}
+}  // namespace
+
+shader_random::shader_random(std::uint32_t pixel_idx, std::uint32_t frame)
+    : m_seed(tea(pixel_idx, frame)) {}
+
+float shader_random::next() {
+  // pcg
+  const std::uint32_t prev = m_seed * 747796405u + 2891336453u;
+  const std::uint32_t word = ((prev >> ((prev >> 28u) + 4u)) ^ prev) * 277803737u;
+  m_seed = prev;
+  const std::uint32_t r = (word >> 22u) ^ word;
+
+  return std::bit_cast<float>(0x3f800000u | (r >> 9)) - 1.f;
+}
+
+std::uint32_t shader_random::tea(std::uint32_t value0, std::uint32_t value1) {
+  std::uint32_t v0 = value0;
+  std::uint32_t v1 = value1;
+  std::uint32_t s0 = 0;
+
+  for (std::uint32_t n = 0; n < 16; ++n) {
+    s0 += 0x9e3779b9u;
+    v0 += ((v1 << 4) + 0xa341316cu) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4u);
+    v1 += ((v0 << 4) + 0xad90777du) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761eu);
+  }
+
+  return v0;
+}
+
+glm::vec3 disney_sample(shading_state& state, const glm::vec3& V,
+                        const glm::vec3& N, glm::vec3& out_L, float& out_pdf,
+                        shader_random& random) {
+  const shading_material& material = state.m_material;
+  state.m_is_subsurface = false;
+  out_pdf = 0.f;
+  glm::vec3 f(0.f);
+
+  const float r1 = random.next();
+  const float r2 = random.next();
+
+  const float diffuse_ratio =
+      0.5f * (1.f - material.m_metallic) * (1.f - material.m_clearcoat);
+  const float trans_weight = (1.f - material.m_metallic) *
+                             (1.f - material.m_clearcoat) *
+                             material.m_transmission;
+  const float primary_spec_ratio = 1.f / (1.f + material.m_clearcoat);
+  const float clearcoat_weight = material.m_clearcoat;
+
+  const glm::vec3 cspec0 = material.m_f0;
+  const glm::vec3 csheen = material.m_sheen_tint;
+
+  const float random_weight = random.next();
+
+  // BSDF
+  if (random_weight < trans_weight) {
+    const glm::vec3 H =
+        to_world(state, N, importance_sample_gtr2(material.m_roughness, r1, r2));
+
+    const glm::vec3 R = glm::reflect(-V, H);
+    float F = dielectric_fresnel(std::abs(glm::dot(R, H)), state.m_eta);
+
+    if (material.m_thin_walled) {
+      if (glm::dot(state.m_ffnormal, state.m_normal) < 0.f) {
+        F = 0.f;
+      }
+      state.m_eta = 1.001f;
+    }
+
+    // The shader normalizes the refracted direction before testing it for
+    // total internal reflection, which is undefined for a zero vector
+    const glm::vec3 refracted = glm::refract(-V, N, state.m_eta);
+    if (random_weight < F || glm::dot(refracted, refracted) == 0.f) {
+      out_L = glm::normalize(R);
+      f = eval_dielectric_reflection(state, V, N, out_L, H, out_pdf);
+    } else {
+      out_L = glm::normalize(refracted);
+      f = eval_dielectric_refraction(state, V, N, out_L, H, out_pdf);
+    }
+
+    f *= trans_weight;
+    out_pdf *= trans_weight;
+    return f;
+  }
+
+  // BRDF
+  if (random_weight < diffuse_ratio) {
+    // Diffuse transmission, approximates subsurface scattering
+    if (random.next() < material.m_subsurface) {
+      const glm::vec3 local = uniform_sample_hemisphere(r1, r2);
+      out_L = state.m_tangent * local.x + state.m_bitangent * local.y -
+              N * local.z;
+
+      f = eval_subsurface(state, V, N, out_L, out_pdf);
+      out_pdf *= material.m_subsurface * diffuse_ratio;
+
+      // Lights are sampled from inside of the surface
+      state.m_is_subsurface = true;
+    } else {
+      out_L = to_world(state, N, cosine_sample_hemisphere(r1, r2));
+
+      const glm::vec3 H = glm::normalize(out_L + V);
+
+      f = eval_diffuse(state, csheen, V, N, out_L, H, out_pdf);
+      out_pdf *= (1.f - material.m_subsurface) * diffuse_ratio;
+    }
+  } else if (random_weight < clearcoat_weight) {
+    constexpr float scale = 10.f;
+    const glm::vec3 H = to_world(
+        state, N,
+        importance_sample_gtr1(material.m_clearcoat_roughness, r1, r2));
+    out_L = glm::normalize(glm::reflect(-V, H));
+
+    f = eval_clearcoat(state, V, N, out_L, H, out_pdf);
+    out_pdf /= (clearcoat_weight * scale);
+  } else if (random_weight < primary_spec_ratio) {
+    const glm::vec3 v_tangent(glm::dot(V, state.m_tangent),
+                              glm::dot(V, state.m_bitangent), glm::dot(V, N));
+    const glm::vec3 H = to_world(
+        state, N,
+        importance_sample_ggx_vndf(v_tangent, material.m_ax, material.m_ay,
+                                   r1, r2));
+
+    out_L = glm::normalize(glm::reflect(-V, H));
+
+    f = eval_specular(state, cspec0, V, N, out_L, H, out_pdf);
+    out_pdf *= primary_spec_ratio * (1.f - diffuse_ratio);
+  }
+
+  f *= (1.f - trans_weight);
+  out_pdf *= (1.f - trans_weight);
+  return f;
+}
+
+glm::vec3 disney_eval(const shading_state& state, const glm::vec3& V,
+                      const glm::vec3& N, const glm::vec3& L, float& out_pdf) {
+  const shading_material& material = state.m_material;
+
+  // Half vector, refracted light bends it by the relative index
+  glm::vec3 H = glm::dot(N, L) < 0.f ? glm::normalize(L * (1.f / state.m_eta) + V)
+                                     : glm::normalize(L + V);
+  if (glm::dot(N, H) < 0.f) {
+    H = -H;
+  }
+
+  const float diffuse_ratio = 0.5f * (1.f - material.m_metallic);
+  const float primary_spec_ratio = 1.f / (1.f + material.m_clearcoat);
+  const float trans_weight =
+      (1.f - material.m_metallic) * material.m_transmission;
+
+  glm::vec3 brdf(0.f);
+  glm::vec3 bsdf(0.f);
+  float brdf_pdf = 0.f;
+  float bsdf_pdf = 0.f;
+
+  // BSDF
+  if (trans_weight > 0.f) {
+    bsdf = glm::dot(N, L) < 0.f
+               ? eval_dielectric_refraction(state, V, N, L, H, bsdf_pdf)
+               : eval_dielectric_reflection(state, V, N, L, H, bsdf_pdf);
+  }
+
+  float lobe_pdf = 0.f;
+  if (trans_weight < 1.f) {
+    if (glm::dot(N, L) < 0.f) {
+      // Subsurface
+      if (material.m_subsurface > 0.f) {
+        brdf = eval_subsurface(state, V, N, L, lobe_pdf);
+        brdf_pdf = lobe_pdf * material.m_subsurface * diffuse_ratio;
+      }
+    } else {
+      const glm::vec3 cdlin = material.m_albedo;
+      // Luminance approximation, normalizes it to isolate hue and saturation
+      const float cdlum = 0.3f * cdlin.x + 0.6f * cdlin.y + 0.1f * cdlin.z;
+      const glm::vec3 ctint = cdlum > 0.f ? cdlin / cdlum : glm::vec3(1.f);
+      const glm::vec3 cspec0 = glm::mix(
+          material.m_specular * 0.08f *
+              glm::mix(glm::vec3(1.f), ctint, material.m_specular_tint),
+          cdlin, material.m_metallic);
+      const glm::vec3 csheen = material.m_sheen_tint;
+
+      brdf += eval_diffuse(state, csheen, V, N, L, H, lobe_pdf);
+      brdf_pdf += lobe_pdf * (1.f - material.m_subsurface) * diffuse_ratio;
+
+      brdf += eval_specular(state, cspec0, V, N, L, H, lobe_pdf);
+      brdf_pdf += lobe_pdf * primary_spec_ratio * (1.f - diffuse_ratio);
+
+      brdf += eval_clearcoat(state, V, N, L, H, lobe_pdf);
+      brdf_pdf +=
+          lobe_pdf * (1.f - primary_spec_ratio) * (1.f - diffuse_ratio);
+    }
+  }
+
+  out_pdf = glm::mix(brdf_pdf, bsdf_pdf, trans_weight);
+  return glm::mix(brdf, bsdf, trans_weight);
+}
+
+float power_heuristic(float a, float b) {
+  const float t = a * a;
+  return t / (b * b + t);
+}
+}  // namespace wunder::cpu
@@ -0,0 +1,112 @@
+#include "gla/cpu/cpu_texture.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+#include "assets/texture_asset.h"
+#include "core/wunder_macros.h"
+
+namespace wunder::cpu {
+namespace {
+constexpr std::uint32_t k_components_count = 4;
+
+std::int64_t wrap_texel(std::int64_t coordinate, std::int64_t size,
+                        address_mode_type address_mode) {
+  switch (address_mode) {
+    case address_mode_type::CLAMP_TO_EDGE:
+      return std::clamp<std::int64_t>(coordinate, 0, size - 1);
+    case address_mode_type::MIRRORED_REPEAT: {
+      const std::int64_t period = 2 * size;
+      const std::int64_t mirrored = ((coordinate % period) + period) % period;
+      return mirrored < size ? mirrored : period - 1 - mirrored;
+    }
+    case address_mode_type::REPEAT:
+      break;
+  }
+
+  return ((coordinate % size) + size) % size;
+}
+
+glm::vec4 fetch_texel(const texture_asset& texture, std::int64_t x,
+                      std::int64_t y) {
+  const std::size_t texel_idx =
+      (static_cast<std::size_t>(y) * texture.m_width +
+       static_cast<std::size_t>(x)) *
+      k_components_count;
+
+  return std::visit(
+      overloaded{[texel_idx](const std::vector<unsigned char>& pixels) {
+                   ReturnIf(texel_idx + k_components_count > pixels.size(),
+                            glm::vec4(0.f));
+                   return glm::vec4(pixels[texel_idx], pixels[texel_idx + 1],
+                                    pixels[texel_idx + 2],
+                                    pixels[texel_idx + 3]) /
+                          255.f;
+                 },
+                 [texel_idx](const std::vector<float>& pixels) {
+                   ReturnIf(texel_idx + k_components_count > pixels.size(),
+                            glm::vec4(0.f));
+                   return glm::vec4(pixels[texel_idx], pixels[texel_idx + 1],
+                                    pixels[texel_idx + 2],
+                                    pixels[texel_idx + 3]);
+                 }},
+      texture.m_texture_data.m_data);
+}
+}  // namespace
+
+glm::vec4 sample_texture(const texture_asset& texture, const glm::vec2& uv) {
+  ReturnIf(texture.m_width == 0 || texture.m_height == 0, glm::vec4(0.f));
+
+  // Vulkan's sampler defaults, the asset sampler overrides them
+  texture_filter_type filter = texture_filter_type::LINEAR;
+  address_mode_type address_mode_u = address_mode_type::REPEAT;
+  address_mode_type address_mode_v = address_mode_type::REPEAT;
+  if (texture.m_sampler.has_value()) {
+    filter = texture.m_sampler->m_mag_filter;
+    address_mode_u = texture.m_sampler->m_address_mode_u;
+    address_mode_v = texture.m_sampler->m_address_mode_v;
+  }
+
+  const auto width = static_cast<std::int64_t>(texture.m_width);
+  const auto height = static_cast<std::int64_t>(texture.m_height);
+  const float x = uv.x * static_cast<float>(width);
+  const float y = uv.y * static_cast<float>(height);
+
+  if (filter == texture_filter_type::NEAREST) {
+    return fetch_texel(
+        texture,
+        wrap_texel(static_cast<std::int64_t>(std::floor(x)), width,
+                   address_mode_u),
+        wrap_texel(static_cast<std::int64_t>(std::floor(y)), height,
+                   address_mode_v));
+  }
+
+  // Texel centers are at half coordinates
+  const float texel_x = x - 0.5f;
+  const float texel_y = y - 0.5f;
+  const float floor_x = std::floor(texel_x);
+  const float floor_y = std::floor(texel_y);
+  const float weight_x = texel_x - floor_x;
+  const float weight_y = texel_y - floor_y;
+
+  const auto x0 = static_cast<std::int64_t>(floor_x);
+  const auto y0 = static_cast<std::int64_t>(floor_y);
+  const std::int64_t left = wrap_texel(x0, width, address_mode_u);
+  const std::int64_t right = wrap_texel(x0 + 1, width, address_mode_u);
+  const std::int64_t top = wrap_texel(y0, height, address_mode_v);
+  const std::int64_t bottom = wrap_texel(y0 + 1, height, address_mode_v);
+
+  const glm::vec4 top_texel = glm::mix(fetch_texel(texture, left, top),
+                                       fetch_texel(texture, right, top),
+                                       weight_x);
+  const glm::vec4 bottom_texel = glm::mix(fetch_texel(texture, left, bottom),
+                                          fetch_texel(texture, right, bottom),
+                                          weight_x);
+  return glm::mix(top_texel, bottom_texel, weight_y);
+}
+}  // namespace wunder::cpu
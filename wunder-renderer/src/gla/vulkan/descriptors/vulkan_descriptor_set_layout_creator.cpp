@@ -11,7 +11,7 @@ descriptor_set_layout_creator::descriptor_set_layout_creator(
 VkDescriptorSetLayoutBinding descriptor_set_layout_creator::operator()(
     const shader_resource::declaration::uniform_buffer& resource) {
   VkDescriptorSetLayoutBinding layout_binding;
-  layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   layout_binding.descriptorCount =
       try_retrieve_binding_count(resource);  // TODO
   layout_binding.stageFlags = VK_SHADER_STAGE_ALL;
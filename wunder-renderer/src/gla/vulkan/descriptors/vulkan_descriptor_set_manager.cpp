@@ -1,6 +1,9 @@
 #include "gla/vulkan/descriptors/vulkan_descriptor_set_manager.h"
 
+#include <algorithm>
 #include <expected>
+#include <tuple>
+#include <unordered_set>
 #include <variant>
 
 #include "core/wunder_macros.h"
@@ -11,6 +14,7 @@
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_physical_device.h"
 #include "gla/vulkan/vulkan_renderer_context.h"
 #include "gla/vulkan/vulkan_shader.h"
 #include "include/gla/vulkan/vulkan_base_pipeline.h"
@@ -77,8 +81,6 @@ void descriptor_set_manager::clear_resource(
   descriptor_bindings.clear_resource(resource_declaration.m_binding);
 }
 
-// TODO:: This mechanism doesn't provide a way of updating descriptors, other
-// than updating everything in the binding
 void descriptor_set_manager::add_resource(
     const vulkan_resource_identifier& resource_identifier,
     shader_resource::instance::element resource) {
@@ -102,16 +104,221 @@ descriptor_set_manager::build_error_code descriptor_set_manager::build() {
   return build_error_code::SUCCESS;
 }
 
-void descriptor_set_manager::bind(const base_pipeline& pipeline) const {
+void descriptor_set_manager::bind(const base_pipeline& pipeline) {
+  recycle_released_elements();
+
   auto command_buffer = layer_abstraction_factory::instance()
                             .get_render_context()
                             .mutable_swap_chain()
                             .get_current_command_buffer();
 
+  std::vector<std::uint32_t> dynamic_offsets;
+  collect_dynamic_offsets(dynamic_offsets);
+
   vkCmdBindDescriptorSets(command_buffer, pipeline.get_bind_point(),
                           pipeline.get_vulkan_pipeline_layout(), 0,
                           static_cast<uint32_t>(m_descriptor_sets.size()),
-                          m_descriptor_sets.data(), 0, nullptr);
+                          m_descriptor_sets.data(),
+                          static_cast<uint32_t>(dynamic_offsets.size()),
+                          dynamic_offsets.data());
+}
+
+void descriptor_set_manager::collect_dynamic_offsets(
+    std::vector<std::uint32_t>& out_offsets) const {
+  for (const auto& dynamic_binding : m_dynamic_bindings) {
+    std::uint32_t descriptors_count = 0;
+
+    auto maybe_binding =
+        find_resource_binding(dynamic_binding.m_set, dynamic_binding.m_binding);
+    if (maybe_binding.has_value()) {
+      const auto& resources = maybe_binding->get().m_dynamic_resources;
+      for (; descriptors_count < dynamic_binding.m_descriptors_count &&
+             descriptors_count < resources.size();
+           ++descriptors_count) {
+        out_offsets.emplace_back(
+            resources[descriptors_count].get().get_dynamic_offset());
+      }
+    }
+
+    // Every dynamic descriptor in the layout needs an offset, even unused ones
+    for (; descriptors_count < dynamic_binding.m_descriptors_count;
+         ++descriptors_count) {
+      out_offsets.emplace_back(0);
+    }
+  }
+}
+
+void descriptor_set_manager::recycle_released_elements() {
+  std::lock_guard lock(m_update_after_bind_mutex);
+
+  // Binding twice a frame, e.g. per tile, mustn't age the elements faster
+  const auto& swap_chain = layer_abstraction_factory::instance()
+                               .get_render_context()
+                               .mutable_swap_chain();
+  const std::uint64_t submitted_frames =
+      swap_chain.get_submitted_frames_count();
+  const auto frames_in_flight =
+      static_cast<std::uint64_t>(swap_chain.get_image_count());
+
+  for (auto& [_, binding] : m_update_after_bind_bindings) {
+    std::erase_if(binding.m_released_elements,
+                  [&binding, submitted_frames, frames_in_flight](
+                      const std::pair<std::uint32_t, std::uint64_t>& released) {
+                    ReturnIf(submitted_frames - released.second <=
+                                 frames_in_flight,
+                             false);
+
+                    binding.m_free_elements.emplace_back(released.first);
+                    return true;
+                  });
+  }
+}
+
+bool descriptor_set_manager::update_resource(
+    const vulkan_resource_identifier& resource_identifier,
+    std::uint32_t array_element, shader_resource::instance::element resource) {
+  auto maybe_resource_declaration =
+      find_resource_declaration(resource_identifier);
+  AssertReturnUnless(maybe_resource_declaration.has_value(), false);
+  const auto& resource_declaration = maybe_resource_declaration->get();
+
+  std::lock_guard lock(m_update_after_bind_mutex);
+  auto* binding = find_update_after_bind_binding(resource_declaration);
+  if (binding == nullptr) {
+    WUNDER_WARN_TAG("Renderer",
+                    "{0} isn't update after bind, rebuild the descriptors",
+                    resource_identifier);
+    return false;
+  }
+  AssertReturnUnless(array_element < binding->m_capacity, false);
+
+  return write_resource(resource_declaration, array_element, resource);
+}
+
+std::optional<std::uint32_t> descriptor_set_manager::append_resource(
+    const vulkan_resource_identifier& resource_identifier,
+    shader_resource::instance::element resource) {
+  auto maybe_resource_declaration =
+      find_resource_declaration(resource_identifier);
+  AssertReturnUnless(maybe_resource_declaration.has_value(), std::nullopt);
+  const auto& resource_declaration = maybe_resource_declaration->get();
+
+  std::lock_guard lock(m_update_after_bind_mutex);
+  auto* binding = find_update_after_bind_binding(resource_declaration);
+  if (binding == nullptr) {
+    WUNDER_WARN_TAG("Renderer",
+                    "{0} isn't update after bind, rebuild the descriptors",
+                    resource_identifier);
+    return std::nullopt;
+  }
+
+  std::uint32_t array_element = 0;
+  if (!binding->m_free_elements.empty()) {
+    array_element = binding->m_free_elements.back();
+    binding->m_free_elements.pop_back();
+  } else {
+    auto maybe_binding = find_resource_binding(resource_declaration.m_set,
+                                               resource_declaration.m_binding);
+    array_element = maybe_binding.has_value()
+                        ? static_cast<std::uint32_t>(maybe_binding->get().size())
+                        : 0;
+  }
+
+  if (array_element >= binding->m_capacity) {
+    WUNDER_WARN_TAG("Renderer", "{0} is full, {1} elements",
+                    resource_identifier, binding->m_capacity);
+    return std::nullopt;
+  }
+
+  ReturnUnless(write_resource(resource_declaration, array_element, resource),
+               std::nullopt);
+
+  return array_element;
+}
+
+void descriptor_set_manager::release_resource(
+    const vulkan_resource_identifier& resource_identifier,
+    std::uint32_t array_element) {
+  auto maybe_resource_declaration =
+      find_resource_declaration(resource_identifier);
+  AssertReturnUnless(maybe_resource_declaration.has_value());
+
+  std::lock_guard lock(m_update_after_bind_mutex);
+  auto* binding =
+      find_update_after_bind_binding(maybe_resource_declaration->get());
+  AssertReturnIf(binding == nullptr);
+  AssertReturnUnless(array_element < binding->m_capacity);
+
+  // The descriptor stays as it is, partially bound bindings tolerate stale
+  // descriptors as long as shaders don't access them
+  binding->m_released_elements.emplace_back(
+      array_element, layer_abstraction_factory::instance()
+                         .get_render_context()
+                         .mutable_swap_chain()
+                         .get_submitted_frames_count());
+}
+
+bool descriptor_set_manager::is_update_after_bind_supported(
+    VkDescriptorType descriptor_type) {
+  const auto& features = layer_abstraction_factory::instance()
+                             .get_vulkan_context()
+                             .mutable_physical_device()
+                             .get_device_info()
+                             .m_vulkan_12_features;
+  ReturnUnless(features.descriptorBindingPartiallyBound &&
+                   features.descriptorBindingUpdateUnusedWhilePending,
+               false);
+
+  switch (descriptor_type) {
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      return features.descriptorBindingSampledImageUpdateAfterBind;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      return features.descriptorBindingStorageBufferUpdateAfterBind;
+    default:
+      return false;
+  }
+}
+
+descriptor_set_manager::update_after_bind_binding*
+descriptor_set_manager::find_update_after_bind_binding(
+    const shader_resource::declaration::base& resource_declaration) {
+  auto binding_it = m_update_after_bind_bindings.find(
+      binding_key{resource_declaration.m_set, resource_declaration.m_binding});
+  ReturnIf(binding_it == m_update_after_bind_bindings.end(), nullptr);
+
+  return &binding_it->second;
+}
+
+bool descriptor_set_manager::write_resource(
+    const shader_resource::declaration::base& resource_declaration,
+    std::uint32_t array_element,
+    const shader_resource::instance::element& resource) {
+  AssertReturnUnless(resource_declaration.m_set < m_descriptor_sets.size(),
+                     false);
+
+  auto& binding = m_input_resources[resource_declaration.m_set]
+                      .m_bindings[resource_declaration.m_binding];
+  ReturnUnless(binding.replace_resource(array_element, resource), false);
+
+  vulkan_descriptor_binding written_binding;
+  written_binding.emplace_resource(resource);
+
+  write_descriptor_creator descriptor_creator;
+  VkWriteDescriptorSet write_descriptor =
+      std::visit(descriptor_creator, written_binding.m_resources);
+  write_descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write_descriptor.dstSet = m_descriptor_sets[resource_declaration.m_set];
+  write_descriptor.dstBinding = resource_declaration.m_binding;
+  write_descriptor.dstArrayElement = array_element;
+  write_descriptor.descriptorType = written_binding.m_descriptor_type;
+
+  auto* const device = layer_abstraction_factory::instance()
+                           .get_vulkan_context()
+                           .mutable_device()
+                           .get_vulkan_logical_device();
+  vkUpdateDescriptorSets(device, 1, &write_descriptor, 0, nullptr);
+
+  return true;
 }
 
 optional_const_ref<shader_resource::declaration::base>
@@ -151,8 +358,27 @@ descriptor_set_manager::create_descriptor_set_layout() {
   vector_map<vulkan_descriptor_set_identifier,
              std::vector<VkDescriptorSetLayoutBinding>>
       per_set_layout_bindings;
+  vector_map<vulkan_descriptor_set_identifier,
+             std::vector<VkDescriptorBindingFlags>>
+      per_set_binding_flags;
+
+  // Dynamic uniform buffers can't live in update after bind sets
+  std::unordered_set<vulkan_descriptor_set_identifier> dynamic_sets;
+  for (auto& [_, resource_declaration_variant] :
+       m_shader_reflection_data.m_shader_resources_declaration) {
+    ContinueUnless(std::holds_alternative<
+                   wunder::vulkan::shader_resource::declaration::uniform_buffer>(
+        resource_declaration_variant));
+
+    dynamic_sets.emplace(
+        std::visit(wunder::vulkan::shader_resource::declaration::downcast,
+                   resource_declaration_variant)
+            .m_set);
+  }
 
   auto layout_creator = descriptor_set_layout_creator(*this);
+  m_dynamic_bindings.clear();
+  m_update_after_bind_bindings.clear();
   for (auto& [_, resource_declaration_variant] :
        m_shader_reflection_data.m_shader_resources_declaration) {
     const wunder::vulkan::shader_resource::declaration::base&
@@ -161,20 +387,71 @@ descriptor_set_manager::create_descriptor_set_layout() {
                        resource_declaration_variant);
 
     auto& layout_bindings = per_set_layout_bindings[resource_declaration.m_set];
-    layout_bindings.emplace_back(
+    auto& binding_flags = per_set_binding_flags[resource_declaration.m_set];
+    auto& layout_binding = layout_bindings.emplace_back(
         std::visit(layout_creator, resource_declaration_variant));
+    auto& layout_binding_flags = binding_flags.emplace_back(0);
+
+    if (layout_binding.descriptorType ==
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+      m_dynamic_bindings.emplace_back(dynamic_binding{
+          .m_set = resource_declaration.m_set,
+          .m_binding = resource_declaration.m_binding,
+          .m_descriptors_count = layout_binding.descriptorCount});
+      continue;
+    }
+
+    ContinueIf(dynamic_sets.contains(resource_declaration.m_set));
+    ContinueUnless(
+        is_update_after_bind_supported(layout_binding.descriptorType));
+
+    // Runtime arrays reserve room for elements appended after the build
+    if (resource_declaration.Count == 0) {
+      layout_binding.descriptorCount =
+          std::max(layout_binding.descriptorCount, s_runtime_array_capacity);
+    }
+
+    layout_binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                           VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    m_update_after_bind_bindings[binding_key{resource_declaration.m_set,
+                                             resource_declaration.m_binding}]
+        .m_capacity = layout_binding.descriptorCount;
   }
 
+  std::ranges::sort(m_dynamic_bindings, [](const dynamic_binding& left,
+                                           const dynamic_binding& right) {
+    return std::tie(left.m_set, left.m_binding) <
+           std::tie(right.m_set, right.m_binding);
+  });
+
   auto& device = layer_abstraction_factory::instance()
                      .get_vulkan_context()
                      .mutable_device();
   VkDevice vulkan_logical_device = device.get_vulkan_logical_device();
 
   for (auto& [set_identifier, layout_bindings] : per_set_layout_bindings) {
+    auto& binding_flags = per_set_binding_flags[set_identifier];
+    const bool is_update_after_bind = std::ranges::any_of(
+        binding_flags, [](VkDescriptorBindingFlags flags) {
+          return (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
+        });
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info{};
+    binding_flags_create_info.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_create_info.bindingCount =
+        static_cast<uint32_t>(binding_flags.size());
+    binding_flags_create_info.pBindingFlags = binding_flags.data();
+
     VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
     descriptorLayout.sType =
         VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorLayout.pNext = nullptr;
+    descriptorLayout.pNext = &binding_flags_create_info;
+    descriptorLayout.flags =
+        is_update_after_bind
+            ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT
+            : 0;
     descriptorLayout.bindingCount = (uint32_t)(layout_bindings.size());
     descriptorLayout.pBindings = layout_bindings.data();
 
@@ -208,6 +485,9 @@ void descriptor_set_manager::create_descriptors_set() {
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  if (!m_update_after_bind_bindings.empty()) {
+    poolInfo.flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  }
   poolInfo.maxSets =
       10 * 3;  // frames in flight should partially determine this
   poolInfo.poolSizeCount = 10;
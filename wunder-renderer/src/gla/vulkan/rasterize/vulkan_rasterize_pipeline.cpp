@@ -5,6 +5,7 @@
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_physical_device.h"
+#include "gla/vulkan/vulkan_pipeline_cache.h"
 #include "gla/vulkan/vulkan_renderer_context.h"
 #include "resources/shaders/host_device.h"
 
@@ -56,6 +57,9 @@ void rasterize_pipeline::initialize_pipeline(
       m_shader_stage_create_infos.size());  // Stages are shaders
   m_pipeline_create_info.pStages = m_shader_stage_create_infos.data();
 
+  m_pipeline_cache = vulkan_context.mutable_pipeline_cache().get_or_load(
+      "rasterize", get_shaders_hash(shaders_of_types));
+
   vkCreateGraphicsPipelines(device.get_vulkan_logical_device(),
                             m_pipeline_cache, 1, &m_pipeline_create_info,
                             nullptr, &m_vulkan_pipeline);
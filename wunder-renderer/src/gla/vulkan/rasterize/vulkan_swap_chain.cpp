@@ -10,14 +10,22 @@
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_memory_allocator.h"
 #include "gla/vulkan/vulkan_physical_device.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
 #include "window/window_factory.h"
 
 namespace wunder::vulkan {
+namespace {
+// Double buffered, as a swap chain with a mailbox present mode would be
+constexpr uint32_t k_offscreen_image_count = 2;
+}  // namespace
+
 swap_chain::queue_element::queue_element() = default;
 
 swap_chain::queue_element::queue_element(queue_element&& other)
     : m_image(other.m_image),
+      m_image_allocation(other.m_image_allocation),
       m_image_view(other.m_image_view),
       m_command_buffer(other.m_command_buffer),
       m_barrier(other.m_barrier),
@@ -26,6 +34,7 @@ swap_chain::queue_element::queue_element(queue_element&& other)
 
 {
   other.m_image = VK_NULL_HANDLE;
+  other.m_image_allocation = VK_NULL_HANDLE;
   other.m_image_view = VK_NULL_HANDLE;
   other.m_command_buffer = VK_NULL_HANDLE;
   other.m_fence = VK_NULL_HANDLE;
@@ -60,6 +69,11 @@ swap_chain::queue_element::~queue_element() {
   // if (m_image != VK_NULL_HANDLE) {
   //   vkDestroyImage(vk_device, m_image, VK_NULL_HANDLE);
   // }
+
+  if (m_image_allocation != VK_NULL_HANDLE) {
+    vulkan_context.mutable_resource_allocator().destroy_image(
+        m_image, m_image_allocation);
+  }
 }
 
 swap_chain::swap_chain(std::uint32_t width, std::uint32_t height)
@@ -67,6 +81,7 @@ swap_chain::swap_chain(std::uint32_t width, std::uint32_t height)
       m_width(width),
       m_height(height),
       m_current_queue_element{},
+      m_submitted_frames_count{0},
       m_queue_elements{},
       m_surface(VK_NULL_HANDLE),
       m_swap_chain(VK_NULL_HANDLE),
@@ -135,6 +150,12 @@ void swap_chain::shutdown() {
 }
 
 std::optional<std::uint32_t> swap_chain::acquire() {
+  if (is_offscreen()) {
+    m_current_queue_element %= static_cast<uint32_t>(m_queue_elements.size());
+    wait_element_to_rendered(m_current_queue_element);
+    return m_current_queue_element;
+  }
+
   context& vulkan_context =
       layer_abstraction_factory::instance().get_vulkan_context();
   auto& device = vulkan_context.mutable_device();
@@ -195,38 +216,105 @@ void swap_chain::flush_current_command_buffer() {
   bool m_use_nv_link = false;
   // In case of using NVLINK
   const uint32_t deviceMask = m_use_nv_link ? 0b0000'0011 : 0b0000'0001;
-  const std::array<uint32_t, 2> deviceIndex = {0, 1};
+  const std::array<uint32_t, 2> deviceMasks = {deviceMask, deviceMask};
+  const std::array<uint32_t, 2> deviceIndex = {0, 0};
+
+  // Besides the acquired image, wait on the GPU for uploads which weren't
+  // executed yet and acquire their ownership before the frame commands
+  const auto submit = [this, &queue_element, &deviceMasks, &deviceIndex](
+                          VkQueue queue,
+                          const upload_manager::submit_dependencies&
+                              uploadDependencies) {
+    const bool hasUploadWait =
+        uploadDependencies.m_wait_semaphore != VK_NULL_HANDLE;
+    const bool hasAcquire =
+        uploadDependencies.m_acquire_command_buffer != VK_NULL_HANDLE;
+
+    // Offscreen images are neither acquired nor presented, so the binary
+    // semaphores at the front of the lists are skipped
+    const uint32_t firstSemaphore = is_offscreen() ? 1u : 0u;
+
+    const std::array<VkSemaphore, 2> waitSemaphores = {
+        queue_element.m_semaphore_entry.read_semaphore,
+        uploadDependencies.m_wait_semaphore};
+    const std::array<uint64_t, 2> waitSemaphoreValues = {
+        0, uploadDependencies.m_wait_value};
+    const uint32_t waitSemaphoreCount =
+        (hasUploadWait ? 2u : 1u) - firstSemaphore;
+
+    const std::array<VkSemaphore, 2> signalSemaphores = {
+        queue_element.m_semaphore_entry.written_semaphore,
+        uploadDependencies.m_signal_semaphore};
+    const std::array<uint64_t, 2> signalSemaphoreValues = {
+        0, uploadDependencies.m_signal_value};
+    const uint32_t signalSemaphoreCount =
+        (hasAcquire ? 2u : 1u) - firstSemaphore;
+
+    // Acquire barriers go first, frame commands follow
+    std::vector<VkCommandBuffer> commandBuffers;
+    if (hasAcquire) {
+      commandBuffers.push_back(uploadDependencies.m_acquire_command_buffer);
+    }
+    commandBuffers.push_back(queue_element.m_command_buffer);
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .waitSemaphoreValueCount = waitSemaphoreCount,
+        .pWaitSemaphoreValues = waitSemaphoreValues.data() + firstSemaphore,
+        .signalSemaphoreValueCount = signalSemaphoreCount,
+        .pSignalSemaphoreValues = signalSemaphoreValues.data() + firstSemaphore,
+    };
 
-  VkDeviceGroupSubmitInfo deviceGroupSubmitInfo{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO_KHR,
-      .pNext = VK_NULL_HANDLE,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphoreDeviceIndices = deviceIndex.data(),
-      .commandBufferCount = 1,
-      .pCommandBufferDeviceMasks = &deviceMask,
-      .signalSemaphoreCount = m_use_nv_link ? 2u : 1u,
-      .pSignalSemaphoreDeviceIndices = deviceIndex.data(),
-  };
+    VkDeviceGroupSubmitInfo deviceGroupSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO_KHR,
+        .pNext = &timelineSubmitInfo,
+        .waitSemaphoreCount = waitSemaphoreCount,
+        .pWaitSemaphoreDeviceIndices = deviceIndex.data(),
+        .commandBufferCount = static_cast<uint32_t>(commandBuffers.size()),
+        .pCommandBufferDeviceMasks = deviceMasks.data(),
+        .signalSemaphoreCount = signalSemaphoreCount,
+        .pSignalSemaphoreDeviceIndices = deviceIndex.data(),
+    };
 
-  // Pipeline stage at which the queue submission will wait (via
-  // pWaitSemaphores)
-  const VkPipelineStageFlags waitStageMask =
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  // The submit info structure specifies a command buffer queue submission batch
-  VkSubmitInfo submitInfo{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .pNext = &deviceGroupSubmitInfo,
-      .waitSemaphoreCount = 1,  // One wait semaphore
-      .pWaitSemaphores = &queue_element.m_semaphore_entry.read_semaphore,
-      .pWaitDstStageMask = &waitStageMask,
-      .commandBufferCount = 1,  // One command buffer
-      .pCommandBuffers = &queue_element.m_command_buffer,
-      .signalSemaphoreCount = 1,  // One signal semaphore
-      .pSignalSemaphores = &queue_element.m_semaphore_entry.written_semaphore,
+    // Pipeline stage at which the queue submission will wait (via
+    // pWaitSemaphores)
+    const std::array<VkPipelineStageFlags, 2> waitStageMask = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+    // The submit info structure specifies a command buffer queue submission
+    // batch
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &deviceGroupSubmitInfo,
+        .waitSemaphoreCount = waitSemaphoreCount,
+        .pWaitSemaphores = waitSemaphores.data() + firstSemaphore,
+        .pWaitDstStageMask = waitStageMask.data() + firstSemaphore,
+        .commandBufferCount = static_cast<uint32_t>(commandBuffers.size()),
+        .pCommandBuffers = commandBuffers.data(),
+        .signalSemaphoreCount = signalSemaphoreCount,
+        .pSignalSemaphores = signalSemaphores.data() + firstSemaphore,
+    };
+
+    // Submit to the graphics queue passing a wait fence
+    return vkQueueSubmit(queue, 1, &submitInfo, queue_element.m_fence);
   };
 
-  // Submit to the graphics queue passing a wait fence
-  vkQueueSubmit(device_queue, 1, &submitInfo, queue_element.m_fence);
+  // The upload manager locks the queue, it is shared with the scene loading
+  // thread
+  VK_CHECK_RESULT(vulkan_context.mutable_upload_manager()
+                      .submit_with_dependencies(
+                          static_cast<uint32_t>(
+                              vulkan_context.mutable_physical_device()
+                                  .get_queue_family_indices()
+                                  .Graphics),
+                          device_queue, submit));
+  ++m_submitted_frames_count;
+
+  if (is_offscreen()) {
+    ++m_current_queue_element;
+    return;
+  }
 
   VkPresentInfoKHR present_info{
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -239,7 +327,10 @@ void swap_chain::flush_current_command_buffer() {
       .pResults = VK_NULL_HANDLE,
   };
 
-  VK_CHECK_RESULT(vkQueuePresentKHR(device_queue, &present_info));
+  {
+    std::lock_guard queue_lock(device.mutable_queue_mutex(device_queue));
+    VK_CHECK_RESULT(vkQueuePresentKHR(device_queue, &present_info));
+  }
 
   ++m_current_queue_element;
 }
@@ -255,6 +346,8 @@ void swap_chain::initialize_swap_chain() {
   VkSwapchainKHR old_swap_chain = m_swap_chain;
 
   m_surface = window_factory::instance().get_window().create_vulkan_surface();
+  // Headless, the queue elements allocate their images themselves
+  ReturnIf(is_offscreen());
 
   uint32_t surface_format_count;
   VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceFormatsKHR(
@@ -494,9 +587,11 @@ void swap_chain::initialize_queue_elements() {
   auto& device = vulkan_context.mutable_device();
   auto vk_device = device.get_vulkan_logical_device();
 
-  uint32_t image_count = 0;
-  VK_CHECK_RESULT(
-      vkGetSwapchainImagesKHR(vk_device, m_swap_chain, &image_count, nullptr));
+  uint32_t image_count = k_offscreen_image_count;
+  if (!is_offscreen()) {
+    VK_CHECK_RESULT(vkGetSwapchainImagesKHR(vk_device, m_swap_chain,
+                                            &image_count, nullptr));
+  }
 
   m_queue_elements.resize(image_count);
 
@@ -517,10 +612,16 @@ void swap_chain::create_image_for_each_queue_element() {
 
   auto image_count = static_cast<uint32_t>(m_queue_elements.size());
 
-  // Get the swap chain images
+  // Get the swap chain images, or allocate them when there's no swap chain
   std::vector<VkImage> images(image_count);
-  VK_CHECK_RESULT(vkGetSwapchainImagesKHR(vk_device, m_swap_chain, &image_count,
-                                          images.data()));
+  if (is_offscreen()) {
+    for (uint32_t i = 0; i < image_count; i++) {
+      images[i] = allocate_offscreen_image(m_queue_elements[i]);
+    }
+  } else {
+    VK_CHECK_RESULT(vkGetSwapchainImagesKHR(vk_device, m_swap_chain,
+                                            &image_count, images.data()));
+  }
 
   // Get the swap chain buffers containing the image and imageview
   for (uint32_t i = 0; i < image_count; i++) {
@@ -557,6 +658,32 @@ void swap_chain::create_image_for_each_queue_element() {
   }
 }
 
+VkImage swap_chain::allocate_offscreen_image(queue_element& element) const {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+
+  // Same usage as the swap chain images request
+  VkImageCreateInfo image_create_info{};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = m_colour_format;
+  image_create_info.extent = VkExtent3D{m_width, m_height, 1};
+  image_create_info.mipLevels = 1;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  element.m_image_allocation = allocator.allocate_image(
+      image_create_info, VMA_MEMORY_USAGE_GPU_ONLY, element.m_image);
+  return element.m_image;
+}
+
 void swap_chain::create_image_barrier_for_each_queue_element() {
   for (auto& queue_element : m_queue_elements) {
     VkImageSubresourceRange range = {};
@@ -666,12 +793,10 @@ void swap_chain::update_barriers() const {
 }
 
 void swap_chain::wait_idle() const {
-  context& vulkan_context =
-      layer_abstraction_factory::instance().get_vulkan_context();
-  auto& device = vulkan_context.mutable_device();
-  auto vk_device = device.get_vulkan_logical_device();
-
-  VK_CHECK_RESULT(vkDeviceWaitIdle(vk_device));
+  layer_abstraction_factory::instance()
+      .get_vulkan_context()
+      .mutable_device()
+      .wait_idle();
 }
 
 void swap_chain::wait_element_to_rendered(size_t element_idx) {
@@ -27,7 +27,7 @@ acceleration_structure_builder<build_info_type>::~acceleration_structure_builder
 
 template <derived<acceleration_structure_build_info> build_info_type>
 void acceleration_structure_builder<build_info_type>::create_scratch_buffer(
-    std::uint32_t scratch_buffer_size) {
+    VkDeviceSize scratch_buffer_size) {
   m_scratch_buffer.reset(new storage_device_buffer(
       descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""}, scratch_buffer_size,
       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
@@ -41,9 +41,19 @@ void acceleration_structure_builder<build_info_type>::
             as_build_offset_info,
         std::vector<VkAccelerationStructureBuildGeometryInfoKHR>&
             as_build_geometry_info) {
-  auto& build_infos = get_build_infos();
+  build_acceleration_structure(
+      std::span<const build_info_type>(get_build_infos()),
+      as_build_offset_info, as_build_geometry_info);
+}
 
-  ;
+template <derived<acceleration_structure_build_info> build_info_type>
+void acceleration_structure_builder<build_info_type>::
+    build_acceleration_structure(
+        std::span<const build_info_type> build_infos,
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>&
+            as_build_offset_info,
+        std::vector<VkAccelerationStructureBuildGeometryInfoKHR>&
+            as_build_geometry_info) {
   as_build_offset_info.reserve(build_infos.size());
   std::transform(build_infos.begin(), build_infos.end(),
                  std::back_insert_iterator(as_build_offset_info),
@@ -51,7 +61,6 @@ void acceleration_structure_builder<build_info_type>::
                    return build_info.get_vulkan_as_build_offset_info().data();
                  });
 
-  ;
   as_build_geometry_info.reserve(build_infos.size());
   std::transform(build_infos.begin(), build_infos.end(),
                  std::back_insert_iterator(as_build_geometry_info),
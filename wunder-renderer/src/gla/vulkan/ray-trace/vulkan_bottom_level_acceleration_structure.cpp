@@ -15,4 +15,10 @@ void bottom_level_acceleration_structure::create(
         build_info.get_vulkan_as_build_sizes_info().accelerationStructureSize);
 
 }
+
+void bottom_level_acceleration_structure::create_compacted(
+    VkDeviceSize compacted_size) {
+  create_acceleration_structure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+                                compacted_size);
+}
 }  // namespace wunder::vulkan
\ No newline at end of file
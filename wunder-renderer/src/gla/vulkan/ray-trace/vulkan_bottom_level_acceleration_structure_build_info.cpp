@@ -4,11 +4,13 @@
 #include <glad/vulkan.h>
 
 #include <cstring>
+#include <utility>
 
 #include "gla/vulkan/scene/vulkan_mesh.h"
 #include "gla/vulkan/vulkan_buffer.h"
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_geometry_arena.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "include/assets/mesh_asset.h"
 #include "resources/shaders/host_device.h"
@@ -16,17 +18,29 @@
 namespace wunder::vulkan {
 bottom_level_acceleration_structure_build_info::
     bottom_level_acceleration_structure_build_info(
-        const vulkan_mesh& vulkan_mesh) {
-  AssertReturnUnless(vulkan_mesh.m_vertex_buffer);
-  AssertReturnUnless(vulkan_mesh.m_index_buffer);
+        const vulkan_mesh& vulkan_mesh,
+        VkBuildAccelerationStructureFlagsKHR build_flags) {
+  AssertReturnUnless(vulkan_mesh.m_vertices.is_valid());
+  AssertReturnUnless(vulkan_mesh.m_indices.is_valid());
+
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
 
   clear_geometry_data();
-  create_geometry_data(vulkan_mesh.m_vertices_count,
-                       *vulkan_mesh.m_vertex_buffer,
-                       *vulkan_mesh.m_index_buffer);
+  create_geometry_data(
+      vulkan_mesh.m_vertices_count,
+      vulkan_context.mutable_vertex_arena().get_address(vulkan_mesh.m_vertices),
+      vulkan_context.mutable_index_arena().get_address(vulkan_mesh.m_indices));
+
+  // Opaque meshes never invoke any-hit, whatever the instance flags are
+  if (vulkan_mesh.m_is_opaque) {
+    m_as_geometry.flags |= VK_GEOMETRY_OPAQUE_BIT_KHR;
+  }
 
-  std::uint32_t build_flags =
-      VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+  if (vulkan_mesh.m_opacity_micromap.is_valid()) {
+    m_opacity_micromap = vulkan_mesh.m_opacity_micromap.get_geometry_info();
+    link_opacity_micromap();
+  }
 
   /**
    * Offset data, this will indicate to the GPU where it could find vertex
@@ -38,15 +52,42 @@ bottom_level_acceleration_structure_build_info::
   calculate_build_size();
 }
 
+bottom_level_acceleration_structure_build_info::
+    bottom_level_acceleration_structure_build_info(
+        bottom_level_acceleration_structure_build_info&& other) noexcept
+    : acceleration_structure_build_info(std::move(other)),
+      m_opacity_micromap(other.m_opacity_micromap) {
+  link_opacity_micromap();
+}
+
+bottom_level_acceleration_structure_build_info&
+bottom_level_acceleration_structure_build_info::operator=(
+    bottom_level_acceleration_structure_build_info&& other) noexcept {
+  acceleration_structure_build_info::operator=(std::move(other));
+  std::swap(m_opacity_micromap, other.m_opacity_micromap);
+
+  link_opacity_micromap();
+  other.link_opacity_micromap();
+
+  return *this;
+}
+
+void bottom_level_acceleration_structure_build_info::link_opacity_micromap() {
+  // The geometry is copied around with the build info, the chain is not
+  m_as_geometry.geometry.triangles.pNext =
+      m_opacity_micromap.sType ==
+              VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_TRIANGLES_OPACITY_MICROMAP_EXT
+          ? &m_opacity_micromap
+          : nullptr;
+}
+
 /**
  * We're covering only triangle meshes for the moment.
  * TODO:: implement procedural geometries, such as spheres
  */
 void bottom_level_acceleration_structure_build_info::create_geometry_data(
-    std::uint32_t vertices_count, const storage_buffer& vertex_buffer,
-    const storage_buffer& index_buffer) {  // Building part
-  VkDeviceAddress vertexAddress = vertex_buffer.get_address();
-  VkDeviceAddress indexAddress = index_buffer.get_address();
+    std::uint32_t vertices_count, VkDeviceAddress vertexAddress,
+    VkDeviceAddress indexAddress) {  // Building part
   // triangles.transformData = ({});
 
   // Setting up the build info of the acceleration
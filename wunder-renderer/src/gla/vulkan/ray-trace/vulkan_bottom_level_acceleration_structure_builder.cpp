@@ -1,8 +1,14 @@
 
 #include "gla/vulkan/ray-trace/vulkan_bottom_level_acceleration_structure_builder.h"
 
-#include <numeric>
+#include <algorithm>
+#include <deque>
+#include <ranges>
+#include <span>
+#include <tuple>
 
+#include "event/event_controller.h"
+#include "event/vulkan_events.h"
 #include "gla/vulkan/scene/vulkan_mesh.h"
 #include "gla/vulkan/scene/vulkan_mesh_scene_node.h"
 #include "gla/vulkan/vulkan_buffer.h"
@@ -10,72 +16,274 @@
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_physical_device.h"
 
 namespace wunder::vulkan {
 
 bottom_level_acceleration_structure_builder::
     bottom_level_acceleration_structure_builder(
-        std::vector<vulkan_mesh_scene_node>& mesh_nodes)
-    : acceleration_structure_builder(layer_abstraction_factory::instance()
-                                         .get_vulkan_context()
-                                         .mutable_command_pool()
-                                         .get_current_compute_command_buffer()),
+        std::vector<vulkan_mesh_scene_node>& mesh_nodes, bool allow_compaction,
+        VkDeviceSize scratch_budget)
+    : acceleration_structure_builder(VK_NULL_HANDLE),
       m_mesh_nodes(mesh_nodes),
-      m_min_alignment(128) {}
+      m_min_alignment(128),
+      m_allow_compaction(allow_compaction),
+      m_scratch_budget(scratch_budget) {}
 
 void bottom_level_acceleration_structure_builder::build() {
-  for (auto& [vulkan_mesh, _] : m_mesh_nodes) {
-    m_build_infos.emplace_back(*vulkan_mesh);
-  }
+  collect_meshes();
+  ReturnIf(m_meshes.empty());
 
-  std::int32_t scratch_buffer_size = 0;
+  m_build_infos.reserve(m_meshes.size());
+  for (std::size_t i = 0; i < m_meshes.size(); ++i) {
+    m_build_infos.emplace_back(*m_meshes[i], get_build_flags(m_policies[i]));
+  }
 
-  scratch_buffer_size = std::accumulate(
-      m_build_infos.begin(), m_build_infos.end(), scratch_buffer_size,
-      [min_alignment = m_min_alignment](
-          std::uint32_t current_accumulation,
-          const acceleration_structure_build_info& right) {
-        return current_accumulation +
-               align_up(right.get_vulkan_as_build_sizes_info().buildScratchSize,
-                        min_alignment);
-      });
+  split_in_batches();
 
-  create_scratch_buffer(scratch_buffer_size);
-  build_info_set_scratch_buffer();
+  const auto largest_batch = std::ranges::max_element(
+      m_batches, {},
+      [](const batch& build_batch) { return build_batch.m_scratch_size; });
+  create_scratch_buffer(largest_batch->m_scratch_size);
   create_acceleration_structures();
+  create_query_pools();
 
-  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>
-      as_build_offset_info;
-  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>
-      as_build_geometry_info;
-  build_acceleration_structure(as_build_offset_info, as_build_geometry_info);
+  auto& compute_command_pool = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_command_pool();
 
-  flush_commands();
+  // The next batch is recorded while the previous one builds, more batches in
+  // flight wouldn't shorten the build as they share the scratch buffer
+  static constexpr std::size_t k_max_batches_in_flight = 2;
+  std::deque<std::pair<std::size_t, command_pool::submit_ticket>>
+      batches_in_flight;
+  auto wait_oldest_batch = [&]() {
+    auto [batch_idx, ticket] = batches_in_flight.front();
+    batches_in_flight.pop_front();
+
+    compute_command_pool.wait(ticket);
+    WUNDER_INFO_TAG("Renderer",
+                    "Bottom level acceleration structures batch {0}/{1} built, "
+                    "{2} structures",
+                    batch_idx + 1, m_batches.size(),
+                    m_batches[batch_idx].m_count);
+  };
+
+  for (std::size_t batch_idx = 0; batch_idx < m_batches.size(); ++batch_idx) {
+    if (batches_in_flight.size() == k_max_batches_in_flight) {
+      wait_oldest_batch();
+    }
+
+    m_command_buffer = compute_command_pool.get_current_compute_command_buffer();
+    record_batch(batch_idx);
+    batches_in_flight.emplace_back(
+        batch_idx, compute_command_pool.submit_compute_command_buffer());
+  }
+
+  while (!batches_in_flight.empty()) {
+    wait_oldest_batch();
+  }
+  m_scratch_buffer.reset();
+
+  read_build_times();
+  compact_acceleration_structures();
+  destroy_query_pools();
+
+  report_statistics();
+}
+
+void bottom_level_acceleration_structure_builder::collect_meshes() {
+  m_meshes.reserve(m_mesh_nodes.size());
+  for (auto& [mesh_instance_ptr, _] : m_mesh_nodes) {
+    AssertContinueUnless(mesh_instance_ptr);
+    m_meshes.emplace_back(mesh_instance_ptr.get());
+  }
+
+  std::ranges::sort(m_meshes);
+  auto duplicates = std::ranges::unique(m_meshes);
+  m_meshes.erase(duplicates.begin(), duplicates.end());
+
+  // Meshes of the same policy are next to each other, so they end up in the
+  // same batches
+  std::ranges::sort(m_meshes, {}, [this](const vulkan_mesh* mesh) {
+    return std::make_tuple(resolve_build_policy(*mesh), mesh->m_idx);
+  });
+
+  m_policies.clear();
+  m_policies.reserve(m_meshes.size());
+  for (const vulkan_mesh* mesh : m_meshes) {
+    m_policies.emplace_back(resolve_build_policy(*mesh));
+  }
+}
+
+acceleration_structure_build_policy
+bottom_level_acceleration_structure_builder::resolve_build_policy(
+    const vulkan_mesh& mesh) const {
+  ReturnIf(mesh.m_build_policy != acceleration_structure_build_policy::automatic,
+           mesh.m_build_policy);
+
+  const std::uint32_t triangles_count = mesh.m_indices_count / 3;
+  ReturnIf(triangles_count < k_small_mesh_triangles,
+           acceleration_structure_build_policy::fast_trace);
+  ReturnIf(triangles_count >= k_large_mesh_triangles,
+           acceleration_structure_build_policy::low_memory);
+
+  return m_allow_compaction ? acceleration_structure_build_policy::allow_compaction
+                            : acceleration_structure_build_policy::fast_trace;
+}
+
+VkBuildAccelerationStructureFlagsKHR
+bottom_level_acceleration_structure_builder::get_build_flags(
+    acceleration_structure_build_policy policy) const {
+  VkBuildAccelerationStructureFlagsKHR build_flags = 0;
+  switch (policy) {
+    case acceleration_structure_build_policy::fast_build:
+      build_flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+      break;
+    case acceleration_structure_build_policy::allow_update:
+      // Deforming meshes are refit often, a quick build matters more than the
+      // quality a refit doesn't keep anyway
+      build_flags = VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR |
+                    VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+      break;
+    case acceleration_structure_build_policy::allow_compaction:
+      build_flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+                    VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+      break;
+    case acceleration_structure_build_policy::low_memory:
+      build_flags = VK_BUILD_ACCELERATION_STRUCTURE_LOW_MEMORY_BIT_KHR |
+                    VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+      break;
+    case acceleration_structure_build_policy::automatic:
+    case acceleration_structure_build_policy::fast_trace:
+    case acceleration_structure_build_policy::count:
+      build_flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+      break;
+  }
+
+  if (!m_allow_compaction) {
+    build_flags &= ~static_cast<VkBuildAccelerationStructureFlagsKHR>(
+        VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+  }
+
+  return build_flags;
+}
+
+bool bottom_level_acceleration_structure_builder::is_compactable(
+    std::size_t structure_idx) const {
+  AssertReturnUnless(structure_idx < m_build_infos.size(), false);
+
+  return (m_build_infos[structure_idx].get_build_info().flags &
+          VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) != 0;
+}
+
+void bottom_level_acceleration_structure_builder::split_in_batches() {
+  m_batches.clear();
+
+  batch current_batch;
+  current_batch.m_policy = m_policies.front();
+  for (std::size_t i = 0; i < m_build_infos.size(); ++i) {
+    const auto& build_sizes = m_build_infos[i].get_vulkan_as_build_sizes_info();
+    const VkDeviceSize scratch_size =
+        align_up(build_sizes.buildScratchSize, m_min_alignment);
+
+    if (current_batch.m_count > 0 &&
+        (current_batch.m_policy != m_policies[i] ||
+         current_batch.m_scratch_size + scratch_size > m_scratch_budget)) {
+      m_batches.emplace_back(current_batch);
+      current_batch = batch{};
+      current_batch.m_first = i;
+      current_batch.m_policy = m_policies[i];
+    }
+
+    ++current_batch.m_count;
+    current_batch.m_scratch_size += scratch_size;
+
+    auto& statistics = m_statistics[static_cast<std::size_t>(m_policies[i])];
+    ++statistics.m_structures_count;
+    statistics.m_build_size += build_sizes.accelerationStructureSize;
+    statistics.m_compacted_size += build_sizes.accelerationStructureSize;
+  }
+  m_batches.emplace_back(current_batch);
+
+  WUNDER_INFO_TAG("Renderer",
+                  "Building {0} bottom level acceleration structures in {1} "
+                  "batches, scratch budget {2} bytes",
+                  m_build_infos.size(), m_batches.size(), m_scratch_budget);
 }
 
 void bottom_level_acceleration_structure_builder::
-    build_info_set_scratch_buffer() {
-  std::uint32_t scratch_buffer_offset = 0;
-  for (auto& build_info : m_build_infos) {
+    build_info_set_scratch_buffer(const batch& build_batch) {
+  // Every batch starts from the beginning of the shared scratch buffer
+  VkDeviceSize scratch_buffer_offset = 0;
+  const std::size_t batch_end = build_batch.m_first + build_batch.m_count;
+  for (std::size_t i = build_batch.m_first; i < batch_end; ++i) {
+    auto& build_info = m_build_infos[i];
     auto& vk_acceleration_structure_build_geometry_info_khr =
         build_info.mutable_build_info();
     vk_acceleration_structure_build_geometry_info_khr.scratchData
         .deviceAddress =
         m_scratch_buffer->get_address() + scratch_buffer_offset;
 
-    scratch_buffer_offset += static_cast<uint32_t>(align_up(
-        build_info.get_vulkan_as_build_sizes_info().buildScratchSize, 128));
+    scratch_buffer_offset += align_up(
+        build_info.get_vulkan_as_build_sizes_info().buildScratchSize,
+        m_min_alignment);
   }
 }
 
+void bottom_level_acceleration_structure_builder::record_batch(
+    std::size_t batch_idx) {
+  const batch& build_batch = m_batches[batch_idx];
+  const auto first_timestamp = static_cast<std::uint32_t>(batch_idx * 2);
+
+  if (m_timestamp_query_pool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(m_command_buffer, m_timestamp_query_pool,
+                        first_timestamp, 2);
+    vkCmdWriteTimestamp(m_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        m_timestamp_query_pool, first_timestamp);
+  }
+
+  if (batch_idx > 0) {
+    // The previous batch is still using the scratch buffer on the same queue
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                            VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                            VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(m_command_buffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  build_info_set_scratch_buffer(build_batch);
+
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>
+      as_build_offset_info;
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>
+      as_build_geometry_info;
+  build_acceleration_structure(
+      std::span<const bottom_level_acceleration_structure_build_info>(
+          m_build_infos.data() + build_batch.m_first, build_batch.m_count),
+      as_build_offset_info, as_build_geometry_info);
+
+  if (m_timestamp_query_pool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(m_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        m_timestamp_query_pool, first_timestamp + 1);
+  }
+
+  write_compacted_sizes(build_batch);
+}
+
 void bottom_level_acceleration_structure_builder::
     create_acceleration_structures() {
-  for (auto& [mesh_instance_ptr, _] : m_mesh_nodes) {
-    AssertContinueUnless(mesh_instance_ptr);
-    vulkan_mesh& mesh_instance = *mesh_instance_ptr;
+  AssertReturnUnless(m_build_infos.size() == m_meshes.size());
 
-    AssertContinueUnless(m_build_infos.size() > mesh_instance.m_idx);
-    auto& build_info = m_build_infos[mesh_instance.m_idx];
+  for (std::size_t i = 0; i < m_meshes.size(); ++i) {
+    vulkan_mesh& mesh_instance = *m_meshes[i];
+    auto& build_info = m_build_infos[i];
 
     mesh_instance.m_blas.create(build_info);
 
@@ -88,4 +296,231 @@ void bottom_level_acceleration_structure_builder::flush_commands() {
   auto& context = layer_abstraction_factory::instance().get_vulkan_context();
   context.mutable_command_pool().flush_compute_command_buffer();
 }
-}  // namespace wunder::vulkan
\ No newline at end of file
+
+void bottom_level_acceleration_structure_builder::create_query_pools() {
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  VkQueryPoolCreateInfo query_pool_create_info{};
+  query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+
+  if (vulkan_context.mutable_physical_device()
+          .get_limits()
+          .timestampComputeAndGraphics) {
+    query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_create_info.queryCount =
+        static_cast<std::uint32_t>(m_batches.size() * 2);
+    VK_CHECK_RESULT(vkCreateQueryPool(vulkan_logical_device,
+                                      &query_pool_create_info, nullptr,
+                                      &m_timestamp_query_pool));
+    set_debug_utils_object_name(
+        vulkan_logical_device, VK_OBJECT_TYPE_QUERY_POOL,
+        "blas build timestamp query pool", m_timestamp_query_pool);
+  }
+
+  // Queries of structures which aren't compacted are never written
+  const bool has_compactable_structures = std::ranges::any_of(
+      std::views::iota(std::size_t{0}, m_build_infos.size()),
+      [this](std::size_t i) { return is_compactable(i); });
+  ReturnUnless(has_compactable_structures);
+
+  query_pool_create_info.queryType =
+      VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+  query_pool_create_info.queryCount =
+      static_cast<std::uint32_t>(m_meshes.size());
+  VK_CHECK_RESULT(vkCreateQueryPool(vulkan_logical_device,
+                                    &query_pool_create_info, nullptr,
+                                    &m_compacted_size_query_pool));
+  set_debug_utils_object_name(vulkan_logical_device, VK_OBJECT_TYPE_QUERY_POOL,
+                              "blas compacted size query pool",
+                              m_compacted_size_query_pool);
+}
+
+void bottom_level_acceleration_structure_builder::destroy_query_pools() {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  if (m_timestamp_query_pool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(vulkan_logical_device, m_timestamp_query_pool, nullptr);
+    m_timestamp_query_pool = VK_NULL_HANDLE;
+  }
+
+  if (m_compacted_size_query_pool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(vulkan_logical_device, m_compacted_size_query_pool,
+                       nullptr);
+    m_compacted_size_query_pool = VK_NULL_HANDLE;
+  }
+}
+
+void bottom_level_acceleration_structure_builder::write_compacted_sizes(
+    const batch& build_batch) {
+  ReturnIf(m_compacted_size_query_pool == VK_NULL_HANDLE);
+
+  vkCmdResetQueryPool(m_command_buffer, m_compacted_size_query_pool,
+                      static_cast<std::uint32_t>(build_batch.m_first),
+                      static_cast<std::uint32_t>(build_batch.m_count));
+
+  // The build barrier makes the structures visible to the query as well
+  const std::size_t batch_end = build_batch.m_first + build_batch.m_count;
+  for (std::size_t i = build_batch.m_first; i < batch_end; ++i) {
+    ContinueUnless(is_compactable(i));
+
+    vkCmdWriteAccelerationStructuresPropertiesKHR(
+        m_command_buffer, 1, &m_meshes[i]->m_blas.m_descriptor,
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+        m_compacted_size_query_pool, static_cast<std::uint32_t>(i));
+  }
+}
+
+void bottom_level_acceleration_structure_builder::read_build_times() {
+  ReturnIf(m_timestamp_query_pool == VK_NULL_HANDLE);
+
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  const double timestamp_period_ns = vulkan_context.mutable_physical_device()
+                                         .get_limits()
+                                         .timestampPeriod;
+
+  std::vector<std::uint64_t> timestamps(m_batches.size() * 2, 0);
+  AssertReturnIf(
+      vkGetQueryPoolResults(
+          vulkan_context.mutable_device().get_vulkan_logical_device(),
+          m_timestamp_query_pool, 0,
+          static_cast<std::uint32_t>(timestamps.size()),
+          timestamps.size() * sizeof(std::uint64_t), timestamps.data(),
+          sizeof(std::uint64_t),
+          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+      VkResult::VK_SUCCESS);
+
+  for (std::size_t batch_idx = 0; batch_idx < m_batches.size(); ++batch_idx) {
+    const std::uint64_t begin = timestamps[batch_idx * 2];
+    const std::uint64_t end = timestamps[batch_idx * 2 + 1];
+    ContinueIf(end < begin);
+
+    m_statistics[static_cast<std::size_t>(m_batches[batch_idx].m_policy)]
+        .m_build_time_ms +=
+        static_cast<double>(end - begin) * timestamp_period_ns * 1e-6;
+  }
+}
+
+void bottom_level_acceleration_structure_builder::
+    compact_acceleration_structures() {
+  ReturnIf(m_compacted_size_query_pool == VK_NULL_HANDLE);
+
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  // The originals are read by the copies, they're kept alive until the
+  // commands complete and are freed when swapped out of the meshes
+  std::vector<bottom_level_acceleration_structure> compacted_structures(
+      m_meshes.size());
+  VkCommandBuffer command_buffer =
+      vulkan_context.mutable_command_pool().get_current_compute_command_buffer();
+
+  VkDeviceSize original_size = 0;
+  VkDeviceSize compacted_size = 0;
+  std::uint32_t compacted_count = 0;
+  for (std::size_t i = 0; i < m_meshes.size(); ++i) {
+    ContinueUnless(is_compactable(i));
+
+    // Unwritten queries never become available, each one is read on its own
+    VkDeviceSize structure_compacted_size = 0;
+    AssertContinueIf(
+        vkGetQueryPoolResults(vulkan_logical_device,
+                              m_compacted_size_query_pool,
+                              static_cast<std::uint32_t>(i), 1,
+                              sizeof(VkDeviceSize), &structure_compacted_size,
+                              sizeof(VkDeviceSize),
+                              VK_QUERY_RESULT_64_BIT |
+                                  VK_QUERY_RESULT_WAIT_BIT) !=
+        VkResult::VK_SUCCESS);
+
+    const VkDeviceSize build_size =
+        m_build_infos[i].get_vulkan_as_build_sizes_info()
+            .accelerationStructureSize;
+    original_size += build_size;
+
+    // Nothing to gain, the structure stays as it is
+    if (structure_compacted_size == 0 ||
+        structure_compacted_size >= build_size) {
+      compacted_size += build_size;
+      continue;
+    }
+    compacted_size += structure_compacted_size;
+    ++compacted_count;
+
+    auto& statistics = m_statistics[static_cast<std::size_t>(m_policies[i])];
+    statistics.m_compacted_size -= build_size - structure_compacted_size;
+
+    auto& compacted_structure = compacted_structures[i];
+    compacted_structure.create_compacted(structure_compacted_size);
+
+    VkCopyAccelerationStructureInfoKHR copy_info{};
+    copy_info.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+    copy_info.src = m_meshes[i]->m_blas.m_descriptor;
+    copy_info.dst = compacted_structure.m_descriptor;
+    copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+    vkCmdCopyAccelerationStructureKHR(command_buffer, &copy_info);
+  }
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  flush_commands();
+
+  for (std::size_t i = 0; i < m_meshes.size(); ++i) {
+    ContinueIf(compacted_structures[i].m_descriptor == VK_NULL_HANDLE);
+    m_meshes[i]->m_blas = std::move(compacted_structures[i]);
+  }
+  compacted_structures.clear();
+
+  const double saved_percentage =
+      original_size == 0
+          ? 0.0
+          : 100.0 * static_cast<double>(original_size - compacted_size) /
+                static_cast<double>(original_size);
+  WUNDER_INFO_TAG("Renderer",
+                  "Compacted {0} bottom level acceleration structures from "
+                  "{1} to {2} bytes, {3:.1f}% saved",
+                  compacted_count, original_size, compacted_size,
+                  saved_percentage);
+}
+
+void bottom_level_acceleration_structure_builder::report_statistics() const {
+  event::vulkan::bottom_level_acceleration_structures_built built_event;
+  for (std::size_t i = 0; i < m_statistics.size(); ++i) {
+    const auto& statistics = m_statistics[i];
+    ContinueIf(statistics.m_structures_count == 0);
+
+    const auto policy = static_cast<acceleration_structure_build_policy>(i);
+    WUNDER_INFO_TAG(
+        "Renderer",
+        "Bottom level acceleration structures, policy {0}: {1} structures "
+        "built in {2:.2f} ms, {3} bytes, {4} bytes after compaction",
+        to_string(policy), statistics.m_structures_count,
+        statistics.m_build_time_ms, statistics.m_build_size,
+        statistics.m_compacted_size);
+
+    built_event.m_policies.push_back(
+        {.m_policy = policy,
+         .m_structures_count = statistics.m_structures_count,
+         .m_build_size = statistics.m_build_size,
+         .m_compacted_size = statistics.m_compacted_size,
+         .m_build_time_ms = statistics.m_build_time_ms});
+  }
+
+  event_controller::on_event(built_event);
+}
+}  // namespace wunder::vulkan
@@ -0,0 +1,200 @@
+#include "gla/vulkan/ray-trace/vulkan_opacity_micromap.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "assets/opacity_micromap_baker.h"
+#include "core/wunder_macros.h"
+#include "gla/vulkan/vulkan_buffer.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+
+namespace wunder::vulkan {
+opacity_micromap::opacity_micromap() = default;
+
+opacity_micromap::~opacity_micromap() {
+  ReturnIf(m_micromap == VK_NULL_HANDLE);
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+  vkDestroyMicromapEXT(vulkan_logical_device, m_micromap, nullptr);
+}
+
+opacity_micromap::opacity_micromap(opacity_micromap&& other) noexcept
+    : m_micromap(std::exchange(other.m_micromap, VK_NULL_HANDLE)),
+      m_micromap_buffer(std::move(other.m_micromap_buffer)),
+      m_indices_buffer(std::move(other.m_indices_buffer)),
+      m_geometry_usage_count(other.m_geometry_usage_count),
+      m_data_buffer(std::move(other.m_data_buffer)),
+      m_triangles_buffer(std::move(other.m_triangles_buffer)),
+      m_scratch_buffer(std::move(other.m_scratch_buffer)) {}
+
+opacity_micromap& opacity_micromap::operator=(
+    opacity_micromap&& other) noexcept {
+  std::swap(m_micromap, other.m_micromap);
+  std::swap(m_micromap_buffer, other.m_micromap_buffer);
+  std::swap(m_indices_buffer, other.m_indices_buffer);
+  std::swap(m_geometry_usage_count, other.m_geometry_usage_count);
+  std::swap(m_data_buffer, other.m_data_buffer);
+  std::swap(m_triangles_buffer, other.m_triangles_buffer);
+  std::swap(m_scratch_buffer, other.m_scratch_buffer);
+
+  return *this;
+}
+
+void opacity_micromap::create(VkCommandBuffer command_buffer,
+                              const baked_opacity_micromap& baked_micromap,
+                              const std::string& name) {
+  AssertReturnIf(baked_micromap.m_indices.empty());
+
+  m_indices_buffer.reset(new storage_device_buffer(
+      command_buffer, {.m_enabled = false, .m_descriptor_name = ""},
+      baked_micromap.m_indices.data(),
+      baked_micromap.m_indices.size() * sizeof(std::int32_t),
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+
+  m_geometry_usage_count.count =
+      baked_micromap.get_referencing_triangles_count();
+  m_geometry_usage_count.subdivisionLevel = baked_micromap.m_subdivision_level;
+  m_geometry_usage_count.format =
+      static_cast<std::uint32_t>(baked_micromap.m_format);
+
+  // Only special indices, the structure doesn't need a micromap at all
+  if (baked_micromap.get_triangles_count() > 0) {
+    build(command_buffer, baked_micromap, name);
+  }
+
+  // The index buffer upload and the micromap build complete before any later
+  // bottom level build reads them
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void opacity_micromap::build(VkCommandBuffer command_buffer,
+                             const baked_opacity_micromap& baked_micromap,
+                             const std::string& name) {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  const std::uint32_t triangles_count = baked_micromap.get_triangles_count();
+  std::vector<VkMicromapTriangleEXT> triangles(triangles_count);
+  for (std::uint32_t i = 0; i < triangles_count; ++i) {
+    triangles[i].dataOffset = i * baked_micromap.m_triangle_size;
+    triangles[i].subdivisionLevel =
+        static_cast<std::uint16_t>(baked_micromap.m_subdivision_level);
+    triangles[i].format = static_cast<std::uint16_t>(baked_micromap.m_format);
+  }
+
+  constexpr VkBufferUsageFlags input_usage =
+      VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT |
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+  m_data_buffer.reset(new storage_device_buffer(
+      command_buffer, {.m_enabled = false, .m_descriptor_name = ""},
+      baked_micromap.m_data.data(), baked_micromap.m_data.size(),
+      input_usage));
+  m_triangles_buffer.reset(new storage_device_buffer(
+      command_buffer, {.m_enabled = false, .m_descriptor_name = ""},
+      triangles.data(), triangles.size() * sizeof(VkMicromapTriangleEXT),
+      input_usage));
+
+  VkMicromapUsageEXT build_usage_count = m_geometry_usage_count;
+  build_usage_count.count = triangles_count;
+
+  VkMicromapBuildInfoEXT build_info{};
+  build_info.sType = VK_STRUCTURE_TYPE_MICROMAP_BUILD_INFO_EXT;
+  build_info.type = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT;
+  build_info.flags = VK_BUILD_MICROMAP_PREFER_FAST_TRACE_BIT_EXT;
+  build_info.mode = VK_BUILD_MICROMAP_MODE_BUILD_EXT;
+  build_info.usageCountsCount = 1;
+  build_info.pUsageCounts = &build_usage_count;
+
+  VkMicromapBuildSizesInfoEXT build_sizes{};
+  build_sizes.sType = VK_STRUCTURE_TYPE_MICROMAP_BUILD_SIZES_INFO_EXT;
+  vkGetMicromapBuildSizesEXT(vulkan_logical_device,
+                             VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+                             &build_info, &build_sizes);
+
+  m_micromap_buffer.reset(new storage_device_buffer(
+      {.m_enabled = false, .m_descriptor_name = ""}, build_sizes.micromapSize,
+      VK_BUFFER_USAGE_MICROMAP_STORAGE_BIT_EXT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+  m_scratch_buffer.reset(new storage_device_buffer(
+      {.m_enabled = false, .m_descriptor_name = ""},
+      std::max<VkDeviceSize>(build_sizes.buildScratchSize, 4),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+
+  VkMicromapCreateInfoEXT micromap_create_info{};
+  micromap_create_info.sType = VK_STRUCTURE_TYPE_MICROMAP_CREATE_INFO_EXT;
+  micromap_create_info.buffer = m_micromap_buffer->get_buffer();
+  micromap_create_info.size = build_sizes.micromapSize;
+  micromap_create_info.type = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT;
+  VK_CHECK_RESULT(vkCreateMicromapEXT(
+      vulkan_logical_device, &micromap_create_info, nullptr, &m_micromap));
+  set_debug_utils_object_name(vulkan_logical_device,
+                              VK_OBJECT_TYPE_MICROMAP_EXT,
+                              name + " opacity micromap", m_micromap);
+
+  build_info.dstMicromap = m_micromap;
+  build_info.data.deviceAddress = m_data_buffer->get_address();
+  build_info.triangleArray.deviceAddress = m_triangles_buffer->get_address();
+  build_info.triangleArrayStride = sizeof(VkMicromapTriangleEXT);
+  build_info.scratchData.deviceAddress = m_scratch_buffer->get_address();
+
+  // The inputs were just copied from the staging buffers
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  vkCmdBuildMicromapsEXT(command_buffer, 1, &build_info);
+}
+
+void opacity_micromap::free_build_data() {
+  m_data_buffer.reset();
+  m_triangles_buffer.reset();
+  m_scratch_buffer.reset();
+
+  if (m_indices_buffer) {
+    m_indices_buffer->free_staging_data();
+  }
+}
+
+VkAccelerationStructureTrianglesOpacityMicromapEXT
+opacity_micromap::get_geometry_info() const {
+  VkAccelerationStructureTrianglesOpacityMicromapEXT geometry_info{};
+  geometry_info.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_TRIANGLES_OPACITY_MICROMAP_EXT;
+  ReturnUnless(is_valid(), geometry_info);
+
+  geometry_info.indexType = VK_INDEX_TYPE_UINT32;
+  geometry_info.indexBuffer.deviceAddress = m_indices_buffer->get_address();
+  geometry_info.indexStride = sizeof(std::int32_t);
+  geometry_info.baseTriangle = 0;
+  geometry_info.micromap = m_micromap;
+
+  if (m_micromap != VK_NULL_HANDLE) {
+    geometry_info.usageCountsCount = 1;
+    geometry_info.pUsageCounts = &m_geometry_usage_count;
+  }
+
+  return geometry_info;
+}
+}  // namespace wunder::vulkan
@@ -1,13 +1,16 @@
 #include "include/gla/vulkan/ray-trace/vulkan_rtx_pipeline.h"
 
+#include <cstddef>
 #include <future>
 
 #include "core/vector_map.h"
+#include "core/wunder_features.h"
 #include "gla/vulkan/vulkan_command_pool.h"
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_pipeline_cache.h"
 #include "gla/vulkan/vulkan_shader.h"
 #include "glad/vulkan.h"
 #include "resources/shaders/host_device.h"
@@ -15,9 +18,10 @@
 namespace wunder::vulkan {
 class shader;
 
-rtx_pipeline::rtx_pipeline()
+rtx_pipeline::rtx_pipeline(const variant& pipeline_variant)
     : base_pipeline(VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR),
-      m_pipeline_create_info{} {
+      m_pipeline_create_info{},
+      m_variant(pipeline_variant) {
   m_pipeline_create_info.sType = {
       VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
 }
@@ -25,9 +29,10 @@ rtx_pipeline::rtx_pipeline()
 std::unique_ptr<rtx_pipeline> rtx_pipeline::create(
     const descriptor_set_manager& descriptor_set_manager,
     const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
-        shaders) {
+        shaders,
+    const variant& pipeline_variant) {
   unique_ptr<rtx_pipeline> pipeline;
-  pipeline.reset(new rtx_pipeline());
+  pipeline.reset(new rtx_pipeline(pipeline_variant));
 
   pipeline->initialize_pipeline_layout(descriptor_set_manager);
   pipeline->initialize_pipeline(shaders);
@@ -46,15 +51,17 @@ VkPushConstantRange rtx_pipeline::get_push_constant_range() const {
 void rtx_pipeline::initialize_pipeline(
     const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
         shaders_of_types) {
-  auto& device = layer_abstraction_factory::instance()
-                     .get_vulkan_context()
-                     .mutable_device();
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& device = vulkan_context.mutable_device();
+  auto& pipeline_cache = vulkan_context.mutable_pipeline_cache();
 
   vkDestroyPipeline(device.get_vulkan_logical_device(), m_vulkan_pipeline,
                     nullptr);
 
   create_shader_stage_create_info(shaders_of_types);
   create_shader_group_info();
+  create_specialization_info();
 
   // --- Pipeline ---
   // Assemble the shader stages and recursion depth info into the ray tracing
@@ -69,6 +76,32 @@ void rtx_pipeline::initialize_pipeline(
 
   m_pipeline_create_info.maxPipelineRayRecursionDepth = 2;  // Ray depth
   m_pipeline_create_info.layout = m_vulkan_pipeline_layout;
+#if OPACITY_MICROMAPS
+  // Without it the micromaps of the bottom level structures can't be traced
+  const VkPipelineCreateFlags pipeline_create_flags =
+      VK_PIPELINE_CREATE_RAY_TRACING_OPACITY_MICROMAP_BIT_EXT;
+#else
+  const VkPipelineCreateFlags pipeline_create_flags = 0;
+#endif
+  m_pipeline_create_info.flags = pipeline_create_flags;
+
+  VkPipelineCache vulkan_pipeline_cache =
+      pipeline_cache.get_or_load("rtx", get_shaders_hash(shaders_of_types));
+  if (pipeline_cache.is_miss_detection_supported()) {
+    // Warm starts end here, without any driver compilation
+    m_pipeline_create_info.flags =
+        pipeline_create_flags |
+        VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+    VkResult result = vkCreateRayTracingPipelinesKHR(
+        device.get_vulkan_logical_device(), VK_NULL_HANDLE,
+        vulkan_pipeline_cache, 1, &m_pipeline_create_info, nullptr,
+        &m_vulkan_pipeline);
+    m_pipeline_create_info.flags = pipeline_create_flags;
+
+    pipeline_cache.record_lookup("rtx", result == VK_SUCCESS);
+    ReturnIf(result == VK_SUCCESS);
+    AssertReturnUnless(result == VK_PIPELINE_COMPILE_REQUIRED);
+  }
 
   // Create a deferred operation (compiling in parallel)
   bool use_deferred{true};
@@ -79,8 +112,9 @@ void rtx_pipeline::initialize_pipeline(
   }
 
   vkCreateRayTracingPipelinesKHR(device.get_vulkan_logical_device(),
-                                 deferred_op, {}, 1, &m_pipeline_create_info,
-                                 nullptr, &m_vulkan_pipeline);
+                                 deferred_op, vulkan_pipeline_cache, 1,
+                                 &m_pipeline_create_info, nullptr,
+                                 &m_vulkan_pipeline);
 
   if (use_deferred) {
     // Query the maximum amount of concurrency and clamp to the desired maximum
@@ -114,6 +148,26 @@ void rtx_pipeline::initialize_pipeline(
   }
 }
 
+void rtx_pipeline::create_specialization_info() {
+  m_specialization_entries[eSpecDebuggingMode] = VkSpecializationMapEntry{
+      eSpecDebuggingMode, offsetof(variant, m_debugging_mode),
+      sizeof(variant::m_debugging_mode)};
+  m_specialization_entries[eSpecMaxDepth] = VkSpecializationMapEntry{
+      eSpecMaxDepth, offsetof(variant, m_max_depth),
+      sizeof(variant::m_max_depth)};
+
+  m_specialization_info.mapEntryCount =
+      static_cast<uint32_t>(m_specialization_entries.size());
+  m_specialization_info.pMapEntries = m_specialization_entries.data();
+  m_specialization_info.dataSize = sizeof(m_variant);
+  m_specialization_info.pData = &m_variant;
+
+  // Stages which don't declare the constants ignore them
+  for (auto& shader_stage_create_info : m_shader_stage_create_infos) {
+    shader_stage_create_info.pSpecializationInfo = &m_specialization_info;
+  }
+}
+
 void rtx_pipeline::create_shader_group_info() {
   auto add_group = [&groups = m_shader_stage_groups](
                        VkRayTracingShaderGroupTypeKHR type,
@@ -1,10 +1,14 @@
 #include "include/gla/vulkan/ray-trace/vulkan_rtx_renderer.h"
 
+#include <algorithm>
+#include <functional>
 #include <optional>
+#include <span>
 
 #include "camera/camera.h"
 #include "core/project.h"
 #include "core/services_factory.h"
+#include "core/wunder_filesystem.h"
 #include "core/wunder_features.h"
 #include "event/event_handler.hpp"
 #include "event/scene_events.h"
@@ -16,7 +20,10 @@
 #include "gla/vulkan/scene/vulkan_scene.h"
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_frame_storage_buffer.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
 #include "gla/vulkan/vulkan_memory_allocator.h"
 #include "gla/vulkan/vulkan_renderer_context.h"
 #include "gla/vulkan/vulkan_shader.h"
@@ -37,18 +44,25 @@ rtx_renderer::rtx_renderer(const renderer_properties &properties) :m_state(std::
   m_state->minHeatmap = 0;
   m_state->maxHeatmap = 65000;
   m_state->debugging_mode = DebugMode::eNoDebug;
+  // Adaptive sampling is opted into, stills rendered to convergence
+  m_state->convergenceThreshold = 0.f;
+  m_state->minConvergenceFrames = 16;
+  m_state->tileOffset = {0, 0};
 }
 
 rtx_renderer::~rtx_renderer() = default;
 
 void rtx_renderer::shutdown_internal() /*override*/ {
-  if (m_rtx_pipeline.get()) {
-    m_rtx_pipeline.reset();
+  if (m_shader_hot_reloader) {
+    m_shader_hot_reloader.reset();
   }
 
-  if (m_shader_binding_table.get()) {
-    m_shader_binding_table.reset();
-  }
+  m_pipeline_variants.clear();
+
+  m_tile_scheduler.reset();
+  m_unconverged_tiles_read_back.reset();
+  m_convergence_buffer.reset();
+  m_moments_image.reset();
 
   if (m_state) {
     m_state.reset();
@@ -60,6 +74,7 @@ void rtx_renderer::init_internal(scene_id scene_id) {
         scene_id);
   AssertReturnUnless(api_scene.has_value());
   auto &scene = api_scene->get();
+  m_scene_id = scene_id;
   const auto &environment_texture = scene.get_environment_texture();
 
   auto &renderer_context =
@@ -71,24 +86,36 @@ void rtx_renderer::init_internal(scene_id scene_id) {
   camera.set_window_size(renderer_properties.m_width,
                          renderer_properties.m_height);
 
+  // The swap chain has its images by now, scene activations share them
+  if (!m_convergence_buffer) {
+    create_convergence_resources(renderer_properties.m_width,
+                                 renderer_properties.m_height);
+    m_tile_scheduler = std::make_unique<rtx_tile_scheduler>(
+        renderer_properties.m_width, renderer_properties.m_height,
+        static_cast<std::uint32_t>(
+            renderer_context.mutable_swap_chain().get_image_count()));
+  }
+
   m_descriptor_set_manager->clear_resources();
   scene.collect_descriptors(*m_descriptor_set_manager);
   camera.collect_descriptors(*m_descriptor_set_manager);
   m_rasterize_renderer.get_output_image().add_descriptor_to(
       *m_descriptor_set_manager);
+  m_moments_image->add_descriptor_to(*m_descriptor_set_manager);
+  m_convergence_buffer->add_descriptor_to(*m_descriptor_set_manager);
 
   AssertReturnIf(m_descriptor_set_manager->build() !=
                      descriptor_set_manager::build_error_code::SUCCESS, );
 
-  m_rtx_pipeline =
-      std::move(rtx_pipeline::create(*m_descriptor_set_manager, m_shaders));
-  AssertReturnUnless(m_rtx_pipeline);
+  // Variants of the previous scene use the previous descriptor layouts
+  m_pipeline_variants.clear();
+  AssertReturnUnless(select_pipeline_variant().has_value());
 
-  m_shader_binding_table = shader_binding_table::create(*m_rtx_pipeline);
-
-  m_state->frame = 0;
+  reset_frames();
   m_state->fireflyClampThreshold =
       environment_texture.m_acceleration_data.m_integral;
+
+  initialize_shader_hot_reload();
 }
 
 vector_map<VkShaderStageFlagBits, std::vector<shader_to_compile>>
@@ -132,42 +159,281 @@ void rtx_renderer::create_descriptor_manager(const shader &shader) {
       shader.get_shader_reflection_data());
 }
 
-void rtx_renderer::update(time_unit /*dt*/) /*override*/
+optional_ref<rtx_renderer::pipeline_variant>
+rtx_renderer::select_pipeline_variant() {
+  const rtx_pipeline::variant current_variant{
+      .m_debugging_mode = m_state->debugging_mode,
+      .m_max_depth = m_state->maxDepth};
+
+  auto found_variant_it = std::find_if(
+      m_pipeline_variants.begin(), m_pipeline_variants.end(),
+      [&current_variant](const pipeline_variant &variant) {
+        return variant.m_pipeline->get_variant() == current_variant;
+      });
+  ReturnIf(found_variant_it != m_pipeline_variants.end(),
+           std::ref(*found_variant_it));
+
+  auto pipeline = rtx_pipeline::create(*m_descriptor_set_manager, m_shaders,
+                                       current_variant);
+  AssertReturnUnless(pipeline, std::nullopt);
+
+  WUNDER_INFO_TAG("Renderer",
+                  "Created rtx pipeline variant, debug mode {0}, depth {1}",
+                  current_variant.m_debugging_mode,
+                  current_variant.m_max_depth);
+
+  auto binding_table = shader_binding_table::create(*pipeline);
+  return std::ref(m_pipeline_variants.emplace_back(
+      pipeline_variant{std::move(pipeline), std::move(binding_table)}));
+}
+
+void rtx_renderer::create_convergence_resources(std::uint32_t width,
+                                                std::uint32_t height) {
+  m_moments_image.reset(new storage_texture(
+      {.m_enabled = true, .m_descriptor_name = "rtxMomentsImage"},
+      VK_FORMAT_R32G32B32A32_SFLOAT, width, height));
+
+  const auto tile_size = static_cast<std::uint32_t>(ConvergenceTileSize);
+  m_convergence_tiles_count =
+      static_cast<VkDeviceSize>((width + tile_size - 1) / tile_size) *
+      ((height + tile_size - 1) / tile_size);
+
+  // unconvergedTiles, then the tileUnconverged flags of both frame parities
+  m_convergence_buffer = std::make_unique<storage_device_buffer>(
+      descriptor_build_data{.m_enabled = true,
+                            .m_descriptor_name = "_Convergence"},
+      static_cast<size_t>((2 + 2 * m_convergence_tiles_count) *
+                          sizeof(std::uint32_t)),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+  const std::uint32_t no_unconverged_tiles = 0;
+  m_unconverged_tiles_read_back = std::make_unique<frame_storage_buffer>(
+      descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""},
+      &no_unconverged_tiles, sizeof(no_unconverged_tiles),
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+  m_read_back_frames.assign(m_unconverged_tiles_read_back->get_frames_count(),
+                            -1);
+}
+
+void rtx_renderer::update_convergence() {
+  ReturnIf(m_is_converged || m_state->convergenceThreshold <= 0.f);
+
+  // The fence of the acquired image was waited for, its copy holds what the
+  // last frame traced with it left unconverged
+  const std::uint32_t image_idx =
+      m_unconverged_tiles_read_back->get_current_frame();
+  const int read_back_frame = m_read_back_frames[image_idx];
+  ReturnIf(read_back_frame < 0 ||
+           read_back_frame + 1 < std::max(m_state->minConvergenceFrames, 1));
+
+  // Read back memory is cached, read_frame invalidates the copy first
+  std::uint32_t unconverged_tiles = 0;
+  m_unconverged_tiles_read_back->read_frame(image_idx, &unconverged_tiles,
+                                            sizeof(unconverged_tiles));
+  ReturnIf(unconverged_tiles > 0);
+
+  m_is_converged = true;
+  WUNDER_INFO_TAG("Renderer", "Converged after {0} frames",
+                  read_back_frame + 1);
+}
+
+void rtx_renderer::record_convergence_reset(
+    VkCommandBuffer command_buffer) const {
+  const VkDeviceSize write_half = static_cast<VkDeviceSize>(m_state->frame & 1);
+  const VkBuffer convergence_buffer = m_convergence_buffer->get_buffer();
+
+  // The previous frame reads the other half, the one before it this one
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                          VK_ACCESS_SHADER_WRITE_BIT |
+                          VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  vkCmdFillBuffer(command_buffer, convergence_buffer,
+                  write_half * sizeof(std::uint32_t), sizeof(std::uint32_t),
+                  0);
+  vkCmdFillBuffer(
+      command_buffer, convergence_buffer,
+      (2 + write_half * m_convergence_tiles_count) * sizeof(std::uint32_t),
+      m_convergence_tiles_count * sizeof(std::uint32_t), 0);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+}
+
+void rtx_renderer::record_convergence_read_back(
+    VkCommandBuffer command_buffer) {
+  const std::uint32_t image_idx =
+      m_unconverged_tiles_read_back->get_current_frame();
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  VkBufferCopy copy_region{};
+  copy_region.srcOffset =
+      static_cast<VkDeviceSize>(m_state->frame & 1) * sizeof(std::uint32_t);
+  copy_region.dstOffset =
+      m_unconverged_tiles_read_back->get_frame_offset(image_idx);
+  copy_region.size = sizeof(std::uint32_t);
+  vkCmdCopyBuffer(command_buffer, m_convergence_buffer->get_buffer(),
+                  m_unconverged_tiles_read_back->get_buffer(), 1,
+                  &copy_region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr,
+                       0, nullptr);
+
+  m_read_back_frames[image_idx] = m_state->frame;
+}
+
+void rtx_renderer::initialize_shader_hot_reload() {
+// Precompiled shaders come without the compiler, nothing to reload them with
+#if SHADER_HOT_RELOAD && !WUNDER_PRECOMPILED_SHADERS
+  // Scene activations reuse the pipeline shaders, they're tracked once
+  ReturnIf(m_shader_hot_reloader);
+
+  m_shader_hot_reloader = make_unique<shader_hot_reloader>(
+      wunder_filesystem::instance().resolve_path(
+          "wunder-renderer/resources/shaders"),
+      std::bind(&rtx_renderer::on_shaders_reloaded, this,
+                std::placeholders::_1));
+
+  for (auto &[shader_type, shaders_compile_data] :
+       get_shaders_for_compilation()) {
+    for (std::size_t i = 0; i < shaders_compile_data.size(); ++i) {
+      m_shader_hot_reloader->track(shader_hot_reloader::tracked_shader{
+          .m_shader_path = shaders_compile_data[i].m_shader_path,
+          .m_stage = shader_type,
+          .m_index = i});
+    }
+  }
+#endif
+}
+
+void rtx_renderer::on_shaders_reloaded(
+    std::vector<shader_hot_reloader::reloaded_shader> &reloaded_shaders) {
+  auto &vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+
+  // Frames in flight still trace with the current pipeline and binding table,
+  // the scene loading thread may be submitting, so all queues are locked
+  vulkan_context.mutable_device().wait_idle();
+
+  for (auto &reloaded_shader : reloaded_shaders) {
+    auto &shaders_of_type = m_shaders[reloaded_shader.m_shader.m_stage];
+    AssertContinueUnless(reloaded_shader.m_shader.m_index <
+                         shaders_of_type.size());
+
+    // The descriptor layouts are kept, shaders are expected to declare the
+    // same resources as the ones they replace
+    shaders_of_type[reloaded_shader.m_shader.m_index] =
+        shader::create(reloaded_shader.m_shader.m_shader_path,
+                       reloaded_shader.m_shader.m_stage,
+                       reloaded_shader.m_binary);
+  }
+
+  // Scene, acceleration structures and descriptors stay as they are, the
+  // other variants are rebuilt once they're selected again
+  m_pipeline_variants.clear();
+  AssertReturnUnless(select_pipeline_variant().has_value());
+
+  reset_frames();
+}
+
+void rtx_renderer::update(time_unit dt) /*override*/
 {
+  // Swapped before anything of this frame references the pipeline
+  if (m_shader_hot_reloader) {
+    m_shader_hot_reloader->update(dt);
+  }
+
   auto &renderer_context =
       layer_abstraction_factory::instance().get_render_context();
-  auto &m_renderer_properties = renderer_context.get_renderer_properties();
+  auto &swap_chain = renderer_context.mutable_swap_chain();
 
-  auto graphic_command_buffer =
-      renderer_context.mutable_swap_chain().get_current_command_buffer();
+  auto graphic_command_buffer = swap_chain.get_current_command_buffer();
 
-  m_rtx_pipeline->bind();
-  m_descriptor_set_manager->bind(*m_rtx_pipeline);
+  // Moved instances invalidate the accumulated samples
+  if (m_scene_id.has_value()) {
+    auto api_scene =
+        project::instance().get_scene_manager().mutable_api_scene(*m_scene_id);
+    if (api_scene.has_value() &&
+        api_scene->get().update_acceleration_structure(
+            graphic_command_buffer)) {
+      reset_frames();
+    }
+  }
+
+  // The output image keeps the converged result, nothing is left to trace
+  update_convergence();
+  ReturnIf(m_is_converged);
 
-  vkCmdPushConstants(
-      graphic_command_buffer, m_rtx_pipeline->get_vulkan_pipeline_layout(),
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
-          VK_SHADER_STAGE_MISS_BIT_KHR,
-      0, sizeof(RtxState), m_state.get());
+  auto pipeline_variant = select_pipeline_variant();
+  AssertReturnUnless(pipeline_variant.has_value());
+  auto &pipeline = *pipeline_variant->get().m_pipeline;
+  auto &binding_table = *pipeline_variant->get().m_shader_binding_table;
+
+  // A pass traces every tile once, the accumulation counts passes
+  const std::uint32_t image_idx = swap_chain.get_current_queue_element();
+  const std::span<const VkRect2D> tiles =
+      m_tile_scheduler->next_tiles(image_idx, m_tiling_properties);
+  if (m_tile_scheduler->is_pass_beginning()) {
+    record_convergence_reset(graphic_command_buffer);
+  }
+
+  pipeline.bind();
+  m_descriptor_set_manager->bind(pipeline);
 
   //  auto& regions = m_sbtWrapper.getRegions();
   VkStridedDeviceAddressRegionKHR raygen_address =
-      m_shader_binding_table->get_stage_address(
+      binding_table.get_stage_address(
           shader_binding_table::shader_stage_type::raygen);
   VkStridedDeviceAddressRegionKHR miss_address =
-      m_shader_binding_table->get_stage_address(
+      binding_table.get_stage_address(
           shader_binding_table::shader_stage_type::miss);
   VkStridedDeviceAddressRegionKHR hit_address =
-      m_shader_binding_table->get_stage_address(
+      binding_table.get_stage_address(
           shader_binding_table::shader_stage_type::hit);
   VkStridedDeviceAddressRegionKHR callable_address =
-      m_shader_binding_table->get_stage_address(
+      binding_table.get_stage_address(
           shader_binding_table::shader_stage_type::callable);
 
-  vkCmdTraceRaysKHR(graphic_command_buffer, &raygen_address, &miss_address,
-                    &hit_address, &callable_address,
-                    m_renderer_properties.m_width,
-                    m_renderer_properties.m_height, 1);
+  m_tile_scheduler->write_begin_timestamp(graphic_command_buffer, image_idx);
+  for (const VkRect2D &tile : tiles) {
+    m_state->tileOffset = {tile.offset.x, tile.offset.y};
+    vkCmdPushConstants(
+        graphic_command_buffer, pipeline.get_vulkan_pipeline_layout(),
+        VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+            VK_SHADER_STAGE_MISS_BIT_KHR,
+        0, sizeof(RtxState), m_state.get());
+
+    vkCmdTraceRaysKHR(graphic_command_buffer, &raygen_address, &miss_address,
+                      &hit_address, &callable_address, tile.extent.width,
+                      tile.extent.height, 1);
+  }
+  m_tile_scheduler->write_end_timestamp(graphic_command_buffer, image_idx);
+
+  ReturnUnless(m_tile_scheduler->is_pass_complete());
+
+  record_convergence_read_back(graphic_command_buffer);
 
   log_current_sate_frame();
   ++m_state->frame;
@@ -175,6 +441,13 @@ void rtx_renderer::update(time_unit /*dt*/) /*override*/
 
 void rtx_renderer::reset_frames() {
   m_state->frame = 0;
+  if (m_tile_scheduler) {
+    m_tile_scheduler->reset();
+  }
+
+  // Counts read back from now on belong to the new frames
+  m_is_converged = false;
+  std::fill(m_read_back_frames.begin(), m_read_back_frames.end(), -1);
 }
 
 void rtx_renderer::on_event(const wunder::event::camera_moved &) /*override*/ {
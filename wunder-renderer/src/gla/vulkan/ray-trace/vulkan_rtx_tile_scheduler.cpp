@@ -0,0 +1,241 @@
+#include "gla/vulkan/ray-trace/vulkan_rtx_tile_scheduler.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <utility>
+
+#include "core/wunder_macros.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_physical_device.h"
+
+namespace wunder::vulkan {
+namespace {
+// Weight of the latest frame in the smoothed time per pixel
+constexpr double k_timing_smoothing = 0.25;
+
+// Distance along the Hilbert curve filling the n x n grid, n a power of two
+std::uint64_t hilbert_index(std::uint32_t n, std::uint32_t x,
+                            std::uint32_t y) {
+  std::uint64_t index = 0;
+  for (std::uint32_t s = n / 2; s > 0; s /= 2) {
+    const std::uint32_t rx = (x & s) > 0 ? 1 : 0;
+    const std::uint32_t ry = (y & s) > 0 ? 1 : 0;
+    index += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+    // Rotates the quadrant, so the curve continues where the last one ended
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+
+  return index;
+}
+}  // namespace
+
+rtx_tile_scheduler::rtx_tile_scheduler(std::uint32_t width,
+                                       std::uint32_t height,
+                                       std::uint32_t frames_count)
+    : m_width(width), m_height(height), m_timed_pixels(frames_count, 0) {
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  const auto& limits = vulkan_context.mutable_physical_device().get_limits();
+  ReturnUnless(limits.timestampComputeAndGraphics);
+
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+  VkQueryPoolCreateInfo query_pool_create_info{};
+  query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  query_pool_create_info.queryCount = frames_count * 2;
+  VK_CHECK_RESULT(vkCreateQueryPool(vulkan_logical_device,
+                                    &query_pool_create_info, nullptr,
+                                    &m_timestamp_query_pool));
+  set_debug_utils_object_name(vulkan_logical_device, VK_OBJECT_TYPE_QUERY_POOL,
+                              "rtx tiles timestamp query pool",
+                              m_timestamp_query_pool);
+
+  m_timestamp_period_ns = limits.timestampPeriod;
+}
+
+rtx_tile_scheduler::~rtx_tile_scheduler() {
+  ReturnIf(m_timestamp_query_pool == VK_NULL_HANDLE);
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+  vkDestroyQueryPool(vulkan_logical_device, m_timestamp_query_pool, nullptr);
+}
+
+void rtx_tile_scheduler::reset() {
+  m_first_tile = 0;
+  m_next_tile = m_tiles.size();
+}
+
+std::span<const VkRect2D> rtx_tile_scheduler::next_tiles(
+    std::uint32_t frame, const properties& tiling_properties) {
+  AssertReturnUnless(frame < m_timed_pixels.size(), {});
+  read_timestamps(frame);
+
+  if (is_pass_complete()) {
+    // Tiles of a pass keep their size and order, whatever changed meanwhile
+    if (m_tiles.empty() ||
+        tiling_properties.m_tile_size != m_tiles_properties.m_tile_size ||
+        tiling_properties.m_order != m_tiles_properties.m_order) {
+      create_tiles(tiling_properties);
+    }
+    m_next_tile = 0;
+  }
+  m_tiles_properties.m_frame_budget_ms = tiling_properties.m_frame_budget_ms;
+
+  m_first_tile = m_next_tile;
+  m_next_tile += get_budget_tiles_count();
+
+  const std::span<const VkRect2D> tiles(m_tiles.data() + m_first_tile,
+                                        m_next_tile - m_first_tile);
+  if (m_tiles_properties.m_tile_size > 0 &&
+      m_timestamp_query_pool != VK_NULL_HANDLE) {
+    for (const VkRect2D& tile : tiles) {
+      m_timed_pixels[frame] +=
+          static_cast<std::uint64_t>(tile.extent.width) * tile.extent.height;
+    }
+  }
+
+  return tiles;
+}
+
+void rtx_tile_scheduler::write_begin_timestamp(VkCommandBuffer command_buffer,
+                                               std::uint32_t frame) const {
+  ReturnIf(m_timestamp_query_pool == VK_NULL_HANDLE ||
+           m_tiles_properties.m_tile_size == 0);
+
+  vkCmdResetQueryPool(command_buffer, m_timestamp_query_pool, frame * 2, 2);
+  vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      m_timestamp_query_pool, frame * 2);
+}
+
+void rtx_tile_scheduler::write_end_timestamp(VkCommandBuffer command_buffer,
+                                             std::uint32_t frame) const {
+  ReturnIf(m_timestamp_query_pool == VK_NULL_HANDLE ||
+           m_tiles_properties.m_tile_size == 0);
+
+  vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      m_timestamp_query_pool, frame * 2 + 1);
+}
+
+void rtx_tile_scheduler::create_tiles(const properties& tiling_properties) {
+  m_tiles_properties = tiling_properties;
+  m_tiles.clear();
+
+  const std::uint32_t tile_size = tiling_properties.m_tile_size;
+  if (tile_size == 0) {
+    m_tiles.push_back(VkRect2D{.offset = {0, 0},
+                               .extent = {m_width, m_height}});
+    return;
+  }
+
+  const std::uint32_t tiles_x = (m_width + tile_size - 1) / tile_size;
+  const std::uint32_t tiles_y = (m_height + tile_size - 1) / tile_size;
+  const std::uint32_t hilbert_size =
+      std::bit_ceil(std::max(tiles_x, tiles_y));
+
+  // Scanline index as the tie breaker keeps the order deterministic
+  std::vector<std::pair<std::uint64_t, VkRect2D>> ordered_tiles;
+  ordered_tiles.reserve(static_cast<std::size_t>(tiles_x) * tiles_y);
+  for (std::uint32_t tile_y = 0; tile_y < tiles_y; ++tile_y) {
+    for (std::uint32_t tile_x = 0; tile_x < tiles_x; ++tile_x) {
+      const VkRect2D tile{
+          .offset = {static_cast<std::int32_t>(tile_x * tile_size),
+                     static_cast<std::int32_t>(tile_y * tile_size)},
+          .extent = {std::min(tile_size, m_width - tile_x * tile_size),
+                     std::min(tile_size, m_height - tile_y * tile_size)}};
+
+      std::uint64_t key = 0;
+      switch (tiling_properties.m_order) {
+        case tile_order::scanline:
+          break;
+        case tile_order::hilbert:
+          key = hilbert_index(hilbert_size, tile_x, tile_y);
+          break;
+        case tile_order::center_out: {
+          // Doubled coordinates keep the tile and image centers integral
+          const std::int64_t dx = 2 * static_cast<std::int64_t>(tile_x) *
+                                      tile_size +
+                                  tile.extent.width - m_width;
+          const std::int64_t dy = 2 * static_cast<std::int64_t>(tile_y) *
+                                      tile_size +
+                                  tile.extent.height - m_height;
+          key = static_cast<std::uint64_t>(dx * dx + dy * dy);
+          break;
+        }
+      }
+
+      ordered_tiles.emplace_back(key, tile);
+    }
+  }
+
+  std::ranges::stable_sort(ordered_tiles, {},
+                           [](const auto& tile) { return tile.first; });
+  for (const auto& [_, tile] : ordered_tiles) {
+    m_tiles.push_back(tile);
+  }
+}
+
+std::size_t rtx_tile_scheduler::get_budget_tiles_count() const {
+  // Until the first tiles were timed a frame traces one
+  const double budget_pixels =
+      m_ns_per_pixel > 0.0
+          ? m_tiles_properties.m_frame_budget_ms * 1e6 / m_ns_per_pixel
+          : 0.0;
+
+  std::size_t tiles_count = 1;
+  double pixels = static_cast<double>(m_tiles[m_first_tile].extent.width) *
+                  m_tiles[m_first_tile].extent.height;
+  for (std::size_t tile_idx = m_first_tile + 1; tile_idx < m_tiles.size();
+       ++tile_idx) {
+    pixels += static_cast<double>(m_tiles[tile_idx].extent.width) *
+              m_tiles[tile_idx].extent.height;
+    ReturnIf(pixels > budget_pixels, tiles_count);
+    ++tiles_count;
+  }
+
+  return tiles_count;
+}
+
+void rtx_tile_scheduler::read_timestamps(std::uint32_t frame) {
+  const std::uint64_t pixels = std::exchange(m_timed_pixels[frame], 0);
+  ReturnIf(pixels == 0);
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+  std::array<std::uint64_t, 2> timestamps{};
+  ReturnIf(vkGetQueryPoolResults(
+               vulkan_logical_device, m_timestamp_query_pool, frame * 2, 2,
+               sizeof(timestamps), timestamps.data(), sizeof(std::uint64_t),
+               VK_QUERY_RESULT_64_BIT) != VkResult::VK_SUCCESS ||
+           timestamps[1] < timestamps[0]);
+
+  const double trace_time_ns =
+      static_cast<double>(timestamps[1] - timestamps[0]) *
+      m_timestamp_period_ns;
+  m_total_timed_pixels += pixels;
+  m_total_trace_time_ns += trace_time_ns;
+
+  const double ns_per_pixel = trace_time_ns / static_cast<double>(pixels);
+  m_ns_per_pixel = m_ns_per_pixel > 0.0
+                       ? std::lerp(m_ns_per_pixel, ns_per_pixel,
+                                   k_timing_smoothing)
+                       : ns_per_pixel;
+}
+}  // namespace wunder::vulkan
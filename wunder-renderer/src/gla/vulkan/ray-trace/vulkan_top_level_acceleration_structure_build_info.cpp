@@ -6,7 +6,7 @@
 #include "gla/vulkan/ray-trace/vulkan_bottom_level_acceleration_structure.h"
 #include "gla/vulkan/scene/vulkan_mesh.h"
 #include "gla/vulkan/scene/vulkan_mesh_scene_node.h"
-#include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_frame_storage_buffer.h"
 namespace {
 inline VkTransformMatrixKHR to_transform_matrix_khr(glm::mat4 matrix) {
   // VkTransformMatrixKHR uses a row-major memory layout, while glm::mat4
@@ -23,21 +23,20 @@ namespace wunder::vulkan {
 
 top_level_acceleration_structure_build_info::
     top_level_acceleration_structure_build_info(
-        VkCommandBuffer command_buffer,
         const std::vector<vulkan_mesh_scene_node>& mesh_nodes)
-    : m_command_buffer(command_buffer) {
-  auto acceleration_structures_instances =
-      create_acceleration_structure_instances(mesh_nodes);
-  create_acceleration_structures_buffer(acceleration_structures_instances);
+    : m_instances(create_acceleration_structure_instances(mesh_nodes)) {
+  create_acceleration_structures_buffer();
 
   clear_geometry_data();
-  create_geometry_data(
-      static_cast<uint32_t>(acceleration_structures_instances.size()));
+  create_geometry_data(static_cast<uint32_t>(m_instances.size()));
 
-  fill_range_info_data(
-      static_cast<uint32_t>(acceleration_structures_instances.size()));
+  fill_range_info_data(static_cast<uint32_t>(m_instances.size()));
 
-  auto build_flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+  // Updates keep the hierarchy and refit its bounds, which is far cheaper than
+  // a build when instances move
+  VkBuildAccelerationStructureFlagsKHR build_flags =
+      VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+      VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
   create_build_info(build_flags);
   calculate_build_size();
 }
@@ -45,7 +44,8 @@ top_level_acceleration_structure_build_info::
 top_level_acceleration_structure_build_info::
     top_level_acceleration_structure_build_info(
         top_level_acceleration_structure_build_info&& other) noexcept
-    : acceleration_structure_build_info(std::move(other)) {
+    : acceleration_structure_build_info(std::move(other)),
+      m_instances(std::move(other.m_instances)) {
   std::swap(m_acceleration_structures_buffer,
             other.m_acceleration_structures_buffer);
 }
@@ -53,6 +53,7 @@ top_level_acceleration_structure_build_info::
 top_level_acceleration_structure_build_info&
 top_level_acceleration_structure_build_info::operator=(
     top_level_acceleration_structure_build_info&& other) noexcept {
+  std::swap(m_instances, other.m_instances);
   std::swap(m_acceleration_structures_buffer,
             other.m_acceleration_structures_buffer);
   acceleration_structure_build_info::operator=(std::move(other));
@@ -81,10 +82,29 @@ top_level_acceleration_structure_build_info::
   return result;
 }
 
-void top_level_acceleration_structure_build_info::free_staging_data() {
+void top_level_acceleration_structure_build_info::set_instance_transform(
+    std::uint32_t instance_idx, const glm::mat4& model_matrix) {
+  AssertReturnUnless(instance_idx < m_instances.size());
+
+  m_instances[instance_idx].transform = to_transform_matrix_khr(model_matrix);
+}
+
+void top_level_acceleration_structure_build_info::write_instances(
+    std::uint32_t frame) {
   AssertReturnUnless(m_acceleration_structures_buffer);
 
-  m_acceleration_structures_buffer->free_staging_data();
+  m_acceleration_structures_buffer->write_frame(
+      frame, m_instances.data(),
+      m_instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+  m_as_geometry.geometry.instances.data.deviceAddress =
+      m_acceleration_structures_buffer->get_frame_address(frame);
+}
+
+std::uint32_t top_level_acceleration_structure_build_info::get_current_frame()
+    const {
+  AssertReturnUnless(m_acceleration_structures_buffer, 0);
+
+  return m_acceleration_structures_buffer->get_current_frame();
 }
 
 bool top_level_acceleration_structure_build_info::
@@ -121,21 +141,17 @@ bool top_level_acceleration_structure_build_info::
 }
 
 void top_level_acceleration_structure_build_info::
-    create_acceleration_structures_buffer(
-        std::vector<VkAccelerationStructureInstanceKHR>&
-            acceleration_structures_instances) {
-  VkAccelerationStructureInstanceKHR* data =
-      acceleration_structures_instances.data();
-  unsigned long size = acceleration_structures_instances.size() *
-                       sizeof(VkAccelerationStructureInstanceKHR);
-  auto flags = VkBufferUsageFlagBits(
+    create_acceleration_structures_buffer() {
+  const size_t size =
+      m_instances.size() * sizeof(VkAccelerationStructureInstanceKHR);
+  auto flags = VkBufferUsageFlags(
       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
       VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
 
-  m_acceleration_structures_buffer = std::make_unique<storage_device_buffer>(
-      m_command_buffer,
-      descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""}, data,
-      size, flags);
+  // The first build reads the copy of frame 0
+  m_acceleration_structures_buffer = std::make_unique<frame_storage_buffer>(
+      descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""},
+      m_instances.data(), size, flags);
 }
 
 void top_level_acceleration_structure_build_info::create_geometry_data(
@@ -146,7 +162,7 @@ void top_level_acceleration_structure_build_info::create_geometry_data(
   geometryInstances.sType =
       VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
   geometryInstances.data.deviceAddress =
-      m_acceleration_structures_buffer->get_address();
+      m_acceleration_structures_buffer->get_frame_address(0);
 
   // Set up the geometry to use instance data.
   std::memset(&m_as_geometry, 0, sizeof(VkAccelerationStructureGeometryKHR));
@@ -23,17 +23,14 @@ top_level_acceleration_structure_builder::
       m_build_infos(build_infos) {}
 
 void top_level_acceleration_structure_builder::build() {
-  m_build_infos.push_back(std::move(top_level_acceleration_structure_build_info(
-      m_command_buffer, mesh_nodes)));
+  m_build_infos.push_back(
+      std::move(top_level_acceleration_structure_build_info(mesh_nodes)));
 
   AssertReturnIf(m_build_infos.empty());
 
   create_scratch_buffer(static_cast<uint32_t>(
       m_build_infos.front().get_vulkan_as_build_sizes_info().buildScratchSize));
   build_info_set_scratch_buffer();
-
-  wait_until_instances_buffer_is_available();
-
   create_acceleration_structures();
 
   std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>
@@ -43,7 +40,6 @@ void top_level_acceleration_structure_builder::build() {
   build_acceleration_structure(as_build_offset_info, as_build_geometry_info);
 
   flush_commands();
-  free_staging_data();
 }
 
 void top_level_acceleration_structure_builder::build_info_set_scratch_buffer() {
@@ -66,27 +62,9 @@ void top_level_acceleration_structure_builder::
       m_acceleration_structure.m_descriptor;
 }
 
-void top_level_acceleration_structure_builder::
-    wait_until_instances_buffer_is_available() const {
-  VkMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
-  vkCmdPipelineBarrier(m_command_buffer,
-                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-                       0, 1, &barrier, 0, nullptr, 0, nullptr);
-}
-
 void top_level_acceleration_structure_builder::flush_commands() {
   auto& context = layer_abstraction_factory::instance().get_vulkan_context();
   context.mutable_command_pool().flush_compute_command_buffer();
 }
 
-void top_level_acceleration_structure_builder::free_staging_data() {
-  for (auto& build_info : m_build_infos) {
-    build_info.free_staging_data();
-  }
-}
-
 }  // namespace wunder::vulkan
\ No newline at end of file
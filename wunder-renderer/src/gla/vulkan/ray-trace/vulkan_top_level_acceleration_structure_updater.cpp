@@ -0,0 +1,136 @@
+#include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure_updater.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "core/wunder_macros.h"
+#include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure.h"
+#include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure_build_info.h"
+#include "gla/vulkan/vulkan_buffer.h"
+#include "gla/vulkan/vulkan_device_buffer.h"
+
+namespace wunder::vulkan {
+namespace {
+glm::vec3 get_translation(const VkAccelerationStructureInstanceKHR& instance) {
+  // VkTransformMatrixKHR is a row-major 3x4 matrix
+  return {instance.transform.matrix[0][3], instance.transform.matrix[1][3],
+          instance.transform.matrix[2][3]};
+}
+}  // namespace
+
+top_level_acceleration_structure_updater::
+    top_level_acceleration_structure_updater(
+        const top_level_acceleration_structure_build_info& build_info) {
+  store_built_translations(build_info);
+}
+
+top_level_acceleration_structure_updater::
+    ~top_level_acceleration_structure_updater() = default;
+
+void top_level_acceleration_structure_updater::update(
+    VkCommandBuffer command_buffer,
+    top_level_acceleration_structure& acceleration_structure,
+    top_level_acceleration_structure_build_info& build_info) {
+  const auto& build_sizes = build_info.get_vulkan_as_build_sizes_info();
+  if (!m_scratch_buffer) {
+    m_scratch_buffer = std::make_unique<storage_device_buffer>(
+        descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""},
+        std::max(build_sizes.buildScratchSize, build_sizes.updateScratchSize),
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  }
+
+  const bool rebuild = is_rebuild_needed(build_info);
+
+  // Frames in flight may still trace the structure that's about to change,
+  // the previous update may still be using the scratch buffer
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                          VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                          VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+                           VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  build_info.write_instances(build_info.get_current_frame());
+
+  auto& vulkan_build_info = build_info.mutable_build_info();
+  vulkan_build_info.mode = rebuild
+                               ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR
+                               : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+  vulkan_build_info.srcAccelerationStructure =
+      rebuild ? VK_NULL_HANDLE : acceleration_structure.m_descriptor;
+  vulkan_build_info.dstAccelerationStructure =
+      acceleration_structure.m_descriptor;
+  vulkan_build_info.scratchData.deviceAddress =
+      m_scratch_buffer->get_address();
+
+  const VkAccelerationStructureBuildRangeInfoKHR* build_range_info =
+      build_info.get_vulkan_as_build_offset_info().data();
+  vkCmdBuildAccelerationStructuresKHR(command_buffer, 1, &vulkan_build_info,
+                                      &build_range_info);
+
+  barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+
+  if (rebuild) {
+    store_built_translations(build_info);
+    WUNDER_INFO_TAG("Renderer",
+                    "Top level acceleration structure rebuilt after {0} refits",
+                    m_refits_since_build);
+    m_refits_since_build = 0;
+  } else {
+    ++m_refits_since_build;
+  }
+}
+
+bool top_level_acceleration_structure_updater::is_rebuild_needed(
+    const top_level_acceleration_structure_build_info& build_info) const {
+  ReturnIf(m_refits_since_build >= k_max_refits, true);
+
+  const auto& instances = build_info.get_instances();
+  AssertReturnUnless(instances.size() == m_built_translations.size(), true);
+
+  const float max_displacement = k_max_relative_displacement * m_built_extent;
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    ReturnIf(glm::distance(get_translation(instances[i]),
+                           m_built_translations[i]) > max_displacement,
+             true);
+  }
+
+  return false;
+}
+
+void top_level_acceleration_structure_updater::store_built_translations(
+    const top_level_acceleration_structure_build_info& build_info) {
+  const auto& instances = build_info.get_instances();
+
+  m_built_translations.clear();
+  m_built_translations.reserve(instances.size());
+
+  glm::vec3 min_translation(std::numeric_limits<float>::max());
+  glm::vec3 max_translation(std::numeric_limits<float>::lowest());
+  for (const auto& instance : instances) {
+    const glm::vec3 translation = get_translation(instance);
+    m_built_translations.emplace_back(translation);
+
+    min_translation = glm::min(min_translation, translation);
+    max_translation = glm::max(max_translation, translation);
+  }
+
+  // A single instance, or instances sharing one origin, still get some slack
+  m_built_extent = instances.empty()
+                       ? 1.f
+                       : std::max(glm::distance(min_translation,
+                                                max_translation),
+                                  1.f);
+}
+}  // namespace wunder::vulkan
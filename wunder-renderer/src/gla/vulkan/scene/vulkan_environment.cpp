@@ -14,14 +14,26 @@ vulkan_environment::~vulkan_environment() {
   if (m_acceleration_data.m_buffer) {
     m_acceleration_data.m_buffer.reset();
   }
+
+  if (m_irradiance_sh) {
+    m_irradiance_sh.reset();
+  }
+
+  if (m_prefiltered_specular) {
+    m_prefiltered_specular.reset();
+  }
 }
 
 void vulkan_environment::add_descriptor_to(descriptor_set_manager& target) const {
   AssertReturnUnless(m_image);
   AssertReturnUnless(m_acceleration_data.m_buffer);
+  AssertReturnUnless(m_irradiance_sh);
+  AssertReturnUnless(m_prefiltered_specular);
 
   m_image->add_descriptor_to(target);
   m_acceleration_data.m_buffer->add_descriptor_to(target);
+  m_irradiance_sh->add_descriptor_to(target);
+  m_prefiltered_specular->add_descriptor_to(target);
 }
 
 }
\ No newline at end of file
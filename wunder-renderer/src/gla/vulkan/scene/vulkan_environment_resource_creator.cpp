@@ -1,10 +1,14 @@
 #include "gla/vulkan/scene/vulkan_environment_resource_creator.h"
 
+#include <fstream>
 #include <numeric>
 
 #include "assets/asset_manager.h"
 #include "assets/texture_asset.h"
+#include "core/hash_utils.h"
+#include "core/parallel_for.h"
 #include "core/project.h"
+#include "core/wunder_filesystem.h"
 #include "core/wunder_macros.h"
 #include "gla/vulkan/scene/vulkan_environment.h"
 #include "gla/vulkan/vulkan_device_buffer.h"
@@ -18,6 +22,28 @@ float luminance(const float* color) {
   return color[0] * 0.2126f + color[1] * 0.7152f + color[2] * 0.0722f;
 }
 
+// Bump whenever the layout of the cache or the way the tables are built
+// changes, so stale files are rebuilt instead of being read.
+constexpr std::uint32_t k_environment_accel_cache_version = 1;
+constexpr std::uint32_t k_environment_accel_cache_magic = 0x43414e45;  // ENAC
+
+struct environment_accel_cache_header {
+  std::uint32_t m_magic = k_environment_accel_cache_magic;
+  std::uint32_t m_version = k_environment_accel_cache_version;
+  std::uint32_t m_width = 0;
+  std::uint32_t m_height = 0;
+  std::uint32_t m_accel_stride = sizeof(EnvAccel);
+  float m_integral = 0.f;
+  float m_average_luminance = 0.f;
+  std::uint32_t m_padding = 0;
+};
+
+std::filesystem::path get_environment_accel_cache_path(
+    const environment_texture_asset& asset) {
+  return wunder_filesystem::instance().get_cache_dir("environment") /
+         (hash::utils::hash_to_string(asset.m_source_hash) + ".envaccel");
+}
+
 }  // namespace
 
 unique_ptr<vulkan_environment>
@@ -40,6 +66,7 @@ vulkan_environment_resource_creator::create_environment_texture() {
       first_environment_texture.get());
   // Needed acceleration metadata
   create_environment_accel(first_environment_texture.get(), *environment);
+  create_environment_ambient(first_environment_texture.get(), *environment);
 
   return environment;
 }
@@ -50,59 +77,108 @@ vulkan_environment_resource_creator::create_environment_texture() {
 void vulkan_environment_resource_creator::create_environment_accel(
     const environment_texture_asset& asset,
     vulkan_environment& out_environment_data) {
-  std::visit(
-      overloaded{
-          [](const std::vector<unsigned char>& /*pixels*/) -> void {
-            WUNDER_ERROR(
-                "Environment map components couldn't be with size less than "
-                "32bits");
-          },
-          [&asset,
-           &out_environment_data](const std::vector<float>& pixels) -> void {
-            create_environment_accel(asset, out_environment_data, pixels);
-          }},
-      asset.m_texture_data.m_data);
+  environment_accel_data accel_data;
+  ReturnUnless(create_environment_accel_data(asset, accel_data));
+
+  out_environment_data.m_acceleration_data.m_average_luminance =
+      accel_data.m_average_luminance;
+  out_environment_data.m_acceleration_data.m_integral = accel_data.m_integral;
+  out_environment_data.m_acceleration_data.m_buffer =
+      std::make_unique<storage_device_buffer>(
+          descriptor_build_data{.m_enabled = true,
+                                .m_descriptor_name = "_EnvAccel"},
+          accel_data.m_env_accels.data(),
+          accel_data.m_env_accels.size() * sizeof(EnvAccel),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 }
 
-void vulkan_environment_resource_creator::create_environment_accel(
+bool vulkan_environment_resource_creator::create_environment_accel_data(
+    const environment_texture_asset& asset,
+    environment_accel_data& out_accel_data) {
+  const auto* pixels =
+      std::get_if<std::vector<float>>(&asset.m_texture_data.m_data);
+  if (!pixels) {
+    WUNDER_ERROR(
+        "Environment map components couldn't be with size less than 32bits");
+    return false;
+  }
+
+  if (!load_environment_accel_cache(asset, out_accel_data)) {
+    build_environment_accel(asset, *pixels, out_accel_data);
+    save_environment_accel_cache(asset, out_accel_data);
+  }
+
+  return true;
+}
+
+void vulkan_environment_resource_creator::create_environment_ambient(
     const environment_texture_asset& asset,
-    vulkan_environment& out_environment_data,
-    const std::vector<float>& pixels) {
+    vulkan_environment& out_environment_data) {
+  out_environment_data.m_irradiance_sh =
+      std::make_unique<storage_device_buffer>(
+          descriptor_build_data{.m_enabled = true,
+                                .m_descriptor_name = "_EnvIrradianceSH"},
+          asset.m_irradiance_sh.data(),
+          asset.m_irradiance_sh.size() * sizeof(glm::vec4),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  out_environment_data.m_prefiltered_specular =
+      std::make_unique<sampled_texture>(
+          descriptor_build_data{.m_enabled = true,
+                                .m_descriptor_name = "environmentPrefiltered"},
+          asset.m_prefiltered_specular);
+}
+
+void vulkan_environment_resource_creator::build_environment_accel(
+    const environment_texture_asset& asset, const std::vector<float>& pixels,
+    environment_accel_data& out_accel_data) {
   const uint32_t rx = asset.m_width;
   const uint32_t ry = asset.m_height;
+  const std::size_t texels_count = std::size_t{rx} * ry;
 
   // Create importance sampling data
-  std::vector<EnvAccel> env_accels(rx * ry);
-  std::vector<float> importance_data(rx * ry);
+  std::vector<EnvAccel>& env_accels = out_accel_data.m_env_accels;
+  env_accels.resize(texels_count);
+  std::vector<float> importance_data(texels_count);
 
-  float cos_theta0 = 1.0f;
   const float step_phi = float(2.0 * M_PI) / float(rx);
   const float step_theta = float(M_PI) / float(ry);
-  double total = 0;
 
   // For each texel of the environment map, we compute the related
   // solid angle subtended by the texel, and store the weighted
   // luminance in importance_data, representing the amount of energy
-  // emitted through each texel. Also compute the average CIE
-  // luminance to drive the tonemapping of the final image
-  for (uint32_t y = 0; y < ry; ++y) {
-    const float theta1 = float(y + 1) * step_theta;
-    const float cos_theta1 = std::cos(theta1);
-    const float area = (cos_theta0 - cos_theta1) * step_phi;  // solid angle
-    cos_theta0 = cos_theta1;
+  // emitted through each texel. Rows are independent, the cosine of the
+  // upper edge is evaluated with the same expression the lower edge of the
+  // previous row used, so the result doesn't depend on the split.
+  parallel_for(
+      ry,
+      [&](std::size_t begin, std::size_t end) {
+        for (auto y = static_cast<uint32_t>(begin); y < end; ++y) {
+          const float cos_theta0 =
+              y == 0 ? 1.0f : std::cos(float(y) * step_theta);
+          const float cos_theta1 = std::cos(float(y + 1) * step_theta);
+          const float area =
+              (cos_theta0 - cos_theta1) * step_phi;  // solid angle
 
-    for (uint32_t x = 0; x < rx; ++x) {
-      const uint32_t idx = y * rx + x;
-      const uint32_t idx4 = idx * 4;
-      float cie_luminance = luminance(&pixels[idx4]);
-      importance_data[idx] =
-          area *
-          std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2]));
-      total += cie_luminance;
-    }
+          for (uint32_t x = 0; x < rx; ++x) {
+            const std::size_t idx = std::size_t{y} * rx + x;
+            const std::size_t idx4 = idx * 4;
+            importance_data[idx] =
+                area * std::max(pixels[idx4], std::max(pixels[idx4 + 1],
+                                                       pixels[idx4 + 2]));
+          }
+        }
+      },
+      8);
+
+  // Average CIE luminance drives the tonemapping of the final image. The sum
+  // is kept sequential, so it's accumulated in the same order as always.
+  double total = 0;
+  for (std::size_t idx = 0; idx < texels_count; ++idx) {
+    total += luminance(&pixels[idx * 4]);
   }
 
-  out_environment_data.m_acceleration_data.m_average_luminance =
+  out_accel_data.m_average_luminance =
       static_cast<float>(total) / static_cast<float>(rx * ry);
 
   // Build the alias map, which aims at creating a set of texel
@@ -111,36 +187,31 @@ void vulkan_environment_resource_creator::create_environment_accel(
   // an "alias" with higher emitted radiance As a byproduct this
   // function also returns the integral of the radiance emitted by the
   // environment
-  out_environment_data.m_acceleration_data.m_integral =
-      build_alias_map(importance_data, env_accels);
+  out_accel_data.m_integral = build_alias_map(importance_data, env_accels);
 
   // We deduce the PDF of each texel by normalizing its emitted
   // radiance by the radiance integral
-  const float invEnvIntegral =
-      1.0f / out_environment_data.m_acceleration_data.m_integral;
-  for (uint32_t i = 0; i < rx * ry; ++i) {
-    const uint32_t idx4 = i * 4;
-    env_accels[i].pdf =
-        std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2])) *
-        invEnvIntegral;
-  }
+  const float invEnvIntegral = 1.0f / out_accel_data.m_integral;
+  parallel_for(texels_count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const std::size_t idx4 = i * 4;
+      env_accels[i].pdf =
+          std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2])) *
+          invEnvIntegral;
+    }
+  });
 
   // At runtime a texel will be uniformly chosen. Whether that texel
   // or its alias is selected depends on the relative emitted
   // radiances of the two texels. We store the PDF of the alias
   // together with the PDF of the first member, so that both PDFs are
   // available in a single lookup
-  for (uint32_t i = 0; i < rx * ry; ++i) {
-    const uint32_t aliasIdx = env_accels[i].alias;
-    env_accels[i].aliasPdf = env_accels[aliasIdx].pdf;
-  }
-
-  out_environment_data.m_acceleration_data.m_buffer =
-      std::make_unique<storage_device_buffer>(
-          descriptor_build_data{.m_enabled = true,
-                                .m_descriptor_name = "_EnvAccel"},
-          env_accels.data(), env_accels.size() * sizeof(EnvAccel),
-          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  parallel_for(texels_count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const uint32_t aliasIdx = env_accels[i].alias;
+      env_accels[i].aliasPdf = env_accels[aliasIdx].pdf;
+    }
+  });
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -156,7 +227,8 @@ float vulkan_environment_resource_creator::build_alias_map(
 
   // Compute the integral of the emitted radiance of the environment map
   // Since each element in data is already weighted by its solid angle
-  // the integral is a simple sum
+  // the integral is a simple sum. Float addition isn't associative, so the
+  // sum stays sequential to keep the table identical between runs.
   float sum = std::accumulate(data.begin(), data.end(), 0.f);
 
   // For each texel, compute the ratio q between the emitted radiance of the
@@ -164,28 +236,57 @@ float vulkan_environment_resource_creator::build_alias_map(
   // initialize the aliases to identity, ie. each texel is its own alias
   auto f_size = static_cast<float>(size);
   float inverse_average = f_size / sum;
-  for (uint32_t i = 0; i < size; ++i) {
-    accel[i].q = data[i] * inverse_average;
-    accel[i].alias = i;
-  }
 
   // Partition the texels according to their emitted radiance ratio wrt.
   // average. Texels with a value q < 1 (ie. below average) are stored
   // incrementally from the beginning of the array, while texels emitting
-  // higher-than-average radiance are stored from the end of the array
+  // higher-than-average radiance are stored from the end of the array.
+  // Every chunk counts its small texels first, prefix sums of the counts give
+  // each chunk its write position, so the table is laid out exactly as a
+  // sequential pass would do it.
+  const std::size_t chunks_count = get_parallel_chunks_count(size, 4096);
+  std::vector<uint32_t> chunk_small_count(chunks_count, 0);
+  parallel_for_chunks(
+      size, chunks_count,
+      [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        uint32_t small_count = 0;
+        for (auto i = static_cast<uint32_t>(begin); i < end; ++i) {
+          accel[i].q = data[i] * inverse_average;
+          accel[i].alias = i;
+          small_count += accel[i].q < 1.f ? 1u : 0u;
+        }
+        chunk_small_count[chunk_idx] = small_count;
+      });
+
   std::vector<uint32_t> partition_table(size);
+  parallel_for_chunks(
+      size, chunks_count,
+      [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        auto small_before = std::accumulate(
+            chunk_small_count.begin(),
+            chunk_small_count.begin() + static_cast<std::ptrdiff_t>(chunk_idx),
+            0u);
+        auto large_before = static_cast<uint32_t>(begin) - small_before;
+
+        uint32_t s = small_before;
+        uint32_t large = size - large_before;
+        for (auto i = static_cast<uint32_t>(begin); i < end; ++i) {
+          if (accel[i].q < 1.f) {
+            partition_table[s++] = i;
+          } else {
+            partition_table[--large] = i;
+          }
+        }
+      });
+
   uint32_t s = 0u;
-  uint32_t large = size;
-  for (uint32_t i = 0; i < size; ++i) {
-    if (accel[i].q < 1.f) {
-      partition_table[s++] = i;
-    } else {
-      partition_table[--large] = i;
-    }
-  }
+  uint32_t large = std::accumulate(chunk_small_count.begin(),
+                                   chunk_small_count.end(), 0u);
 
   // Associate the lower-energy texels to higher-energy ones. Since the emission
   // of a high-energy texel may be vastly superior to the average,
+  // This is the Vose pairing step, every small texel is visited once and the
+  // large cursor only moves forward, so it stays linear and sequential.
   for (s = 0; s < large && large < size; ++s) {
     // Index of the smaller energy texel
     const uint32_t small_energy_index = partition_table[s];
@@ -223,4 +324,173 @@ float vulkan_environment_resource_creator::build_alias_map(
   // normalize the probability distribution function (PDF) of each pixel
   return sum;
 }
-}  // namespace wunder::vulkan
\ No newline at end of file
+
+//--------------------------------------------------------------------------------------------------
+// The builder as it was before it ran on worker threads. Not used by the
+// renderer, wunder-environment-accel-check compares the parallel builder's
+// tables against it.
+void vulkan_environment_resource_creator::build_environment_accel_serial(
+    const environment_texture_asset& asset, const std::vector<float>& pixels,
+    environment_accel_data& out_accel_data) {
+  const uint32_t rx = asset.m_width;
+  const uint32_t ry = asset.m_height;
+  const std::size_t texels_count = std::size_t{rx} * ry;
+
+  std::vector<EnvAccel>& env_accels = out_accel_data.m_env_accels;
+  env_accels.resize(texels_count);
+  std::vector<float> importance_data(texels_count);
+
+  float cos_theta0 = 1.0f;
+  const float step_phi = float(2.0 * M_PI) / float(rx);
+  const float step_theta = float(M_PI) / float(ry);
+  double total = 0;
+
+  for (uint32_t y = 0; y < ry; ++y) {
+    const float theta1 = float(y + 1) * step_theta;
+    const float cos_theta1 = std::cos(theta1);
+    const float area = (cos_theta0 - cos_theta1) * step_phi;  // solid angle
+    cos_theta0 = cos_theta1;
+
+    for (uint32_t x = 0; x < rx; ++x) {
+      const std::size_t idx = std::size_t{y} * rx + x;
+      const std::size_t idx4 = idx * 4;
+      float cie_luminance = luminance(&pixels[idx4]);
+      importance_data[idx] =
+          area *
+          std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2]));
+      total += cie_luminance;
+    }
+  }
+
+  out_accel_data.m_average_luminance =
+      static_cast<float>(total) / static_cast<float>(rx * ry);
+  out_accel_data.m_integral = build_alias_map_serial(importance_data,
+                                                     env_accels);
+
+  const float invEnvIntegral = 1.0f / out_accel_data.m_integral;
+  for (std::size_t i = 0; i < texels_count; ++i) {
+    const std::size_t idx4 = i * 4;
+    env_accels[i].pdf =
+        std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2])) *
+        invEnvIntegral;
+  }
+
+  for (std::size_t i = 0; i < texels_count; ++i) {
+    const uint32_t aliasIdx = env_accels[i].alias;
+    env_accels[i].aliasPdf = env_accels[aliasIdx].pdf;
+  }
+}
+
+float vulkan_environment_resource_creator::build_alias_map_serial(
+    const std::vector<float>& data, std::vector<EnvAccel>& accel) {
+  auto size = static_cast<uint32_t>(data.size());
+
+  float sum = std::accumulate(data.begin(), data.end(), 0.f);
+
+  auto f_size = static_cast<float>(size);
+  float inverse_average = f_size / sum;
+  for (uint32_t i = 0; i < size; ++i) {
+    accel[i].q = data[i] * inverse_average;
+    accel[i].alias = i;
+  }
+
+  std::vector<uint32_t> partition_table(size);
+  uint32_t s = 0u;
+  uint32_t large = size;
+  for (uint32_t i = 0; i < size; ++i) {
+    if (accel[i].q < 1.f) {
+      partition_table[s++] = i;
+    } else {
+      partition_table[--large] = i;
+    }
+  }
+
+  for (s = 0; s < large && large < size; ++s) {
+    const uint32_t small_energy_index = partition_table[s];
+    const uint32_t high_energy_index = partition_table[large];
+
+    accel[small_energy_index].alias = high_energy_index;
+    accel[high_energy_index].q -= 1.f - accel[small_energy_index].q;
+    if (accel[high_energy_index].q < 1.0f) {
+      ++large;
+    }
+  }
+
+  return sum;
+}
+
+bool vulkan_environment_resource_creator::load_environment_accel_cache(
+    const environment_texture_asset& asset,
+    environment_accel_data& out_accel_data) {
+  ReturnIf(asset.m_source_hash == 0, false);
+
+  auto cache_path = get_environment_accel_cache_path(asset);
+  std::ifstream cache_file(cache_path, std::ios::binary);
+  ReturnUnless(cache_file.is_open(), false);
+
+  environment_accel_cache_header header;
+  cache_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  ReturnUnless(cache_file.good(), false);
+
+  environment_accel_cache_header expected_header;
+  ReturnIf(header.m_magic != expected_header.m_magic, false);
+  ReturnIf(header.m_version != expected_header.m_version, false);
+  ReturnIf(header.m_accel_stride != expected_header.m_accel_stride, false);
+  ReturnIf(header.m_width != asset.m_width || header.m_height != asset.m_height,
+           false);
+
+  out_accel_data.m_env_accels.resize(std::size_t{asset.m_width} *
+                                     asset.m_height);
+  cache_file.read(
+      reinterpret_cast<char*>(out_accel_data.m_env_accels.data()),
+      static_cast<std::streamsize>(out_accel_data.m_env_accels.size() *
+                                   sizeof(EnvAccel)));
+  if (!cache_file.good()) {
+    WUNDER_WARN_TAG("Renderer", "Truncated environment cache {0}, rebuilding",
+                    cache_path.string());
+    out_accel_data.m_env_accels.clear();
+    return false;
+  }
+
+  out_accel_data.m_integral = header.m_integral;
+  out_accel_data.m_average_luminance = header.m_average_luminance;
+
+  WUNDER_INFO_TAG("Renderer", "Environment importance tables loaded from {0}",
+                  cache_path.string());
+  return true;
+}
+
+void vulkan_environment_resource_creator::save_environment_accel_cache(
+    const environment_texture_asset& asset,
+    const environment_accel_data& accel_data) {
+  ReturnIf(asset.m_source_hash == 0);
+
+  auto cache_path = get_environment_accel_cache_path(asset);
+  // Written next to the final file and renamed, a crash mid-write never
+  // leaves a truncated cache behind.
+  auto temp_path = cache_path;
+  temp_path += ".tmp";
+
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    AssertReturnUnless(cache_file.is_open());
+
+    environment_accel_cache_header header;
+    header.m_width = asset.m_width;
+    header.m_height = asset.m_height;
+    header.m_integral = accel_data.m_integral;
+    header.m_average_luminance = accel_data.m_average_luminance;
+
+    cache_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    cache_file.write(
+        reinterpret_cast<const char*>(accel_data.m_env_accels.data()),
+        static_cast<std::streamsize>(accel_data.m_env_accels.size() *
+                                     sizeof(EnvAccel)));
+    AssertReturnUnless(cache_file.good());
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temp_path, cache_path, error);
+  AssertReturnIf(static_cast<bool>(error));
+}
+}  // namespace wunder::vulkan
@@ -15,13 +15,8 @@ using host_light_array = std::vector<host_light_type>;
 unique_ptr<storage_buffer> lights_resource_creator::create_light_buffer(
     const std::vector<const_ref<scene_node>>& light_nodes,
     std::uint64_t& out_lights_count) {
-  vector_map<asset_handle, transform_component> transformations;
-
-  assets<light_asset> light_assets =
-      extract_scene_light_data(light_nodes, transformations);
-
-  host_light_array host_lights =
-      create_host_light_array(transformations, light_assets);
+  host_light_array host_lights = create_host_lights(
+      light_nodes, project::instance().get_asset_manager().get_storage());
 
   out_lights_count = host_lights.size();
 
@@ -32,11 +27,21 @@ unique_ptr<storage_buffer> lights_resource_creator::create_light_buffer(
       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
 }
 
+std::vector<Light> lights_resource_creator::create_host_lights(
+    const std::vector<const_ref<scene_node>>& light_nodes,
+    const asset_storage& storage) {
+  vector_map<asset_handle, transform_component> transformations;
+
+  assets<light_asset> light_assets =
+      extract_scene_light_data(light_nodes, storage, transformations);
+
+  return create_host_light_array(transformations, light_assets);
+}
+
 assets<light_asset> lights_resource_creator::extract_scene_light_data(
     const std::vector<const_ref<scene_node>>& light_nodes,
+    const asset_storage& storage,
     vector_map<asset_handle, transform_component>& out_transformations) {
-  auto& asset_manager = project::instance().get_asset_manager();
-
   std::vector<asset_handle> light_asset_handles;
   for (auto& light_ref : light_nodes) {
     optional_const_ref<light_component> maybe_light_component =
@@ -51,8 +56,15 @@ assets<light_asset> lights_resource_creator::extract_scene_light_data(
     out_transformations[light_handle] = maybe_transform_component->get();
   }
 
-  auto result = asset_manager.find_assets<light_asset>(
-      light_asset_handles.begin(), light_asset_handles.end());
+  assets<light_asset> result;
+  for (asset_handle light_handle : light_asset_handles) {
+    ContinueUnless(light_handle.is_valid());
+
+    auto maybe_light_asset = storage.find_asset<light_asset>(light_handle);
+    AssertContinueUnless(maybe_light_asset.has_value());
+
+    result.emplace_back(light_handle, *maybe_light_asset);
+  }
   if (result.empty()) {
     result.emplace_back(asset_handle::invalid(), get_default_light_asset());
     out_transformations.emplace_back(asset_handle::invalid(),
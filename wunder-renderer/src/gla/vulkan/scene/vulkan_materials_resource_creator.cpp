@@ -50,6 +50,21 @@ materials_resource_creator::extract_material_assets(
 
 unique_ptr<storage_buffer> materials_resource_creator::create_material_buffer(
     const assets<texture_asset>& texture_assets) {
+  std::vector<GltfShadeMaterial> shader_materials =
+      create_host_materials(material_assets, texture_assets);
+
+  return std::move(std::make_unique<storage_device_buffer>(
+      descriptor_build_data{.m_enabled = true,
+                            .m_descriptor_name = "_MaterialBuffer"},
+      shader_materials.data(),
+      shader_materials.size() * sizeof(GltfShadeMaterial),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+}
+
+std::vector<GltfShadeMaterial> materials_resource_creator::create_host_materials(
+    const assets<material_asset>& material_assets,
+    const assets<texture_asset>& texture_assets) {
   auto create_shader_material = [&texture_assets](
                                     const material_asset& asset,
                                     GltfShadeMaterial& out_shader_material) {
@@ -95,13 +110,7 @@ unique_ptr<storage_buffer> materials_resource_creator::create_material_buffer(
     create_shader_material(material_ref.get(), shader_materials.emplace_back());
   }
 
-  return std::move(std::make_unique<storage_device_buffer>(
-      descriptor_build_data{.m_enabled = true,
-                            .m_descriptor_name = "_MaterialBuffer"},
-      shader_materials.data(),
-      shader_materials.size() * sizeof(GltfShadeMaterial),
-      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+  return shader_materials;
 }
 
 const material_asset& materials_resource_creator::get_default_material() {
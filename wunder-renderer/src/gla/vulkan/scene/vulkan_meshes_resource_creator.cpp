@@ -1,13 +1,23 @@
 #include "gla/vulkan/scene/vulkan_meshes_resource_creator.h"
 
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <format>
 #include <functional>
+#include <limits>
 #include <numeric>
 #include <set>
 #include <unordered_set>
 
 #include "assets/asset_manager.h"
+#include "assets/material_asset.h"
+#include "assets/mesh_asset.h"
+#include "assets/opacity_micromap_baker.h"
+#include "assets/texture_asset.h"
 #include "core/project.h"
 #include "core/vector_map.h"
+#include "core/wunder_features.h"
 #include "core/wunder_macros.h"
 #include "gla/vulkan/ray-trace/vulkan_bottom_level_acceleration_structure_build_info.h"
 #include "gla/vulkan/ray-trace/vulkan_bottom_level_acceleration_structure_builder.h"
@@ -19,11 +29,56 @@
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_geometry_arena.h"
 #include "gla/vulkan/vulkan_index_buffer.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_vertex_buffer.h"
+#include "resources/shaders/material.h"
 
 namespace wunder::vulkan {
+namespace {
+// Coverage of the texels the mesh samples, after the factor and the alpha
+// test pathtrace.rahit applies
+alpha_coverage get_alpha_coverage(const mesh_asset& mesh_asset,
+                                  const material_asset& material) {
+  ReturnIf(material.m_alpha_mode == ALPHA_OPAQUE, alpha_coverage::opaque);
+
+  texture_alpha_coverage::alpha_range range{1.0f, 1.0f};
+  if (material.m_pbr_base_color_texture.is_valid()) {
+    auto maybe_texture =
+        project::instance().get_asset_manager().find_asset<texture_asset>(
+            material.m_pbr_base_color_texture);
+    ReturnUnless(maybe_texture.has_value(), alpha_coverage::unknown);
+
+    const auto& texture_coverage = maybe_texture->get().m_alpha_coverage;
+    ReturnIf(texture_coverage.is_empty(), alpha_coverage::unknown);
+
+    glm::vec2 uv_min(std::numeric_limits<float>::max());
+    glm::vec2 uv_max(std::numeric_limits<float>::lowest());
+    for (const auto& mesh_vertex : mesh_asset.m_vertices) {
+      const glm::vec2 uv(glm::vec4(mesh_vertex.m_texcoord, 1.0f, 1.0f) *
+                         material.m_uv_transform);
+      uv_min = glm::min(uv_min, uv);
+      uv_max = glm::max(uv_max, uv);
+    }
+    range = texture_coverage.get_alpha_range(uv_min, uv_max);
+  }
+
+  const float min_alpha = range.m_min * material.m_pbr_base_color_factor.w;
+  const float max_alpha = range.m_max * material.m_pbr_base_color_factor.w;
+  if (material.m_alpha_mode == ALPHA_MASK) {
+    ReturnIf(min_alpha > material.m_alpha_cutoff, alpha_coverage::opaque);
+    ReturnIf(max_alpha <= material.m_alpha_cutoff,
+             alpha_coverage::transparent);
+    return alpha_coverage::mixed;
+  }
+
+  ReturnIf(min_alpha >= 1.0f, alpha_coverage::opaque);
+  ReturnIf(max_alpha <= 0.0f, alpha_coverage::transparent);
+  return alpha_coverage::mixed;
+}
+}  // namespace
+
 meshes_resource_creator::meshes_resource_creator(
     std::vector<const_ref<scene_node>>& input_mesh_scene_nodes,
     std::vector<vulkan_mesh_scene_node>& out_vulkan_mesh_scene_nodes)
@@ -67,18 +122,30 @@ void meshes_resource_creator::create_mesh_scene_nodes(
     auto& mesh_instance = mesh_instance_it->second;
     AssertContinueUnless(mesh_instance);
 
+    // Nodes sharing a mesh share its structure, any override applies to all
+    const auto build_policy = maybe_mesh_component->get().m_build_policy;
+    if (build_policy != acceleration_structure_build_policy::automatic) {
+      mesh_instance->m_build_policy = build_policy;
+    }
+
     m_out_vulkan_mesh_nodes.emplace_back(vulkan_mesh_scene_node{
         .m_mesh = mesh_instance,
         .m_model_matrix = maybe_transform_component->get().m_world_matrix,
     });
   }
 
-  bottom_level_acceleration_structure_builder builder(m_out_vulkan_mesh_nodes);
+  bottom_level_acceleration_structure_builder builder(
+      m_out_vulkan_mesh_nodes, COMPACT_BOTTOM_LEVEL_ACCELERATION_STRUCTURES);
   builder.build();
 }
 
 unique_ptr<storage_buffer>
 meshes_resource_creator::create_mesh_instances_buffer() {
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& vertex_arena = vulkan_context.mutable_vertex_arena();
+  auto& index_arena = vulkan_context.mutable_index_arena();
+
   std::vector<InstanceData> instances;
   instances.reserve(m_out_vulkan_mesh_nodes.size());
 
@@ -87,11 +154,14 @@ meshes_resource_creator::create_mesh_instances_buffer() {
     vulkan_mesh& mesh = *mesh_node.m_mesh;
 
     instances.emplace_back(InstanceData{
-        .vertexAddress = mesh.m_vertex_buffer->get_address(),
-        .indexAddress = mesh.m_index_buffer->get_address(),
+        .vertexAddress =
+            vertex_arena.get_block_address(mesh.m_vertices.m_block),
+        .indexAddress = index_arena.get_block_address(mesh.m_indices.m_block),
+        .vertexOffset = mesh.m_vertices.get_offset(),
+        .indexOffset = mesh.m_indices.get_offset(),
         .materialIndex = static_cast<int>(
             mesh.m_material_idx),  // most probably will never overflow
-        ._pad = glm::vec3{0.f}});
+        ._pad = 0});
   }
 
   unique_ptr<storage_buffer> result;
@@ -126,11 +196,7 @@ void meshes_resource_creator::create_index_and_vertex_buffer(
     vector_map<asset_handle, shared_ptr<vulkan_mesh>>& out_mesh_instances) {
   std::uint32_t i = 0;
   out_mesh_instances.reserve(m_input_mesh_assets.size());
-
-  auto& command_pool = layer_abstraction_factory::instance()
-                           .get_vulkan_context()
-                           .mutable_command_pool();
-  auto command_buffer = command_pool.get_current_compute_command_buffer();
+  std::vector<vulkan_mesh*> micromapped_meshes;
 
   for (const auto& [mesh_id, mesh_asset_ref] : m_input_mesh_assets) {
     auto& [id, _vulkan_mesh] = out_mesh_instances.emplace_back();
@@ -144,37 +210,83 @@ void meshes_resource_creator::create_index_and_vertex_buffer(
     auto& material = material_it->second.get();
 
     _vulkan_mesh = make_shared<vulkan_mesh>();
-    _vulkan_mesh->m_vertex_buffer =
-        std::move(vertex_buffer::create(command_buffer, mesh_asset));
+    _vulkan_mesh->m_vertices = vertex_buffer::create(mesh_asset);
     _vulkan_mesh->m_vertices_count =
         static_cast<uint32_t>(mesh_asset.m_vertices.size());
-    _vulkan_mesh->m_index_buffer =
-        std::move(index_buffer::create(command_buffer, mesh_asset));
+    _vulkan_mesh->m_indices = index_buffer::create(mesh_asset);
     _vulkan_mesh->m_indices_count =
         static_cast<uint32_t>(mesh_asset.m_indices.size());
     _vulkan_mesh->m_idx = i;
     _vulkan_mesh->m_material_idx = material_idx;
-    _vulkan_mesh->m_is_opaque = material.m_alpha_mode == 0 ||
-                                (material.m_pbr_base_color_factor.w == 1.0f &&
-                                 !material.m_pbr_base_color_texture.is_valid());
+    const alpha_coverage coverage = get_alpha_coverage(mesh_asset, material);
+    _vulkan_mesh->m_is_opaque = coverage == alpha_coverage::opaque;
+    if (coverage == alpha_coverage::transparent) {
+      WUNDER_WARN_TAG("Renderer", "Mesh {0} is fully transparent", i);
+    }
     _vulkan_mesh->m_is_double_sided = material.m_double_sided;
 
+#if OPACITY_MICROMAPS
+    if (!_vulkan_mesh->m_is_opaque &&
+        create_opacity_micromap(mesh_asset, material, *_vulkan_mesh)) {
+      micromapped_meshes.emplace_back(_vulkan_mesh.get());
+    }
+#endif
+
     id = mesh_id;
     ++i;
   }
 
-  command_pool.flush_compute_command_buffer();
+  ReturnIf(micromapped_meshes.empty());
 
-  // free staging data
-  for (auto& [_, mesh] : out_mesh_instances) {
-    AssertContinueUnless(mesh);
+  // All micromaps are built in one submission, before any bottom level build
+  layer_abstraction_factory::instance()
+      .get_vulkan_context()
+      .mutable_command_pool()
+      .flush_compute_command_buffer();
+  for (vulkan_mesh* micromapped_mesh : micromapped_meshes) {
+    micromapped_mesh->m_opacity_micromap.free_build_data();
+  }
+}
 
-    if (mesh->m_vertex_buffer) {
-      mesh->m_vertex_buffer->free_staging_data();
-    }
-    if (mesh->m_index_buffer) {
-      mesh->m_index_buffer->free_staging_data();
-    }
+bool meshes_resource_creator::create_opacity_micromap(
+    const mesh_asset& mesh_asset, const material_asset& material,
+    vulkan_mesh& out_mesh) {
+  ReturnUnless(material.m_pbr_base_color_texture.is_valid(), false);
+
+  auto maybe_texture = project::instance()
+                           .get_asset_manager()
+                           .find_asset<texture_asset>(
+                               material.m_pbr_base_color_texture);
+  AssertReturnUnless(maybe_texture.has_value(), false);
+
+  auto maybe_baked_micromap = opacity_micromap_baker::bake(
+      mesh_asset, material, maybe_texture->get(),
+      OPACITY_MICROMAP_SUBDIVISION_LEVEL,
+      static_cast<opacity_micromap_format>(OPACITY_MICROMAP_FORMAT));
+  ReturnUnless(maybe_baked_micromap.has_value(), false);
+
+  const auto& baked_micromap = maybe_baked_micromap.value();
+  WUNDER_INFO_TAG("Renderer",
+                  "Mesh {0} opacity micromap: {1}/{2} triangles run any-hit, "
+                  "{3} unique micromap triangles",
+                  out_mesh.m_idx,
+                  baked_micromap.get_referencing_triangles_count(),
+                  baked_micromap.m_indices.size(),
+                  baked_micromap.get_triangles_count());
+
+  // Nothing left for any-hit to decide
+  if (baked_micromap.is_fully_opaque()) {
+    out_mesh.m_is_opaque = true;
+    return false;
   }
+
+  out_mesh.m_opacity_micromap.create(
+      layer_abstraction_factory::instance()
+          .get_vulkan_context()
+          .mutable_command_pool()
+          .get_current_compute_command_buffer(),
+      baked_micromap, std::format("mesh {}", out_mesh.m_idx));
+
+  return true;
 }
 }  // namespace wunder::vulkan
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure.h"
 #include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure_build_info.h"
 #include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure_builder.h"
+#include "gla/vulkan/ray-trace/vulkan_top_level_acceleration_structure_updater.h"
 #include "gla/vulkan/scene/vulkan_environment.h"
 #include "gla/vulkan/scene/vulkan_environment_resource_creator.h"
 #include "gla/vulkan/scene/vulkan_lights_resource_creator.h"
@@ -23,9 +24,11 @@
 #include "gla/vulkan/scene/vulkan_texture_resource_creator.h"
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_geometry_arena.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_memory_allocator.h"
 #include "gla/vulkan/vulkan_texture.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
 #include "resources/shaders/host_device.h"
 
 namespace wunder::vulkan {
@@ -48,26 +51,45 @@ scene::~scene() {
     m_environment_textures.reset();
   }
 
+  if (m_acceleration_structure_updater) {
+    m_acceleration_structure_updater.reset();
+  }
+
   if (m_acceleration_structure) {
     m_acceleration_structure.reset();
   }
 
   m_acceleration_structure_build_info.clear();
 
+  ReturnIf(m_mesh_nodes.empty());
+
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& vertex_arena = vulkan_context.mutable_vertex_arena();
+  auto& index_arena = vulkan_context.mutable_index_arena();
+
+  // Meshes are shared between nodes, freeing invalidates the range so each
+  // one is given back once
   for (auto& [mesh, _] : m_mesh_nodes) {
     ContinueUnless(mesh);
 
-    if (mesh->m_index_buffer) {
-      mesh->m_index_buffer.reset();
-    }
-
-    if (mesh->m_vertex_buffer) {
-      mesh->m_vertex_buffer.reset();
-    }
+    index_arena.free(mesh->m_indices);
+    vertex_arena.free(mesh->m_vertices);
 
     mesh.reset();
   }
   m_mesh_nodes.clear();
+
+  auto vertex_report = vertex_arena.get_storage_report();
+  auto index_report = index_arena.get_storage_report();
+  WUNDER_INFO_TAG("Renderer",
+                  "Geometry arenas after unload, vertices free: {0} in {1} "
+                  "regions ({2} fragmented), indices free: {3} in {4} regions "
+                  "({5} fragmented)",
+                  vertex_report.m_free_size, vertex_report.m_free_regions_count,
+                  vertex_report.fragmentation(), index_report.m_free_size,
+                  index_report.m_free_regions_count,
+                  index_report.fragmentation());
 }
 
 scene::scene(scene&&) = default;
@@ -108,10 +130,57 @@ void scene::load_scene(const scene_asset& asset) {
           *m_acceleration_structure, m_acceleration_structure_build_info,
           m_mesh_nodes);
   top_level_acceleration_structure_builder.build();
+  AssertReturnIf(m_acceleration_structure_build_info.empty());
+
+  m_acceleration_structure_updater =
+      std::make_unique<top_level_acceleration_structure_updater>(
+          m_acceleration_structure_build_info.front());
 
   m_environment_textures = std::move(
       vulkan_environment_resource_creator::create_environment_texture());
   AssertReturnUnless(m_environment_textures);
+
+  // Don't wait for the copies, the renderer switches to this scene once they
+  // are done
+  m_upload_timeline_value = layer_abstraction_factory::instance()
+                                .get_vulkan_context()
+                                .mutable_upload_manager()
+                                .submit();
+}
+
+bool scene::is_resident() const {
+  return layer_abstraction_factory::instance()
+      .get_vulkan_context()
+      .mutable_upload_manager()
+      .is_complete(m_upload_timeline_value);
+}
+
+void scene::set_instance_transform(std::uint32_t instance_idx,
+                                   const glm::mat4& model_matrix) {
+  AssertReturnUnless(instance_idx < m_mesh_nodes.size());
+  AssertReturnIf(m_acceleration_structure_build_info.empty());
+
+  m_mesh_nodes[instance_idx].m_model_matrix = model_matrix;
+  m_acceleration_structure_build_info.front().set_instance_transform(
+      instance_idx, model_matrix);
+  m_have_instances_moved = true;
+}
+
+std::uint32_t scene::get_instances_count() const {
+  return static_cast<std::uint32_t>(m_mesh_nodes.size());
+}
+
+bool scene::update_acceleration_structure(VkCommandBuffer command_buffer) {
+  ReturnUnless(m_have_instances_moved, false);
+  AssertReturnUnless(m_acceleration_structure_updater, false);
+  AssertReturnIf(m_acceleration_structure_build_info.empty(), false);
+
+  m_acceleration_structure_updater->update(
+      command_buffer, *m_acceleration_structure,
+      m_acceleration_structure_build_info.front());
+  m_have_instances_moved = false;
+
+  return true;
 }
 
 void scene::collect_descriptors(descriptor_set_manager& target) {
@@ -1,5 +1,6 @@
 #include "gla/vulkan/vulkan_base_pipeline.h"
 
+#include "core/hash_utils.h"
 #include "gla/vulkan/descriptors/vulkan_descriptor_set_manager.h"
 #include "gla/vulkan/rasterize/vulkan_swap_chain.h"
 #include "gla/vulkan/vulkan_context.h"
@@ -61,6 +62,21 @@ void base_pipeline::create_shader_stage_create_info(
   }
 }
 
+std::uint64_t base_pipeline::get_shaders_hash(
+    const vector_map<VkShaderStageFlagBits, std::vector<unique_ptr<shader>>>&
+        shaders_of_types) {
+  std::uint64_t result = hash::utils::k_fnv_offset_basis;
+  for (auto& [shader_type, shaders] : shaders_of_types) {
+    result = hash::utils::fnv1a_64(&shader_type, sizeof(shader_type), result);
+    for (auto& shader : shaders) {
+      const std::uint64_t spirv_hash = shader->get_spirv_hash();
+      result = hash::utils::fnv1a_64(&spirv_hash, sizeof(spirv_hash), result);
+    }
+  }
+
+  return result;
+}
+
 void base_pipeline::bind() {
   auto graphic_command_buffer = layer_abstraction_factory::instance()
                                     .get_render_context()
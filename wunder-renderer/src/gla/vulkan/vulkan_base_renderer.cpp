@@ -1,5 +1,15 @@
 #include "gla/vulkan/vulkan_base_renderer.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <expected>
+#include <latch>
+#include <thread>
+#include <vector>
+
+#include "core/async_task.h"
+#include "core/task_executor.h"
+#include "core/time_unit.h"
 #include "core/wunder_macros.h"
 #include "gla/vulkan/descriptors/vulkan_descriptor_set_manager.h"
 #include "gla/vulkan/vulkan_context.h"
@@ -7,8 +17,47 @@
 #include "gla/vulkan/vulkan_shader.h"
 
 namespace wunder::vulkan {
+namespace {
+struct shader_job {
+  VkShaderStageFlagBits m_stage;
+  shader_to_compile* m_compile_data;
+  std::expected<shader_binary, shader_operation_output_code> m_binary;
+};
+
+/**
+ * Preprocessing, cache lookups and compilation don't need the device, they
+ * run on the compile workers. The latch releases the waiting thread once all
+ * jobs ran, every task is then handed back to it through the executor.
+ */
+class shader_load_task : public async_task {
+ public:
+  shader_load_task(shader_job& job, std::latch& loaded_latch,
+                   std::size_t& finished_count)
+      : m_job(job),
+        m_loaded_latch(loaded_latch),
+        m_finished_count(finished_count) {}
+
+ private:
+  void run() override {
+    m_job.m_binary = shader::load_spirv(m_job.m_compile_data->m_shader_path,
+                                        m_job.m_stage);
+    m_loaded_latch.count_down();
+  }
+
+  void execute_on_main_thread() override { ++m_finished_count; }
 
-base_renderer::~base_renderer() = default;
+ private:
+  shader_job& m_job;
+  std::latch& m_loaded_latch;
+  std::size_t& m_finished_count;
+};
+}  // namespace
+
+base_renderer::~base_renderer() {
+  if (m_shader_compile_executor) {
+    m_shader_compile_executor->shutdown();
+  }
+}
 
 descriptor_set_manager &base_renderer::mutable_descriptor_set_manager() {
   return *m_descriptor_set_manager;
@@ -42,30 +91,53 @@ void base_renderer::init(scene_id scene_id) {
 }
 
 void base_renderer::initialize_shaders() {
-  for (auto &[shader_type, shaders_compile_data] :
-       get_shaders_for_compilation()) {
-    auto &shaders_of_type = m_shaders[shader_type];
+  auto shaders_for_compilation = get_shaders_for_compilation();
 
+  std::vector<shader_job> jobs;
+  for (auto &[shader_type, shaders_compile_data] : shaders_for_compilation) {
     for (auto &shader_compile_data : shaders_compile_data) {
-      auto maybe_shader =
-          shader::create(shader_compile_data.m_shader_path, shader_type);
-      if (maybe_shader.has_value()) {
-        auto &shader =
-            shaders_of_type.emplace_back(std::move(maybe_shader.value()));
-
-        ContinueUnless(shader_compile_data.m_on_successful_compile);
-        shader_compile_data.m_on_successful_compile(*shader);
-        continue;
-      }
-
-      WUNDER_ERROR_TAG("Renderer",
-                       "Failed to compile {0} of type {1}. Error:  {2}",
-                       shader_compile_data.m_shader_path.string(),
-                       static_cast<int>(shader_type),
-                       static_cast<int>(maybe_shader.error()));
-      ContinueIf(shader_compile_data.m_optional);
-      CRASH;
+      jobs.push_back(shader_job{
+          shader_type, &shader_compile_data,
+          std::unexpected(shader_operation_output_code::Error)});
     }
   }
+
+  if (!m_shader_compile_executor) {
+    m_shader_compile_executor = make_unique<task_executor>(
+        std::max(1u, std::thread::hardware_concurrency()));
+  }
+
+  std::latch loaded_latch(static_cast<std::ptrdiff_t>(jobs.size()));
+  std::size_t finished_count = 0;
+  for (auto &job : jobs) {
+    m_shader_compile_executor->enqueue(
+        new shader_load_task(job, loaded_latch, finished_count));
+  }
+
+  // Only creating the shader modules below needs the device
+  loaded_latch.wait();
+  while (finished_count < jobs.size()) {
+    m_shader_compile_executor->update(time_unit{});
+  }
+
+  for (auto &job : jobs) {
+    auto &shader_compile_data = *job.m_compile_data;
+    if (job.m_binary.has_value()) {
+      auto &shader = m_shaders[job.m_stage].emplace_back(shader::create(
+          shader_compile_data.m_shader_path, job.m_stage, job.m_binary.value()));
+
+      ContinueUnless(shader_compile_data.m_on_successful_compile);
+      shader_compile_data.m_on_successful_compile(*shader);
+      continue;
+    }
+
+    WUNDER_ERROR_TAG("Renderer",
+                     "Failed to compile {0} of type {1}. Error:  {2}",
+                     shader_compile_data.m_shader_path.string(),
+                     static_cast<int>(job.m_stage),
+                     static_cast<int>(job.m_binary.error()));
+    ContinueIf(shader_compile_data.m_optional);
+    CRASH;
+  }
 }
 }  // namespace wunder::vulkan
\ No newline at end of file
@@ -1,173 +1,413 @@
 #include "gla/vulkan/vulkan_command_pool.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "core/wunder_macros.h"
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_macros.h"
 #include "gla/vulkan/vulkan_physical_device.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
 
 namespace wunder::vulkan {
-command_pool::command_pool() {
-  context& vulkan_context =
-      layer_abstraction_factory::instance().get_vulkan_context();
-  auto& physical_device = vulkan_context.mutable_physical_device();
-  auto& logical_device = vulkan_context.mutable_device();
-
-  VkCommandPoolCreateInfo cmd_pool_info = {};
-  cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  cmd_pool_info.queueFamilyIndex =
-      physical_device.get_queue_family_indices().Graphics;
-  cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-  VkDevice vulkan_logical_device = logical_device.get_vulkan_logical_device();
-  AssertReturnUnless(vkCreateCommandPool(vulkan_logical_device, &cmd_pool_info,
-                                         nullptr, &m_graphics_command_pool) ==
-                     VkResult::VK_SUCCESS);
-  set_debug_utils_object_name(vulkan_logical_device, "graphic command pool", m_graphics_command_pool);
-
-  cmd_pool_info.queueFamilyIndex =
-      physical_device.get_queue_family_indices().Compute;
-  AssertReturnUnless(vkCreateCommandPool(vulkan_logical_device, &cmd_pool_info,
-                                         nullptr, &m_compute_command_pool) ==
-                     VkResult::VK_SUCCESS);
-  set_debug_utils_object_name(vulkan_logical_device, "compute command pool", m_compute_command_pool);
-
-}
+command_pool::command_pool() = default;
 
 command_pool::~command_pool() {
   auto& logical_device = layer_abstraction_factory::instance()
                              .get_vulkan_context()
                              .mutable_device();
 
-  auto vulkanDevice = logical_device.get_vulkan_logical_device();
+  auto vulkan_logical_device = logical_device.get_vulkan_logical_device();
+
+  std::lock_guard lock(m_mutex);
+
+  for (auto& submission : m_in_flight_submissions) {
+    VK_CHECK_RESULT(vkWaitForFences(vulkan_logical_device, 1,
+                                    &submission.m_fence, VK_TRUE,
+                                    std::numeric_limits<std::uint64_t>::max()));
+    m_free_fences.push_back(submission.m_fence);
+  }
+  m_in_flight_submissions.clear();
+
+  for (auto fence : m_free_fences) {
+    vkDestroyFence(vulkan_logical_device, fence, nullptr);
+  }
+  m_free_fences.clear();
 
-  vkFreeCommandBuffers(vulkanDevice, m_graphics_command_pool, 1, &m_current_graphics_command_buffer);
-  vkFreeCommandBuffers(vulkanDevice, m_compute_command_pool, 1, &m_current_compute_command_buffer);
+  for (auto& [_, thread_command_pools] : m_thread_command_pools) {
+    destroy_thread_pools(*thread_command_pools);
+  }
+  m_thread_command_pools.clear();
 
-  vkDestroyCommandPool(vulkanDevice, m_graphics_command_pool, nullptr);
-  vkDestroyCommandPool(vulkanDevice, m_compute_command_pool, nullptr);
+  for (auto& thread_command_pools : m_released_thread_command_pools) {
+    destroy_thread_pools(*thread_command_pools);
+  }
+  m_released_thread_command_pools.clear();
 }
 
 VkCommandBuffer command_pool::get_current_graphics_command_buffer() {
-  ReturnUnless(m_current_graphics_command_buffer == VK_NULL_HANDLE,
-               m_current_graphics_command_buffer);
-
-  return allocate_graphics_command_buffer(true);
+  return get_current_command_buffer(queue_type::graphics);
 }
 
 VkCommandBuffer command_pool::get_current_compute_command_buffer() {
-  ReturnUnless(m_current_compute_command_buffer == VK_NULL_HANDLE,
-               m_current_compute_command_buffer);
-
-  return allocate_compute_command_buffer(true);
+  return get_current_command_buffer(queue_type::compute);
 }
 
 void command_pool::flush_graphics_command_buffer() {
-  auto& logical_device = layer_abstraction_factory::instance()
-                             .get_vulkan_context()
-                             .mutable_device();
-
-  flush_command_buffer(m_current_graphics_command_buffer,
-                       m_graphics_command_pool,
-                       logical_device.get_graphics_queue());
+  wait(submit_command_buffer(queue_type::graphics));
 }
 
 void command_pool::flush_compute_command_buffer() {
-  auto& logical_device = layer_abstraction_factory::instance()
-                             .get_vulkan_context()
-                             .mutable_device();
+  wait(submit_command_buffer(queue_type::compute));
+}
 
-  flush_command_buffer(m_current_compute_command_buffer, m_compute_command_pool,
-                       logical_device.get_compute_queue());
+command_pool::submit_ticket command_pool::submit_graphics_command_buffer() {
+  return submit_command_buffer(queue_type::graphics);
 }
 
-void command_pool::flush_command_buffer(VkCommandBuffer& command_buffer,
-                                        VkCommandPool source_pool,
-                                        VkQueue queue) {
-  auto& logical_device = layer_abstraction_factory::instance()
-                             .get_vulkan_context()
-                             .mutable_device();
-  auto vulkan_logical_device = logical_device.get_vulkan_logical_device();
+command_pool::submit_ticket command_pool::submit_compute_command_buffer() {
+  return submit_command_buffer(queue_type::compute);
+}
+
+bool command_pool::is_complete(submit_ticket ticket) {
+  std::lock_guard lock(m_mutex);
+  retire_completed_submissions();
+
+  return find_submission(ticket) == m_in_flight_submissions.end();
+}
 
+void command_pool::wait(submit_ticket ticket) {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
 
-  const uint64_t DEFAULT_FENCE_TIMEOUT =
-      std::numeric_limits<std::uint64_t>::max();
+  VkFence fence = VK_NULL_HANDLE;
+  {
+    std::lock_guard lock(m_mutex);
+    auto submission_it = find_submission(ticket);
+    ReturnIf(submission_it == m_in_flight_submissions.end());
+
+    // Pins the fence, other threads retiring submissions meanwhile would
+    // reset it for a new one otherwise
+    ++submission_it->m_waiters_count;
+    fence = submission_it->m_fence;
+  }
 
-  AssertReturnIf(command_buffer == VK_NULL_HANDLE);
-  AssertReturnIf(vkEndCommandBuffer(command_buffer) != VkResult::VK_SUCCESS);
+  // Other threads keep recording and submitting while this one waits
+  const VkResult result = vkWaitForFences(
+      vulkan_logical_device, 1, &fence, VK_TRUE,
+      std::numeric_limits<std::uint64_t>::max());
 
-  VkSubmitInfo submit_info = {};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_buffer;
+  std::lock_guard lock(m_mutex);
+  auto submission_it = find_submission(ticket);
+  if (submission_it != m_in_flight_submissions.end()) {
+    --submission_it->m_waiters_count;
+  }
+  AssertReturnIf(result != VkResult::VK_SUCCESS);
 
-  // Create fence to ensure that the command buffer has finished executing
-  VkFenceCreateInfo fenceCreateInfo = {};
-  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceCreateInfo.flags = 0;
-  VkFence fence;
-  AssertReturnIf(vkCreateFence(vulkan_logical_device, &fenceCreateInfo, nullptr,
-                               &fence) != VkResult::VK_SUCCESS);
+  retire_completed_submissions();
+}
 
-  {
-    // Submit to the queue
-    AssertReturnIf(vkQueueSubmit(queue, 1, &submit_info, fence) !=
-                   VkResult::VK_SUCCESS);
+void command_pool::release_thread_pools() {
+  std::lock_guard lock(m_mutex);
+
+  auto thread_command_pools_it =
+      m_thread_command_pools.find(std::this_thread::get_id());
+  ReturnIf(thread_command_pools_it == m_thread_command_pools.end());
+
+  for (const auto& queue_command_buffers :
+       thread_command_pools_it->second->m_queues) {
+    AssertLogIf(queue_command_buffers.m_current != VK_NULL_HANDLE,
+                "Released command pool has an unsubmitted command buffer");
   }
-  // Wait for the fence to signal that command buffer has finished executing
-  AssertReturnIf(vkWaitForFences(vulkan_logical_device, 1, &fence, VK_TRUE,
-                                 DEFAULT_FENCE_TIMEOUT) !=
-                 VkResult::VK_SUCCESS);
 
-  vkDestroyFence(vulkan_logical_device, fence, nullptr);
-  vkFreeCommandBuffers(vulkan_logical_device, source_pool, 1, &command_buffer);
+  // Submissions keep pointing at the pools, they don't move on the heap
+  m_released_thread_command_pools.push_back(
+      std::move(thread_command_pools_it->second));
+  m_thread_command_pools.erase(thread_command_pools_it);
+
+  retire_completed_submissions();
+}
+
+command_pool::thread_command_pools&
+command_pool::mutable_thread_command_pools() {
+  auto [thread_command_pools_it, inserted] =
+      m_thread_command_pools.try_emplace(std::this_thread::get_id());
+  auto& thread_command_pools = thread_command_pools_it->second;
+  ReturnUnless(inserted, *thread_command_pools);
+
+  thread_command_pools = make_unique<command_pool::thread_command_pools>();
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  VkCommandPoolCreateInfo cmd_pool_info = {};
+  cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-  command_buffer = VK_NULL_HANDLE;
+  const std::string thread_suffix =
+      " " + std::to_string(m_thread_command_pools.size() - 1);
+
+  cmd_pool_info.queueFamilyIndex = get_queue_family(queue_type::graphics);
+  auto& graphics = thread_command_pools->m_queues[queue_type::graphics];
+  VK_CHECK_RESULT(vkCreateCommandPool(vulkan_logical_device, &cmd_pool_info,
+                                      nullptr, &graphics.m_pool));
+  set_debug_utils_object_name(vulkan_logical_device,
+                              "graphic command pool" + thread_suffix,
+                              graphics.m_pool);
+
+  cmd_pool_info.queueFamilyIndex = get_queue_family(queue_type::compute);
+  auto& compute = thread_command_pools->m_queues[queue_type::compute];
+  VK_CHECK_RESULT(vkCreateCommandPool(vulkan_logical_device, &cmd_pool_info,
+                                      nullptr, &compute.m_pool));
+  set_debug_utils_object_name(vulkan_logical_device,
+                              "compute command pool" + thread_suffix,
+                              compute.m_pool);
+
+  return *thread_command_pools;
 }
 
-VkCommandBuffer command_pool::allocate_graphics_command_buffer(bool begin) {
-  return allocate_command_buffer(begin, m_graphics_command_pool,
-                                 m_current_graphics_command_buffer, "graphics command buffer");
+VkCommandBuffer command_pool::get_current_command_buffer(queue_type type) {
+  std::lock_guard lock(m_mutex);
+
+  auto& queue_command_buffers = mutable_thread_command_pools().m_queues[type];
+  ReturnUnless(queue_command_buffers.m_current == VK_NULL_HANDLE,
+               queue_command_buffers.m_current);
+
+  queue_command_buffers.m_current =
+      allocate_command_buffer(type, queue_command_buffers);
+  return queue_command_buffers.m_current;
 }
-VkCommandBuffer command_pool::allocate_compute_command_buffer(bool begin) {
-  return allocate_command_buffer(begin, m_compute_command_pool,
-                                 m_current_compute_command_buffer, "compute command buffer");
+
+command_pool::submit_ticket command_pool::submit_command_buffer(
+    queue_type type) {
+  std::lock_guard lock(m_mutex);
+
+  auto& queue_command_buffers = mutable_thread_command_pools().m_queues[type];
+  VkCommandBuffer command_buffer = queue_command_buffers.m_current;
+  AssertReturnIf(command_buffer == VK_NULL_HANDLE, 0);
+  queue_command_buffers.m_current = VK_NULL_HANDLE;
+
+  AssertReturnIf(vkEndCommandBuffer(command_buffer) != VkResult::VK_SUCCESS, 0);
+
+  VkFence fence = acquire_fence();
+  AssertReturnIf(fence == VK_NULL_HANDLE, 0);
+
+  // Resources used by this command buffer may still be copied on the transfer
+  // queue, wait for them on the GPU and acquire their ownership first
+  const auto submit = [command_buffer, fence](
+                          VkQueue queue,
+                          const upload_manager::submit_dependencies&
+                              upload_dependencies) {
+    VkPipelineStageFlags upload_wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    std::array<VkCommandBuffer, 2> command_buffers = {
+        upload_dependencies.m_acquire_command_buffer, command_buffer};
+    const bool has_acquire =
+        upload_dependencies.m_acquire_command_buffer != VK_NULL_HANDLE;
+    const bool has_upload_wait =
+        upload_dependencies.m_wait_semaphore != VK_NULL_HANDLE;
+
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+    timeline_submit_info.sType =
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_submit_info.waitSemaphoreValueCount = has_upload_wait ? 1u : 0u;
+    timeline_submit_info.pWaitSemaphoreValues =
+        &upload_dependencies.m_wait_value;
+    timeline_submit_info.signalSemaphoreValueCount = has_acquire ? 1u : 0u;
+    timeline_submit_info.pSignalSemaphoreValues =
+        &upload_dependencies.m_signal_value;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_submit_info;
+    submit_info.commandBufferCount = has_acquire ? 2u : 1u;
+    submit_info.pCommandBuffers =
+        has_acquire ? command_buffers.data() : &command_buffer;
+    submit_info.waitSemaphoreCount = has_upload_wait ? 1u : 0u;
+    submit_info.pWaitSemaphores = &upload_dependencies.m_wait_semaphore;
+    submit_info.pWaitDstStageMask = &upload_wait_stage;
+    submit_info.signalSemaphoreCount = has_acquire ? 1u : 0u;
+    submit_info.pSignalSemaphores = &upload_dependencies.m_signal_semaphore;
+
+    return vkQueueSubmit(queue, 1, &submit_info, fence);
+  };
+
+  AssertReturnIf(layer_abstraction_factory::instance()
+                         .get_vulkan_context()
+                         .mutable_upload_manager()
+                         .submit_with_dependencies(get_queue_family(type),
+                                                   get_queue(type), submit) !=
+                     VkResult::VK_SUCCESS,
+                 0);
+
+  const submit_ticket ticket = m_next_ticket++;
+  m_in_flight_submissions.push_back(
+      in_flight_submission{.m_ticket = ticket,
+                           .m_fence = fence,
+                           .m_command_buffer = command_buffer,
+                           .m_owner = &queue_command_buffers});
+
+  return ticket;
 }
 
 VkCommandBuffer command_pool::allocate_command_buffer(
-    bool begin, VkCommandPool& out_pool, VkCommandBuffer& out_buffer, std::string name) {
-  AssertReturnUnless(out_buffer == VK_NULL_HANDLE, out_buffer);
-
+    queue_type type, queue_command_buffers& buffers) {
   auto& logical_device = layer_abstraction_factory::instance()
                              .get_vulkan_context()
                              .mutable_device();
 
   auto vulkan_logical_device = logical_device.get_vulkan_logical_device();
 
-  VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
-  command_buffer_allocate_info.sType =
-      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  command_buffer_allocate_info.commandPool = out_pool;
-  command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  command_buffer_allocate_info.commandBufferCount = 1;
+  retire_completed_submissions();
+
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  if (!buffers.m_free.empty()) {
+    // The pool allows to reset single buffers, begin resets it implicitly
+    command_buffer = buffers.m_free.back();
+    buffers.m_free.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.sType =
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool = buffers.m_pool;
+    command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = 1;
+
+    AssertReturnUnless(vkAllocateCommandBuffers(
+                           vulkan_logical_device, &command_buffer_allocate_info,
+                           &command_buffer) == VkResult::VK_SUCCESS,
+                       nullptr);
+    set_debug_utils_object_name(vulkan_logical_device,
+                                type == queue_type::graphics
+                                    ? "graphics command buffer"
+                                    : "compute command buffer",
+                                command_buffer);
+  }
 
-  AssertReturnUnless(vkAllocateCommandBuffers(
-                         vulkan_logical_device, &command_buffer_allocate_info,
-                         &out_buffer) == VkResult::VK_SUCCESS,
-                     nullptr);
-  set_debug_utils_object_name(vulkan_logical_device, name, out_buffer);
+  VkCommandBufferBeginInfo command_buffer_begin_info{};
+  command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
+  VK_CHECK_RESULT(
+      vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
 
-  // If requested, also start the new command buffer
-  ReturnUnless(begin, out_buffer);
+  return command_buffer;
+}
 
-  VkCommandBufferBeginInfo command_buffer_begin_info{};
-  command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+VkFence command_pool::acquire_fence() {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  VkFence fence = VK_NULL_HANDLE;
+  if (!m_free_fences.empty()) {
+    fence = m_free_fences.back();
+    m_free_fences.pop_back();
+    VK_CHECK_RESULT(vkResetFences(vulkan_logical_device, 1, &fence));
+    return fence;
+  }
+
+  VkFenceCreateInfo fence_create_info = {};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_create_info.flags = 0;
+  AssertReturnIf(vkCreateFence(vulkan_logical_device, &fence_create_info,
+                               nullptr, &fence) != VkResult::VK_SUCCESS,
+                 VK_NULL_HANDLE);
+
+  return fence;
+}
+
+std::vector<command_pool::in_flight_submission>::iterator
+command_pool::find_submission(submit_ticket ticket) {
+  return std::ranges::find_if(m_in_flight_submissions,
+                              [ticket](const in_flight_submission& submission) {
+                                return submission.m_ticket == ticket;
+                              });
+}
+
+void command_pool::retire_completed_submissions() {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  std::erase_if(m_in_flight_submissions, [this, vulkan_logical_device](
+                                             in_flight_submission& submission) {
+    ReturnIf(submission.m_waiters_count > 0, false);
+    ReturnIf(vkGetFenceStatus(vulkan_logical_device, submission.m_fence) !=
+                 VkResult::VK_SUCCESS,
+             false);
+
+    // Only the owner thread records into its pool, it takes the buffer from
+    // the free list on its next allocation
+    submission.m_owner->m_free.push_back(submission.m_command_buffer);
+    m_free_fences.push_back(submission.m_fence);
+    return true;
+  });
+
+  destroy_released_thread_pools();
+}
+
+void command_pool::destroy_released_thread_pools() {
+  std::erase_if(
+      m_released_thread_command_pools,
+      [this](const unique_ptr<thread_command_pools>& released_pools) {
+        const bool has_in_flight_submissions = std::ranges::any_of(
+            m_in_flight_submissions,
+            [&released_pools](const in_flight_submission& submission) {
+              return std::ranges::any_of(
+                  released_pools->m_queues,
+                  [&submission](const queue_command_buffers& buffers) {
+                    return submission.m_owner == &buffers;
+                  });
+            });
+        ReturnIf(has_in_flight_submissions, false);
+
+        destroy_thread_pools(*released_pools);
+        return true;
+      });
+}
+
+void command_pool::destroy_thread_pools(thread_command_pools& pools) const {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  // Destroying the pools frees their command buffers as well
+  for (auto& queue_command_buffers : pools.m_queues) {
+    ContinueIf(queue_command_buffers.m_pool == VK_NULL_HANDLE);
+    vkDestroyCommandPool(vulkan_logical_device, queue_command_buffers.m_pool,
+                         nullptr);
+    queue_command_buffers.m_pool = VK_NULL_HANDLE;
+  }
+}
+
+std::uint32_t command_pool::get_queue_family(queue_type type) const {
+  const auto& queue_family_indices = layer_abstraction_factory::instance()
+                                         .get_vulkan_context()
+                                         .mutable_physical_device()
+                                         .get_queue_family_indices();
 
-  VK_CHECK_RESULT(vkBeginCommandBuffer(out_buffer, &command_buffer_begin_info));
+  return static_cast<std::uint32_t>(type == queue_type::graphics
+                                        ? queue_family_indices.Graphics
+                                        : queue_family_indices.Compute);
+}
+
+VkQueue command_pool::get_queue(queue_type type) const {
+  auto& logical_device = layer_abstraction_factory::instance()
+                             .get_vulkan_context()
+                             .mutable_device();
 
-  return out_buffer;
+  return type == queue_type::graphics ? logical_device.get_graphics_queue()
+                                      : logical_device.get_compute_queue();
 }
 
-}  // namespace wunder::vulkan
\ No newline at end of file
+}  // namespace wunder::vulkan
@@ -9,9 +9,13 @@
 #include "gla/vulkan/vulkan.h"
 #include "gla/vulkan/vulkan_command_pool.h"
 #include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_geometry_arena.h"
 #include "gla/vulkan/vulkan_macros.h"
 #include "gla/vulkan/vulkan_memory_allocator.h"
 #include "gla/vulkan/vulkan_physical_device.h"
+#include "gla/vulkan/vulkan_pipeline_cache.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
+#include "resources/shaders/host_device.h"
 #include "window/window_factory.h"
 
 namespace wunder::vulkan {
@@ -25,6 +29,24 @@ void context::shutdown() {
     m_renderer_capabilities.reset();
   }
 
+  // writes the pipeline caches back to disk
+  if (m_pipeline_cache.get()) {
+    m_pipeline_cache.reset();
+  }
+
+  // waits for the pending copies into the arenas
+  if (m_upload_manager.get()) {
+    m_upload_manager.reset();
+  }
+
+  if (m_index_arena.get()) {
+    m_index_arena.reset();
+  }
+
+  if (m_vertex_arena.get()) {
+    m_vertex_arena.reset();
+  }
+
   if (m_resource_allocator.get()) {
     m_resource_allocator.reset();
   }
@@ -61,6 +83,10 @@ void context::init(const wunder::renderer_properties &properties) {
       m_logical_device->get_vulkan_logical_device()));
 
   create_allocator();
+  create_upload_manager();
+  create_geometry_arenas();
+
+  m_pipeline_cache = make_unique<pipeline_cache>();
 }
 
 void context::create_vulkan_instance(const renderer_properties &properties) {
@@ -99,6 +125,21 @@ void context::create_allocator() {
   m_resource_allocator->initialize();
 }
 
+void context::create_upload_manager() {
+  m_upload_manager = make_unique<upload_manager>();
+}
+
+void context::create_geometry_arenas() {
+  // 128MB of vertices and 64MB of indices per block
+  constexpr std::uint32_t k_vertex_block_size = 4 * 1024 * 1024;
+  constexpr std::uint32_t k_index_block_size = 16 * 1024 * 1024;
+
+  m_vertex_arena = make_unique<geometry_arena>(
+      "vertex arena", sizeof(VertexAttributes), k_vertex_block_size);
+  m_index_arena = make_unique<geometry_arena>(
+      "index arena", sizeof(std::uint32_t), k_index_block_size);
+}
+
 const renderer_capabilities &context::get_capabilities() const {
   static renderer_capabilities s_empty;
   return m_renderer_capabilities ? *m_renderer_capabilities : s_empty;
@@ -118,4 +159,12 @@ memory_allocator &context::mutable_resource_allocator() {
 
 command_pool &context::mutable_command_pool() { return *m_command_pool; }
 
+upload_manager &context::mutable_upload_manager() { return *m_upload_manager; }
+
+geometry_arena &context::mutable_vertex_arena() { return *m_vertex_arena; }
+
+geometry_arena &context::mutable_index_arena() { return *m_index_arena; }
+
+pipeline_cache &context::mutable_pipeline_cache() { return *m_pipeline_cache; }
+
 }  // namespace wunder::vulkan
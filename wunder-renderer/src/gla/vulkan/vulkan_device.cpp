@@ -1,7 +1,10 @@
 #include "gla/vulkan/vulkan_device.h"
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
+#include "core/wunder_macros.h"
 #include "gla/vulkan/vulkan.h"
 #include "gla/vulkan/vulkan_command_pool.h"
 #include "gla/vulkan/vulkan_macros.h"
@@ -27,9 +30,7 @@ device::device(VkPhysicalDeviceFeatures /*enabled_features*/) {}
 device::~device() = default;
 
 void device::shutdown() {
-
-
-  VK_CHECK_RESULT(vkDeviceWaitIdle(m_logical_device));
+  wait_idle();
   vkDestroyDevice(m_logical_device, nullptr);
 }
 
@@ -49,7 +50,32 @@ void device::initialize() {
   vkGetDeviceQueue(m_logical_device,
                    physical_device.m_queue_family_indices.Compute, 0,
                    &m_compute_queue);
-  set_debug_utils_object_name(m_logical_device, "compute queue", m_graphics_queue);
+  set_debug_utils_object_name(m_logical_device, "compute queue",
+                              m_compute_queue);
+
+  // Dedicated transfer family if the device has one, used for uploads
+  vkGetDeviceQueue(m_logical_device,
+                   physical_device.m_queue_family_indices.Transfer, 0,
+                   &m_transfer_queue);
+  set_debug_utils_object_name(m_logical_device, "transfer queue",
+                              m_transfer_queue);
+}
+
+std::mutex& device::mutable_queue_mutex(VkQueue queue) {
+  // Aliased queues resolve to the mutex of the first family using them
+  const std::array queues = {m_graphics_queue, m_compute_queue,
+                             m_transfer_queue};
+  const auto queue_it = std::ranges::find(queues, queue);
+  AssertReturnIf(queue_it == queues.end(), m_queue_mutexes[0]);
+
+  return m_queue_mutexes[static_cast<std::size_t>(
+      std::distance(queues.begin(), queue_it))];
+}
+
+void device::wait_idle() {
+  std::scoped_lock lock(m_queue_mutexes[0], m_queue_mutexes[1],
+                        m_queue_mutexes[2]);
+  VK_CHECK_RESULT(vkDeviceWaitIdle(m_logical_device));
 }
 
 void device::create_extensions_list() {
@@ -63,6 +89,8 @@ void device::create_extensions_list() {
        .m_optional = true});
   m_requested_extensions.push_back(
       {.m_name = VK_EXT_DEBUG_MARKER_EXTENSION_NAME, .m_optional = true});
+  m_requested_extensions.push_back(
+      {.m_name = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, .m_optional = true});
 
   m_requested_extensions.push_back(
       {.m_name = VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
@@ -70,8 +98,14 @@ void device::create_extensions_list() {
   m_requested_extensions.push_back(
       {.m_name = VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
        .m_optional = false});
+  static VkPhysicalDeviceOpacityMicromapFeaturesEXT
+      opacity_micromap_features_ext{};
+  opacity_micromap_features_ext.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_OPACITY_MICROMAP_FEATURES_EXT;
   m_requested_extensions.push_back(
-      {.m_name = VK_EXT_OPACITY_MICROMAP_EXTENSION_NAME, .m_optional = false});
+      {.m_name = VK_EXT_OPACITY_MICROMAP_EXTENSION_NAME,
+       .m_optional = false,
+       .m_feature_struct = &opacity_micromap_features_ext});
 
   static VkPhysicalDeviceShaderClockFeaturesKHR clock_features_khr{};
   clock_features_khr.sType =
@@ -1,6 +1,8 @@
 #include "gla/vulkan/vulkan_device_buffer.h"
 
+#include <cstdint>
 #include <cstring>
+#include <vector>
 
 #include "gla/vulkan/rasterize/vulkan_swap_chain.h"
 #include "gla/vulkan/vulkan_command_pool.h"
@@ -9,34 +11,37 @@
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_memory_allocator.h"
 #include "gla/vulkan/vulkan_renderer_context.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
 
 namespace wunder::vulkan {
 
 template <typename base_buffer_type>
 device_buffer<base_buffer_type>::device_buffer(
     descriptor_build_data descriptor_build_data, size_t data_size,
-    VkBufferUsageFlags usage_flags)
+    VkBufferUsageFlags usage_flags, upload_destination owner)
     : buffer<base_buffer_type>(std::move(descriptor_build_data)) {
-  allocate_device_buffer(data_size, usage_flags);
+  allocate_device_buffer(data_size, usage_flags, owner);
 }
 
 template <typename base_buffer_type>
 device_buffer<base_buffer_type>::device_buffer(
     descriptor_build_data descriptor_build_data, const void* data,
-    size_t data_size, VkBufferUsageFlags usage_flags)
-    : device_buffer<base_buffer_type>(layer_abstraction_factory::instance()
-                                          .get_vulkan_context()
-                                          .mutable_command_pool()
-                                          .get_current_compute_command_buffer(),
-                                      std::move(descriptor_build_data), data,
-                                      data_size, usage_flags) {
-  auto& command_pool = layer_abstraction_factory::instance()
-                           .get_vulkan_context()
-                           .mutable_command_pool();
-
-  command_pool.flush_compute_command_buffer();
-
-  free_staging_data();
+    size_t data_size, VkBufferUsageFlags usage_flags, upload_destination owner)
+    : buffer<base_buffer_type>(std::move(descriptor_build_data)) {
+  auto& upload_manager = layer_abstraction_factory::instance()
+                             .get_vulkan_context()
+                             .mutable_upload_manager();
+
+  allocate_device_buffer(data_size, usage_flags, owner);
+
+  // The copy goes through the staging ring on the transfer queue, submissions
+  // of the owner queue family wait for it on the GPU
+  upload_manager.upload_buffer(buffer<base_buffer_type>::m_vk_buffer, 0, data,
+                               data_size, owner);
+
+  base_buffer_type::m_descriptor.buffer = buffer<base_buffer_type>::m_vk_buffer;
+  base_buffer_type::m_descriptor.offset = 0;
+  base_buffer_type::m_descriptor.range = VK_WHOLE_SIZE;
 }
 
 template <typename base_buffer_type>
@@ -54,11 +59,15 @@ device_buffer<base_buffer_type>::device_buffer(
     auto* dest_data =
         allocator.map_memory<uint8_t>(m_staging_buffer_allocation);
     std::memcpy(dest_data, data, data_size);
+    // Staging memory isn't necessarily host coherent
+    vmaFlushAllocation(allocator.get_vma_allocator(),
+                       m_staging_buffer_allocation, 0, data_size);
     allocator.unmap_memory(m_staging_buffer_allocation);
   }
 
   {  // allocate device memory
-    allocate_device_buffer(data_size, usage_flags);
+    allocate_device_buffer(data_size, usage_flags,
+                           upload_destination::graphics);
   }
 
   {  // copy host staging buffer to device
@@ -135,7 +144,8 @@ void device_buffer<base_buffer_type>::allocate_cpu_staging_buffer(
 
 template <typename base_buffer_type>
 void device_buffer<base_buffer_type>::allocate_device_buffer(
-    size_t data_size, VkBufferUsageFlags usage_flags) {
+    size_t data_size, VkBufferUsageFlags usage_flags,
+    upload_destination owner) {
   context& vulkan_context =
       layer_abstraction_factory::instance().get_vulkan_context();
   auto& allocator = vulkan_context.mutable_resource_allocator();
@@ -146,6 +156,19 @@ void device_buffer<base_buffer_type>::allocate_device_buffer(
   vertex_buffer_create_info.usage =
       usage_flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
+  // Used by several queue families without ownership transfers
+  std::vector<std::uint32_t> queue_families;
+  if (owner == upload_destination::shared) {
+    queue_families =
+        vulkan_context.mutable_upload_manager().get_shared_queue_families();
+  }
+  if (queue_families.size() > 1) {
+    vertex_buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    vertex_buffer_create_info.queueFamilyIndexCount =
+        static_cast<std::uint32_t>(queue_families.size());
+    vertex_buffer_create_info.pQueueFamilyIndices = queue_families.data();
+  }
+
   buffer<base_buffer_type>::m_allocation = allocator.allocate_buffer(
       vertex_buffer_create_info, VMA_MEMORY_USAGE_GPU_ONLY,
       buffer<base_buffer_type>::m_vk_buffer);
@@ -153,13 +176,15 @@ void device_buffer<base_buffer_type>::allocate_device_buffer(
 
 template <typename base_buffer_type>
 void device_buffer<base_buffer_type>::free_staging_data() {
-  AssertReturnIf(m_staging_buffer == VK_NULL_HANDLE);
+  ReturnIf(m_staging_buffer == VK_NULL_HANDLE);
 
   context& vulkan_context =
       layer_abstraction_factory::instance().get_vulkan_context();
   auto& allocator = vulkan_context.mutable_resource_allocator();
 
   allocator.destroy_buffer(m_staging_buffer, m_staging_buffer_allocation);
+  m_staging_buffer = VK_NULL_HANDLE;
+  m_staging_buffer_allocation = VK_NULL_HANDLE;
 }
 
 template class device_buffer<
@@ -0,0 +1,118 @@
+#include "gla/vulkan/vulkan_frame_storage_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "core/wunder_macros.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/rasterize/vulkan_swap_chain.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_memory_allocator.h"
+#include "gla/vulkan/vulkan_physical_device.h"
+#include "gla/vulkan/vulkan_renderer_context.h"
+
+namespace wunder::vulkan {
+frame_storage_buffer::frame_storage_buffer(
+    descriptor_build_data descriptor_build_data, const void* data,
+    size_t data_size, VkBufferUsageFlags usage_flags,
+    VmaMemoryUsage memory_usage)
+    : storage_buffer(std::move(descriptor_build_data)),
+      m_data_size(data_size) {
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+  auto& swap_chain = layer_abstraction_factory::instance()
+                         .get_render_context()
+                         .mutable_swap_chain();
+
+  const VkDeviceSize offset_alignment = vulkan_context.mutable_physical_device()
+                                            .get_limits()
+                                            .minStorageBufferOffsetAlignment;
+
+  m_frames_count = static_cast<std::uint32_t>(swap_chain.get_image_count());
+  m_frame_stride = align_up(static_cast<VkDeviceSize>(data_size),
+                            std::max<VkDeviceSize>(offset_alignment, 16));
+
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = m_frame_stride * m_frames_count;
+  buffer_create_info.usage = usage_flags;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  m_allocation = allocator.allocate_buffer(buffer_create_info, memory_usage,
+                                          m_vk_buffer);
+  AssertReturnIf(m_allocation == VK_NULL_HANDLE);
+
+  m_mapped_data = allocator.map_memory<std::uint8_t>(m_allocation);
+  for (std::uint32_t frame = 0; frame < m_frames_count; ++frame) {
+    write_frame(frame, data, data_size);
+  }
+
+  m_descriptor.buffer = m_vk_buffer;
+  m_descriptor.offset = 0;
+  m_descriptor.range = data_size;
+}
+
+frame_storage_buffer::~frame_storage_buffer() {
+  ReturnIf(m_mapped_data == nullptr);
+
+  auto& allocator = layer_abstraction_factory::instance()
+                        .get_vulkan_context()
+                        .mutable_resource_allocator();
+  allocator.unmap_memory(m_allocation);
+}
+
+void frame_storage_buffer::update_data(void* data,
+                                       size_t data_size) /*override*/ {
+  write_frame(get_current_frame(), data, data_size);
+}
+
+void frame_storage_buffer::write_frame(std::uint32_t frame, const void* data,
+                                       size_t data_size) {
+  AssertReturnUnless(frame < m_frames_count);
+  AssertReturnIf(data_size > m_data_size);
+  ReturnIf(m_mapped_data == nullptr || data == nullptr);
+
+  std::memcpy(m_mapped_data + frame * m_frame_stride, data, data_size);
+
+  auto& allocator = layer_abstraction_factory::instance()
+                        .get_vulkan_context()
+                        .mutable_resource_allocator();
+  VK_CHECK_RESULT(vmaFlushAllocation(allocator.get_vma_allocator(),
+                                     m_allocation, frame * m_frame_stride,
+                                     data_size));
+}
+
+void frame_storage_buffer::read_frame(std::uint32_t frame, void* out_data,
+                                      size_t data_size) const {
+  AssertReturnUnless(frame < m_frames_count);
+  AssertReturnIf(data_size > m_data_size);
+  ReturnIf(m_mapped_data == nullptr || out_data == nullptr);
+
+  // The transfer to host barrier makes GPU writes available once the frame's
+  // fence signaled
+  auto& allocator = layer_abstraction_factory::instance()
+                        .get_vulkan_context()
+                        .mutable_resource_allocator();
+  VK_CHECK_RESULT(vmaInvalidateAllocation(allocator.get_vma_allocator(),
+                                          m_allocation, frame * m_frame_stride,
+                                          data_size));
+  std::memcpy(out_data, m_mapped_data + frame * m_frame_stride, data_size);
+}
+
+VkDeviceAddress frame_storage_buffer::get_frame_address(
+    std::uint32_t frame) const {
+  AssertReturnUnless(frame < m_frames_count, 0);
+
+  return get_address() + frame * m_frame_stride;
+}
+
+std::uint32_t frame_storage_buffer::get_current_frame() const {
+  return layer_abstraction_factory::instance()
+      .get_render_context()
+      .mutable_swap_chain()
+      .get_current_queue_element();
+}
+}  // namespace wunder::vulkan
@@ -0,0 +1,112 @@
+#include "gla/vulkan/vulkan_frame_uniform_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "core/wunder_macros.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/rasterize/vulkan_swap_chain.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_memory_allocator.h"
+#include "gla/vulkan/vulkan_physical_device.h"
+#include "gla/vulkan/vulkan_renderer_context.h"
+
+namespace wunder::vulkan {
+frame_uniform_buffer::frame_uniform_buffer(
+    descriptor_build_data descriptor_build_data, const void* data,
+    size_t data_size)
+    : uniform_buffer(std::move(descriptor_build_data)),
+      m_data(static_cast<const std::byte*>(data),
+             static_cast<const std::byte*>(data) + data_size) {
+  auto& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+  auto& swap_chain = layer_abstraction_factory::instance()
+                         .get_render_context()
+                         .mutable_swap_chain();
+
+  const VkDeviceSize offset_alignment = vulkan_context.mutable_physical_device()
+                                            .get_limits()
+                                            .minUniformBufferOffsetAlignment;
+
+  m_frames_count = static_cast<std::uint32_t>(swap_chain.get_image_count());
+  m_frame_stride = align_up(static_cast<VkDeviceSize>(data_size),
+                            std::max<VkDeviceSize>(offset_alignment, 1));
+  m_is_frame_outdated.assign(m_frames_count, false);
+
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = m_frame_stride * m_frames_count;
+  buffer_create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  m_allocation = allocator.allocate_buffer(
+      buffer_create_info, VMA_MEMORY_USAGE_CPU_TO_GPU, m_vk_buffer);
+  AssertReturnIf(m_allocation == VK_NULL_HANDLE);
+
+  m_mapped_data = allocator.map_memory<std::uint8_t>(m_allocation);
+  for (std::uint32_t frame = 0; frame < m_frames_count; ++frame) {
+    write_frame(frame);
+  }
+
+  m_descriptor.buffer = m_vk_buffer;
+  m_descriptor.offset = 0;
+  m_descriptor.range = data_size;
+}
+
+frame_uniform_buffer::~frame_uniform_buffer() {
+  ReturnIf(m_mapped_data == nullptr);
+
+  auto& allocator = layer_abstraction_factory::instance()
+                        .get_vulkan_context()
+                        .mutable_resource_allocator();
+  allocator.unmap_memory(m_allocation);
+}
+
+void frame_uniform_buffer::update_data(void* data,
+                                       size_t data_size) /*override*/ {
+  AssertReturnIf(data_size > m_data.size());
+
+  std::memcpy(m_data.data(), data, data_size);
+  std::fill(m_is_frame_outdated.begin(), m_is_frame_outdated.end(), true);
+
+  write_frame(get_current_frame());
+}
+
+std::uint32_t frame_uniform_buffer::get_dynamic_offset() /*override*/ {
+  const std::uint32_t frame = get_current_frame();
+  AssertReturnUnless(frame < m_frames_count, 0);
+
+  // The data may have been updated while another frame was recorded
+  if (m_is_frame_outdated[frame]) {
+    write_frame(frame);
+  }
+
+  return static_cast<std::uint32_t>(frame * m_frame_stride);
+}
+
+std::uint32_t frame_uniform_buffer::get_current_frame() const {
+  return layer_abstraction_factory::instance()
+      .get_render_context()
+      .mutable_swap_chain()
+      .get_current_queue_element();
+}
+
+void frame_uniform_buffer::write_frame(std::uint32_t frame) {
+  AssertReturnUnless(frame < m_frames_count);
+  ReturnIf(m_mapped_data == nullptr);
+
+  std::memcpy(m_mapped_data + frame * m_frame_stride, m_data.data(),
+              m_data.size());
+  // Visible to the next submission, also on memory that isn't coherent
+  auto& allocator = layer_abstraction_factory::instance()
+                        .get_vulkan_context()
+                        .mutable_resource_allocator();
+  VK_CHECK_RESULT(vmaFlushAllocation(allocator.get_vma_allocator(),
+                                     m_allocation, frame * m_frame_stride,
+                                     m_data.size()));
+  m_is_frame_outdated[frame] = false;
+}
+}  // namespace wunder::vulkan
@@ -0,0 +1,127 @@
+#include "gla/vulkan/vulkan_geometry_arena.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "core/wunder_macros.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+
+namespace wunder::vulkan {
+geometry_arena::geometry_arena(std::string name, VkDeviceSize element_size,
+                               std::uint32_t block_elements_count)
+    : m_name(std::move(name)),
+      m_element_size(element_size),
+      m_block_elements_count(block_elements_count) {}
+
+geometry_arena::~geometry_arena() = default;
+
+geometry_arena::range geometry_arena::allocate(const void* data,
+                                               std::uint32_t elements_count) {
+  range result;
+  ReturnIf(elements_count == 0, result);
+
+  std::lock_guard lock(m_mutex);
+
+  for (std::uint32_t i = 0; i < m_blocks.size(); ++i) {
+    result.m_allocation = m_blocks[i]->m_allocator.allocate(elements_count);
+    ContinueUnless(result.m_allocation.is_valid());
+
+    result.m_block = i;
+    break;
+  }
+
+  if (!result.is_valid()) {
+    auto& block = create_block(elements_count);
+    result.m_allocation = block.m_allocator.allocate(elements_count);
+    AssertReturnUnless(result.m_allocation.is_valid(), range{});
+
+    result.m_block = static_cast<std::uint32_t>(m_blocks.size() - 1);
+  }
+
+  auto& upload_manager = layer_abstraction_factory::instance()
+                             .get_vulkan_context()
+                             .mutable_upload_manager();
+  upload_manager.upload_buffer(
+      m_blocks[result.m_block]->m_buffer->get_buffer(),
+      result.m_allocation.m_offset * m_element_size, data,
+      elements_count * m_element_size, upload_destination::shared);
+
+  return result;
+}
+
+void geometry_arena::free(range& geometry_range) {
+  ReturnUnless(geometry_range.is_valid());
+
+  std::lock_guard lock(m_mutex);
+  AssertReturnUnless(geometry_range.m_block < m_blocks.size());
+
+  m_blocks[geometry_range.m_block]->m_allocator.free(
+      geometry_range.m_allocation);
+  geometry_range = range{};
+}
+
+VkDeviceAddress geometry_arena::get_block_address(std::uint32_t block) const {
+  std::lock_guard lock(m_mutex);
+  AssertReturnUnless(block < m_blocks.size(), 0);
+
+  return m_blocks[block]->m_address;
+}
+
+VkDeviceAddress geometry_arena::get_address(const range& geometry_range) const {
+  AssertReturnUnless(geometry_range.is_valid(), 0);
+
+  return get_block_address(geometry_range.m_block) +
+         geometry_range.m_allocation.m_offset * m_element_size;
+}
+
+offset_allocator::storage_report geometry_arena::get_storage_report() const {
+  std::lock_guard lock(m_mutex);
+
+  offset_allocator::storage_report result;
+  for (const auto& block : m_blocks) {
+    auto report = block->m_allocator.get_storage_report();
+    result.m_free_size += report.m_free_size;
+    result.m_largest_free_region =
+        std::max(result.m_largest_free_region, report.m_largest_free_region);
+    result.m_free_regions_count += report.m_free_regions_count;
+  }
+
+  return result;
+}
+
+geometry_arena::block& geometry_arena::create_block(
+    std::uint32_t elements_count) {
+  // Meshes bigger than a block get a block of their own
+  const std::uint32_t block_elements_count =
+      std::max(elements_count, m_block_elements_count);
+
+  auto new_block = make_unique<block>(block{
+      .m_buffer = make_unique<storage_device_buffer>(
+          descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""},
+          block_elements_count * m_element_size,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+          upload_destination::shared),
+      .m_address = 0,
+      .m_allocator = offset_allocator(block_elements_count)});
+  new_block->m_address = new_block->m_buffer->get_address();
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+  set_debug_utils_object_name(
+      vulkan_logical_device, m_name + " " + std::to_string(m_blocks.size()),
+      new_block->m_buffer->get_buffer());
+
+  WUNDER_INFO_TAG("Renderer", "{0}: new block of {1} elements", m_name,
+                  block_elements_count);
+
+  return *m_blocks.emplace_back(std::move(new_block));
+}
+}  // namespace wunder::vulkan
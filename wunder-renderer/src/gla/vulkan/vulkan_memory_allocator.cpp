@@ -2,7 +2,6 @@
 
 #include <vk_mem_alloc.h>
 
-#include <map>
 #include <utility>
 
 #include "core/string_utils.h"
@@ -15,13 +14,28 @@
 #include "gla/vulkan/vulkan_physical_device.h"
 
 namespace wunder::vulkan {
-enum class AllocationType : uint8_t { None = 0, Buffer = 1, Image = 2 };
+namespace {
+const char* memory_class_to_string(memory_class type) {
+  switch (type) {
+    case memory_class::generic:
+      return "generic";
+    case memory_class::staging:
+      return "staging";
+    case memory_class::geometry:
+      return "geometry";
+    case memory_class::acceleration_structure:
+      return "acceleration structure";
+    case memory_class::shader_binding_table:
+      return "shader binding table";
+    case memory_class::texture:
+      return "texture";
+    case memory_class::count:
+      break;
+  }
 
-struct AllocInfo {
-  uint64_t AllocatedSize = 0;
-  AllocationType Type = AllocationType::None;
-};
-static std::map<VmaAllocation, AllocInfo> k_allocation_map;
+  return "unknown";
+}
+}  // namespace
 
 memory_allocator::memory_allocator(std::string tag) : m_tag(std::move(tag)) {}
 
@@ -32,6 +46,15 @@ memory_allocator::~memory_allocator() {
   // WUNDER_WARN("{0}\n", statsString);
   // vmaFreeStatsString(m_resource_allocator, statsString);
 
+  for (auto& memory_class_pools : m_pools) {
+    for (auto& pool : memory_class_pools) {
+      VmaPool vma_pool = pool.exchange(VK_NULL_HANDLE);
+      ContinueIf(vma_pool == VK_NULL_HANDLE);
+
+      vmaDestroyPool(m_resource_allocator, vma_pool);
+    }
+  }
+
   vmaDestroyAllocator(m_resource_allocator);
 }
 
@@ -53,6 +76,18 @@ void memory_allocator::initialize() {
   vma_allocator_create_info.flags |=
       VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 
+  // The device enables the extension whenever it's supported
+  m_is_budget_supported = physical_device.is_extension_supported(
+      VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (m_is_budget_supported) {
+    vma_allocator_create_info.flags |=
+        VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  } else {
+    WUNDER_WARN_TAG(m_tag,
+                    "VK_EXT_memory_budget is not supported, allocations are "
+                    "checked against the heap sizes only");
+  }
+
   vmaCreateAllocator(&vma_allocator_create_info, &m_resource_allocator);
 }
 
@@ -61,21 +96,41 @@ VmaAllocation memory_allocator::allocate_buffer(
     VkBuffer& out_buffer) {
   AssertReturnIf(buffer_create_info.size <= 0, VK_NULL_HANDLE);
 
-  VmaAllocationCreateInfo alloc_create_info = {};
-  alloc_create_info.usage = usage;
-
-  VmaAllocation allocation;
-  vmaCreateBuffer(m_resource_allocator, &buffer_create_info, &alloc_create_info,
-                  &out_buffer, &allocation, nullptr);
-  if (allocation == nullptr) {
+  const memory_class type =
+      get_buffer_memory_class(buffer_create_info.usage, usage);
+
+  VmaAllocationCreateInfo find_create_info = {};
+  find_create_info.usage = usage;
+
+  std::uint32_t memory_type_index = 0;
+  AssertReturnUnless(
+      vmaFindMemoryTypeIndexForBufferInfo(
+          m_resource_allocator, &buffer_create_info, &find_create_info,
+          &memory_type_index) == VK_SUCCESS,
+      VK_NULL_HANDLE);
+
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  bool degraded = false;
+  VkResult result = allocate_within_budget(
+      [&](const VmaAllocationCreateInfo& allocation_create_info) {
+        return vmaCreateBuffer(m_resource_allocator, &buffer_create_info,
+                               &allocation_create_info, &out_buffer,
+                               &allocation, nullptr);
+      },
+      create_allocation_info(type, usage, memory_type_index), usage, degraded);
+  if (result != VK_SUCCESS) {
     WUNDER_ERROR_TAG(m_tag, "Failed to allocate GPU buffer!");
     WUNDER_ERROR_TAG(m_tag, "  Requested size: {}",
                      string::utils::bytes_to_string(buffer_create_info.size));
+    return VK_NULL_HANDLE;
   }
 
+  track_allocation(allocation, degraded);
+
   VmaAllocationInfo allocation_info{};
   vmaGetAllocationInfo(m_resource_allocator, allocation, &allocation_info);
-  WUNDER_WARN_TAG(m_tag, "allocating buffer; size = {0}",
+  WUNDER_WARN_TAG(m_tag, "allocating {0} buffer; size = {1}",
+                  memory_class_to_string(type),
                   string::utils::bytes_to_string(allocation_info.size));
 
   return allocation;
@@ -84,21 +139,38 @@ VmaAllocation memory_allocator::allocate_buffer(
 VmaAllocation memory_allocator::allocate_image(
     VkImageCreateInfo image_create_info, VmaMemoryUsage usage,
     VkImage& outImage, VkDeviceSize* allocatedSize) {
-  VmaAllocationCreateInfo alloc_create_info = {};
-  alloc_create_info.usage = usage;
-
-  VmaAllocation allocation;
-  vmaCreateImage(m_resource_allocator, &image_create_info, &alloc_create_info,
-                 &outImage, &allocation, nullptr);
-  if (allocation == nullptr) {
+  VmaAllocationCreateInfo find_create_info = {};
+  find_create_info.usage = usage;
+
+  std::uint32_t memory_type_index = 0;
+  AssertReturnUnless(
+      vmaFindMemoryTypeIndexForImageInfo(m_resource_allocator,
+                                         &image_create_info, &find_create_info,
+                                         &memory_type_index) == VK_SUCCESS,
+      VK_NULL_HANDLE);
+
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  bool degraded = false;
+  VkResult result = allocate_within_budget(
+      [&](const VmaAllocationCreateInfo& allocation_create_info) {
+        return vmaCreateImage(m_resource_allocator, &image_create_info,
+                              &allocation_create_info, &outImage, &allocation,
+                              nullptr);
+      },
+      create_allocation_info(memory_class::texture, usage, memory_type_index),
+      usage, degraded);
+  if (result != VK_SUCCESS) {
     WUNDER_ERROR_TAG(m_tag, "Failed to allocate GPU image!");
     WUNDER_ERROR_TAG(
         m_tag, "  Requested size: {}x{}x{}", image_create_info.extent.width,
         image_create_info.extent.height, image_create_info.extent.depth);
     WUNDER_ERROR_TAG(m_tag, "  Mips: {}", image_create_info.mipLevels);
     WUNDER_ERROR_TAG(m_tag, "  Layers: {}", image_create_info.arrayLayers);
+    return VK_NULL_HANDLE;
   }
 
+  track_allocation(allocation, degraded);
+
   VmaAllocationInfo allocInfo;
   vmaGetAllocationInfo(m_resource_allocator, allocation, &allocInfo);
   if (allocatedSize) {
@@ -112,6 +184,7 @@ VmaAllocation memory_allocator::allocate_image(
 }
 
 void memory_allocator::free(VmaAllocation allocation) {
+  untrack_allocation(allocation);
   vmaFreeMemory(m_resource_allocator, allocation);
 }
 
@@ -125,6 +198,7 @@ void memory_allocator::destroy_image(VkImage image, VmaAllocation allocation) {
   WUNDER_WARN_TAG(m_tag, "Deallocating image; size = {}",
                   string::utils::bytes_to_string(allocInfo.size));
 
+  untrack_allocation(allocation);
   vmaDestroyImage(m_resource_allocator, image, allocation);
 }
 
@@ -139,6 +213,7 @@ void memory_allocator::destroy_buffer(VkBuffer buffer,
   WUNDER_WARN_TAG(m_tag, "Deallocating buffer; size = {}",
                   string::utils::bytes_to_string(allocInfo.size));
 
+  untrack_allocation(allocation);
   vmaDestroyBuffer(m_resource_allocator, buffer, allocation);
 }
 
@@ -147,26 +222,187 @@ void memory_allocator::unmap_memory(VmaAllocation allocation) {
 }
 
 void memory_allocator::dump_stats() {
-  VmaTotalStatistics stats;
-  vmaCalculateStatistics(m_resource_allocator, &stats);
+  const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+  vmaGetMemoryProperties(m_resource_allocator, &memory_properties);
+
+  std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+  vmaGetHeapBudgets(m_resource_allocator, budgets.data());
 
   WUNDER_WARN_TAG(m_tag, "-----------------------------------");
-  for (auto& b : stats.memoryHeap) {
+  for (std::uint32_t i = 0; i < memory_properties->memoryHeapCount; ++i) {
+    auto& budget = budgets[i];
+    WUNDER_WARN_TAG(m_tag, "Heap {0}", i);
     WUNDER_WARN_TAG(
         m_tag, "VmaBudget.allocationBytes = {0}",
-        string::utils::bytes_to_string(b.statistics.allocationBytes));
-    WUNDER_WARN_TAG(m_tag, "VmaBudget.blockBytes = {0}",
-                    string::utils::bytes_to_string(b.statistics.blockBytes));
+        string::utils::bytes_to_string(budget.statistics.allocationBytes));
+    WUNDER_WARN_TAG(
+        m_tag, "VmaBudget.blockBytes = {0}",
+        string::utils::bytes_to_string(budget.statistics.blockBytes));
     WUNDER_WARN_TAG(m_tag, "VmaBudget.usage = {0}",
-                    string::utils::bytes_to_string(b.allocationSizeMax));
+                    string::utils::bytes_to_string(budget.usage));
     WUNDER_WARN_TAG(m_tag, "VmaBudget.budget = {0}",
-                    string::utils::bytes_to_string(b.unusedRangeSizeMax));
+                    string::utils::bytes_to_string(budget.budget));
+  }
+
+  for (std::size_t i = 0; i < s_memory_classes_count; ++i) {
+    const auto type = static_cast<memory_class>(i);
+    const auto usage = get_usage(type);
+    WUNDER_WARN_TAG(m_tag, "{0}: {1} in {2} allocations, {3} degraded",
+                    memory_class_to_string(type),
+                    string::utils::bytes_to_string(usage.m_allocated_bytes),
+                    usage.m_allocations_count,
+                    usage.m_degraded_allocations_count);
   }
   WUNDER_WARN_TAG(m_tag, "-----------------------------------");
 }
 
+memory_allocator::memory_class_usage memory_allocator::get_usage(
+    memory_class type) const {
+  const auto& counters = m_counters[static_cast<std::size_t>(type)];
+
+  return memory_class_usage{
+      .m_allocated_bytes =
+          counters.m_allocated_bytes.load(std::memory_order_relaxed),
+      .m_allocations_count =
+          counters.m_allocations_count.load(std::memory_order_relaxed),
+      .m_degraded_allocations_count =
+          counters.m_degraded_allocations_count.load(
+              std::memory_order_relaxed)};
+}
+
 VmaAllocator& memory_allocator::get_vma_allocator() {
   return m_resource_allocator;
 }
 
-}  // namespace wunder::vulkan
\ No newline at end of file
+memory_class memory_allocator::get_buffer_memory_class(
+    VkBufferUsageFlags buffer_usage, VmaMemoryUsage usage) {
+  ReturnIf(usage == VMA_MEMORY_USAGE_CPU_TO_GPU ||
+               usage == VMA_MEMORY_USAGE_CPU_ONLY,
+           memory_class::staging);
+  ReturnIf(buffer_usage &
+               VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
+           memory_class::acceleration_structure);
+  ReturnIf(buffer_usage & VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR,
+           memory_class::shader_binding_table);
+  ReturnIf(buffer_usage &
+               VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+           memory_class::geometry);
+
+  return memory_class::generic;
+}
+
+VmaPool memory_allocator::get_or_create_pool(memory_class type,
+                                             std::uint32_t memory_type_index) {
+  auto& pool = m_pools[static_cast<std::size_t>(type)][memory_type_index];
+
+  VmaPool vma_pool = pool.load(std::memory_order_acquire);
+  ReturnIf(vma_pool != VK_NULL_HANDLE, vma_pool);
+
+  std::lock_guard lock(m_pools_mutex);
+  vma_pool = pool.load(std::memory_order_acquire);
+  ReturnIf(vma_pool != VK_NULL_HANDLE, vma_pool);
+
+  // Block size is left to VMA, it starts with small blocks for small pools
+  VmaPoolCreateInfo pool_create_info = {};
+  pool_create_info.memoryTypeIndex = memory_type_index;
+  AssertReturnUnless(vmaCreatePool(m_resource_allocator, &pool_create_info,
+                                   &vma_pool) == VK_SUCCESS,
+                     VK_NULL_HANDLE);
+
+  const std::string pool_name = std::string(memory_class_to_string(type)) +
+                                " pool " + std::to_string(memory_type_index);
+  vmaSetPoolName(m_resource_allocator, vma_pool, pool_name.c_str());
+
+  pool.store(vma_pool, std::memory_order_release);
+  return vma_pool;
+}
+
+VmaAllocationCreateInfo memory_allocator::create_allocation_info(
+    memory_class type, VmaMemoryUsage usage, std::uint32_t memory_type_index) {
+  VmaAllocationCreateInfo allocation_create_info = {};
+  allocation_create_info.usage = usage;
+  // falls back to the default pools, if the class pool can't be created
+  allocation_create_info.pool = get_or_create_pool(type, memory_type_index);
+  allocation_create_info.pUserData =
+      reinterpret_cast<void*>(static_cast<std::uintptr_t>(type));
+  if (m_is_budget_supported) {
+    allocation_create_info.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+  }
+
+  return allocation_create_info;
+}
+
+VmaAllocationCreateInfo memory_allocator::create_degraded_allocation_info(
+    const VmaAllocationCreateInfo& allocation_create_info,
+    VmaMemoryUsage usage) {
+  // Any memory type works for device resources, it's just slower when it's
+  // not device local. Host resources still have to be mappable, they may lose
+  // coherency, so writers flush what they wrote.
+  VmaAllocationCreateInfo degraded_create_info = allocation_create_info;
+  degraded_create_info.pool = VK_NULL_HANDLE;
+  degraded_create_info.usage = VMA_MEMORY_USAGE_UNKNOWN;
+  if (usage == VMA_MEMORY_USAGE_GPU_ONLY) {
+    degraded_create_info.requiredFlags = 0;
+    degraded_create_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  } else {
+    degraded_create_info.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    degraded_create_info.preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  }
+
+  return degraded_create_info;
+}
+
+VkResult memory_allocator::allocate_within_budget(
+    const std::function<VkResult(const VmaAllocationCreateInfo&)>& allocate,
+    const VmaAllocationCreateInfo& allocation_create_info,
+    VmaMemoryUsage usage, bool& out_degraded) {
+  out_degraded = false;
+
+  VkResult result = allocate(allocation_create_info);
+  ReturnIf(result == VK_SUCCESS, result);
+
+  // The preferred memory type is over budget, try the other ones
+  out_degraded = true;
+  VmaAllocationCreateInfo degraded_create_info =
+      create_degraded_allocation_info(allocation_create_info, usage);
+  result = allocate(degraded_create_info);
+  ReturnIf(result == VK_SUCCESS || !m_is_budget_supported, result);
+
+  // Everything is over budget, let the driver page memory out rather than
+  // failing the allocation
+  WUNDER_WARN_TAG(m_tag, "Memory budget exceeded, allocating over budget");
+  degraded_create_info.flags &= ~static_cast<VmaAllocationCreateFlags>(
+      VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT);
+  return allocate(degraded_create_info);
+}
+
+void memory_allocator::track_allocation(VmaAllocation allocation,
+                                        bool degraded) {
+  VmaAllocationInfo allocation_info{};
+  vmaGetAllocationInfo(m_resource_allocator, allocation, &allocation_info);
+
+  auto& counters = m_counters[reinterpret_cast<std::uintptr_t>(
+      allocation_info.pUserData)];
+  counters.m_allocated_bytes.fetch_add(allocation_info.size,
+                                       std::memory_order_relaxed);
+  counters.m_allocations_count.fetch_add(1, std::memory_order_relaxed);
+  if (degraded) {
+    counters.m_degraded_allocations_count.fetch_add(1,
+                                                    std::memory_order_relaxed);
+  }
+}
+
+void memory_allocator::untrack_allocation(VmaAllocation allocation) {
+  ReturnIf(allocation == VK_NULL_HANDLE);
+
+  VmaAllocationInfo allocation_info{};
+  vmaGetAllocationInfo(m_resource_allocator, allocation, &allocation_info);
+
+  auto& counters = m_counters[reinterpret_cast<std::uintptr_t>(
+      allocation_info.pUserData)];
+  counters.m_allocated_bytes.fetch_sub(allocation_info.size,
+                                       std::memory_order_relaxed);
+  counters.m_allocations_count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+}  // namespace wunder::vulkan
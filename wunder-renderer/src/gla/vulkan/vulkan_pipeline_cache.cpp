@@ -0,0 +1,250 @@
+#include "gla/vulkan/vulkan_pipeline_cache.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "core/hash_utils.h"
+#include "core/wunder_filesystem.h"
+#include "core/wunder_macros.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_physical_device.h"
+
+namespace wunder::vulkan {
+namespace {
+// Bump whenever the layout of the file changes
+constexpr std::uint32_t k_pipeline_cache_version = 1;
+constexpr std::uint32_t k_pipeline_cache_magic = 0x50434b57;  // WKCP
+
+// Drivers validate their own header only partially and may crash on corrupted
+// data, everything the data depends on is checked before it is handed over.
+struct pipeline_cache_header {
+  std::uint32_t m_magic = k_pipeline_cache_magic;
+  std::uint32_t m_version = k_pipeline_cache_version;
+  std::uint32_t m_vendor_id = 0;
+  std::uint32_t m_device_id = 0;
+  std::uint32_t m_driver_version = 0;
+  std::uint32_t m_padding = 0;
+  std::uint8_t m_pipeline_cache_uuid[VK_UUID_SIZE]{};
+  std::uint64_t m_shaders_hash = 0;
+  std::uint64_t m_data_size = 0;
+  std::uint64_t m_data_hash = 0;
+};
+
+pipeline_cache_header create_expected_header(std::uint64_t shaders_hash) {
+  const auto& properties = layer_abstraction_factory::instance()
+                               .get_vulkan_context()
+                               .mutable_physical_device()
+                               .get_properties();
+
+  pipeline_cache_header header;
+  header.m_vendor_id = properties.vendorID;
+  header.m_device_id = properties.deviceID;
+  header.m_driver_version = properties.driverVersion;
+  std::memcpy(header.m_pipeline_cache_uuid, properties.pipelineCacheUUID,
+              VK_UUID_SIZE);
+  header.m_shaders_hash = shaders_hash;
+
+  return header;
+}
+}  // namespace
+
+pipeline_cache::pipeline_cache() = default;
+
+pipeline_cache::~pipeline_cache() {
+  save();
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  std::lock_guard lock(m_mutex);
+  for (auto& [_, cache_entry] : m_entries) {
+    vkDestroyPipelineCache(vulkan_logical_device,
+                           cache_entry.m_vulkan_pipeline_cache, nullptr);
+  }
+
+  WUNDER_INFO_TAG("Renderer", "Pipeline cache: {0} hits, {1} misses",
+                  m_statistics.m_hits, m_statistics.m_misses);
+}
+
+VkPipelineCache pipeline_cache::get_or_load(const std::string& name,
+                                            std::uint64_t shaders_hash) {
+  std::lock_guard lock(m_mutex);
+
+  const std::uint64_t key = hash::utils::fnv1a_64(
+      &shaders_hash, sizeof(shaders_hash), get_device_hash());
+  auto found_entry_it = m_entries.find(key);
+  ReturnIf(found_entry_it != m_entries.end(),
+           found_entry_it->second.m_vulkan_pipeline_cache);
+
+  entry cache_entry;
+  cache_entry.m_shaders_hash = shaders_hash;
+  cache_entry.m_path = wunder_filesystem::instance().get_cache_dir("pipelines") /
+                       (name + "_" + hash::utils::hash_to_string(key) +
+                        ".pipelinecache");
+
+  std::vector<char> initial_data = load_data(cache_entry);
+  cache_entry.m_data_hash =
+      initial_data.empty()
+          ? 0
+          : hash::utils::fnv1a_64(initial_data.data(), initial_data.size());
+
+  VkPipelineCacheCreateInfo pipeline_cache_create_info{};
+  pipeline_cache_create_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  pipeline_cache_create_info.initialDataSize = initial_data.size();
+  pipeline_cache_create_info.pInitialData = initial_data.data();
+
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+  VK_CHECK_RESULT(vkCreatePipelineCache(vulkan_logical_device,
+                                        &pipeline_cache_create_info, nullptr,
+                                        &cache_entry.m_vulkan_pipeline_cache));
+  set_debug_utils_object_name(
+      vulkan_logical_device, VK_OBJECT_TYPE_PIPELINE_CACHE,
+      name + " pipeline cache", cache_entry.m_vulkan_pipeline_cache);
+
+  WUNDER_INFO_TAG("Renderer", "{0} pipeline cache {1}, {2} bytes", name,
+                  initial_data.empty() ? "created" : "loaded",
+                  initial_data.size());
+
+  return m_entries.emplace(key, std::move(cache_entry))
+      .first->second.m_vulkan_pipeline_cache;
+}
+
+bool pipeline_cache::is_miss_detection_supported() const {
+  return layer_abstraction_factory::instance()
+      .get_vulkan_context()
+      .mutable_physical_device()
+      .get_device_info()
+      .m_vulkan_13_features.pipelineCreationCacheControl;
+}
+
+void pipeline_cache::record_lookup(const std::string& name, bool hit) {
+  std::lock_guard lock(m_mutex);
+
+  if (hit) {
+    ++m_statistics.m_hits;
+    WUNDER_INFO_TAG("Renderer", "{0} pipeline loaded from cache", name);
+  } else {
+    ++m_statistics.m_misses;
+    WUNDER_INFO_TAG("Renderer", "{0} pipeline not in cache, compiling", name);
+  }
+}
+
+pipeline_cache::statistics pipeline_cache::get_statistics() const {
+  std::lock_guard lock(m_mutex);
+  return m_statistics;
+}
+
+void pipeline_cache::save() {
+  std::lock_guard lock(m_mutex);
+
+  for (auto& [_, cache_entry] : m_entries) {
+    save_entry(cache_entry);
+  }
+}
+
+std::uint64_t pipeline_cache::get_device_hash() const {
+  pipeline_cache_header header = create_expected_header(0);
+
+  return hash::utils::fnv1a_64(&header, sizeof(header));
+}
+
+std::vector<char> pipeline_cache::load_data(const entry& cache_entry) const {
+  std::ifstream cache_file(cache_entry.m_path, std::ios::binary);
+  ReturnUnless(cache_file.is_open(), {});
+
+  pipeline_cache_header header;
+  cache_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  ReturnUnless(cache_file.good(), {});
+
+  pipeline_cache_header expected_header =
+      create_expected_header(cache_entry.m_shaders_hash);
+  ReturnIf(header.m_magic != expected_header.m_magic, {});
+  ReturnIf(header.m_version != expected_header.m_version, {});
+  ReturnIf(header.m_vendor_id != expected_header.m_vendor_id ||
+               header.m_device_id != expected_header.m_device_id ||
+               header.m_driver_version != expected_header.m_driver_version,
+           {});
+  ReturnIf(std::memcmp(header.m_pipeline_cache_uuid,
+                       expected_header.m_pipeline_cache_uuid,
+                       VK_UUID_SIZE) != 0,
+           {});
+  ReturnIf(header.m_shaders_hash != expected_header.m_shaders_hash, {});
+
+  std::error_code error;
+  const auto file_size = std::filesystem::file_size(cache_entry.m_path, error);
+  ReturnIf(static_cast<bool>(error) ||
+               file_size != sizeof(header) + header.m_data_size,
+           {});
+
+  std::vector<char> data(header.m_data_size);
+  cache_file.read(data.data(), static_cast<std::streamsize>(data.size()));
+  if (!cache_file.good() ||
+      hash::utils::fnv1a_64(data.data(), data.size()) != header.m_data_hash) {
+    WUNDER_WARN_TAG("Renderer", "Corrupted pipeline cache {0}, ignoring it",
+                    cache_entry.m_path.string());
+    return {};
+  }
+
+  return data;
+}
+
+void pipeline_cache::save_entry(entry& cache_entry) const {
+  auto vulkan_logical_device = layer_abstraction_factory::instance()
+                                   .get_vulkan_context()
+                                   .mutable_device()
+                                   .get_vulkan_logical_device();
+
+  size_t data_size = 0;
+  VK_CHECK_RESULT(vkGetPipelineCacheData(vulkan_logical_device,
+                                         cache_entry.m_vulkan_pipeline_cache,
+                                         &data_size, nullptr));
+  ReturnIf(data_size == 0);
+
+  std::vector<char> data(data_size);
+  VK_CHECK_RESULT(vkGetPipelineCacheData(vulkan_logical_device,
+                                         cache_entry.m_vulkan_pipeline_cache,
+                                         &data_size, data.data()));
+  data.resize(data_size);
+
+  const std::uint64_t data_hash =
+      hash::utils::fnv1a_64(data.data(), data.size());
+  // Nothing was compiled since the cache was loaded
+  ReturnIf(data_hash == cache_entry.m_data_hash);
+
+  // Written next to the final file and renamed, a crash mid-write never
+  // leaves a truncated cache behind.
+  auto temp_path = cache_entry.m_path;
+  temp_path += ".tmp";
+
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    AssertReturnUnless(cache_file.is_open());
+
+    pipeline_cache_header header =
+        create_expected_header(cache_entry.m_shaders_hash);
+    header.m_data_size = data.size();
+    header.m_data_hash = data_hash;
+
+    cache_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    cache_file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    AssertReturnUnless(cache_file.good());
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temp_path, cache_entry.m_path, error);
+  AssertReturnIf(static_cast<bool>(error));
+
+  cache_entry.m_data_hash = data_hash;
+  WUNDER_INFO_TAG("Renderer", "Pipeline cache saved to {0}, {1} bytes",
+                  cache_entry.m_path.string(), data.size());
+}
+}  // namespace wunder::vulkan
@@ -1,17 +1,30 @@
 #include "gla/vulkan/vulkan_renderer_context.h"
 
+#include <glm/vec4.hpp>
+
 #include "application_properties.h"
+#include "core/project.h"
 #include "core/services_factory.h"
 #include "core/time_unit.h"
 #include "core/wunder_memory.h"
 #include "event/event_controller.h"
 #include "event/scene_events.h"
 #include "event/vulkan_events.h"
+#include "gla/cpu/cpu_render_target.h"
 #include "gla/renderer_properties.h"
 #include "gla/vulkan/rasterize/vulkan_rasterize_renderer.h"
 #include "gla/vulkan/rasterize/vulkan_render_pass.h"
 #include "gla/vulkan/rasterize/vulkan_swap_chain.h"
 #include "gla/vulkan/ray-trace/vulkan_rtx_renderer.h"
+#include "gla/vulkan/scene/vulkan_scene.h"
+#include "gla/vulkan/vulkan_command_pool.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_memory_allocator.h"
+#include "gla/vulkan/vulkan_texture.h"
+#include "scene/scene_manager.h"
 
 namespace wunder::vulkan {
 renderer_context::renderer_context(const application_properties& properties)
@@ -77,6 +90,7 @@ bool renderer_context::begin() {
 }
 
 void renderer_context::update(time_unit dt) {
+  try_activate_pending_scene();
   ReturnUnless(m_have_active_scene);
 
   service_factory::instance().update(dt);
@@ -87,14 +101,117 @@ void renderer_context::update(time_unit dt) {
 
 void renderer_context::end() { m_swap_chain->flush_current_command_buffer(); }
 
+bool renderer_context::read_output_image(cpu::render_target& out_target) {
+  AssertReturnUnless(m_have_active_scene, false);
+
+  const std::uint32_t width = m_renderer_properties.m_width;
+  const std::uint32_t height = m_renderer_properties.m_height;
+  AssertReturnUnless(
+      out_target.get_width() == width && out_target.get_height() == height,
+      false);
+
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+  auto& pool = vulkan_context.mutable_command_pool();
+
+  // Submitted frames still accumulate into the image
+  vulkan_context.mutable_device().wait_idle();
+
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size =
+      static_cast<VkDeviceSize>(width) * height * sizeof(glm::vec4);
+  buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer readback_buffer = VK_NULL_HANDLE;
+  VmaAllocation readback_allocation = allocator.allocate_buffer(
+      buffer_create_info, VMA_MEMORY_USAGE_GPU_TO_CPU, readback_buffer);
+  AssertReturnUnless(readback_allocation, false);
+
+  // The ray generation shader keeps the image in the general layout
+  VkImage output_image =
+      m_rasterize_renderer->get_output_image().get_image_info()->m_image;
+  auto command_buffer = pool.get_current_graphics_command_buffer();
+
+  VkImageMemoryBarrier image_barrier{};
+  image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  image_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  image_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  image_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  image_barrier.image = output_image;
+  image_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &image_barrier);
+
+  VkBufferImageCopy copy_region{};
+  copy_region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  copy_region.imageExtent = VkExtent3D{width, height, 1};
+  vkCmdCopyImageToBuffer(command_buffer, output_image, VK_IMAGE_LAYOUT_GENERAL,
+                         readback_buffer, 1, &copy_region);
+
+  VkBufferMemoryBarrier buffer_barrier{};
+  buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  buffer_barrier.buffer = readback_buffer;
+  buffer_barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                       &buffer_barrier, 0, nullptr);
+
+  pool.flush_graphics_command_buffer();
+
+  // Read back memory is cached, not necessarily coherent
+  vmaInvalidateAllocation(allocator.get_vma_allocator(), readback_allocation, 0,
+                          VK_WHOLE_SIZE);
+  const auto* pixels = allocator.map_memory<glm::vec4>(readback_allocation);
+  for (std::uint32_t y = 0; y < height; ++y) {
+    for (std::uint32_t x = 0; x < width; ++x) {
+      out_target.set_pixel(x, y, glm::vec3(pixels[y * width + x]));
+    }
+  }
+  allocator.unmap_memory(readback_allocation);
+  allocator.destroy_buffer(readback_buffer, readback_allocation);
+
+  return true;
+}
+
 void renderer_context::on_event(
     const wunder::event::scene_activated& event) /*override*/ {
-  m_rasterize_renderer->init(event.m_id);
-  m_rtx_renderer->init(event.m_id);
+  m_pending_scene_id = event.m_id;
+  try_activate_pending_scene();
+}
+
+void renderer_context::try_activate_pending_scene() {
+  ReturnUnless(m_pending_scene_id.has_value());
+
+  auto scene_id = m_pending_scene_id.value();
+  auto api_scene =
+      project::instance().get_scene_manager().mutable_api_scene(scene_id);
+  if (!api_scene.has_value()) {
+    m_pending_scene_id.reset();
+    return;
+  }
+
+  // Keep accumulating the current scene while the new one is uploading
+  ReturnUnless(api_scene->get().is_resident());
+
+  m_rasterize_renderer->init(scene_id);
+  m_rtx_renderer->init(scene_id);
 
   log_loaded_scene_size();
 
   m_have_active_scene = true;
+  m_pending_scene_id.reset();
 }
 
 void renderer_context::log_loaded_scene_size() {
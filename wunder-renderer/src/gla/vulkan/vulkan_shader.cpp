@@ -1,53 +1,27 @@
 #include "gla/vulkan/vulkan_shader.h"
 
-#include <libshaderc_util/file_finder.h>
-
+#include <array>
 #include <filesystem>
-#include <fstream>
-#include <memory>
-#include <shaderc/shaderc.hpp>
-#include <spirv_cross.hpp>
+#include <format>
 #include <utility>
 
-#include "core/vector_map.h"
+#include "core/hash_utils.h"
 #include "core/wunder_filesystem.h"
+#include "core/wunder_logger.h"
 #include "core/wunder_macros.h"
-#include "file_includer.h"
-#include "gla/vulkan/descriptors/vulkan_descriptor_set_manager.h"
 #include "gla/vulkan/vulkan_context.h"
 #include "gla/vulkan/vulkan_device.h"
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_macros.h"
 #include "gla/vulkan/vulkan_shader_types.h"
 
-namespace {
+#if WUNDER_PRECOMPILED_SHADERS
+#include "gla/vulkan/vulkan_shader_artifact.h"
+#else
+#include "gla/vulkan/vulkan_shader_compiler.h"
+#endif
 
-shaderc_shader_kind vulkan_shader_stage_to_shaderc(
-    const VkShaderStageFlagBits stage) {
-  switch (stage) {
-    case VK_SHADER_STAGE_VERTEX_BIT:
-      return shaderc_vertex_shader;
-    case VK_SHADER_STAGE_FRAGMENT_BIT:
-      return shaderc_fragment_shader;
-    case VK_SHADER_STAGE_COMPUTE_BIT:
-      return shaderc_compute_shader;
-    case VK_SHADER_STAGE_RAYGEN_BIT_KHR:
-      return shaderc_raygen_shader;
-    case VK_SHADER_STAGE_ANY_HIT_BIT_KHR:
-      return shaderc_anyhit_shader;
-    case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR:
-      return shaderc_closesthit_shader;
-    case VK_SHADER_STAGE_MISS_BIT_KHR:
-      return shaderc_miss_shader;
-    case VK_SHADER_STAGE_INTERSECTION_BIT_KHR:
-      return shaderc_intersection_shader;
-    case VK_SHADER_STAGE_CALLABLE_BIT_KHR:
-      return shaderc_callable_shader;
-    default:
-      AssertLogIf(true, "Failed to parse shader type");
-      return {};
-  }
-}
+namespace {
 
 std::string vulkan_shader_stage_to_string(const VkShaderStageFlagBits stage) {
   switch (stage) {
@@ -75,27 +49,28 @@ std::string vulkan_shader_stage_to_string(const VkShaderStageFlagBits stage) {
   }
 }
 
-template <typename T>
-concept vulkan_shader_resource_concept =
-    std::is_base_of<wunder::vulkan::shader_resource::declaration::base,
-                    T>::value;
-
-template <vulkan_shader_resource_concept resource_type>
-void spirv_resources_to_descriptors_declarations(
-    const spirv_cross::Compiler& compiler,
-    const spirv_cross::SmallVector<spirv_cross::Resource>& resources,
-    wunder::vulkan::vulkan_shader_reflection_data& out_reflection_data) {
-  for (const auto& resource : resources) {
-    uint32_t descriptor_set =
-        compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
-    uint32_t descriptor_binding =
-        compiler.get_decoration(resource.id, spv::DecorationBinding);
-
-    out_reflection_data.m_shader_resources_declaration[resource.name] =
-        resource_type{descriptor_set, descriptor_binding};
+#if WUNDER_PRECOMPILED_SHADERS
+/**
+ * wunder-shaders output is installed next to the executables. Relocated
+ * applications may keep it with their resources instead, and running from
+ * the build tree it is where the target wrote it.
+ */
+std::filesystem::path get_precompiled_shaders_dir() {
+  auto& filesystem = wunder::wunder_filesystem::instance();
+  const std::array candidates = {
+      filesystem.get_executable_dir() / "precompiled_shaders",
+      filesystem.resolve_path("precompiled_shaders"),
+      std::filesystem::path{WUNDER_PRECOMPILED_SHADERS_BUILD_DIR}};
+
+  for (const auto& candidate : candidates) {
+    ReturnIf(std::filesystem::is_directory(candidate), candidate);
   }
-}
 
+  WUNDER_ERROR_TAG("Renderer", "Precompiled shaders not found, looked in {0}",
+                   candidates[0].string());
+  return candidates[0];
+}
+#endif
 }  // namespace
 
 namespace wunder::vulkan {
@@ -119,63 +94,56 @@ shader::~shader() {
 std::expected<unique_ptr<shader>, shader_operation_output_code> shader::create(
     const std::filesystem::path& spirv_path,
     const VkShaderStageFlagBits stage) {
-  auto spirv_real_path = wunder_filesystem::instance().resolve_path(spirv_path);
-  AssertReturnUnless(
-      std::filesystem::exists(spirv_real_path),
-      std::unexpected(shader_operation_output_code::ShaderFileDoesntExist));
+  auto expected = load_spirv(spirv_path, stage);
+  ReturnIf(!expected.has_value(), std::unexpected(expected.error()));
 
-  auto spirv_istream = std::ifstream(spirv_real_path);
-  auto shader_name = spirv_real_path.filename().string();
-  auto shader_dir = spirv_real_path.parent_path();
+  return create(spirv_path, stage, expected.value());
+}
 
-  auto expected = compile_shader(spirv_istream, shader_dir, shader_name, stage);
-  ReturnIf(!expected.has_value(), std::unexpected(expected.error()));
+unique_ptr<shader> shader::create(const std::filesystem::path& spirv_path,
+                                  const VkShaderStageFlagBits stage,
+                                  const shader_binary& binary) {
+  auto shader_name = spirv_path.filename().string();
 
   auto shader_ptr = std::make_unique<shader>(std::move(shader_name), stage);
-  shader_ptr->initialize(expected.value());
+  shader_ptr->initialize(binary);
   return shader_ptr;
 }
 
-std::expected<std::vector<std::uint32_t>, shader_operation_output_code>
-shader::compile_shader(std::ifstream& spirv_istream,
-                       const std::filesystem::path& shader_parent_dir,
-                       const std::string& shader_name,
-                       const VkShaderStageFlagBits stage) {
-  static shaderc::Compiler compiler;
-
-  shaderc_util::FileFinder fileFinder;
-  fileFinder.search_path().push_back(shader_parent_dir);
-
-  shaderc::CompileOptions compile_options;
-  compile_options.SetTargetEnvironment(shaderc_target_env_vulkan,
-                                       shaderc_env_version_vulkan_1_3);
-  compile_options.SetTargetSpirv(
-      shaderc_spirv_version::shaderc_spirv_version_1_6);
-  compile_options.SetWarningsAsErrors();
-  compile_options.SetGenerateDebugInfo();
-  compile_options.SetIncluder(
-      std::make_unique<glslc::FileIncluder>(&fileFinder));
-
-  //  compile_options.SetOptimizationLevel(shaderc_optimization_level_performance);
-
-  std::stringstream shader_string_stream;
-  shader_string_stream << spirv_istream.rdbuf();
+std::expected<shader_binary, shader_operation_output_code> shader::load_spirv(
+    const std::filesystem::path& spirv_path,
+    const VkShaderStageFlagBits stage) {
+#if WUNDER_PRECOMPILED_SHADERS
+  // Built by the wunder-shaders target, artifacts are named after the source
+  static const std::filesystem::path s_precompiled_shaders_dir =
+      get_precompiled_shaders_dir();
+  auto binary = shader_artifact::load(s_precompiled_shaders_dir,
+                                      spirv_path.filename().string());
+  AssertReturnUnless(
+      binary.has_value(),
+      std::unexpected(shader_operation_output_code::ShaderFileDoesntExist));
+  (void)stage;
 
-  const shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(
-      shader_string_stream.str(), vulkan_shader_stage_to_shaderc(stage),
-      shader_name.c_str(), "main", compile_options);
+  return std::move(binary.value());
+#else
+  auto spirv_real_path = wunder_filesystem::instance().resolve_path(spirv_path);
+  AssertReturnUnless(
+      std::filesystem::exists(spirv_real_path),
+      std::unexpected(shader_operation_output_code::ShaderFileDoesntExist));
 
-  if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
-    WUNDER_ERROR_TAG("Renderer", module.GetErrorMessage());
-    return std::unexpected(shader_operation_output_code::CompilationFailed);
-  }
+  auto spirv = shader_compiler::compile(spirv_real_path, stage);
+  ReturnIf(!spirv.has_value(), std::unexpected(spirv.error()));
 
-  std::vector binary(module.begin(), module.end());
+  shader_binary binary;
+  binary.m_reflection_data = shader_compiler::reflect(spirv.value());
+  binary.m_spirv = std::move(spirv.value());
   return binary;
+#endif
 }
 
-void shader::initialize(const std::vector<std::uint32_t>& debug_spirv) {
-  AssertReturnIf(debug_spirv.empty());
+void shader::initialize(const shader_binary& binary) {
+  const auto& spirv = binary.m_spirv;
+  AssertReturnIf(spirv.empty());
   auto& device = layer_abstraction_factory::instance()
                      .get_vulkan_context()
                      .mutable_device();
@@ -183,8 +151,9 @@ void shader::initialize(const std::vector<std::uint32_t>& debug_spirv) {
   VkShaderModuleCreateInfo moduleCreateInfo{};
 
   moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  moduleCreateInfo.codeSize = debug_spirv.size() * sizeof(uint32_t);
-  moduleCreateInfo.pCode = debug_spirv.data();
+  moduleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+  m_spirv_hash = hash::utils::fnv1a_64(spirv.data(), moduleCreateInfo.codeSize);
+  moduleCreateInfo.pCode = spirv.data();
 
   VK_CHECK_RESULT(vkCreateShaderModule(device.get_vulkan_logical_device(),
                                        &moduleCreateInfo, NULL,
@@ -195,7 +164,7 @@ void shader::initialize(const std::vector<std::uint32_t>& debug_spirv) {
                   vulkan_shader_stage_to_string(m_vulkan_shader_type)),
       m_shader_module);
 
-  initialize_reflection_data(debug_spirv);
+  m_reflection_data = binary.m_reflection_data;
 }
 
 VkPipelineShaderStageCreateInfo shader::get_shader_stage_info() const {
@@ -209,58 +178,4 @@ VkPipelineShaderStageCreateInfo shader::get_shader_stage_info() const {
   return result;
 }
 
-void shader::initialize_reflection_data(
-    const std::vector<std::uint32_t>& debug_spirv) {
-  spirv_cross::Compiler compiler(debug_spirv);
-  auto resources = compiler.get_shader_resources();
-
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::uniform_buffer>(
-      compiler, resources.uniform_buffers, m_reflection_data);
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::storage_buffers>(
-      compiler, resources.storage_buffers, m_reflection_data);
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::sampled_images>(
-      compiler, resources.sampled_images, m_reflection_data);
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::separate_images>(
-      compiler, resources.separate_images, m_reflection_data);
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::separate_samplers>(
-      compiler, resources.separate_samplers, m_reflection_data);
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::storage_images>(
-      compiler, resources.storage_images, m_reflection_data);
-  spirv_resources_to_descriptors_declarations<
-      shader_resource::declaration::acceleration_structures>(
-      compiler, resources.acceleration_structures, m_reflection_data);
-
-  ReturnIf(m_reflection_data.m_shader_resources_declaration.empty());
-
-  auto resource_with_max_set = std::max_element(
-      m_reflection_data.m_shader_resources_declaration.begin(),
-      m_reflection_data.m_shader_resources_declaration.end(),
-      [](const std::pair<vulkan_resource_identifier,
-                         shader_resource::declaration::element>& left_element,
-         const std::pair<vulkan_resource_identifier,
-                         shader_resource::declaration::element>&
-             right_element) {
-        const shader_resource::declaration::base& left_resource_declaration =
-            std::visit(shader_resource::declaration::downcast,
-                       left_element.second);
-        const shader_resource::declaration::base& right_resource_declaration =
-            std::visit(shader_resource::declaration::downcast,
-                       right_element.second);
-
-        return left_resource_declaration.m_set <
-               right_resource_declaration.m_set;
-      });
-
-  m_reflection_data.m_descriptor_sets_count =
-      std::visit(shader_resource::declaration::downcast,
-                 resource_with_max_set->second)
-          .m_set +
-      1;
-}
 }  // namespace wunder::vulkan
\ No newline at end of file
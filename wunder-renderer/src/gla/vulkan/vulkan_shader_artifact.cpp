@@ -0,0 +1,201 @@
+#include "gla/vulkan/vulkan_shader_artifact.h"
+
+#include <cstdint>
+#include <fstream>
+
+#include "core/hash_utils.h"
+#include "core/wunder_macros.h"
+
+namespace wunder::vulkan::shader_artifact {
+namespace {
+// Bump whenever the layout of the reflection file changes
+constexpr std::uint32_t k_reflection_version = 1;
+constexpr std::uint32_t k_reflection_magic = 0x46455257;  // WREF
+
+struct reflection_header {
+  std::uint32_t m_magic = k_reflection_magic;
+  std::uint32_t m_version = k_reflection_version;
+  std::uint32_t m_descriptor_sets_count = 0;
+  std::uint32_t m_declarations_count = 0;
+  // ties the reflection to the SPIR-V written next to it
+  std::uint64_t m_spirv_hash = 0;
+};
+
+struct declaration_header {
+  // index of the declaration type in shader_resource::declaration::element
+  std::uint32_t m_type = 0;
+  std::uint32_t m_set = 0;
+  std::uint32_t m_binding = 0;
+  std::uint32_t m_count = 0;
+  std::uint32_t m_name_length = 0;
+};
+
+std::optional<shader_resource::declaration::element> create_declaration(
+    std::uint32_t type) {
+  switch (type) {
+    case 0:
+      return shader_resource::declaration::uniform_buffer{};
+    case 1:
+      return shader_resource::declaration::storage_buffers{};
+    case 2:
+      return shader_resource::declaration::sampled_images{};
+    case 3:
+      return shader_resource::declaration::separate_images{};
+    case 4:
+      return shader_resource::declaration::separate_samplers{};
+    case 5:
+      return shader_resource::declaration::storage_images{};
+    case 6:
+      return shader_resource::declaration::acceleration_structures{};
+    default:
+      return std::nullopt;
+  }
+}
+
+std::uint64_t get_spirv_hash(const std::vector<std::uint32_t>& spirv) {
+  return hash::utils::fnv1a_64(spirv.data(),
+                               spirv.size() * sizeof(std::uint32_t));
+}
+
+bool write_atomically(const std::filesystem::path& path, const char* data,
+                      std::size_t size) {
+  // Written next to the final file and renamed, an interrupted build never
+  // leaves a truncated artifact behind.
+  auto temp_path = path;
+  temp_path += ".tmp";
+
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    AssertReturnUnless(file.is_open(), false);
+
+    file.write(data, static_cast<std::streamsize>(size));
+    AssertReturnUnless(file.good(), false);
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temp_path, path, error);
+  AssertReturnIf(static_cast<bool>(error), false);
+
+  return true;
+}
+
+template <typename T>
+void append_value(std::vector<char>& out, const T& value) {
+  const auto* bytes = reinterpret_cast<const char*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+}  // namespace
+
+std::filesystem::path get_spirv_path(const std::filesystem::path& directory,
+                                     const std::string& shader_name) {
+  return directory / (shader_name + ".spv");
+}
+
+std::filesystem::path get_reflection_path(
+    const std::filesystem::path& directory, const std::string& shader_name) {
+  return directory / (shader_name + ".refl");
+}
+
+bool save(const std::filesystem::path& directory,
+          const std::string& shader_name, const shader_binary& binary) {
+  reflection_header header;
+  header.m_descriptor_sets_count =
+      binary.m_reflection_data.m_descriptor_sets_count;
+  header.m_declarations_count = static_cast<std::uint32_t>(
+      binary.m_reflection_data.m_shader_resources_declaration.size());
+  header.m_spirv_hash = get_spirv_hash(binary.m_spirv);
+
+  std::vector<char> reflection;
+  append_value(reflection, header);
+  for (const auto& [name, declaration] :
+       binary.m_reflection_data.m_shader_resources_declaration) {
+    const shader_resource::declaration::base& base_declaration =
+        std::visit(shader_resource::declaration::downcast, declaration);
+
+    declaration_header entry;
+    entry.m_type = static_cast<std::uint32_t>(declaration.index());
+    entry.m_set = base_declaration.m_set;
+    entry.m_binding = base_declaration.m_binding;
+    entry.m_count = base_declaration.Count;
+    entry.m_name_length = static_cast<std::uint32_t>(name.size());
+
+    append_value(reflection, entry);
+    reflection.insert(reflection.end(), name.begin(), name.end());
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  AssertReturnIf(static_cast<bool>(error), false);
+
+  ReturnUnless(
+      write_atomically(get_spirv_path(directory, shader_name),
+                       reinterpret_cast<const char*>(binary.m_spirv.data()),
+                       binary.m_spirv.size() * sizeof(std::uint32_t)),
+      false);
+  return write_atomically(get_reflection_path(directory, shader_name),
+                          reflection.data(), reflection.size());
+}
+
+std::optional<shader_binary> load(const std::filesystem::path& directory,
+                                  const std::string& shader_name) {
+  const auto spirv_path = get_spirv_path(directory, shader_name);
+  std::error_code error;
+  const auto spirv_size = std::filesystem::file_size(spirv_path, error);
+  ReturnIf(static_cast<bool>(error) || spirv_size == 0 ||
+               spirv_size % sizeof(std::uint32_t) != 0,
+           std::nullopt);
+
+  shader_binary binary;
+  binary.m_spirv.resize(spirv_size / sizeof(std::uint32_t));
+  {
+    std::ifstream spirv_file(spirv_path, std::ios::binary);
+    spirv_file.read(reinterpret_cast<char*>(binary.m_spirv.data()),
+                    static_cast<std::streamsize>(spirv_size));
+    ReturnUnless(spirv_file.good(), std::nullopt);
+  }
+
+  std::ifstream reflection_file(get_reflection_path(directory, shader_name),
+                                std::ios::binary);
+  ReturnUnless(reflection_file.is_open(), std::nullopt);
+
+  reflection_header header;
+  reflection_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  ReturnUnless(reflection_file.good(), std::nullopt);
+  ReturnIf(header.m_magic != k_reflection_magic ||
+               header.m_version != k_reflection_version,
+           std::nullopt);
+  if (header.m_spirv_hash != get_spirv_hash(binary.m_spirv)) {
+    WUNDER_WARN_TAG("Renderer", "Reflection of {0} doesn't match its SPIR-V",
+                    shader_name);
+    return std::nullopt;
+  }
+
+  binary.m_reflection_data.m_descriptor_sets_count =
+      header.m_descriptor_sets_count;
+  for (std::uint32_t i = 0; i < header.m_declarations_count; ++i) {
+    declaration_header entry;
+    reflection_file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+    ReturnUnless(reflection_file.good(), std::nullopt);
+
+    std::string name(entry.m_name_length, '\0');
+    reflection_file.read(name.data(),
+                         static_cast<std::streamsize>(name.size()));
+    ReturnUnless(reflection_file.good(), std::nullopt);
+
+    auto declaration = create_declaration(entry.m_type);
+    ReturnUnless(declaration.has_value(), std::nullopt);
+    std::visit(
+        [&entry](auto& typed_declaration) {
+          typed_declaration.m_set = entry.m_set;
+          typed_declaration.m_binding = entry.m_binding;
+          typed_declaration.Count = entry.m_count;
+        },
+        declaration.value());
+
+    binary.m_reflection_data.m_shader_resources_declaration.emplace(
+        std::move(name), std::move(declaration.value()));
+  }
+
+  return binary;
+}
+}  // namespace wunder::vulkan::shader_artifact
@@ -0,0 +1,368 @@
+#include "gla/vulkan/vulkan_shader_compiler.h"
+
+#include <libshaderc_util/file_finder.h>
+#if __has_include(<glslang/build_info.h>)
+#include <glslang/build_info.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <shaderc/shaderc.hpp>
+#include <spirv_cross.hpp>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "core/hash_utils.h"
+#include "core/wunder_filesystem.h"
+#include "core/wunder_macros.h"
+#include "file_includer.h"
+
+namespace {
+
+shaderc_shader_kind vulkan_shader_stage_to_shaderc(
+    const VkShaderStageFlagBits stage) {
+  switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+      return shaderc_vertex_shader;
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+      return shaderc_fragment_shader;
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+      return shaderc_compute_shader;
+    case VK_SHADER_STAGE_RAYGEN_BIT_KHR:
+      return shaderc_raygen_shader;
+    case VK_SHADER_STAGE_ANY_HIT_BIT_KHR:
+      return shaderc_anyhit_shader;
+    case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR:
+      return shaderc_closesthit_shader;
+    case VK_SHADER_STAGE_MISS_BIT_KHR:
+      return shaderc_miss_shader;
+    case VK_SHADER_STAGE_INTERSECTION_BIT_KHR:
+      return shaderc_intersection_shader;
+    case VK_SHADER_STAGE_CALLABLE_BIT_KHR:
+      return shaderc_callable_shader;
+    default:
+      AssertLogIf(true, "Failed to parse shader type");
+      return {};
+  }
+}
+
+// Tags of the fetched shaderc, glslang and SPIRV-Tools, set by CMake
+#ifndef WUNDER_SHADER_COMPILER_IDENTITY
+#define WUNDER_SHADER_COMPILER_IDENTITY "unknown"
+#endif
+
+// Bump whenever the cache layout or create_compile_options change
+constexpr std::uint32_t k_spirv_cache_version = 2;
+constexpr std::uint32_t k_spirv_cache_magic = 0x56505357;  // WSPV
+
+struct spirv_cache_header {
+  std::uint32_t m_magic = k_spirv_cache_magic;
+  std::uint32_t m_version = k_spirv_cache_version;
+  std::uint64_t m_source_hash = 0;
+  std::uint64_t m_words_count = 0;
+  std::uint64_t m_data_hash = 0;
+};
+
+shaderc::CompileOptions create_compile_options(
+    shaderc_util::FileFinder& file_finder, bool optimize) {
+  shaderc::CompileOptions compile_options;
+  compile_options.SetTargetEnvironment(shaderc_target_env_vulkan,
+                                       shaderc_env_version_vulkan_1_3);
+  compile_options.SetTargetSpirv(
+      shaderc_spirv_version::shaderc_spirv_version_1_6);
+  compile_options.SetWarningsAsErrors();
+  compile_options.SetIncluder(
+      std::make_unique<glslc::FileIncluder>(&file_finder));
+
+  if (optimize) {
+    compile_options.SetOptimizationLevel(
+        shaderc_optimization_level_performance);
+  } else {
+    compile_options.SetGenerateDebugInfo();
+  }
+
+  return compile_options;
+}
+
+// Everything the SPIR-V depends on besides the preprocessed source
+std::uint64_t get_compile_options_hash(const VkShaderStageFlagBits stage,
+                                       bool optimize) {
+  unsigned int spirv_version = 0;
+  unsigned int spirv_revision = 0;
+  shaderc_get_spv_version(&spirv_version, &spirv_revision);
+
+  std::uint64_t hash = wunder::hash::utils::fnv1a_64(
+      &k_spirv_cache_version, sizeof(k_spirv_cache_version));
+  hash = wunder::hash::utils::fnv1a_64(&spirv_version, sizeof(spirv_version),
+                                       hash);
+  hash = wunder::hash::utils::fnv1a_64(&spirv_revision, sizeof(spirv_revision),
+                                       hash);
+
+  // The SPIR-V version doesn't change with every compiler release, the
+  // binaries it produces do
+  constexpr std::string_view compiler_identity =
+      WUNDER_SHADER_COMPILER_IDENTITY;
+  hash = wunder::hash::utils::fnv1a_64(compiler_identity.data(),
+                                       compiler_identity.size(), hash);
+#ifdef GLSLANG_VERSION_MAJOR
+  constexpr std::array<int, 3> glslang_version{
+      GLSLANG_VERSION_MAJOR, GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH};
+  hash = wunder::hash::utils::fnv1a_64(glslang_version.data(),
+                                       sizeof(glslang_version), hash);
+#endif
+  hash = wunder::hash::utils::fnv1a_64(&optimize, sizeof(optimize), hash);
+  return wunder::hash::utils::fnv1a_64(&stage, sizeof(stage), hash);
+}
+
+std::filesystem::path get_spirv_cache_path(const std::string& shader_name,
+                                           std::uint64_t source_hash) {
+  return wunder::wunder_filesystem::instance().get_cache_dir("shaders") /
+         (shader_name + "_" + wunder::hash::utils::hash_to_string(source_hash) +
+          ".spv");
+}
+
+std::optional<std::vector<std::uint32_t>> load_spirv_cache(
+    const std::filesystem::path& cache_path, std::uint64_t source_hash) {
+  std::ifstream cache_file(cache_path, std::ios::binary);
+  ReturnUnless(cache_file.is_open(), std::nullopt);
+
+  spirv_cache_header header;
+  cache_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  ReturnUnless(cache_file.good(), std::nullopt);
+
+  spirv_cache_header expected_header;
+  ReturnIf(header.m_magic != expected_header.m_magic, std::nullopt);
+  ReturnIf(header.m_version != expected_header.m_version, std::nullopt);
+  ReturnIf(header.m_source_hash != source_hash, std::nullopt);
+
+  std::error_code error;
+  const auto file_size = std::filesystem::file_size(cache_path, error);
+  ReturnIf(static_cast<bool>(error) ||
+               file_size != sizeof(header) +
+                                header.m_words_count * sizeof(std::uint32_t),
+           std::nullopt);
+
+  std::vector<std::uint32_t> binary(header.m_words_count);
+  cache_file.read(reinterpret_cast<char*>(binary.data()),
+                  static_cast<std::streamsize>(binary.size() *
+                                               sizeof(std::uint32_t)));
+  ReturnUnless(cache_file.good(), std::nullopt);
+  ReturnIf(wunder::hash::utils::fnv1a_64(
+               binary.data(), binary.size() * sizeof(std::uint32_t)) !=
+               header.m_data_hash,
+           std::nullopt);
+
+  return binary;
+}
+
+void save_spirv_cache(const std::filesystem::path& cache_path,
+                      std::uint64_t source_hash,
+                      const std::vector<std::uint32_t>& binary) {
+  // Written next to the final file and renamed, a crash mid-write or another
+  // thread compiling the same shader never leaves a truncated file behind.
+  auto temp_path = cache_path;
+  temp_path += "." + std::to_string(std::hash<std::thread::id>{}(
+                         std::this_thread::get_id())) +
+               ".tmp";
+
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    AssertReturnUnless(cache_file.is_open());
+
+    spirv_cache_header header;
+    header.m_source_hash = source_hash;
+    header.m_words_count = binary.size();
+    header.m_data_hash = wunder::hash::utils::fnv1a_64(
+        binary.data(), binary.size() * sizeof(std::uint32_t));
+
+    cache_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    cache_file.write(reinterpret_cast<const char*>(binary.data()),
+                     static_cast<std::streamsize>(binary.size() *
+                                                  sizeof(std::uint32_t)));
+    AssertReturnUnless(cache_file.good());
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temp_path, cache_path, error);
+  AssertReturnIf(static_cast<bool>(error));
+}
+
+template <typename T>
+concept vulkan_shader_resource_concept =
+    std::is_base_of<wunder::vulkan::shader_resource::declaration::base,
+                    T>::value;
+
+template <vulkan_shader_resource_concept resource_type>
+void spirv_resources_to_descriptors_declarations(
+    const spirv_cross::Compiler& compiler,
+    const spirv_cross::SmallVector<spirv_cross::Resource>& resources,
+    wunder::vulkan::vulkan_shader_reflection_data& out_reflection_data) {
+  for (const auto& resource : resources) {
+    uint32_t descriptor_set =
+        compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+    uint32_t descriptor_binding =
+        compiler.get_decoration(resource.id, spv::DecorationBinding);
+
+    // 0 marks runtime sized arrays, e.g. texturesMap[]
+    uint32_t descriptor_count = 1;
+    for (auto array_size : compiler.get_type(resource.type_id).array) {
+      descriptor_count *= array_size;
+    }
+
+    out_reflection_data.m_shader_resources_declaration[resource.name] =
+        resource_type{descriptor_set, descriptor_binding, descriptor_count};
+  }
+}
+
+}  // namespace
+
+namespace wunder::vulkan::shader_compiler {
+std::expected<std::vector<std::uint32_t>, shader_operation_output_code>
+compile(const std::filesystem::path& source_path,
+        const VkShaderStageFlagBits stage, bool optimize) {
+  // Compiler objects are safe to use from multiple threads
+  static shaderc::Compiler compiler;
+
+  std::ifstream source_istream(source_path);
+  AssertReturnUnless(
+      source_istream.is_open(),
+      std::unexpected(shader_operation_output_code::ShaderFileDoesntExist));
+
+  const auto shader_name = source_path.filename().string();
+
+  shaderc_util::FileFinder fileFinder;
+  fileFinder.search_path().push_back(source_path.parent_path().string());
+
+  shaderc::CompileOptions compile_options =
+      create_compile_options(fileFinder, optimize);
+
+  std::stringstream shader_string_stream;
+  shader_string_stream << source_istream.rdbuf();
+  const std::string source = shader_string_stream.str();
+
+  // Preprocessing resolves the includes, so an edit in any included file
+  // changes the key as well
+  const shaderc::PreprocessedSourceCompilationResult preprocessed =
+      compiler.PreprocessGlsl(source, vulkan_shader_stage_to_shaderc(stage),
+                              shader_name.c_str(), compile_options);
+  if (preprocessed.GetCompilationStatus() !=
+      shaderc_compilation_status_success) {
+    WUNDER_ERROR_TAG("Renderer", preprocessed.GetErrorMessage());
+    return std::unexpected(shader_operation_output_code::CompilationFailed);
+  }
+
+  const std::uint64_t source_hash = hash::utils::fnv1a_64(
+      preprocessed.begin(),
+      static_cast<std::size_t>(preprocessed.end() - preprocessed.begin()),
+      get_compile_options_hash(stage, optimize));
+  const auto cache_path = get_spirv_cache_path(shader_name, source_hash);
+
+  if (auto cached_binary = load_spirv_cache(cache_path, source_hash)) {
+    WUNDER_INFO_TAG("Renderer", "{0} loaded from {1}", shader_name,
+                    cache_path.string());
+    return std::move(cached_binary.value());
+  }
+
+  const shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(
+      source, vulkan_shader_stage_to_shaderc(stage), shader_name.c_str(),
+      "main", compile_options);
+
+  if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
+    WUNDER_ERROR_TAG("Renderer", module.GetErrorMessage());
+    return std::unexpected(shader_operation_output_code::CompilationFailed);
+  }
+
+  std::vector binary(module.begin(), module.end());
+  save_spirv_cache(cache_path, source_hash, binary);
+
+  return binary;
+}
+
+vulkan_shader_reflection_data reflect(
+    const std::vector<std::uint32_t>& spirv) {
+  vulkan_shader_reflection_data reflection_data{};
+
+  spirv_cross::Compiler compiler(spirv);
+  auto resources = compiler.get_shader_resources();
+
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::uniform_buffer>(
+      compiler, resources.uniform_buffers, reflection_data);
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::storage_buffers>(
+      compiler, resources.storage_buffers, reflection_data);
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::sampled_images>(
+      compiler, resources.sampled_images, reflection_data);
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::separate_images>(
+      compiler, resources.separate_images, reflection_data);
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::separate_samplers>(
+      compiler, resources.separate_samplers, reflection_data);
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::storage_images>(
+      compiler, resources.storage_images, reflection_data);
+  spirv_resources_to_descriptors_declarations<
+      shader_resource::declaration::acceleration_structures>(
+      compiler, resources.acceleration_structures, reflection_data);
+
+  ReturnIf(reflection_data.m_shader_resources_declaration.empty(),
+           reflection_data);
+
+  auto resource_with_max_set = std::max_element(
+      reflection_data.m_shader_resources_declaration.begin(),
+      reflection_data.m_shader_resources_declaration.end(),
+      [](const std::pair<vulkan_resource_identifier,
+                         shader_resource::declaration::element>& left_element,
+         const std::pair<vulkan_resource_identifier,
+                         shader_resource::declaration::element>&
+             right_element) {
+        const shader_resource::declaration::base& left_resource_declaration =
+            std::visit(shader_resource::declaration::downcast,
+                       left_element.second);
+        const shader_resource::declaration::base& right_resource_declaration =
+            std::visit(shader_resource::declaration::downcast,
+                       right_element.second);
+
+        return left_resource_declaration.m_set <
+               right_resource_declaration.m_set;
+      });
+
+  reflection_data.m_descriptor_sets_count =
+      std::visit(shader_resource::declaration::downcast,
+                 resource_with_max_set->second)
+          .m_set +
+      1;
+
+  return reflection_data;
+}
+
+std::optional<VkShaderStageFlagBits> get_stage_from_extension(
+    const std::filesystem::path& source_path) {
+  static const std::unordered_map<std::string, VkShaderStageFlagBits>
+      s_stages_of_extensions = {
+          {".vert", VK_SHADER_STAGE_VERTEX_BIT},
+          {".frag", VK_SHADER_STAGE_FRAGMENT_BIT},
+          {".comp", VK_SHADER_STAGE_COMPUTE_BIT},
+          {".rgen", VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+          {".rahit", VK_SHADER_STAGE_ANY_HIT_BIT_KHR},
+          {".rchit", VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR},
+          {".rmiss", VK_SHADER_STAGE_MISS_BIT_KHR},
+          {".rint", VK_SHADER_STAGE_INTERSECTION_BIT_KHR},
+          {".rcall", VK_SHADER_STAGE_CALLABLE_BIT_KHR}};
+
+  auto found_stage_it =
+      s_stages_of_extensions.find(source_path.extension().string());
+  ReturnIf(found_stage_it == s_stages_of_extensions.end(), std::nullopt);
+
+  return found_stage_it->second;
+}
+}  // namespace wunder::vulkan::shader_compiler
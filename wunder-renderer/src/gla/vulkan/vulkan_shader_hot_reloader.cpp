@@ -0,0 +1,208 @@
+#include "gla/vulkan/vulkan_shader_hot_reloader.h"
+
+#include <algorithm>
+#include <expected>
+#include <fstream>
+#include <regex>
+#include <utility>
+
+#include "core/async_task.h"
+#include "core/file_watcher.h"
+#include "core/parallel_for.h"
+#include "core/task_executor.h"
+#include "core/time_unit.h"
+#include "core/wunder_filesystem.h"
+#include "core/wunder_macros.h"
+#include "gla/vulkan/vulkan_shader.h"
+
+namespace wunder::vulkan {
+namespace {
+std::string normalize_path(const std::filesystem::path& path) {
+  std::error_code error;
+  auto canonical_path = std::filesystem::weakly_canonical(path, error);
+  return error ? path.lexically_normal().string() : canonical_path.string();
+}
+
+class shader_compile_task : public async_task {
+ public:
+  using completion_callback = std::function<void(
+      std::vector<shader_hot_reloader::reloaded_shader>&, bool)>;
+
+ public:
+  shader_compile_task(std::vector<shader_hot_reloader::tracked_shader> shaders,
+                      completion_callback on_completed)
+      : m_on_completed(std::move(on_completed)) {
+    for (auto& shader : shaders) {
+      m_reloaded_shaders.push_back(
+          shader_hot_reloader::reloaded_shader{std::move(shader), {}});
+    }
+  }
+
+ private:
+  void run() override {
+    std::vector<char> is_compiled(m_reloaded_shaders.size(), false);
+
+    // every stage is an independent compilation
+    parallel_for(
+        m_reloaded_shaders.size(),
+        [this, &is_compiled](std::size_t begin, std::size_t end) {
+          for (std::size_t i = begin; i < end; ++i) {
+            auto& reloaded_shader = m_reloaded_shaders[i];
+            auto binary =
+                shader::load_spirv(reloaded_shader.m_shader.m_shader_path,
+                                   reloaded_shader.m_shader.m_stage);
+            ContinueUnless(binary.has_value());
+
+            reloaded_shader.m_binary = std::move(binary.value());
+            is_compiled[i] = true;
+          }
+        },
+        1);
+
+    m_succeeded = std::find(is_compiled.begin(), is_compiled.end(), false) ==
+                  is_compiled.end();
+  }
+
+  void execute_on_main_thread() override {
+    m_on_completed(m_reloaded_shaders, m_succeeded);
+  }
+
+ private:
+  std::vector<shader_hot_reloader::reloaded_shader> m_reloaded_shaders;
+  completion_callback m_on_completed;
+  bool m_succeeded = false;
+};
+}  // namespace
+
+shader_hot_reloader::shader_hot_reloader(
+    const std::filesystem::path& shaders_directory,
+    reloaded_callback on_reloaded)
+    : m_on_reloaded(std::move(on_reloaded)),
+      m_file_watcher(make_unique<file_watcher>(shaders_directory)),
+      m_compile_executor(make_unique<task_executor>(1)) {
+  if (m_file_watcher->is_watching()) {
+    WUNDER_INFO_TAG("Renderer", "Watching {0} for shader changes",
+                    shaders_directory.string());
+  }
+}
+
+shader_hot_reloader::~shader_hot_reloader() {
+  // a compilation in flight finishes, its results are dropped
+  m_compile_executor->shutdown();
+}
+
+void shader_hot_reloader::track(tracked_shader shader) {
+  shader.m_shader_path =
+      wunder_filesystem::instance().resolve_path(shader.m_shader_path);
+  m_tracked_shaders.emplace_back(std::move(shader));
+  m_dependencies.emplace_back();
+
+  update_dependencies(m_tracked_shaders.size() - 1);
+}
+
+void shader_hot_reloader::update(time_unit dt) {
+  m_compile_executor->update(dt);
+
+  collect_affected_shaders();
+  try_compile_affected_shaders();
+}
+
+void shader_hot_reloader::on_compiled(
+    std::vector<reloaded_shader>& reloaded_shaders, bool succeeded) {
+  m_is_compiling = false;
+
+  // includes may have been added or removed by the edit
+  for (const auto& reloaded_shader : reloaded_shaders) {
+    for (std::size_t shader_idx = 0; shader_idx < m_tracked_shaders.size();
+         ++shader_idx) {
+      ContinueUnless(m_tracked_shaders[shader_idx].m_shader_path ==
+                     reloaded_shader.m_shader.m_shader_path);
+      update_dependencies(shader_idx);
+    }
+  }
+
+  if (!succeeded) {
+    WUNDER_ERROR_TAG("Renderer",
+                     "Shader reload failed, keeping the previous shaders");
+    return;
+  }
+
+  WUNDER_INFO_TAG("Renderer", "Reloaded {0} shaders", reloaded_shaders.size());
+  m_on_reloaded(reloaded_shaders);
+}
+
+void shader_hot_reloader::collect_affected_shaders() {
+  for (const auto& changed_file : m_file_watcher->poll_changes()) {
+    auto dependants_it = m_dependants.find(normalize_path(changed_file));
+    ContinueIf(dependants_it == m_dependants.end());
+
+    WUNDER_INFO_TAG("Renderer", "{0} changed, recompiling {1} shaders",
+                    changed_file.string(), dependants_it->second.size());
+    m_affected_shaders.insert(dependants_it->second.begin(),
+                              dependants_it->second.end());
+  }
+}
+
+void shader_hot_reloader::try_compile_affected_shaders() {
+  // changes made while compiling are picked up by the next compilation
+  ReturnIf(m_is_compiling || m_affected_shaders.empty());
+
+  std::vector<tracked_shader> shaders_to_compile;
+  for (auto shader_idx : m_affected_shaders) {
+    shaders_to_compile.push_back(m_tracked_shaders[shader_idx]);
+  }
+  m_affected_shaders.clear();
+
+  m_is_compiling = true;
+  m_compile_executor->enqueue(new shader_compile_task(
+      std::move(shaders_to_compile),
+      [this](std::vector<reloaded_shader>& reloaded_shaders, bool succeeded) {
+        on_compiled(reloaded_shaders, succeeded);
+      }));
+}
+
+void shader_hot_reloader::update_dependencies(std::size_t shader_idx) {
+  auto& dependencies = m_dependencies[shader_idx];
+  for (const auto& dependency : dependencies) {
+    auto& dependants = m_dependants[dependency];
+    std::erase(dependants, shader_idx);
+  }
+  dependencies.clear();
+
+  const auto& shader_path = m_tracked_shaders[shader_idx].m_shader_path;
+  dependencies.insert(normalize_path(shader_path));
+  collect_includes(shader_path, shader_path.parent_path(), dependencies);
+
+  for (const auto& dependency : dependencies) {
+    m_dependants[dependency].push_back(shader_idx);
+  }
+}
+
+void shader_hot_reloader::collect_includes(
+    const std::filesystem::path& file,
+    const std::filesystem::path& search_directory,
+    std::unordered_set<std::string>& dependencies) const {
+  static const std::regex s_include_regex(
+      R"(^\s*#\s*include\s*[<"]([^>"]+)[>"])");
+
+  std::ifstream source(file);
+  ReturnUnless(source.is_open());
+
+  std::string line;
+  std::smatch match;
+  while (std::getline(source, line)) {
+    ContinueUnless(std::regex_search(line, match, s_include_regex));
+
+    // same lookup order as the includer used for compilation
+    auto include_path = file.parent_path() / match[1].str();
+    if (!std::filesystem::exists(include_path)) {
+      include_path = search_directory / match[1].str();
+    }
+    ContinueUnless(std::filesystem::exists(include_path));
+    // already visited, include guards or a shared header
+    ContinueUnless(dependencies.insert(normalize_path(include_path)).second);
+
+    collect_includes(include_path, search_directory, dependencies);
+  }
+}
+}  // namespace wunder::vulkan
@@ -1,5 +1,7 @@
 #include "gla/vulkan/vulkan_shader_types.h"
 
+#include <type_traits>
+
 #include "core/wunder_macros.h"
 
 namespace wunder::vulkan {
@@ -50,14 +52,15 @@ void vulkan_descriptor_binding::emplace_resource(
           [this](const std::reference_wrapper<
                  shader_resource::instance::uniform_buffer>& buffer) {
             initialize_if_empty(std::vector<VkDescriptorBufferInfo>(),
-                                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+                                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 
             AssertReturnUnless(m_descriptor_type ==
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 
             add_resource_template<shader_resource::instance::uniform_buffer,
                                   VkDescriptorBufferInfo>(buffer.get(),
                                                           m_resources);
+            m_dynamic_resources.emplace_back(buffer);
           },
 
           [this](const std::reference_wrapper<
@@ -106,6 +109,36 @@ void vulkan_descriptor_binding::emplace_resource(
       resource);
 }
 
+bool vulkan_descriptor_binding::replace_resource(
+    std::uint32_t array_element,
+    const shader_resource::instance::element& resource) {
+  if (array_element >= size()) {
+    AssertReturnUnless(array_element == size(), false);
+
+    emplace_resource(resource);
+    return true;
+  }
+
+  vulkan_descriptor_binding replacement;
+  replacement.emplace_resource(resource);
+  AssertReturnIf(replacement.size() == 0, false);
+  AssertReturnUnless(replacement.m_descriptor_type == m_descriptor_type, false);
+
+  std::visit(
+      [array_element](auto& descriptors, const auto& replacement_descriptors) {
+        using descriptors_type = std::decay_t<decltype(descriptors)>;
+        using replacement_descriptors_type =
+            std::decay_t<decltype(replacement_descriptors)>;
+        if constexpr (std::is_same_v<descriptors_type,
+                                     replacement_descriptors_type>) {
+          descriptors[array_element] = replacement_descriptors.front();
+        }
+      },
+      m_resources, replacement.m_resources);
+
+  return true;
+}
+
 void vulkan_descriptor_binding::initialize_if_empty(
     shader_resource::instance::resource_list default_value,
     VkDescriptorType descriptor_type) {
@@ -136,6 +169,7 @@ void vulkan_descriptor_binding::clear_resources() {
   // clang-format on
   // @formatter:on
 
+  m_dynamic_resources.clear();
   m_descriptor_type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
 }
 
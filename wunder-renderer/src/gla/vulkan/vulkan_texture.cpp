@@ -8,6 +8,7 @@
 #include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "gla/vulkan/vulkan_macros.h"
 #include "gla/vulkan/vulkan_memory_allocator.h"
+#include "gla/vulkan/vulkan_upload_manager.h"
 #include "include/assets/texture_asset.h"
 #include "include/gla/vulkan/ray-trace/vulkan_rtx_renderer.h"
 
@@ -142,7 +143,7 @@ texture<base_texture>::texture(descriptor_build_data build_data,
       m_image_size(asset.m_width, asset.m_height),
       m_descriptor_build_data(std::move(build_data)) {
   std::string name = generate_next_texture_name();
-  m_mip_levels = 1;
+  m_mip_levels = 1 + static_cast<uint32_t>(asset.m_mip_chain.size());
 
   VkFormat image_format = asset.m_texture_data.get_image_format();
   VkImageLayout target_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -432,60 +433,31 @@ void texture<base_texture>::bind_texture_data(const texture_asset& asset,
   const auto& texture_data = asset.m_texture_data;
   ReturnIf(texture_data.is_empty());
 
-  auto& vulkan_context =
-      layer_abstraction_factory::instance().get_vulkan_context();
-  auto& command_pool = vulkan_context.mutable_command_pool() ;
-  auto& allocator = vulkan_context.mutable_resource_allocator();
-
-  VkMemoryAllocateInfo memAllocInfo{};
-  memset(&memAllocInfo, 0, sizeof(VkMemoryAllocateInfo));
-
-  memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-  // Create staging buffer
-  VkBufferCreateInfo buffer_create_info{};
-  memset(&buffer_create_info, 0, sizeof(VkBufferCreateInfo));
-
-  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  buffer_create_info.size = texture_data.size();
-  buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  VkBuffer staging_buffer;
-  VmaAllocation staging_buffer_allocation = allocator.allocate_buffer(
-      buffer_create_info, VMA_MEMORY_USAGE_CPU_TO_GPU, staging_buffer);
-
-  // Copy data to staging buffer
-  texture_data.copy_to(staging_buffer_allocation);
-  allocator.unmap_memory(staging_buffer_allocation);
-
-  VkCommandBuffer command_buffer =
-      command_pool.get_current_compute_command_buffer();
-
-  VkBufferImageCopy buffer_copy_region = {};
-  buffer_copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  buffer_copy_region.imageSubresource.mipLevel = 0;
-  buffer_copy_region.imageSubresource.baseArrayLayer = 0;
-  buffer_copy_region.imageSubresource.layerCount = m_mip_levels;
-  buffer_copy_region.imageExtent.width = asset.m_width;
-  buffer_copy_region.imageExtent.height = asset.m_height;
-  buffer_copy_region.imageExtent.depth = 1;
-  buffer_copy_region.bufferOffset = 0;
-
-  transit_image_layout(command_buffer, VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED,
-                       VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-  // Copy mip levels from staging buffer
-  vkCmdCopyBufferToImage(command_buffer, staging_buffer, m_image_info->m_image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                         &buffer_copy_region);
-
-  transit_image_layout(command_buffer,
-                       VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                       target_layout);
-
-  command_pool.flush_compute_command_buffer();
+  auto& upload_manager = layer_abstraction_factory::instance()
+                             .get_vulkan_context()
+                             .mutable_upload_manager();
+
+  // Level 0 comes from the asset data, the rest from the precomputed chain
+  std::vector<upload_manager::image_upload_region> regions;
+  regions.reserve(m_mip_levels);
+
+  for (uint32_t mip_level = 0; mip_level < m_mip_levels; ++mip_level) {
+    const auto& mip_level_data =
+        mip_level == 0 ? texture_data : asset.m_mip_chain[mip_level - 1];
+
+    regions.push_back(upload_manager::image_upload_region{
+        .m_data = mip_level_data.data(),
+        .m_size = mip_level_data.size(),
+        .m_mip_level = mip_level,
+        .m_extent = {.width = std::max(1u, asset.m_width >> mip_level),
+                     .height = std::max(1u, asset.m_height >> mip_level),
+                     .depth = 1}});
+  }
 
-  allocator.destroy_buffer(staging_buffer, staging_buffer_allocation);
+  // Copied and transitioned on the transfer queue, ownership goes to the
+  // graphics queue family which samples the texture
+  upload_manager.upload_image(m_image_info->m_image, m_mip_levels, regions,
+                              target_layout);
 }
 
 template <typename base_texture>
@@ -0,0 +1,759 @@
+#include "gla/vulkan/vulkan_upload_manager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "core/wunder_macros.h"
+#include "core/wunder_memory.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_device.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_macros.h"
+#include "gla/vulkan/vulkan_memory_allocator.h"
+#include "gla/vulkan/vulkan_physical_device.h"
+
+namespace wunder::vulkan {
+namespace {
+VkSemaphore create_timeline_semaphore(VkDevice vulkan_logical_device,
+                                      const std::string& name) {
+  VkSemaphoreTypeCreateInfo semaphore_type_create_info{};
+  semaphore_type_create_info.sType =
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  semaphore_type_create_info.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphore_create_info{};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_create_info.pNext = &semaphore_type_create_info;
+
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkCreateSemaphore(vulkan_logical_device,
+                                    &semaphore_create_info, nullptr,
+                                    &semaphore));
+  set_debug_utils_object_name(vulkan_logical_device, name, semaphore);
+
+  return semaphore;
+}
+}  // namespace
+
+upload_manager::upload_manager(VkDeviceSize ring_size)
+    : m_ring_size(ring_size) {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  const auto& queue_family_indices =
+      vulkan_context.mutable_physical_device().get_queue_family_indices();
+
+  m_transfer_family = static_cast<std::uint32_t>(queue_family_indices.Transfer);
+  m_graphics_family = static_cast<std::uint32_t>(queue_family_indices.Graphics);
+  m_compute_family = static_cast<std::uint32_t>(queue_family_indices.Compute);
+  m_transfer_queue = vulkan_context.mutable_device().get_transfer_queue();
+
+  create_ring_buffer();
+  create_command_pool();
+
+  m_timeline_semaphore = create_timeline_semaphore(
+      vulkan_context.mutable_device().get_vulkan_logical_device(),
+      "upload timeline");
+}
+
+upload_manager::~upload_manager() {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+
+  flush();
+
+  // Acquire command buffers are executed by the consumer queues, make sure
+  // none of them is still in use
+  vulkan_context.mutable_device().wait_idle();
+
+  std::lock_guard lock(m_mutex);
+  retire_completed_batches();
+
+  for (auto& [_, queue_family] : m_queue_families) {
+    vkDestroyCommandPool(vulkan_logical_device, queue_family.m_command_pool,
+                         nullptr);
+    vkDestroySemaphore(vulkan_logical_device, queue_family.m_acquire_semaphore,
+                       nullptr);
+  }
+  m_queue_families.clear();
+
+  if (m_timeline_semaphore != VK_NULL_HANDLE) {
+    vkDestroySemaphore(vulkan_logical_device, m_timeline_semaphore, nullptr);
+  }
+
+  if (m_command_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(vulkan_logical_device, m_command_pool, nullptr);
+  }
+
+  if (m_ring_buffer != VK_NULL_HANDLE) {
+    allocator.unmap_memory(m_ring_allocation);
+    allocator.destroy_buffer(m_ring_buffer, m_ring_allocation);
+  }
+}
+
+void upload_manager::upload_buffer(VkBuffer destination,
+                                   VkDeviceSize destination_offset,
+                                   const void* data, VkDeviceSize data_size,
+                                   upload_destination owner) {
+  ReturnIf(data_size == 0);
+  AssertReturnIf(destination == VK_NULL_HANDLE);
+
+  std::lock_guard lock(m_mutex);
+
+  staging_allocation staging = allocate_staging(data_size);
+  AssertReturnIf(staging.m_mapped_data == nullptr);
+
+  std::memcpy(staging.m_mapped_data, data, data_size);
+  flush_staging(staging, data_size);
+
+  VkCommandBuffer command_buffer = begin_batch();
+
+  VkBufferCopy copy_region = {};
+  copy_region.srcOffset = staging.m_offset;
+  copy_region.dstOffset = destination_offset;
+  copy_region.size = data_size;
+  vkCmdCopyBuffer(command_buffer, staging.m_buffer, destination, 1,
+                  &copy_region);
+
+  if (owner == upload_destination::shared) {
+    // Concurrent buffers are only waited for, the semaphore signal makes the
+    // copy visible to both families
+    mutable_queue_family_state(m_graphics_family).m_has_pending_uploads = true;
+    mutable_queue_family_state(m_compute_family).m_has_pending_uploads = true;
+
+    m_pending_batch.m_copied_bytes += data_size;
+    submit_batch_if_big();
+    return;
+  }
+
+  const std::uint32_t queue_family = get_queue_family(owner);
+  auto& queue_family_state = mutable_queue_family_state(queue_family);
+  queue_family_state.m_has_pending_uploads = true;
+
+  if (queue_family != m_transfer_family) {
+    // Release the written range to the consumer queue family, the matching
+    // acquire is executed by its next submission
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = m_transfer_family;
+    barrier.dstQueueFamilyIndex = queue_family;
+    barrier.buffer = destination;
+    barrier.offset = destination_offset;
+    barrier.size = data_size;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                         &barrier, 0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask =
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    queue_family_state.m_buffer_acquires.push_back(barrier);
+  }
+
+  m_pending_batch.m_copied_bytes += data_size;
+  submit_batch_if_big();
+}
+
+void upload_manager::upload_image(
+    VkImage destination, std::uint32_t mip_levels,
+    const std::vector<image_upload_region>& regions,
+    VkImageLayout target_layout, upload_destination owner) {
+  ReturnIf(regions.empty());
+  AssertReturnIf(destination == VK_NULL_HANDLE);
+  // Images are exclusive to one family
+  AssertReturnIf(owner == upload_destination::shared);
+
+  std::lock_guard lock(m_mutex);
+
+  VkDeviceSize data_size = 0;
+  for (const auto& region : regions) {
+    data_size += region.m_size;
+  }
+
+  staging_allocation staging = allocate_staging(data_size);
+  AssertReturnIf(staging.m_mapped_data == nullptr);
+
+  // All regions are packed one after another in the staging memory
+  std::vector<VkBufferImageCopy> buffer_copy_regions;
+  buffer_copy_regions.reserve(regions.size());
+
+  VkDeviceSize staging_offset = 0;
+  for (const auto& region : regions) {
+    std::memcpy(staging.m_mapped_data + staging_offset, region.m_data,
+                region.m_size);
+
+    VkBufferImageCopy& buffer_copy_region = buffer_copy_regions.emplace_back();
+    buffer_copy_region = {};
+    buffer_copy_region.bufferOffset = staging.m_offset + staging_offset;
+    buffer_copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    buffer_copy_region.imageSubresource.mipLevel = region.m_mip_level;
+    buffer_copy_region.imageSubresource.baseArrayLayer = 0;
+    buffer_copy_region.imageSubresource.layerCount = 1;
+    buffer_copy_region.imageExtent = region.m_extent;
+
+    staging_offset += region.m_size;
+  }
+  flush_staging(staging, data_size);
+
+  VkCommandBuffer command_buffer = begin_batch();
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = destination;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mip_levels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  vkCmdCopyBufferToImage(command_buffer, staging.m_buffer, destination,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(buffer_copy_regions.size()),
+                         buffer_copy_regions.data());
+
+  const std::uint32_t queue_family = get_queue_family(owner);
+  auto& queue_family_state = mutable_queue_family_state(queue_family);
+  queue_family_state.m_has_pending_uploads = true;
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = target_layout;
+
+  if (queue_family != m_transfer_family) {
+    // Release with the layout transition, a dedicated transfer queue doesn't
+    // support the shader stages of the target layout
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = m_transfer_family;
+    barrier.dstQueueFamilyIndex = queue_family;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    queue_family_state.m_image_acquires.push_back(barrier);
+  } else {
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+  }
+
+  m_pending_batch.m_copied_bytes += data_size;
+  submit_batch_if_big();
+}
+
+std::uint64_t upload_manager::submit() {
+  std::lock_guard lock(m_mutex);
+  return submit_pending_batch();
+}
+
+void upload_manager::wait(std::uint64_t timeline_value) {
+  {
+    std::lock_guard lock(m_mutex);
+    ReturnIf(timeline_value <= m_last_completed_value);
+  }
+
+  // Other threads keep uploading while this one waits
+  wait_semaphore(m_timeline_semaphore, timeline_value);
+
+  std::lock_guard lock(m_mutex);
+  retire_completed_batches();
+}
+
+void upload_manager::flush() { wait(submit()); }
+
+bool upload_manager::is_complete(std::uint64_t timeline_value) {
+  std::lock_guard lock(m_mutex);
+  ReturnIf(timeline_value <= m_last_completed_value, true);
+
+  retire_completed_batches();
+  return timeline_value <= m_last_completed_value;
+}
+
+VkResult upload_manager::submit_with_dependencies(
+    std::uint32_t queue_family, VkQueue queue,
+    const queue_submit_function& submit_function) {
+  std::lock_guard lock(m_mutex);
+
+  const submit_dependencies dependencies =
+      get_submit_dependencies(queue_family);
+
+  // The queue is shared by the loading threads and the swap chain
+  auto& device = layer_abstraction_factory::instance()
+                     .get_vulkan_context()
+                     .mutable_device();
+  std::lock_guard queue_lock(device.mutable_queue_mutex(queue));
+  return submit_function(queue, dependencies);
+}
+
+std::vector<std::uint32_t> upload_manager::get_shared_queue_families() const {
+  std::vector<std::uint32_t> queue_families = {m_graphics_family};
+  for (std::uint32_t queue_family : {m_compute_family, m_transfer_family}) {
+    ContinueIf(std::ranges::find(queue_families, queue_family) !=
+               queue_families.end());
+    queue_families.push_back(queue_family);
+  }
+
+  return queue_families;
+}
+
+void upload_manager::create_ring_buffer() {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = m_ring_size;
+  buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  m_ring_allocation = allocator.allocate_buffer(
+      buffer_create_info, VMA_MEMORY_USAGE_CPU_TO_GPU, m_ring_buffer);
+
+  // Mapped for the whole lifetime of the manager
+  m_ring_mapped_data = allocator.map_memory<std::uint8_t>(m_ring_allocation);
+
+  set_debug_utils_object_name(
+      vulkan_context.mutable_device().get_vulkan_logical_device(),
+      "upload staging ring", m_ring_buffer);
+}
+
+void upload_manager::create_command_pool() {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  VkCommandPoolCreateInfo command_pool_create_info = {};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.queueFamilyIndex = m_transfer_family;
+  command_pool_create_info.flags =
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VK_CHECK_RESULT(vkCreateCommandPool(vulkan_logical_device,
+                                      &command_pool_create_info, nullptr,
+                                      &m_command_pool));
+  set_debug_utils_object_name(vulkan_logical_device, "upload command pool",
+                              m_command_pool);
+}
+
+std::uint32_t upload_manager::get_queue_family(
+    upload_destination owner) const {
+  return owner == upload_destination::compute ? m_compute_family
+                                              : m_graphics_family;
+}
+
+upload_manager::queue_family_state& upload_manager::mutable_queue_family_state(
+    std::uint32_t queue_family) {
+  auto [queue_family_it, inserted] = m_queue_families.try_emplace(queue_family);
+  auto& queue_family_state = queue_family_it->second;
+  ReturnUnless(inserted, queue_family_state);
+
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  // Acquire barriers have to be recorded on the consumer queue family
+  VkCommandPoolCreateInfo command_pool_create_info = {};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.queueFamilyIndex = queue_family;
+  command_pool_create_info.flags =
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VK_CHECK_RESULT(vkCreateCommandPool(vulkan_logical_device,
+                                      &command_pool_create_info, nullptr,
+                                      &queue_family_state.m_command_pool));
+  set_debug_utils_object_name(vulkan_logical_device,
+                              "upload acquire command pool " +
+                                  std::to_string(queue_family),
+                              queue_family_state.m_command_pool);
+
+  queue_family_state.m_acquire_semaphore = create_timeline_semaphore(
+      vulkan_logical_device,
+      "upload acquire timeline " + std::to_string(queue_family));
+
+  return queue_family_state;
+}
+
+upload_manager::submit_dependencies upload_manager::get_submit_dependencies(
+    std::uint32_t queue_family) {
+  submit_dependencies dependencies;
+  auto& queue_family_state = mutable_queue_family_state(queue_family);
+
+  if (queue_family_state.m_has_pending_uploads) {
+    submit_pending_batch();
+  }
+
+  retire_completed_batches();
+
+  // Uploads consumed by other queue families don't stall this one
+  if (queue_family_state.m_required_value > m_last_completed_value) {
+    dependencies.m_wait_semaphore = m_timeline_semaphore;
+    dependencies.m_wait_value = queue_family_state.m_required_value;
+  }
+
+  ReturnIf(queue_family_state.m_buffer_acquires.empty() &&
+               queue_family_state.m_image_acquires.empty(),
+           dependencies);
+
+  dependencies.m_acquire_command_buffer =
+      record_acquire_command_buffer(queue_family_state);
+  dependencies.m_signal_semaphore = queue_family_state.m_acquire_semaphore;
+  dependencies.m_signal_value = queue_family_state.m_last_acquire_value;
+
+  return dependencies;
+}
+
+upload_manager::staging_allocation upload_manager::allocate_staging(
+    VkDeviceSize size) {
+  if (size > m_ring_size) {
+    return allocate_dedicated_staging(size);
+  }
+
+  retire_completed_batches();
+
+  VkDeviceSize offset = 0;
+  while (!try_allocate_from_ring(size, offset)) {
+    // The ring is full of copies which still have to be executed, start
+    // the pending ones and wait for the oldest batch to free its space
+    if (m_in_flight_batches.empty()) {
+      submit_pending_batch();
+    }
+
+    if (m_in_flight_batches.empty()) {
+      // Nothing to wait for, the pending batch alone fills the ring
+      return allocate_dedicated_staging(size);
+    }
+
+    wait_oldest_batch();
+  }
+
+  return staging_allocation{.m_buffer = m_ring_buffer,
+                            .m_allocation = m_ring_allocation,
+                            .m_offset = offset,
+                            .m_mapped_data = m_ring_mapped_data + offset};
+}
+
+bool upload_manager::try_allocate_from_ring(VkDeviceSize size,
+                                            VkDeviceSize& out_offset) {
+  if (m_ring_used == 0) {
+    m_ring_head = 0;
+    m_ring_tail = 0;
+  }
+
+  // head == tail with used memory means the ring is full
+  ReturnIf(m_ring_used > 0 && m_ring_head == m_ring_tail, false);
+
+  const VkDeviceSize aligned_head = align_up(m_ring_head, s_staging_alignment);
+  VkDeviceSize consumed = 0;
+
+  if (m_ring_head >= m_ring_tail) {
+    // Free space is [head, end) and [0, tail)
+    if (aligned_head + size <= m_ring_size) {
+      out_offset = aligned_head;
+      consumed = aligned_head + size - m_ring_head;
+    } else if (size <= m_ring_tail) {
+      out_offset = 0;
+      consumed = (m_ring_size - m_ring_head) + size;
+    } else {
+      return false;
+    }
+  } else {
+    // Free space is [head, tail)
+    ReturnIf(aligned_head + size > m_ring_tail, false);
+    out_offset = aligned_head;
+    consumed = aligned_head + size - m_ring_head;
+  }
+
+  m_ring_head = (out_offset + size) % m_ring_size;
+  m_ring_used += consumed;
+  m_pending_batch.m_ring_consumed += consumed;
+
+  return true;
+}
+
+upload_manager::staging_allocation upload_manager::allocate_dedicated_staging(
+    VkDeviceSize size) {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+
+  WUNDER_WARN_TAG("Renderer",
+                  "Upload of {0} bytes doesn't fit the staging ring, using a "
+                  "dedicated staging buffer",
+                  size);
+
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = size;
+  buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  auto& [staging_buffer, staging_buffer_allocation] =
+      m_pending_batch.m_dedicated_staging.emplace_back();
+  staging_buffer_allocation = allocator.allocate_buffer(
+      buffer_create_info, VMA_MEMORY_USAGE_CPU_TO_GPU, staging_buffer);
+
+  // Stays mapped until the batch is retired
+  return staging_allocation{
+      .m_buffer = staging_buffer,
+      .m_allocation = staging_buffer_allocation,
+      .m_offset = 0,
+      .m_mapped_data =
+          allocator.map_memory<std::uint8_t>(staging_buffer_allocation)};
+}
+
+void upload_manager::flush_staging(const staging_allocation& staging,
+                                   VkDeviceSize size) const {
+  auto& allocator = layer_abstraction_factory::instance()
+                        .get_vulkan_context()
+                        .mutable_resource_allocator();
+
+  // Staging memory is host visible, but not necessarily coherent. The copy is
+  // submitted later, so the written range is made available here.
+  VK_CHECK_RESULT(vmaFlushAllocation(allocator.get_vma_allocator(),
+                                     staging.m_allocation, staging.m_offset,
+                                     size));
+}
+
+VkCommandBuffer upload_manager::begin_batch() {
+  ReturnIf(m_has_pending_batch, m_pending_batch.m_command_buffer);
+
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  if (m_free_command_buffers.empty()) {
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.sType =
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool = m_command_pool;
+    command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = 1;
+
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkan_logical_device,
+                                             &command_buffer_allocate_info,
+                                             &m_pending_batch.m_command_buffer));
+    set_debug_utils_object_name(vulkan_logical_device,
+                                "upload command buffer",
+                                m_pending_batch.m_command_buffer);
+  } else {
+    m_pending_batch.m_command_buffer = m_free_command_buffers.back();
+    m_free_command_buffers.pop_back();
+    VK_CHECK_RESULT(vkResetCommandBuffer(m_pending_batch.m_command_buffer, 0));
+  }
+
+  VkCommandBufferBeginInfo command_buffer_begin_info{};
+  command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkBeginCommandBuffer(m_pending_batch.m_command_buffer,
+                                       &command_buffer_begin_info));
+
+  m_has_pending_batch = true;
+  return m_pending_batch.m_command_buffer;
+}
+
+std::uint64_t upload_manager::submit_pending_batch() {
+  ReturnUnless(m_has_pending_batch, m_last_submitted_value);
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(m_pending_batch.m_command_buffer));
+
+  m_pending_batch.m_timeline_value = ++m_last_submitted_value;
+  m_pending_batch.m_ring_end = m_ring_head;
+
+  VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+  timeline_submit_info.sType =
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timeline_submit_info.signalSemaphoreValueCount = 1;
+  timeline_submit_info.pSignalSemaphoreValues =
+      &m_pending_batch.m_timeline_value;
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.pNext = &timeline_submit_info;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &m_pending_batch.m_command_buffer;
+  submit_info.signalSemaphoreCount = 1;
+  submit_info.pSignalSemaphores = &m_timeline_semaphore;
+
+  {
+    // Without a dedicated transfer family the queue is the one the main
+    // thread renders with
+    auto& device = layer_abstraction_factory::instance()
+                       .get_vulkan_context()
+                       .mutable_device();
+    std::lock_guard queue_lock(device.mutable_queue_mutex(m_transfer_queue));
+    VK_CHECK_RESULT(
+        vkQueueSubmit(m_transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+  }
+
+  for (auto& [_, queue_family_state] : m_queue_families) {
+    ContinueUnless(queue_family_state.m_has_pending_uploads);
+
+    queue_family_state.m_required_value = m_last_submitted_value;
+    queue_family_state.m_has_pending_uploads = false;
+  }
+
+  m_in_flight_batches.emplace_back(std::move(m_pending_batch));
+  m_pending_batch = upload_batch{};
+  m_has_pending_batch = false;
+
+  return m_last_submitted_value;
+}
+
+void upload_manager::submit_batch_if_big() {
+  // Big batches are kicked off early, so the GPU copies while we keep
+  // filling the ring
+  ReturnIf(m_pending_batch.m_copied_bytes < m_ring_size / 4);
+  submit_pending_batch();
+}
+
+VkCommandBuffer upload_manager::record_acquire_command_buffer(
+    queue_family_state& state) {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  if (state.m_free_command_buffers.empty()) {
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.sType =
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool = state.m_command_pool;
+    command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = 1;
+
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(
+        vulkan_logical_device, &command_buffer_allocate_info, &command_buffer));
+    set_debug_utils_object_name(vulkan_logical_device,
+                                "upload acquire command buffer",
+                                command_buffer);
+  } else {
+    command_buffer = state.m_free_command_buffers.back();
+    state.m_free_command_buffers.pop_back();
+    VK_CHECK_RESULT(vkResetCommandBuffer(command_buffer, 0));
+  }
+
+  VkCommandBufferBeginInfo command_buffer_begin_info{};
+  command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(
+      vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
+
+  vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+      static_cast<uint32_t>(state.m_buffer_acquires.size()),
+      state.m_buffer_acquires.data(),
+      static_cast<uint32_t>(state.m_image_acquires.size()),
+      state.m_image_acquires.data());
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(command_buffer));
+
+  state.m_buffer_acquires.clear();
+  state.m_image_acquires.clear();
+  state.m_in_flight_command_buffers.emplace_back(++state.m_last_acquire_value,
+                                                 command_buffer);
+
+  return command_buffer;
+}
+
+void upload_manager::retire_completed_batches() {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  VK_CHECK_RESULT(vkGetSemaphoreCounterValue(
+      vulkan_logical_device, m_timeline_semaphore, &m_last_completed_value));
+
+  while (!m_in_flight_batches.empty() &&
+         m_in_flight_batches.front().m_timeline_value <=
+             m_last_completed_value) {
+    retire_batch(m_in_flight_batches.front());
+    m_in_flight_batches.pop_front();
+  }
+
+  for (auto& [_, queue_family_state] : m_queue_families) {
+    std::uint64_t last_completed_acquire_value = 0;
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(
+        vulkan_logical_device, queue_family_state.m_acquire_semaphore,
+        &last_completed_acquire_value));
+
+    auto& in_flight_command_buffers =
+        queue_family_state.m_in_flight_command_buffers;
+    while (!in_flight_command_buffers.empty() &&
+           in_flight_command_buffers.front().first <=
+               last_completed_acquire_value) {
+      queue_family_state.m_free_command_buffers.push_back(
+          in_flight_command_buffers.front().second);
+      in_flight_command_buffers.pop_front();
+    }
+  }
+}
+
+void upload_manager::retire_batch(upload_batch& batch) {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto& allocator = vulkan_context.mutable_resource_allocator();
+
+  // Batches are retired in submission order, so the tail simply moves to
+  // where the batch stopped writing
+  m_ring_tail = batch.m_ring_end;
+  m_ring_used -= batch.m_ring_consumed;
+
+  for (auto& [staging_buffer, staging_allocation] : batch.m_dedicated_staging) {
+    allocator.unmap_memory(staging_allocation);
+    allocator.destroy_buffer(staging_buffer, staging_allocation);
+  }
+
+  m_free_command_buffers.push_back(batch.m_command_buffer);
+}
+
+void upload_manager::wait_oldest_batch() {
+  AssertReturnIf(m_in_flight_batches.empty());
+
+  wait_semaphore(m_timeline_semaphore,
+                 m_in_flight_batches.front().m_timeline_value);
+  retire_completed_batches();
+}
+
+void upload_manager::wait_semaphore(VkSemaphore semaphore,
+                                    std::uint64_t value) const {
+  context& vulkan_context =
+      layer_abstraction_factory::instance().get_vulkan_context();
+  auto vulkan_logical_device =
+      vulkan_context.mutable_device().get_vulkan_logical_device();
+
+  VkSemaphoreWaitInfo wait_info{};
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &semaphore;
+  wait_info.pValues = &value;
+
+  VK_CHECK_RESULT(vkWaitSemaphores(vulkan_logical_device, &wait_info,
+                                   std::numeric_limits<std::uint64_t>::max()));
+}
+}  // namespace wunder::vulkan
@@ -4,16 +4,14 @@
 #include <fstream>
 #include <vector>
 
-#include "gla/vulkan/vulkan_device_buffer.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 #include "include/assets/mesh_asset.h"
 #include "resources/shaders/compress.glsl"
 #include "resources/shaders/host_device.h"
 
 namespace wunder::vulkan {
-unique_ptr<storage_buffer> vertex_buffer::create(VkCommandBuffer command_buffer,
-                                                 const mesh_asset& asset)
-
-{
+geometry_arena::range vertex_buffer::create(const mesh_asset& asset) {
   std::vector<VertexAttributes> vertices{};
   vertices.reserve(asset.m_vertices.size());
 
@@ -42,13 +40,12 @@ unique_ptr<storage_buffer> vertex_buffer::create(VkCommandBuffer command_buffer,
     device_vertex.texcoord.y = uintBitsToFloat(value);
   }
 
-  return std::make_unique<storage_device_buffer>(
-      command_buffer,
-      descriptor_build_data{.m_enabled = false, .m_descriptor_name = ""},
-      vertices.data(), vertices.size() * sizeof(VertexAttributes),
-      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  auto& vertex_arena = layer_abstraction_factory::instance()
+                           .get_vulkan_context()
+                           .mutable_vertex_arena();
+
+  return vertex_arena.allocate(vertices.data(),
+                               static_cast<std::uint32_t>(vertices.size()));
 }
 
 }  // namespace wunder::vulkan
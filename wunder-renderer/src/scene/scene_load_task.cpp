@@ -4,6 +4,9 @@
 #include "event/event_controller.h"
 #include "event/scene_events.h"
 #include "gla/vulkan/scene/vulkan_scene.h"
+#include "gla/vulkan/vulkan_command_pool.h"
+#include "gla/vulkan/vulkan_context.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
 
 namespace wunder {
 scene_load_task::scene_load_task(scene_id id, vulkan::scene& scene,
@@ -12,6 +15,12 @@ scene_load_task::scene_load_task(scene_id id, vulkan::scene& scene,
 
 void scene_load_task::run() /*override*/ {
   m_out_scene.load_scene(m_input_scene_asset);
+
+  // The loader records nothing until the next scene, don't keep its pools
+  vulkan::layer_abstraction_factory::instance()
+      .get_vulkan_context()
+      .mutable_command_pool()
+      .release_thread_pools();
 }
 
 void scene_load_task::execute_on_main_thread() /*override*/ {
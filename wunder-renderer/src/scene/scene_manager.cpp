@@ -48,6 +48,15 @@ optional_const_ref<scene_asset> scene_manager::get_scene_asset(
   return found_scene_asset_it->second;
 }
 
+optional_ref<scene_asset> scene_manager::mutable_scene_asset(scene_id id) {
+  static optional_ref<scene_asset> s_empty = std::nullopt;
+
+  auto found_scene_asset_it = m_loaded_scenes.find(id);
+  ReturnIf(found_scene_asset_it == m_loaded_scenes.end(), s_empty);
+
+  return found_scene_asset_it->second;
+}
+
 bool scene_manager::activate_scene(scene_id id) {
   auto found_active_scene_it = m_active_scenes.find(id);
   ReturnIf(found_active_scene_it != m_active_scenes.end(), false);
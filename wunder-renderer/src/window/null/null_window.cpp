@@ -0,0 +1,32 @@
+#include "window/null/null_window.h"
+
+#include "core/wunder_logger.h"
+#include "window/window_properties.h"
+
+namespace wunder {
+/////////////////////////////////////////////////////////////////////////////////////////
+null_window::null_window() : window(type) {};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+null_window::~null_window() = default;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+void null_window::init(const window_properties &properties) {
+  WUNDER_INFO_TAG("Window", "Headless {0}x{1}", properties.m_width,
+                  properties.m_height);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+void null_window::update(time_unit /*dt*/) {}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+void null_window::fill_vulkan_extensions(
+    vulkan::vulkan_extensions & /*out_extensions*/) const {
+  // No surface, so no platform surface extensions
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+VkSurfaceKHR null_window::create_vulkan_surface() const {
+  return VK_NULL_HANDLE;
+}
+}  // namespace wunder
@@ -2,6 +2,7 @@
 
 #include "core/wunder_macros.h"
 #include "window/glfw/glfw_window.h"
+#include "window/null/null_window.h"
 #include "window/window.h"
 #include "window/window_properties.h"
 
@@ -17,6 +18,9 @@ bool window_factory::initialize(const window_properties& window_properties) {
     case window_type::glfw: {
       m_window = make_unique<wunder::glfw_window>();
     } break;
+    case window_type::null: {
+      m_window = make_unique<wunder::null_window>();
+    } break;
     default:
       AssertReturnIf("Not handled window type.", false)
   }
@@ -0,0 +1,185 @@
+#include "headless_rendering.h"
+
+#include <stb_image.h>
+#include <tiny_gltf.h>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string>
+
+#include "assets/asset_storage.h"
+#include "assets/serializers/environment_map_serializer.h"
+#include "assets/serializers/gltf/gltf_asset_importer.h"
+#include "core/aabb.h"
+#include "core/hash_utils.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "gla/cpu/cpu_path_tracer.h"
+#include "gla/cpu/cpu_render_target.h"
+
+namespace wunder::tools {
+std::optional<int> parse_positive(std::string_view value) {
+  int result = 0;
+  const auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), result);
+  ReturnUnless(error == std::errc() && end == value.data() + value.size() &&
+                   result > 0,
+               std::nullopt);
+
+  return result;
+}
+
+std::optional<float> parse_float(std::string_view value) {
+  float result = 0.0f;
+  const auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), result);
+  ReturnUnless(error == std::errc() && end == value.data() + value.size(),
+               std::nullopt);
+
+  return result;
+}
+
+std::optional<glm::vec3> parse_vec3(std::string_view value) {
+  std::array<float, 3> components{};
+  for (std::size_t component_idx = 0; component_idx < components.size();
+       ++component_idx) {
+    const bool is_last = component_idx + 1 == components.size();
+    const std::size_t separator = value.find(',');
+    ReturnIf(is_last != (separator == std::string_view::npos), std::nullopt);
+
+    const std::optional<float> component =
+        parse_float(value.substr(0, separator));
+    ReturnUnless(component.has_value(), std::nullopt);
+
+    components[component_idx] = *component;
+    value.remove_prefix(is_last ? value.size() : separator + 1);
+  }
+
+  return glm::vec3(components[0], components[1], components[2]);
+}
+
+bool import_scene(const std::filesystem::path& scene_path,
+                  asset_storage& storage) {
+  tinygltf::TinyGLTF gltf;
+  tinygltf::Model gltf_model;
+  std::string error;
+  std::string warning;
+  const bool is_loaded =
+      scene_path.extension() == ".glb"
+          ? gltf.LoadBinaryFromFile(&gltf_model, &error, &warning,
+                                    scene_path.string())
+          : gltf.LoadASCIIFromFile(&gltf_model, &error, &warning,
+                                   scene_path.string());
+  if (!is_loaded) {
+    WUNDER_ERROR_TAG("Headless", "Failed to load {0}: {1}",
+                     scene_path.string(), error);
+    return false;
+  }
+
+  gltf_asset_importer importer(storage);
+  if (importer.import_asset(gltf_model) !=
+      asset_serialization_result_codes::ok) {
+    WUNDER_ERROR_TAG("Headless", "Failed to import {0}", scene_path.string());
+    return false;
+  }
+
+  return true;
+}
+
+// As asset_manager::import_environment_map, without the filesystem roots
+bool import_environment(const std::filesystem::path& environment_path,
+                        asset_storage& storage) {
+  int32_t width{0};
+  int32_t height{0};
+  int32_t component{0};
+  int32_t required_components = STBI_rgb_alpha;
+
+  float* pixels = stbi_loadf(environment_path.string().c_str(), &width,
+                             &height, &component, required_components);
+  if (pixels == nullptr) {
+    WUNDER_ERROR_TAG("Headless", "Failed to load {0}",
+                     environment_path.string());
+    return false;
+  }
+
+  const auto result = environment_map_serializer::import_asset(
+      {.m_width = static_cast<uint32_t>(width),
+       .m_height = static_cast<uint32_t>(height),
+       .m_components = static_cast<uint32_t>(required_components),
+       .m_pixels_ptr = pixels,
+       .m_source_hash = hash::utils::hash_file(environment_path).value_or(0)},
+      storage);
+  stbi_image_free(pixels);
+
+  return result == asset_serialization_result_codes::ok;
+}
+
+camera_view frame_bounds(const aabb& bounds) {
+  const glm::vec3 center = bounds.center();
+  const float radius = glm::length(bounds.size()) * 0.5f;
+
+  camera_view view;
+  view.m_eye =
+      center + glm::normalize(glm::vec3(0.3f, 0.35f, 1.0f)) * radius * 1.5f;
+  view.m_center = center;
+  return view;
+}
+
+SceneCamera create_host_camera(const camera_view& view, std::uint32_t width,
+                               std::uint32_t height,
+                               std::uint32_t lights_count) {
+  const glm::mat4 view_matrix =
+      glm::lookAt(view.m_eye, view.m_center, glm::vec3(0.0f, 1.0f, 0.0f));
+  auto proj = glm::perspectiveRH_ZO(
+      glm::radians(view.m_fov),
+      static_cast<float>(width) / static_cast<float>(height), 0.001f,
+      100000.0f);
+  proj[1][1] *= -1;
+
+  SceneCamera camera{};
+  std::memset(&camera, 0, sizeof(SceneCamera));
+  camera.viewInverse = glm::inverse(view_matrix);
+  camera.projInverse = glm::inverse(proj);
+  camera.focalDist = glm::length(view.m_center - view.m_eye);
+  camera.nbLights = lights_count;
+  return camera;
+}
+
+void render_frame_estimate(const cpu::path_tracer& path_tracer,
+                           const cpu::scene& scene, const SceneCamera& camera,
+                           const RtxState& state,
+                           cpu::render_target& out_estimate) {
+  // Mixed into black the estimate is weighted by 1 / (frame + 1)
+  out_estimate =
+      cpu::render_target(out_estimate.get_width(), out_estimate.get_height());
+  path_tracer.render(scene, camera, state, out_estimate);
+
+  const auto weight = static_cast<float>(state.frame + 1);
+  for (std::uint32_t y = 0; y < out_estimate.get_height(); ++y) {
+    for (std::uint32_t x = 0; x < out_estimate.get_width(); ++x) {
+      out_estimate.set_pixel(x, y, out_estimate.get_pixel(x, y) * weight);
+    }
+  }
+}
+
+bool write_image(const cpu::render_target& target,
+                 const std::filesystem::path& output_path) {
+  if (output_path.extension() == ".exr") {
+    return target.write_exr(output_path);
+  }
+  if (output_path.extension() == ".png") {
+    return target.write_png(output_path);
+  }
+
+  WUNDER_ERROR_TAG("Headless", "Unsupported output format {0}",
+                   output_path.string());
+  return false;
+}
+}  // namespace wunder::tools
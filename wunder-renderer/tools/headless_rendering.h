@@ -0,0 +1,69 @@
+#ifndef WUNDER_TOOLS_HEADLESS_RENDERING_H
+#define WUNDER_TOOLS_HEADLESS_RENDERING_H
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "resources/shaders/host_device.h"
+
+namespace wunder {
+class asset_storage;
+struct aabb;
+}  // namespace wunder
+
+namespace wunder::cpu {
+class path_tracer;
+class render_target;
+class scene;
+}  // namespace wunder::cpu
+
+/**
+ * What the headless tools share: argument parsing, importing a glTF scene
+ * and an HDR environment without the asset manager's filesystem roots,
+ * framing the camera and writing the rendered image.
+ */
+namespace wunder::tools {
+struct camera_view {
+  glm::vec3 m_eye{0.0f};
+  glm::vec3 m_center{0.0f};
+  // camera::properties default
+  float m_fov = 60.0f;
+};
+
+std::optional<int> parse_positive(std::string_view value);
+std::optional<float> parse_float(std::string_view value);
+// Comma separated, e.g. 1,2.5,-3
+std::optional<glm::vec3> parse_vec3(std::string_view value);
+
+bool import_scene(const std::filesystem::path& scene_path,
+                  asset_storage& storage);
+bool import_environment(const std::filesystem::path& environment_path,
+                        asset_storage& storage);
+
+// Looks at the whole box, from above and in front of it
+camera_view frame_bounds(const aabb& bounds);
+
+// camera::create_host_camera for the given view
+SceneCamera create_host_camera(const camera_view& view, std::uint32_t width,
+                               std::uint32_t height,
+                               std::uint32_t lights_count);
+
+/**
+ * What the frame's dispatch traced per pixel on its own, before it's mixed
+ * into the accumulated image, e.g. for cpu::convergence_tracker.
+ */
+void render_frame_estimate(const cpu::path_tracer& path_tracer,
+                           const cpu::scene& scene, const SceneCamera& camera,
+                           const RtxState& state,
+                           cpu::render_target& out_estimate);
+
+// EXR for golden image comparisons, PNG to look at
+bool write_image(const cpu::render_target& target,
+                 const std::filesystem::path& output_path);
+}  // namespace wunder::tools
+
+#endif  // WUNDER_TOOLS_HEADLESS_RENDERING_H
@@ -0,0 +1,410 @@
+/**
+ * Acceleration structure policy benchmark. Loads glTF scenes once per bottom
+ * level acceleration structure build policy, every mesh forced to it, and
+ * reports per policy how long the builds took on the GPU, how much memory
+ * the structures take before and after compaction and how fast the ray
+ * tracing renderer traces the scene with them. Trace time is measured with
+ * timestamps around the vkCmdTraceRaysKHR dispatches, the whole image is
+ * traced by one dispatch a frame. Every run is an application of its own
+ * behind a null window, so software ICDs work as well.
+ *
+ * usage: wunder-as-policy-benchmark <environment.hdr> <scene.gltf|glb>...
+ *            [--policy name] [--width n] [--height n] [--samples n]
+ *            [--depth n] [--warmup-frames n] [--frames n] [--root dir]
+ */
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "application.h"
+#include "application_properties.h"
+#include "assets/asset_manager.h"
+#include "assets/components/scene_components.h"
+#include "assets/scene_asset.h"
+#include "camera/camera.h"
+#include "core/project.h"
+#include "core/services_factory.h"
+#include "core/wunder_filesystem.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "event/event_handler.hpp"
+#include "event/scene_events.h"
+#include "event/vulkan_events.h"
+#include "gla/renderer_properties.h"
+#include "gla/vulkan/ray-trace/vulkan_rtx_renderer.h"
+#include "gla/vulkan/ray-trace/vulkan_rtx_tile_scheduler.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_renderer_context.h"
+#include "headless_rendering.h"
+#include "scene/scene_manager.h"
+#include "window/window_properties.h"
+
+namespace {
+using wunder::acceleration_structure_build_policy;
+using built_event =
+    wunder::event::vulkan::bottom_level_acceleration_structures_built;
+
+// No tile is left for a second frame
+constexpr float k_unlimited_frame_budget_ms = 1e9f;
+constexpr double k_bytes_per_mib = 1024.0 * 1024.0;
+
+struct benchmark_options {
+  std::filesystem::path m_environment_path;
+  std::vector<std::filesystem::path> m_scene_paths;
+  std::filesystem::path m_root_path = std::filesystem::current_path();
+  // All of them when not given
+  std::optional<acceleration_structure_build_policy> m_policy;
+  std::uint32_t m_width = 1024;
+  std::uint32_t m_height = 1024;
+  // Per pixel and frame
+  int m_samples = 1;
+  int m_depth = 10;
+  // Not timed, the first frames compile pipelines and warm caches
+  int m_warmup_frames = 16;
+  int m_frames = 64;
+};
+
+bool parse_option(benchmark_options& options, std::string_view name,
+                  std::string_view value) {
+  if (name == "--root") {
+    options.m_root_path = std::filesystem::absolute(value);
+    return true;
+  }
+  if (name == "--policy") {
+    options.m_policy =
+        wunder::acceleration_structure_build_policy_from_string(value);
+    return options.m_policy.has_value();
+  }
+
+  const std::optional<int> count = wunder::tools::parse_positive(value);
+  ReturnUnless(count.has_value(), false);
+  if (name == "--width") {
+    options.m_width = static_cast<std::uint32_t>(*count);
+  } else if (name == "--height") {
+    options.m_height = static_cast<std::uint32_t>(*count);
+  } else if (name == "--samples") {
+    options.m_samples = *count;
+  } else if (name == "--depth") {
+    options.m_depth = *count;
+  } else if (name == "--warmup-frames") {
+    options.m_warmup_frames = *count;
+  } else if (name == "--frames") {
+    options.m_frames = *count;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<benchmark_options> parse_options(int argc, char** argv) {
+  ReturnIf(argc < 3, std::nullopt);
+
+  // Absolute, so the filesystem's work directory doesn't apply to them
+  benchmark_options options{.m_environment_path =
+                                std::filesystem::absolute(argv[1])};
+  int arg_idx = 2;
+  for (; arg_idx < argc && !std::string_view(argv[arg_idx]).starts_with("--");
+       ++arg_idx) {
+    options.m_scene_paths.emplace_back(
+        std::filesystem::absolute(argv[arg_idx]));
+  }
+  ReturnIf(options.m_scene_paths.empty(), std::nullopt);
+
+  for (; arg_idx < argc; arg_idx += 2) {
+    const std::string_view name = argv[arg_idx];
+    if (arg_idx + 1 == argc) {
+      WUNDER_ERROR_TAG("Benchmark", "Missing value of {0}", name);
+      return std::nullopt;
+    }
+
+    if (!parse_option(options, name, argv[arg_idx + 1])) {
+      WUNDER_ERROR_TAG("Benchmark", "Invalid option {0} {1}", name,
+                       argv[arg_idx + 1]);
+      return std::nullopt;
+    }
+  }
+
+  return options;
+}
+
+/**
+ * What one policy's run measured. Automatic resolves to several policies,
+ * their builds are summed.
+ */
+struct policy_result {
+  built_event::policy_statistics m_build;
+  std::uint64_t m_traced_pixels = 0;
+  double m_trace_ms = 0.0;
+};
+
+/**
+ * The application driven by a null window. Forces the build policy on every
+ * mesh of the scene before activating it, collects the build statistics the
+ * scene loading thread sends and times the frames traced after the warmup.
+ */
+class benchmark_application
+    : public wunder::application,
+      public wunder::event_handler<wunder::event::scene_loaded>,
+      public wunder::event_handler<built_event> {
+ public:
+  benchmark_application(wunder::application_properties&& properties,
+                        benchmark_options options,
+                        std::filesystem::path scene_path,
+                        acceleration_structure_build_policy policy)
+      : application(std::move(properties)),
+        event_handler<wunder::event::scene_loaded>(),
+        event_handler<built_event>(),
+        m_options(std::move(options)),
+        m_scene_path(std::move(scene_path)),
+        m_policy(policy),
+        m_build{.m_policy = policy} {}
+
+ public:
+  [[nodiscard]] std::optional<policy_result> get_result() const {
+    return m_result;
+  }
+
+ private:
+  void initialize_internal() override {
+    auto& asset_manager = wunder::project::instance().get_asset_manager();
+    m_is_import_failed =
+        asset_manager.import_environment_map(m_options.m_environment_path) !=
+            wunder::asset_serialization_result_codes::ok ||
+        asset_manager.import_asset(m_scene_path) ==
+            wunder::asset_serialization_result_codes::error;
+  }
+
+  void update_internal(const wunder::time_unit& /*time_unit*/) override {
+    // run() starts the loop, so it can't be closed before
+    if (m_is_import_failed) {
+      close();
+      return;
+    }
+
+    auto& renderer_context =
+        wunder::vulkan::layer_abstraction_factory::instance()
+            .get_render_context();
+    ReturnUnless(m_scene_id.has_value() && renderer_context.has_active_scene());
+
+    auto& rtx_renderer = renderer_context.mutable_rtx_renderer();
+    auto& rtx_state = rtx_renderer.mutable_rtx_config();
+    if (!m_is_camera_set) {
+      // One tile covering the image, so its dispatch is timed
+      rtx_renderer.mutable_tiling_config() =
+          wunder::vulkan::rtx_tile_scheduler::properties{
+              .m_tile_size = std::max(m_options.m_width, m_options.m_height),
+              .m_order =
+                  wunder::vulkan::rtx_tile_scheduler::tile_order::scanline,
+              .m_frame_budget_ms = k_unlimited_frame_budget_ms};
+      set_camera();
+
+      rtx_state.maxDepth = m_options.m_depth;
+      rtx_state.maxSamples = m_options.m_samples;
+      rtx_state.convergenceThreshold = 0.0f;
+      m_is_camera_set = true;
+      return;
+    }
+
+    const wunder::vulkan::rtx_tile_scheduler* tile_scheduler =
+        rtx_renderer.get_tile_scheduler();
+    AssertReturnIf(tile_scheduler == nullptr);
+
+    // Dispatches are timed once their swap chain image comes back, the
+    // totals lag a few frames behind on both ends
+    if (!m_warmup_pixels.has_value() &&
+        rtx_state.frame >= m_options.m_warmup_frames) {
+      m_warmup_pixels = tile_scheduler->get_timed_pixels_count();
+      m_warmup_trace_ms = tile_scheduler->get_timed_trace_ms();
+    }
+    ReturnIf(rtx_state.frame < m_options.m_warmup_frames + m_options.m_frames);
+
+    std::lock_guard lock(m_mutex);
+    m_result = policy_result{
+        .m_build = m_build,
+        .m_traced_pixels =
+            tile_scheduler->get_timed_pixels_count() - *m_warmup_pixels,
+        .m_trace_ms = tile_scheduler->get_timed_trace_ms() - m_warmup_trace_ms};
+    close();
+  }
+
+  void shutdown_internal() override {}
+
+  void on_event(const wunder::event::scene_loaded& event) override {
+    m_scene_id = event.m_id;
+
+    auto& scene_manager = wunder::project::instance().get_scene_manager();
+    auto scene_asset = scene_manager.mutable_scene_asset(event.m_id);
+    AssertReturnUnless(scene_asset.has_value());
+
+    for (auto& scene_node :
+         scene_asset->get().filter_nodes<wunder::mesh_component>()) {
+      auto mesh_component =
+          scene_node.get().mutable_component<wunder::mesh_component>();
+      AssertContinueUnless(mesh_component.has_value());
+      mesh_component->get().m_build_policy = m_policy;
+    }
+
+    scene_manager.activate_scene(event.m_id);
+  }
+
+  // On the scene loading thread
+  void on_event(const built_event& event) override {
+    std::lock_guard lock(m_mutex);
+    for (const auto& statistics : event.m_policies) {
+      m_build.m_structures_count += statistics.m_structures_count;
+      m_build.m_build_size += statistics.m_build_size;
+      m_build.m_compacted_size += statistics.m_compacted_size;
+      m_build.m_build_time_ms += statistics.m_build_time_ms;
+    }
+  }
+
+ private:
+  void set_camera() {
+    auto scene_asset =
+        wunder::project::instance().get_scene_manager().get_scene_asset(
+            *m_scene_id);
+    AssertReturnUnless(scene_asset.has_value());
+
+    const wunder::tools::camera_view view =
+        wunder::tools::frame_bounds(scene_asset->get().get_aabb());
+    auto& camera = wunder::service_factory::instance().get_camera();
+    camera.set_fov(view.m_fov);
+    camera.set_lookat(view.m_eye, view.m_center, glm::vec3(0.0f, 1.0f, 0.0f));
+  }
+
+ private:
+  benchmark_options m_options;
+  std::filesystem::path m_scene_path;
+  acceleration_structure_build_policy m_policy;
+
+  std::optional<wunder::scene_id> m_scene_id;
+  bool m_is_import_failed = false;
+  bool m_is_camera_set = false;
+
+  std::optional<std::uint64_t> m_warmup_pixels;
+  double m_warmup_trace_ms = 0.0;
+
+  std::mutex m_mutex;
+  built_event::policy_statistics m_build;
+  std::optional<policy_result> m_result;
+};
+
+std::optional<policy_result> benchmark_policy(
+    const benchmark_options& options, const std::filesystem::path& scene_path,
+    acceleration_structure_build_policy policy) {
+  auto properties = wunder::application_properties{
+      "wunder-as-policy-benchmark", "1",
+      wunder::window_properties{"wunder acceleration structure benchmark",
+                                options.m_width, options.m_height,
+                                wunder::window_type::null},
+      wunder::renderer_properties{
+          .m_width = options.m_width,
+          .m_height = options.m_height,
+          .m_driver = wunder::driver::Vulkan,
+          .m_renderer = wunder::renderer_type::RAY_TRACE,
+          .m_gpu_to_use = wunder::gpu_to_use::Dedicated,
+          .m_enable_validation = false}};
+
+  benchmark_application application(std::move(properties), options,
+                                    scene_path, policy);
+  application.initialize();
+  application.run();
+  application.shutdown();
+
+  return application.get_result();
+}
+
+void log_result(const policy_result& result, std::uint32_t width,
+                std::uint32_t height, int samples) {
+  const auto& build = result.m_build;
+  WUNDER_INFO_TAG("Benchmark",
+                  "  {0}: {1} structures built in {2:.2f} ms, {3:.2f} MiB, "
+                  "{4:.2f} MiB after compaction",
+                  to_string(build.m_policy), build.m_structures_count,
+                  build.m_build_time_ms,
+                  static_cast<double>(build.m_build_size) / k_bytes_per_mib,
+                  static_cast<double>(build.m_compacted_size) /
+                      k_bytes_per_mib);
+
+  if (result.m_traced_pixels == 0 || result.m_trace_ms <= 0.0) {
+    WUNDER_INFO_TAG("Benchmark",
+                    "  {0}: trace not timed, the device has no timestamps",
+                    to_string(build.m_policy));
+    return;
+  }
+
+  const double frames = static_cast<double>(result.m_traced_pixels) /
+                        (static_cast<double>(width) * height);
+  const double paths = static_cast<double>(result.m_traced_pixels) *
+                       static_cast<double>(samples);
+  WUNDER_INFO_TAG("Benchmark",
+                  "  {0}: {1:.3f} ms per frame, {2:.1f} Mpaths/s over {3:.0f} "
+                  "frames",
+                  to_string(build.m_policy), result.m_trace_ms / frames,
+                  paths / (result.m_trace_ms * 1e3), frames);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  const std::optional<benchmark_options> options = parse_options(argc, argv);
+  if (!options.has_value()) {
+    WUNDER_ERROR_TAG(
+        "Benchmark",
+        "usage: wunder-as-policy-benchmark <environment.hdr> "
+        "<scene.gltf|glb>... [--policy name] [--width n] [--height n] "
+        "[--samples n] [--depth n] [--warmup-frames n] [--frames n] "
+        "[--root dir]");
+    return EXIT_FAILURE;
+  }
+
+  // Shaders are resolved relative to the repository root
+  wunder::wunder_filesystem::instance().set_work_dir(options->m_root_path);
+
+  std::vector<acceleration_structure_build_policy> policies;
+  if (options->m_policy.has_value()) {
+    policies.push_back(*options->m_policy);
+  } else {
+    constexpr auto policies_count =
+        static_cast<std::size_t>(acceleration_structure_build_policy::count);
+    for (std::size_t i = 0; i < policies_count; ++i) {
+      policies.push_back(static_cast<acceleration_structure_build_policy>(i));
+    }
+  }
+
+  bool is_succeeded = true;
+  for (const std::filesystem::path& scene_path : options->m_scene_paths) {
+    std::vector<policy_result> results;
+    for (acceleration_structure_build_policy policy : policies) {
+      const std::optional<policy_result> result =
+          benchmark_policy(*options, scene_path, policy);
+      if (!result.has_value()) {
+        WUNDER_ERROR_TAG("Benchmark", "{0} with policy {1} failed",
+                         scene_path.string(), to_string(policy));
+        is_succeeded = false;
+        continue;
+      }
+      results.push_back(*result);
+    }
+
+    // After all runs, so the report isn't interleaved with the load logs
+    WUNDER_INFO_TAG("Benchmark", "{0}, {1}x{2}, {3} samples per pixel",
+                    scene_path.string(), options->m_width, options->m_height,
+                    options->m_samples);
+    for (const policy_result& result : results) {
+      log_result(result, options->m_width, options->m_height,
+                 options->m_samples);
+    }
+  }
+
+  return is_succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
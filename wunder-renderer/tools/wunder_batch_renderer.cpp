@@ -0,0 +1,403 @@
+/**
+ * Headless batch renderer, a render farm worker. Renders a glTF scene lit by
+ * an HDR environment until the requested samples per pixel have accumulated,
+ * writes the linear image and exits. The vulkan backend runs the ray tracing
+ * renderer behind a null window, which works on software ICDs as well, e.g.
+ * VK_ICD_FILENAMES pointing to lavapipe. The cpu backend runs the reference
+ * path tracer on nodes without any Vulkan driver. Without --eye and --center
+ * both backends look at the whole scene the same way. With --threshold pixels
+ * stop sampling once their relative error is below it, the render stops
+ * early once all have. Huge outputs are traced in tiles with --tile-size,
+ * so no single dispatch runs into the driver's timeout.
+ *
+ * usage: wunder-batch-renderer <scene.gltf|glb> <environment.hdr>
+ *            <output.exr|png> [--backend vulkan|cpu] [--width n]
+ *            [--height n] [--samples n] [--depth n] [--eye x,y,z]
+ *            [--center x,y,z] [--fov degrees] [--threshold error]
+ *            [--min-frames n] [--tile-size n]
+ *            [--tile-order scanline|hilbert|center-out] [--root dir]
+ */
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "application.h"
+#include "application_properties.h"
+#include "assets/asset_manager.h"
+#include "assets/asset_storage.h"
+#include "assets/scene_asset.h"
+#include "camera/camera.h"
+#include "core/project.h"
+#include "core/services_factory.h"
+#include "core/wunder_filesystem.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "event/event_handler.hpp"
+#include "event/scene_events.h"
+#include "gla/cpu/cpu_convergence.h"
+#include "gla/cpu/cpu_path_tracer.h"
+#include "gla/cpu/cpu_render_target.h"
+#include "gla/cpu/cpu_scene.h"
+#include "gla/renderer_properties.h"
+#include "gla/vulkan/ray-trace/vulkan_rtx_renderer.h"
+#include "gla/vulkan/vulkan_layer_abstraction_factory.h"
+#include "gla/vulkan/vulkan_renderer_context.h"
+#include "headless_rendering.h"
+#include "scene/scene_manager.h"
+#include "window/window_properties.h"
+
+namespace {
+// RtxState default of the ray tracing renderer, samples traced per frame
+constexpr int k_max_samples_per_frame = 7;
+
+enum class backend { vulkan, cpu };
+
+struct batch_options {
+  std::filesystem::path m_scene_path;
+  std::filesystem::path m_environment_path;
+  std::filesystem::path m_output_path;
+  std::filesystem::path m_root_path = std::filesystem::current_path();
+  backend m_backend = backend::vulkan;
+  std::uint32_t m_width = 512;
+  std::uint32_t m_height = 512;
+  // Per pixel, rounded up to whole frames
+  int m_samples = 64;
+  int m_depth = 10;
+  std::optional<glm::vec3> m_eye;
+  std::optional<glm::vec3> m_center;
+  float m_fov = wunder::tools::camera_view{}.m_fov;
+  // Adaptive sampling, disabled by default
+  float m_threshold = 0.0f;
+  int m_min_frames = 16;
+  // The Vulkan backend's, the whole image in one dispatch by default
+  wunder::vulkan::rtx_tile_scheduler::properties m_tiling;
+
+ public:
+  [[nodiscard]] int get_samples_per_frame() const {
+    return std::min(m_samples, k_max_samples_per_frame);
+  }
+
+  [[nodiscard]] int get_frames() const {
+    return (m_samples + get_samples_per_frame() - 1) / get_samples_per_frame();
+  }
+
+  // The given view, or the one looking at the whole scene
+  [[nodiscard]] wunder::tools::camera_view get_camera_view(
+      const wunder::aabb& scene_bounds) const {
+    wunder::tools::camera_view view = wunder::tools::frame_bounds(scene_bounds);
+    view.m_eye = m_eye.value_or(view.m_eye);
+    view.m_center = m_center.value_or(view.m_center);
+    view.m_fov = m_fov;
+    return view;
+  }
+};
+
+bool parse_option(batch_options& options, std::string_view name,
+                  std::string_view value) {
+  if (name == "--backend") {
+    ReturnUnless(value == "vulkan" || value == "cpu", false);
+    options.m_backend = value == "cpu" ? backend::cpu : backend::vulkan;
+    return true;
+  }
+  if (name == "--root") {
+    options.m_root_path = std::filesystem::absolute(value);
+    return true;
+  }
+  if (name == "--eye" || name == "--center") {
+    const std::optional<glm::vec3> point = wunder::tools::parse_vec3(value);
+    ReturnUnless(point.has_value(), false);
+    (name == "--eye" ? options.m_eye : options.m_center) = point;
+    return true;
+  }
+  if (name == "--fov") {
+    const std::optional<float> fov = wunder::tools::parse_float(value);
+    ReturnUnless(fov.has_value() && *fov > 0.0f && *fov < 180.0f, false);
+    options.m_fov = *fov;
+    return true;
+  }
+  if (name == "--tile-order") {
+    using tile_order = wunder::vulkan::rtx_tile_scheduler::tile_order;
+    if (value == "scanline") {
+      options.m_tiling.m_order = tile_order::scanline;
+    } else if (value == "hilbert") {
+      options.m_tiling.m_order = tile_order::hilbert;
+    } else if (value == "center-out") {
+      options.m_tiling.m_order = tile_order::center_out;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--threshold") {
+    const std::optional<float> threshold = wunder::tools::parse_float(value);
+    ReturnUnless(threshold.has_value() && *threshold >= 0.0f, false);
+    options.m_threshold = *threshold;
+    return true;
+  }
+
+  const std::optional<int> count = wunder::tools::parse_positive(value);
+  ReturnUnless(count.has_value(), false);
+  if (name == "--width") {
+    options.m_width = static_cast<std::uint32_t>(*count);
+  } else if (name == "--height") {
+    options.m_height = static_cast<std::uint32_t>(*count);
+  } else if (name == "--samples") {
+    options.m_samples = *count;
+  } else if (name == "--depth") {
+    options.m_depth = *count;
+  } else if (name == "--min-frames") {
+    options.m_min_frames = *count;
+  } else if (name == "--tile-size") {
+    options.m_tiling.m_tile_size = static_cast<std::uint32_t>(*count);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<batch_options> parse_options(int argc, char** argv) {
+  ReturnIf(argc < 4, std::nullopt);
+
+  // Absolute, so the filesystem's work directory doesn't apply to them
+  batch_options options{
+      .m_scene_path = std::filesystem::absolute(argv[1]),
+      .m_environment_path = std::filesystem::absolute(argv[2]),
+      .m_output_path = std::filesystem::absolute(argv[3])};
+  for (int arg_idx = 4; arg_idx < argc; arg_idx += 2) {
+    const std::string_view name = argv[arg_idx];
+    if (arg_idx + 1 == argc) {
+      WUNDER_ERROR_TAG("Batch", "Missing value of {0}", name);
+      return std::nullopt;
+    }
+
+    if (!parse_option(options, name, argv[arg_idx + 1])) {
+      WUNDER_ERROR_TAG("Batch", "Invalid option {0} {1}", name,
+                       argv[arg_idx + 1]);
+      return std::nullopt;
+    }
+  }
+
+  return options;
+}
+
+bool render_on_cpu(const batch_options& options) {
+  wunder::asset_storage storage;
+  ReturnUnless(wunder::tools::import_scene(options.m_scene_path, storage),
+               false);
+  ReturnUnless(
+      wunder::tools::import_environment(options.m_environment_path, storage),
+      false);
+
+  auto scene_assets = storage.find_assets_of<wunder::scene_asset>();
+  if (scene_assets.empty()) {
+    WUNDER_ERROR_TAG("Batch", "{0} has no scene",
+                     options.m_scene_path.string());
+    return false;
+  }
+
+  wunder::cpu::scene scene;
+  ReturnUnless(scene.load_scene(scene_assets.begin()->second.get(), storage),
+               false);
+
+  const SceneCamera camera = wunder::tools::create_host_camera(
+      options.get_camera_view(scene.get_bvh().get_bounds()), options.m_width,
+      options.m_height, static_cast<std::uint32_t>(scene.get_lights().size()));
+
+  RtxState state{};
+  std::memset(&state, 0, sizeof(RtxState));
+  state.maxDepth = options.m_depth;
+  state.maxSamples = options.get_samples_per_frame();
+  state.fireflyClampThreshold = scene.get_environment_integral();
+  state.hdrMultiplier = 1.7f;
+  state.debugging_mode = DebugMode::eNoDebug;
+  state.size = glm::ivec2(options.m_width, options.m_height);
+  state.convergenceThreshold = options.m_threshold;
+  state.minConvergenceFrames = options.m_min_frames;
+
+  wunder::cpu::path_tracer path_tracer;
+  if (options.m_threshold <= 0.0f) {
+    wunder::cpu::render_target target(options.m_width, options.m_height);
+    for (state.frame = 0; state.frame < options.get_frames(); ++state.frame) {
+      path_tracer.render(scene, camera, state, target);
+    }
+
+    return wunder::tools::write_image(target, options.m_output_path);
+  }
+
+  // Accumulated as the adaptive ray generation shader does
+  wunder::cpu::render_target estimate(options.m_width, options.m_height);
+  wunder::cpu::convergence_tracker tracker(options.m_width, options.m_height,
+                                           options.m_threshold,
+                                           options.m_min_frames);
+  for (state.frame = 0;
+       state.frame < options.get_frames() && !tracker.is_converged();
+       ++state.frame) {
+    wunder::tools::render_frame_estimate(path_tracer, scene, camera, state,
+                                         estimate);
+    tracker.add_frame(estimate, state.frame);
+  }
+
+  return wunder::tools::write_image(tracker.get_image(),
+                                    options.m_output_path);
+}
+
+/**
+ * The application driven by a null window. Activates the scene once it's
+ * loaded, points the camera at it and reads the accumulated image back after
+ * the last frame was submitted.
+ */
+class batch_application
+    : public wunder::application,
+      public wunder::event_handler<wunder::event::scene_loaded> {
+ public:
+  batch_application(wunder::application_properties&& properties,
+                    batch_options options)
+      : application(std::move(properties)),
+        event_handler<wunder::event::scene_loaded>(),
+        m_options(std::move(options)) {}
+
+ public:
+  [[nodiscard]] bool is_succeeded() const { return m_is_succeeded; }
+
+ private:
+  void initialize_internal() override {
+    auto& asset_manager = wunder::project::instance().get_asset_manager();
+    m_is_import_failed =
+        asset_manager.import_environment_map(m_options.m_environment_path) !=
+            wunder::asset_serialization_result_codes::ok ||
+        asset_manager.import_asset(m_options.m_scene_path) ==
+            wunder::asset_serialization_result_codes::error;
+  }
+
+  void update_internal(const wunder::time_unit& /*time_unit*/) override {
+    // run() starts the loop, so it can't be closed before
+    if (m_is_import_failed) {
+      close();
+      return;
+    }
+
+    auto& renderer_context =
+        wunder::vulkan::layer_abstraction_factory::instance()
+            .get_render_context();
+    ReturnUnless(m_scene_id.has_value() && renderer_context.has_active_scene());
+
+    auto& rtx_renderer = renderer_context.mutable_rtx_renderer();
+    auto& rtx_state = rtx_renderer.mutable_rtx_config();
+    if (!m_is_camera_set) {
+      // Applies from the pass the camera move starts
+      rtx_renderer.mutable_tiling_config() = m_options.m_tiling;
+      set_camera();
+
+      rtx_state.maxDepth = m_options.m_depth;
+      rtx_state.maxSamples = m_options.get_samples_per_frame();
+      rtx_state.convergenceThreshold = m_options.m_threshold;
+      rtx_state.minConvergenceFrames = m_options.m_min_frames;
+      m_is_camera_set = true;
+      return;
+    }
+
+    // frame counts the completed passes, the last one is submitted once this
+    // iteration ends, so the loop stops without tracing another and the
+    // output is read back after it
+    ReturnUnless(rtx_state.frame >= m_options.get_frames() ||
+                 rtx_renderer.is_converged());
+
+    m_is_output_ready = true;
+    close();
+  }
+
+  // Before the renderer shuts down, every frame was submitted by now
+  void shutdown_internal() override {
+    ReturnUnless(m_is_output_ready);
+
+    wunder::cpu::render_target target(m_options.m_width, m_options.m_height);
+    m_is_succeeded =
+        wunder::vulkan::layer_abstraction_factory::instance()
+            .get_render_context()
+            .read_output_image(target) &&
+        wunder::tools::write_image(target, m_options.m_output_path);
+  }
+
+  void on_event(const wunder::event::scene_loaded& event) override {
+    m_scene_id = event.m_id;
+    wunder::project::instance().get_scene_manager().activate_scene(
+        event.m_id);
+  }
+
+ private:
+  // Moving the camera restarts the accumulation
+  void set_camera() {
+    auto scene_asset =
+        wunder::project::instance().get_scene_manager().get_scene_asset(
+            *m_scene_id);
+    AssertReturnUnless(scene_asset.has_value());
+
+    const wunder::tools::camera_view view =
+        m_options.get_camera_view(scene_asset->get().get_aabb());
+    auto& camera = wunder::service_factory::instance().get_camera();
+    camera.set_fov(view.m_fov);
+    camera.set_lookat(view.m_eye, view.m_center, glm::vec3(0.0f, 1.0f, 0.0f));
+  }
+
+ private:
+  batch_options m_options;
+  std::optional<wunder::scene_id> m_scene_id;
+  bool m_is_import_failed = false;
+  bool m_is_camera_set = false;
+  bool m_is_output_ready = false;
+  bool m_is_succeeded = false;
+};
+
+bool render_on_vulkan(const batch_options& options) {
+  // Shaders are resolved relative to the repository root
+  wunder::wunder_filesystem::instance().set_work_dir(options.m_root_path);
+
+  auto properties = wunder::application_properties{
+      "wunder-batch-renderer", "1",
+      wunder::window_properties{"wunder batch renderer", options.m_width,
+                                options.m_height, wunder::window_type::null},
+      wunder::renderer_properties{
+          .m_width = options.m_width,
+          .m_height = options.m_height,
+          .m_driver = wunder::driver::Vulkan,
+          .m_renderer = wunder::renderer_type::RAY_TRACE,
+          .m_gpu_to_use = wunder::gpu_to_use::Dedicated,
+          .m_enable_validation = false}};
+
+  batch_application application(std::move(properties), options);
+  application.initialize();
+  application.run();
+  application.shutdown();
+
+  return application.is_succeeded();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  const std::optional<batch_options> options = parse_options(argc, argv);
+  if (!options.has_value()) {
+    WUNDER_ERROR_TAG(
+        "Batch",
+        "usage: wunder-batch-renderer <scene.gltf|glb> <environment.hdr> "
+        "<output.exr|png> [--backend vulkan|cpu] [--width n] [--height n] "
+        "[--samples n] [--depth n] [--eye x,y,z] [--center x,y,z] "
+        "[--fov degrees] [--threshold error] [--min-frames n] "
+        "[--tile-size n] [--tile-order scanline|hilbert|center-out] "
+        "[--root dir]");
+    return EXIT_FAILURE;
+  }
+
+  const bool is_rendered = options->m_backend == backend::cpu
+                               ? render_on_cpu(*options)
+                               : render_on_vulkan(*options);
+  return is_rendered ? EXIT_SUCCESS : EXIT_FAILURE;
+}
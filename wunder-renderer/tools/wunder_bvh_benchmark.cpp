@@ -0,0 +1,291 @@
+/**
+ * CPU ray tracing benchmark. Imports glTF scenes, builds their CPU bounding
+ * volume hierarchies and reports how many million rays per second they trace,
+ * closest and any hit, single rays and packets. Primary rays come from a
+ * camera looking at the whole scene, diffuse rays bounce off their hits in
+ * random directions.
+ *
+ * usage: wunder-bvh-benchmark <scene files...>
+ */
+#include <tiny_gltf.h>
+
+#include <glm/geometric.hpp>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <numbers>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assets/asset_storage.h"
+#include "assets/scene_asset.h"
+#include "assets/serializers/gltf/gltf_asset_importer.h"
+#include "core/bvh.h"
+#include "core/parallel_for.h"
+#include "core/wunder_logger.h"
+
+namespace {
+constexpr std::uint32_t k_image_width = 1024;
+constexpr std::uint32_t k_image_height = 1024;
+// tan of half the 60 degrees vertical field of view
+constexpr float k_tan_half_fov = 0.57735f;
+constexpr std::size_t k_min_rays_per_thread = 1024;
+
+enum class trace_query { closest_hit, any_hit };
+
+/**
+ * Rays of 2x2 pixel quads follow each other, packets of consecutive rays are
+ * as coherent as those of a GPU wave.
+ */
+std::vector<wunder::ray> generate_primary_rays(const wunder::aabb& bounds) {
+  const glm::vec3 center = bounds.center();
+  const float radius = glm::length(bounds.size()) * 0.5f;
+  const glm::vec3 eye =
+      center + glm::normalize(glm::vec3(0.3f, 0.35f, 1.0f)) * radius * 1.5f;
+  const glm::vec3 forward = glm::normalize(center - eye);
+  const glm::vec3 right =
+      glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+  const glm::vec3 up = glm::cross(right, forward);
+  const float aspect_ratio =
+      static_cast<float>(k_image_width) / static_cast<float>(k_image_height);
+
+  std::vector<wunder::ray> rays;
+  rays.reserve(static_cast<std::size_t>(k_image_width) * k_image_height);
+  for (std::uint32_t quad_y = 0; quad_y < k_image_height; quad_y += 2) {
+    for (std::uint32_t quad_x = 0; quad_x < k_image_width; quad_x += 2) {
+      for (std::uint32_t pixel_idx = 0; pixel_idx < 4; ++pixel_idx) {
+        const float x = static_cast<float>(quad_x + pixel_idx % 2) + 0.5f;
+        const float y = static_cast<float>(quad_y + pixel_idx / 2) + 0.5f;
+        const float ndc_x =
+            (x / static_cast<float>(k_image_width) * 2.0f - 1.0f) *
+            k_tan_half_fov * aspect_ratio;
+        const float ndc_y =
+            (1.0f - y / static_cast<float>(k_image_height) * 2.0f) *
+            k_tan_half_fov;
+
+        rays.push_back(wunder::ray{
+            .m_origin = eye,
+            .m_direction = glm::normalize(forward + right * ndc_x + up * ndc_y)});
+      }
+    }
+  }
+
+  return rays;
+}
+
+std::vector<wunder::ray> generate_diffuse_rays(
+    const wunder::scene_bvh& scene_bvh,
+    const std::vector<wunder::ray>& primary_rays) {
+  const float t_min = glm::length(scene_bvh.get_bounds().size()) * 1e-5f;
+
+  std::vector<wunder::ray> rays(primary_rays.size());
+  std::vector<std::uint8_t> has_ray(primary_rays.size(), 0);
+  wunder::parallel_for(
+      primary_rays.size(),
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t ray_idx = begin; ray_idx < end; ++ray_idx) {
+          const wunder::ray& primary_ray = primary_rays[ray_idx];
+          wunder::ray_hit hit;
+          ContinueUnless(scene_bvh.intersect(primary_ray, hit));
+
+          // Uniform over the sphere, seeded by the ray so runs are repeatable
+          std::minstd_rand random(static_cast<std::uint32_t>(ray_idx) + 1);
+          std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+          const float z = 1.0f - 2.0f * distribution(random);
+          const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+          const float phi = 2.0f * std::numbers::pi_v<float> * distribution(random);
+
+          rays[ray_idx] = wunder::ray{
+              .m_origin = primary_ray.m_origin + primary_ray.m_direction * hit.m_t,
+              .m_direction = glm::vec3(r * std::cos(phi), r * std::sin(phi), z),
+              .m_t_min = t_min};
+          has_ray[ray_idx] = 1;
+        }
+      },
+      k_min_rays_per_thread);
+
+  std::vector<wunder::ray> diffuse_rays;
+  diffuse_rays.reserve(rays.size());
+  for (std::size_t ray_idx = 0; ray_idx < rays.size(); ++ray_idx) {
+    if (has_ray[ray_idx]) {
+      diffuse_rays.push_back(rays[ray_idx]);
+    }
+  }
+
+  return diffuse_rays;
+}
+
+std::size_t trace_rays(const wunder::scene_bvh& scene_bvh,
+                       const std::vector<wunder::ray>& rays,
+                       trace_query query) {
+  std::atomic<std::size_t> hits_count = 0;
+  wunder::parallel_for(
+      rays.size(),
+      [&](std::size_t begin, std::size_t end) {
+        std::size_t chunk_hits_count = 0;
+        for (std::size_t ray_idx = begin; ray_idx < end; ++ray_idx) {
+          wunder::ray_hit hit;
+          const bool has_hit = query == trace_query::closest_hit
+                                   ? scene_bvh.intersect(rays[ray_idx], hit)
+                                   : scene_bvh.occluded(rays[ray_idx]);
+          chunk_hits_count += has_hit ? 1 : 0;
+        }
+        hits_count += chunk_hits_count;
+      },
+      k_min_rays_per_thread);
+
+  return hits_count;
+}
+
+std::size_t trace_packets(const wunder::scene_bvh& scene_bvh,
+                          const std::vector<wunder::ray>& rays,
+                          trace_query query) {
+  constexpr std::size_t packet_size = wunder::ray_packet::k_size;
+  const std::size_t packets_count = (rays.size() + packet_size - 1) / packet_size;
+
+  std::atomic<std::size_t> hits_count = 0;
+  wunder::parallel_for(
+      packets_count,
+      [&](std::size_t begin, std::size_t end) {
+        std::size_t chunk_hits_count = 0;
+        for (std::size_t packet_idx = begin; packet_idx < end; ++packet_idx) {
+          wunder::ray_packet packet;
+          for (std::uint32_t lane = 0; lane < packet_size; ++lane) {
+            const std::size_t ray_idx = packet_idx * packet_size + lane;
+            if (ray_idx >= rays.size()) {
+              break;
+            }
+            packet.set_ray(lane, rays[ray_idx]);
+          }
+
+          std::array<wunder::ray_hit, packet_size> hits;
+          const std::uint32_t hit_lanes =
+              query == trace_query::closest_hit
+                  ? scene_bvh.intersect(packet, hits)
+                  : scene_bvh.occluded(packet);
+          chunk_hits_count += static_cast<std::size_t>(std::popcount(hit_lanes));
+        }
+        hits_count += chunk_hits_count;
+      },
+      k_min_rays_per_thread / packet_size);
+
+  return hits_count;
+}
+
+template <typename trace_function>
+void report(const std::string& rays_name, std::size_t rays_count,
+            trace_function&& trace) {
+  const auto start = std::chrono::steady_clock::now();
+  const std::size_t hits_count = trace();
+  const std::chrono::duration<double> duration =
+      std::chrono::steady_clock::now() - start;
+
+  const double mrays_per_second =
+      static_cast<double>(rays_count) / duration.count() * 1e-6;
+  const double hit_percentage =
+      rays_count > 0 ? static_cast<double>(hits_count) * 100.0 /
+                           static_cast<double>(rays_count)
+                     : 0.0;
+  WUNDER_INFO_TAG("Benchmark", "{0:<28} {1:>9} rays {2:>8.2f} Mrays/s {3:>6.1f}% hit",
+                  rays_name, rays_count, mrays_per_second, hit_percentage);
+}
+
+void benchmark_scene(const wunder::scene_asset& scene,
+                     const wunder::asset_storage& storage,
+                     const std::string& scene_name) {
+  wunder::scene_bvh scene_bvh;
+  const auto build_start = std::chrono::steady_clock::now();
+  scene_bvh.build(scene, storage);
+  const std::chrono::duration<double, std::milli> build_duration =
+      std::chrono::steady_clock::now() - build_start;
+
+  std::size_t triangles_count = 0;
+  for (const auto& instance : scene_bvh.get_instances()) {
+    triangles_count += instance.m_bvh->get_triangles_count();
+  }
+  WUNDER_INFO_TAG("Benchmark",
+                  "{0}: {1} instances, {2} triangles, built in {3:.1f} ms",
+                  scene_name, scene_bvh.get_instances().size(),
+                  triangles_count, build_duration.count());
+  ReturnIf(scene_bvh.get_instances().empty());
+
+  const auto primary_rays = generate_primary_rays(scene_bvh.get_bounds());
+  const auto diffuse_rays = generate_diffuse_rays(scene_bvh, primary_rays);
+
+  for (const auto& [rays_name, rays] :
+       {std::pair{"primary", std::cref(primary_rays)},
+        std::pair{"diffuse", std::cref(diffuse_rays)}}) {
+    const std::vector<wunder::ray>& benchmark_rays = rays.get();
+    const std::string name = rays_name;
+    report(name + " closest hit", benchmark_rays.size(), [&]() {
+      return trace_rays(scene_bvh, benchmark_rays, trace_query::closest_hit);
+    });
+    report(name + " closest hit packets", benchmark_rays.size(), [&]() {
+      return trace_packets(scene_bvh, benchmark_rays, trace_query::closest_hit);
+    });
+    report(name + " any hit", benchmark_rays.size(), [&]() {
+      return trace_rays(scene_bvh, benchmark_rays, trace_query::any_hit);
+    });
+    report(name + " any hit packets", benchmark_rays.size(), [&]() {
+      return trace_packets(scene_bvh, benchmark_rays, trace_query::any_hit);
+    });
+  }
+}
+
+bool benchmark_file(const std::filesystem::path& scene_path) {
+  tinygltf::TinyGLTF gltf;
+  tinygltf::Model gltf_model;
+  std::string error;
+  std::string warning;
+  const bool is_loaded =
+      scene_path.extension() == ".glb"
+          ? gltf.LoadBinaryFromFile(&gltf_model, &error, &warning,
+                                    scene_path.string())
+          : gltf.LoadASCIIFromFile(&gltf_model, &error, &warning,
+                                   scene_path.string());
+  if (!is_loaded) {
+    WUNDER_ERROR_TAG("Benchmark", "Failed to load {0}: {1}",
+                     scene_path.string(), error);
+    return false;
+  }
+
+  wunder::asset_storage storage;
+  wunder::gltf_asset_importer importer(storage);
+  if (importer.import_asset(gltf_model) !=
+      wunder::asset_serialization_result_codes::ok) {
+    WUNDER_ERROR_TAG("Benchmark", "Failed to import {0}", scene_path.string());
+    return false;
+  }
+
+  for (const auto& [scene_handle, scene] :
+       storage.find_assets_of<wunder::scene_asset>()) {
+    benchmark_scene(scene.get(), storage, scene_path.filename().string());
+  }
+
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  if (argc < 2) {
+    WUNDER_ERROR_TAG("Benchmark", "usage: wunder-bvh-benchmark <scene files...>");
+    return EXIT_FAILURE;
+  }
+
+  bool succeeded = true;
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    succeeded = benchmark_file(argv[arg_idx]) && succeeded;
+  }
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
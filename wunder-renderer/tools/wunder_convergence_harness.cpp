@@ -0,0 +1,275 @@
+/**
+ * Verifies the convergence statistics of the adaptive sampling. Path traces a
+ * glTF scene on the CPU, feeds the frames to the convergence tracker the way
+ * the ray generation shader accumulates them and compares every tile that
+ * stopped against a reference of independent frames. A tile converged too
+ * early when its actual relative error is above the threshold, the tool
+ * fails if more tiles than tolerated did.
+ *
+ * usage: wunder-convergence-harness <scene.gltf|glb> <environment.hdr>
+ *            [--width n] [--height n] [--samples n] [--depth n]
+ *            [--frames n] [--reference-frames n] [--threshold error]
+ *            [--min-frames n]
+ */
+#include <glm/common.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "assets/asset_storage.h"
+#include "assets/scene_asset.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "gla/cpu/cpu_convergence.h"
+#include "gla/cpu/cpu_path_tracer.h"
+#include "gla/cpu/cpu_render_target.h"
+#include "gla/cpu/cpu_scene.h"
+#include "headless_rendering.h"
+
+namespace {
+// The reference's own noise makes a few tiles look off
+constexpr double k_max_false_convergence_rate = 0.05;
+
+struct harness_options {
+  std::filesystem::path m_scene_path;
+  std::filesystem::path m_environment_path;
+  std::uint32_t m_width = 256;
+  std::uint32_t m_height = 256;
+  int m_samples = 7;
+  int m_depth = 10;
+  // Adaptive frames at most, the reference is traced with the ones after
+  int m_frames = 256;
+  int m_reference_frames = 1024;
+  float m_threshold = 0.05f;
+  int m_min_frames = 16;
+};
+
+bool parse_option(harness_options& options, std::string_view name,
+                  std::string_view value) {
+  if (name == "--threshold") {
+    const std::optional<float> threshold = wunder::tools::parse_float(value);
+    ReturnUnless(threshold.has_value() && *threshold > 0.0f, false);
+    options.m_threshold = *threshold;
+    return true;
+  }
+
+  const std::optional<int> count = wunder::tools::parse_positive(value);
+  ReturnUnless(count.has_value(), false);
+  if (name == "--width") {
+    options.m_width = static_cast<std::uint32_t>(*count);
+  } else if (name == "--height") {
+    options.m_height = static_cast<std::uint32_t>(*count);
+  } else if (name == "--samples") {
+    options.m_samples = *count;
+  } else if (name == "--depth") {
+    options.m_depth = *count;
+  } else if (name == "--frames") {
+    options.m_frames = *count;
+  } else if (name == "--reference-frames") {
+    options.m_reference_frames = *count;
+  } else if (name == "--min-frames") {
+    options.m_min_frames = *count;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<harness_options> parse_options(int argc, char** argv) {
+  ReturnIf(argc < 3, std::nullopt);
+
+  harness_options options{.m_scene_path = argv[1],
+                          .m_environment_path = argv[2]};
+  for (int arg_idx = 3; arg_idx < argc; arg_idx += 2) {
+    const std::string_view name = argv[arg_idx];
+    if (arg_idx + 1 == argc) {
+      WUNDER_ERROR_TAG("Convergence", "Missing value of {0}", name);
+      return std::nullopt;
+    }
+
+    if (!parse_option(options, name, argv[arg_idx + 1])) {
+      WUNDER_ERROR_TAG("Convergence", "Invalid option {0} {1}", name,
+                       argv[arg_idx + 1]);
+      return std::nullopt;
+    }
+  }
+
+  return options;
+}
+
+/**
+ * Relative RMS error of the tile's pixels against the reference and the mean
+ * error the tracker estimated for them.
+ */
+struct tile_error {
+  double m_actual = 0.0;
+  double m_estimated = 0.0;
+};
+
+std::vector<tile_error> measure_tiles(
+    const wunder::cpu::convergence_tracker& tracker,
+    const wunder::cpu::render_target& reference) {
+  std::vector<tile_error> errors(tracker.get_tiles_count());
+  std::vector<std::uint32_t> pixels_count(tracker.get_tiles_count(), 0);
+
+  const wunder::cpu::render_target& image = tracker.get_image();
+  for (std::uint32_t y = 0; y < image.get_height(); ++y) {
+    for (std::uint32_t x = 0; x < image.get_width(); ++x) {
+      const float expected =
+          wunder::cpu::convergence_luminance(reference.get_pixel(x, y));
+      const float actual =
+          wunder::cpu::convergence_luminance(image.get_pixel(x, y));
+      const double relative_error =
+          (actual - expected) / (expected + ConvergenceDarkOffset);
+
+      tile_error& error = errors[tracker.get_tile_idx(x, y)];
+      error.m_actual += relative_error * relative_error;
+      error.m_estimated += tracker.get_pixel_error(x, y);
+      ++pixels_count[tracker.get_tile_idx(x, y)];
+    }
+  }
+
+  for (std::size_t tile_idx = 0; tile_idx < errors.size(); ++tile_idx) {
+    const auto count = static_cast<double>(pixels_count[tile_idx]);
+    errors[tile_idx].m_actual = std::sqrt(errors[tile_idx].m_actual / count);
+    errors[tile_idx].m_estimated /= count;
+  }
+
+  return errors;
+}
+
+bool verify(const harness_options& options) {
+  wunder::asset_storage storage;
+  ReturnUnless(wunder::tools::import_scene(options.m_scene_path, storage),
+               false);
+  ReturnUnless(
+      wunder::tools::import_environment(options.m_environment_path, storage),
+      false);
+
+  auto scene_assets = storage.find_assets_of<wunder::scene_asset>();
+  if (scene_assets.empty()) {
+    WUNDER_ERROR_TAG("Convergence", "{0} has no scene",
+                     options.m_scene_path.string());
+    return false;
+  }
+
+  wunder::cpu::scene scene;
+  ReturnUnless(scene.load_scene(scene_assets.begin()->second.get(), storage),
+               false);
+
+  const SceneCamera camera = wunder::tools::create_host_camera(
+      wunder::tools::frame_bounds(scene.get_bvh().get_bounds()),
+      options.m_width, options.m_height,
+      static_cast<std::uint32_t>(scene.get_lights().size()));
+
+  RtxState state{};
+  std::memset(&state, 0, sizeof(RtxState));
+  state.maxDepth = options.m_depth;
+  state.maxSamples = options.m_samples;
+  state.fireflyClampThreshold = scene.get_environment_integral();
+  state.hdrMultiplier = 1.7f;
+  state.debugging_mode = DebugMode::eNoDebug;
+  state.size = glm::ivec2(options.m_width, options.m_height);
+  state.convergenceThreshold = options.m_threshold;
+  state.minConvergenceFrames = options.m_min_frames;
+
+  wunder::cpu::path_tracer path_tracer;
+  wunder::cpu::render_target estimate(options.m_width, options.m_height);
+  wunder::cpu::convergence_tracker tracker(options.m_width, options.m_height,
+                                           options.m_threshold,
+                                           options.m_min_frames);
+  for (state.frame = 0;
+       state.frame < options.m_frames && !tracker.is_converged();
+       ++state.frame) {
+    wunder::tools::render_frame_estimate(path_tracer, scene, camera, state,
+                                         estimate);
+    tracker.add_frame(estimate, state.frame);
+  }
+  const int adaptive_frames = state.frame;
+
+  // Seeded by frames the adaptive accumulation didn't use
+  wunder::cpu::render_target reference(options.m_width, options.m_height);
+  for (int reference_frame = 0; reference_frame < options.m_reference_frames;
+       ++reference_frame) {
+    state.frame = options.m_frames + reference_frame;
+    wunder::tools::render_frame_estimate(path_tracer, scene, camera, state,
+                                         estimate);
+
+    const float weight = 1.f / static_cast<float>(reference_frame + 1);
+    for (std::uint32_t y = 0; y < options.m_height; ++y) {
+      for (std::uint32_t x = 0; x < options.m_width; ++x) {
+        reference.set_pixel(x, y,
+                            glm::mix(reference.get_pixel(x, y),
+                                     estimate.get_pixel(x, y), weight));
+      }
+    }
+  }
+
+  const std::vector<tile_error> errors = measure_tiles(tracker, reference);
+  std::uint32_t converged_tiles = 0;
+  std::uint32_t false_converged_tiles = 0;
+  double converged_frames_sum = 0.0;
+  double actual_error_sum = 0.0;
+  double estimated_error_sum = 0.0;
+  for (std::uint32_t tile_idx = 0; tile_idx < errors.size(); ++tile_idx) {
+    const int converged_frames = tracker.get_tile_converged_frames(tile_idx);
+    ContinueIf(converged_frames == 0);
+
+    ++converged_tiles;
+    converged_frames_sum += converged_frames;
+    actual_error_sum += errors[tile_idx].m_actual;
+    estimated_error_sum += errors[tile_idx].m_estimated;
+    if (errors[tile_idx].m_actual > options.m_threshold) {
+      ++false_converged_tiles;
+    }
+  }
+
+  const double traced_pixels =
+      static_cast<double>(options.m_width) * options.m_height * adaptive_frames;
+  WUNDER_INFO_TAG("Convergence",
+                  "{0} of {1} tiles converged after {2:.1f} frames on "
+                  "average, {3} frames traced {4:.1f}% of their pixels",
+                  converged_tiles, tracker.get_tiles_count(),
+                  converged_tiles > 0 ? converged_frames_sum / converged_tiles
+                                      : 0.0,
+                  adaptive_frames,
+                  100.0 *
+                      static_cast<double>(tracker.get_traced_pixels_count()) /
+                      traced_pixels);
+  ReturnIf(converged_tiles == 0, true);
+
+  const double false_convergence_rate =
+      static_cast<double>(false_converged_tiles) / converged_tiles;
+  WUNDER_INFO_TAG("Convergence",
+                  "Converged tiles, estimated error {0:.4f} actual {1:.4f}, "
+                  "{2} above the threshold {3}, {4:.1f}%",
+                  estimated_error_sum / converged_tiles,
+                  actual_error_sum / converged_tiles, false_converged_tiles,
+                  options.m_threshold, 100.0 * false_convergence_rate);
+
+  return false_convergence_rate <= k_max_false_convergence_rate;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  const std::optional<harness_options> options = parse_options(argc, argv);
+  if (!options.has_value()) {
+    WUNDER_ERROR_TAG("Convergence",
+                     "usage: wunder-convergence-harness <scene.gltf|glb> "
+                     "<environment.hdr> [--width n] [--height n] "
+                     "[--samples n] [--depth n] [--frames n] "
+                     "[--reference-frames n] [--threshold error] "
+                     "[--min-frames n]");
+    return EXIT_FAILURE;
+  }
+
+  return verify(*options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,139 @@
+/**
+ * Verifies the environment importance sampling tables. Builds them for every
+ * HDR with the parallel builder the renderer uses and with the serial one it
+ * replaced, and fails unless the EnvAccel entries, the radiance integral and
+ * the average luminance are bitwise identical. Without arguments the HDRs
+ * bundled in the renderer's resources are checked.
+ *
+ * usage: wunder-environment-accel-check [environment.hdr...]
+ */
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <variant>
+#include <vector>
+
+#include "assets/asset_storage.h"
+#include "assets/texture_asset.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "gla/vulkan/scene/vulkan_environment_resource_creator.h"
+#include "headless_rendering.h"
+
+namespace {
+using accel_creator = wunder::vulkan::vulkan_environment_resource_creator;
+
+bool is_same_bits(float lhs, float rhs) {
+  return std::bit_cast<std::uint32_t>(lhs) == std::bit_cast<std::uint32_t>(rhs);
+}
+
+bool is_same_entry(const EnvAccel& lhs, const EnvAccel& rhs) {
+  return lhs.alias == rhs.alias && is_same_bits(lhs.q, rhs.q) &&
+         is_same_bits(lhs.pdf, rhs.pdf) &&
+         is_same_bits(lhs.aliasPdf, rhs.aliasPdf);
+}
+
+bool check_environment(const std::filesystem::path& environment_path) {
+  wunder::asset_storage storage;
+  ReturnUnless(wunder::tools::import_environment(environment_path, storage),
+               false);
+
+  auto environment_assets =
+      storage.find_assets_of<wunder::environment_texture_asset>();
+  AssertReturnIf(environment_assets.empty(), false);
+  const wunder::environment_texture_asset& asset =
+      environment_assets.begin()->second.get();
+
+  const auto* pixels =
+      std::get_if<std::vector<float>>(&asset.m_texture_data.m_data);
+  AssertReturnUnless(pixels, false);
+
+  accel_creator::environment_accel_data parallel_data;
+  accel_creator::build_environment_accel(asset, *pixels, parallel_data);
+  accel_creator::environment_accel_data serial_data;
+  accel_creator::build_environment_accel_serial(asset, *pixels, serial_data);
+
+  bool is_identical = true;
+  if (!is_same_bits(parallel_data.m_integral, serial_data.m_integral)) {
+    WUNDER_ERROR_TAG("EnvAccel", "{0}: integral {1} differs from {2}",
+                     environment_path.string(), parallel_data.m_integral,
+                     serial_data.m_integral);
+    is_identical = false;
+  }
+
+  if (!is_same_bits(parallel_data.m_average_luminance,
+                    serial_data.m_average_luminance)) {
+    WUNDER_ERROR_TAG("EnvAccel", "{0}: average luminance {1} differs from {2}",
+                     environment_path.string(),
+                     parallel_data.m_average_luminance,
+                     serial_data.m_average_luminance);
+    is_identical = false;
+  }
+
+  std::size_t different_entries = 0;
+  std::size_t first_different_entry = 0;
+  for (std::size_t entry_idx = 0; entry_idx < serial_data.m_env_accels.size();
+       ++entry_idx) {
+    ContinueIf(is_same_entry(parallel_data.m_env_accels[entry_idx],
+                             serial_data.m_env_accels[entry_idx]));
+
+    if (different_entries == 0) {
+      first_different_entry = entry_idx;
+    }
+    ++different_entries;
+  }
+
+  if (different_entries > 0) {
+    WUNDER_ERROR_TAG("EnvAccel", "{0}: {1} of {2} entries differ, first {3}",
+                     environment_path.string(), different_entries,
+                     serial_data.m_env_accels.size(), first_different_entry);
+    is_identical = false;
+  }
+
+  ReturnUnless(is_identical, false);
+
+  WUNDER_INFO_TAG("EnvAccel",
+                  "{0}: {1}x{2}, {3} entries identical, integral {4} average "
+                  "luminance {5}",
+                  environment_path.string(), asset.m_width, asset.m_height,
+                  serial_data.m_env_accels.size(), serial_data.m_integral,
+                  serial_data.m_average_luminance);
+  return true;
+}
+
+std::vector<std::filesystem::path> get_bundled_environments() {
+  std::vector<std::filesystem::path> environment_paths;
+  for (const auto& entry : std::filesystem::directory_iterator(
+           WUNDER_BUNDLED_RESOURCES_DIR)) {
+    ContinueUnless(entry.is_regular_file() &&
+                   entry.path().extension() == ".hdr");
+    environment_paths.push_back(entry.path());
+  }
+
+  return environment_paths;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  std::vector<std::filesystem::path> environment_paths(argv + 1, argv + argc);
+  if (environment_paths.empty()) {
+    environment_paths = get_bundled_environments();
+  }
+
+  if (environment_paths.empty()) {
+    WUNDER_ERROR_TAG("EnvAccel",
+                     "usage: wunder-environment-accel-check "
+                     "[environment.hdr...]");
+    return EXIT_FAILURE;
+  }
+
+  bool is_identical = true;
+  for (const std::filesystem::path& environment_path : environment_paths) {
+    is_identical = check_environment(environment_path) && is_identical;
+  }
+
+  return is_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
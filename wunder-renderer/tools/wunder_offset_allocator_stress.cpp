@@ -0,0 +1,207 @@
+/**
+ * Offset allocator stress test. Every cycle runs seeded random allocations
+ * and frees on a wunder::offset_allocator, checks after each operation that
+ * the live ranges stay inside the storage without overlapping and that the
+ * reported free size matches them, then frees what's left in random order.
+ * Freed neighbours must have coalesced back into a single free region of the
+ * whole storage by then. Reports the largest free region and the
+ * fragmentation seen at the end of the random phase, the tool fails on the
+ * first broken check.
+ *
+ * usage: wunder-offset-allocator-stress [--size n] [--cycles n]
+ *            [--operations n] [--max-allocation n] [--seed n]
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "core/offset_allocator.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "headless_rendering.h"
+
+namespace {
+struct stress_options {
+  std::uint32_t m_size = 1u << 20;
+  int m_cycles = 100;
+  // Random allocations and frees a cycle does before freeing everything
+  int m_operations = 4096;
+  std::uint32_t m_max_allocation = 4096;
+  std::uint32_t m_seed = 1;
+};
+
+bool parse_option(stress_options& options, std::string_view name,
+                  std::string_view value) {
+  const std::optional<int> count = wunder::tools::parse_positive(value);
+  ReturnUnless(count.has_value(), false);
+  if (name == "--size") {
+    options.m_size = static_cast<std::uint32_t>(*count);
+  } else if (name == "--cycles") {
+    options.m_cycles = *count;
+  } else if (name == "--operations") {
+    options.m_operations = *count;
+  } else if (name == "--max-allocation") {
+    options.m_max_allocation = static_cast<std::uint32_t>(*count);
+  } else if (name == "--seed") {
+    options.m_seed = static_cast<std::uint32_t>(*count);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<stress_options> parse_options(int argc, char** argv) {
+  stress_options options;
+  for (int arg_idx = 1; arg_idx < argc; arg_idx += 2) {
+    const std::string_view name = argv[arg_idx];
+    if (arg_idx + 1 == argc) {
+      WUNDER_ERROR_TAG("Allocator", "Missing value of {0}", name);
+      return std::nullopt;
+    }
+
+    if (!parse_option(options, name, argv[arg_idx + 1])) {
+      WUNDER_ERROR_TAG("Allocator", "Invalid option {0} {1}", name,
+                       argv[arg_idx + 1]);
+      return std::nullopt;
+    }
+  }
+
+  return options;
+}
+
+using allocation = wunder::offset_allocator::allocation;
+
+/**
+ * Live ranges are inside the storage, don't overlap and the allocator's free
+ * size is what they leave.
+ */
+bool check_live_allocations(const wunder::offset_allocator& allocator,
+                            std::vector<allocation> live_allocations) {
+  std::ranges::sort(live_allocations, {}, &allocation::m_offset);
+
+  std::uint64_t used_size = 0;
+  std::uint64_t previous_end = 0;
+  for (const allocation& live_allocation : live_allocations) {
+    const std::uint64_t end =
+        std::uint64_t{live_allocation.m_offset} + live_allocation.m_size;
+    if (live_allocation.m_offset < previous_end ||
+        end > allocator.get_size()) {
+      WUNDER_ERROR_TAG("Allocator",
+                       "Range {0} of size {1} overlaps its neighbour or "
+                       "leaves the storage",
+                       live_allocation.m_offset, live_allocation.m_size);
+      return false;
+    }
+
+    used_size += live_allocation.m_size;
+    previous_end = end;
+  }
+
+  const auto report = allocator.get_storage_report();
+  if (report.m_free_size != allocator.get_size() - used_size) {
+    WUNDER_ERROR_TAG("Allocator", "Free size {0}, the live ranges leave {1}",
+                     report.m_free_size, allocator.get_size() - used_size);
+    return false;
+  }
+
+  return true;
+}
+
+bool stress(const stress_options& options) {
+  std::mt19937 random_engine(options.m_seed);
+  std::uniform_int_distribution<std::uint32_t> size_distribution(
+      1, options.m_max_allocation);
+  std::bernoulli_distribution allocate_distribution(0.6);
+
+  std::uint64_t allocations_count = 0;
+  std::uint64_t failed_allocations_count = 0;
+  std::uint32_t min_largest_free_region = options.m_size;
+  float max_fragmentation = 0.f;
+  double fragmentation_sum = 0.0;
+
+  wunder::offset_allocator allocator(options.m_size);
+  std::vector<allocation> live_allocations;
+  for (int cycle = 0; cycle < options.m_cycles; ++cycle) {
+    for (int operation = 0; operation < options.m_operations; ++operation) {
+      if (live_allocations.empty() || allocate_distribution(random_engine)) {
+        const allocation new_allocation =
+            allocator.allocate(size_distribution(random_engine));
+        ++allocations_count;
+        if (new_allocation.is_valid()) {
+          live_allocations.push_back(new_allocation);
+        } else {
+          ++failed_allocations_count;
+        }
+      } else {
+        std::uniform_int_distribution<std::size_t> live_distribution(
+            0, live_allocations.size() - 1);
+        const std::size_t freed_idx = live_distribution(random_engine);
+        allocator.free(live_allocations[freed_idx]);
+        live_allocations[freed_idx] = live_allocations.back();
+        live_allocations.pop_back();
+      }
+
+      ReturnUnless(check_live_allocations(allocator, live_allocations),
+                   false);
+    }
+
+    const auto report = allocator.get_storage_report();
+    min_largest_free_region =
+        std::min(min_largest_free_region, report.m_largest_free_region);
+    max_fragmentation = std::max(max_fragmentation, report.fragmentation());
+    fragmentation_sum += report.fragmentation();
+
+    std::ranges::shuffle(live_allocations, random_engine);
+    for (const allocation& live_allocation : live_allocations) {
+      allocator.free(live_allocation);
+    }
+    live_allocations.clear();
+
+    const auto empty_report = allocator.get_storage_report();
+    if (empty_report.m_free_size != options.m_size ||
+        empty_report.m_free_regions_count != 1 ||
+        empty_report.m_largest_free_region != options.m_size) {
+      WUNDER_ERROR_TAG("Allocator",
+                       "Cycle {0} freed everything into {1} regions, {2} "
+                       "free, the largest {3}, expected one of {4}",
+                       cycle, empty_report.m_free_regions_count,
+                       empty_report.m_free_size,
+                       empty_report.m_largest_free_region, options.m_size);
+      return false;
+    }
+  }
+
+  WUNDER_INFO_TAG("Allocator",
+                  "{0} cycles, {1} allocations of which {2} failed, every "
+                  "cycle coalesced back into one free region",
+                  options.m_cycles, allocations_count,
+                  failed_allocations_count);
+  WUNDER_INFO_TAG("Allocator",
+                  "Before freeing everything: largest free region at least "
+                  "{0} of {1}, fragmentation {2:.3f} on average, {3:.3f} at "
+                  "most",
+                  min_largest_free_region, options.m_size,
+                  fragmentation_sum / options.m_cycles, max_fragmentation);
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  const std::optional<stress_options> options = parse_options(argc, argv);
+  if (!options.has_value()) {
+    WUNDER_ERROR_TAG("Allocator",
+                     "usage: wunder-offset-allocator-stress [--size n] "
+                     "[--cycles n] [--operations n] [--max-allocation n] "
+                     "[--seed n]");
+    return EXIT_FAILURE;
+  }
+
+  return stress(*options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
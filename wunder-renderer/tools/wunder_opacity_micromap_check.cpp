@@ -0,0 +1,451 @@
+/**
+ * Verifies the opacity micromap baker. The micro-triangles of subdivision
+ * levels 1 and 2 are compared against the discrete barycentrics of the
+ * VK_EXT_opacity_micromap bird curve, deeper levels must tile the base
+ * triangle, every micro-triangle nested in its parent and touching the one
+ * before it. Then synthetic alpha textures are baked in both formats, a fully
+ * opaque, a fully transparent and a mixed triangle, and a uniformly blended
+ * one, checking which triangles get special indices and the states of the
+ * micro-triangles that keep their data.
+ *
+ * usage: wunder-opacity-micromap-check
+ */
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "assets/material_asset.h"
+#include "assets/mesh_asset.h"
+#include "assets/opacity_micromap_baker.h"
+#include "assets/texture_asset.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "resources/shaders/material.h"
+
+namespace {
+using micro_triangle = wunder::opacity_micromap_baker::micro_triangle;
+
+struct discrete_barycentrics {
+  std::uint32_t m_u = 0;
+  std::uint32_t m_v = 0;
+  std::uint32_t m_w = 0;
+};
+
+// Bird curve order the specification's index to discrete barycentrics
+// conversion gives, indices 4i to 4i + 3 subdivide micro-triangle i of the
+// level above
+constexpr std::array<discrete_barycentrics, 4> k_level_1_curve{
+    {{0, 0, 1}, {0, 0, 0}, {1, 0, 0}, {0, 1, 0}}};
+constexpr std::array<discrete_barycentrics, 16> k_level_2_curve{
+    {{0, 0, 3},
+     {0, 0, 2},
+     {1, 0, 2},
+     {0, 1, 2},
+     {0, 1, 1},
+     {1, 1, 1},
+     {1, 1, 0},
+     {1, 0, 1},
+     {2, 0, 1},
+     {2, 0, 0},
+     {3, 0, 0},
+     {2, 1, 0},
+     {1, 2, 0},
+     {0, 2, 0},
+     {0, 2, 1},
+     {0, 3, 0}}};
+
+constexpr std::uint32_t k_max_tiled_level = 8;
+constexpr std::uint32_t k_texture_size = 16;
+constexpr std::uint32_t k_baked_level = 3;
+
+/**
+ * Upright micro-triangles have u + v + w = 2^level - 1 and span one step
+ * along u and v from their origin, the ones pointing down are a step short
+ * and span back from the opposite corner.
+ */
+std::optional<micro_triangle> to_micro_triangle(
+    const discrete_barycentrics& barycentrics, std::uint32_t level) {
+  const std::uint32_t steps = 1u << level;
+  const std::uint32_t sum =
+      barycentrics.m_u + barycentrics.m_v + barycentrics.m_w;
+  ReturnUnless(sum + 1 == steps || sum + 2 == steps, std::nullopt);
+
+  const float step = 1.0f / static_cast<float>(steps);
+  const glm::vec2 origin{static_cast<float>(barycentrics.m_u) * step,
+                         static_cast<float>(barycentrics.m_v) * step};
+  if (sum + 1 == steps) {
+    return micro_triangle{origin, origin + glm::vec2{step, 0.0f},
+                          origin + glm::vec2{0.0f, step}};
+  }
+
+  return micro_triangle{origin + glm::vec2{step, 0.0f},
+                        origin + glm::vec2{0.0f, step},
+                        origin + glm::vec2{step, step}};
+}
+
+// Corners are compared in any order, the winding doesn't matter for baking
+bool is_same_triangle(const micro_triangle& lhs, const micro_triangle& rhs) {
+  return std::ranges::all_of(lhs, [&rhs](const glm::vec2& corner) {
+    return std::ranges::find(rhs, corner) != rhs.end();
+  });
+}
+
+std::size_t get_shared_corners_count(const micro_triangle& lhs,
+                                     const micro_triangle& rhs) {
+  return static_cast<std::size_t>(
+      std::ranges::count_if(lhs, [&rhs](const glm::vec2& corner) {
+        return std::ranges::find(rhs, corner) != rhs.end();
+      }));
+}
+
+float edge_function(const glm::vec2& a, const glm::vec2& b,
+                    const glm::vec2& point) {
+  return (b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x);
+}
+
+bool is_inside(const micro_triangle& triangle, const glm::vec2& point) {
+  const float e0 = edge_function(triangle[0], triangle[1], point);
+  const float e1 = edge_function(triangle[1], triangle[2], point);
+  const float e2 = edge_function(triangle[2], triangle[0], point);
+  return (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) ||
+         (e0 <= 0.0f && e1 <= 0.0f && e2 <= 0.0f);
+}
+
+glm::vec2 get_centre(const micro_triangle& triangle) {
+  return (triangle[0] + triangle[1] + triangle[2]) / 3.0f;
+}
+
+bool check_curve_table(std::span<const discrete_barycentrics> curve,
+                       std::uint32_t level) {
+  for (std::uint32_t idx = 0; idx < curve.size(); ++idx) {
+    const std::optional<micro_triangle> expected =
+        to_micro_triangle(curve[idx], level);
+    AssertReturnUnless(expected.has_value(), false);
+
+    const micro_triangle baked =
+        wunder::opacity_micromap_baker::get_micro_triangle(idx, level);
+    if (!is_same_triangle(*expected, baked)) {
+      WUNDER_ERROR_TAG("Micromap",
+                       "Level {0} micro-triangle {1} is ({2}, {3}) ({4}, {5}) "
+                       "({6}, {7}), the bird curve puts it at u {8} v {9} w "
+                       "{10}",
+                       level, idx, baked[0].x, baked[0].y, baked[1].x,
+                       baked[1].y, baked[2].x, baked[2].y, curve[idx].m_u,
+                       curve[idx].m_v, curve[idx].m_w);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Micro-triangles lie inside the base triangle, each in its own place with
+ * the area of a 4^level th of it, so together they tile it exactly. All the
+ * coordinates are multiples of powers of two, the comparisons are exact.
+ */
+bool check_curve_tiling(std::uint32_t level) {
+  const std::uint32_t count = 1u << (2 * level);
+  const float expected_area = 0.5f / static_cast<float>(count);
+  const float lattice_scale = 3.0f * static_cast<float>(1u << level);
+
+  std::set<std::pair<std::int64_t, std::int64_t>> centres;
+  micro_triangle previous{};
+  for (std::uint32_t idx = 0; idx < count; ++idx) {
+    const micro_triangle triangle =
+        wunder::opacity_micromap_baker::get_micro_triangle(idx, level);
+
+    const bool is_in_base = std::ranges::all_of(triangle, [](const auto& c) {
+      return c.x >= 0.0f && c.y >= 0.0f && c.x + c.y <= 1.0f;
+    });
+    const float area =
+        0.5f * std::abs(edge_function(triangle[0], triangle[1], triangle[2]));
+    const glm::vec2 centre = get_centre(triangle) * lattice_scale;
+    const bool is_unique =
+        centres
+            .emplace(static_cast<std::int64_t>(std::lround(centre.x)),
+                     static_cast<std::int64_t>(std::lround(centre.y)))
+            .second;
+    const bool is_nested =
+        level == 1 ||
+        is_inside(wunder::opacity_micromap_baker::get_micro_triangle(
+                      idx / 4, level - 1),
+                  get_centre(triangle));
+    // The bird curve is continuous, consecutive micro-triangles share an
+    // edge or at least a corner
+    const bool is_continuous =
+        idx == 0 || get_shared_corners_count(previous, triangle) > 0;
+
+    if (!is_in_base || area != expected_area || !is_unique || !is_nested ||
+        !is_continuous) {
+      WUNDER_ERROR_TAG("Micromap",
+                       "Level {0} micro-triangle {1}: inside {2}, area {3} "
+                       "expected {4}, unique {5}, nested {6}, continuous {7}",
+                       level, idx, is_in_base, area, expected_area, is_unique,
+                       is_nested, is_continuous);
+      return false;
+    }
+
+    previous = triangle;
+  }
+
+  return true;
+}
+
+wunder::texture_asset create_alpha_texture(
+    const std::function<std::uint8_t(std::uint32_t x)>& alpha) {
+  std::vector<unsigned char> pixels(k_texture_size * k_texture_size * 4, 255);
+  for (std::uint32_t y = 0; y < k_texture_size; ++y) {
+    for (std::uint32_t x = 0; x < k_texture_size; ++x) {
+      pixels[(y * k_texture_size + x) * 4 + 3] = alpha(x);
+    }
+  }
+
+  wunder::texture_asset texture;
+  texture.m_texture_data.m_data = std::move(pixels);
+  texture.m_width = k_texture_size;
+  texture.m_height = k_texture_size;
+  texture.m_sampler = wunder::texture_sampler{};
+  return texture;
+}
+
+wunder::material_asset create_material(int alpha_mode) {
+  wunder::material_asset material{};
+  material.m_pbr_base_color_factor = glm::vec4(1.0f);
+  material.m_alpha_mode = alpha_mode;
+  material.m_alpha_cutoff = 0.5f;
+  material.m_uv_transform = glm::mat4(1.0f);
+  return material;
+}
+
+wunder::mesh_asset create_mesh(
+    std::span<const std::array<glm::vec2, 3>> triangles_uvs) {
+  wunder::mesh_asset mesh{};
+  for (const auto& triangle_uvs : triangles_uvs) {
+    for (const glm::vec2& uv : triangle_uvs) {
+      wunder::vertex vertex{};
+      vertex.m_texcoord = uv;
+      mesh.m_indices.push_back(
+          static_cast<std::uint32_t>(mesh.m_vertices.size()));
+      mesh.m_vertices.push_back(vertex);
+    }
+  }
+
+  return mesh;
+}
+
+wunder::opacity_micromap_state get_state(
+    const wunder::baked_opacity_micromap& micromap, std::int32_t index,
+    std::uint32_t micro_triangle_idx) {
+  const std::uint32_t bits =
+      micromap.m_format == wunder::opacity_micromap_format::two_state ? 1 : 2;
+  const std::uint32_t bit_offset = micro_triangle_idx * bits;
+  const std::uint8_t byte =
+      micromap.m_data[static_cast<std::size_t>(index) *
+                          micromap.m_triangle_size +
+                      bit_offset / 8];
+
+  return static_cast<wunder::opacity_micromap_state>(
+      (byte >> (bit_offset % 8)) & ((1u << bits) - 1));
+}
+
+const char* get_format_name(wunder::opacity_micromap_format format) {
+  return format == wunder::opacity_micromap_format::two_state ? "2-state"
+                                                              : "4-state";
+}
+
+/**
+ * The left half of the texture is opaque, the right one transparent. The
+ * first triangle samples the left half only, the second the right one and
+ * the third crosses the edge between them, its micro-triangles are checked
+ * against the texels their footprint may reach, bilinear neighbours included.
+ */
+bool check_mixed_bake(wunder::opacity_micromap_format format) {
+  const wunder::texture_asset texture = create_alpha_texture(
+      [](std::uint32_t x) -> std::uint8_t {
+        return x < k_texture_size / 2 ? 255 : 0;
+      });
+  const wunder::material_asset material = create_material(ALPHA_MASK);
+  constexpr std::array<std::array<glm::vec2, 3>, 3> k_triangles_uvs{
+      {{{{0.05f, 0.05f}, {0.3f, 0.05f}, {0.05f, 0.3f}}},
+       {{{0.7f, 0.05f}, {0.95f, 0.05f}, {0.7f, 0.3f}}},
+       {{{0.1f, 0.5f}, {0.8f, 0.5f}, {0.1f, 0.9f}}}}};
+  const wunder::mesh_asset mesh = create_mesh(k_triangles_uvs);
+
+  const auto micromap = wunder::opacity_micromap_baker::bake(
+      mesh, material, texture, k_baked_level, format);
+  AssertReturnUnless(micromap.has_value(), false);
+
+  const std::array<std::int32_t, 2> expected_special_indices{
+      wunder::baked_opacity_micromap::k_fully_opaque_index,
+      wunder::baked_opacity_micromap::k_fully_transparent_index};
+  for (std::size_t triangle_idx = 0; triangle_idx < 2; ++triangle_idx) {
+    ContinueIf(micromap->m_indices[triangle_idx] ==
+               expected_special_indices[triangle_idx]);
+
+    WUNDER_ERROR_TAG("Micromap", "{0} triangle {1} got index {2}, not {3}",
+                     get_format_name(format), triangle_idx,
+                     micromap->m_indices[triangle_idx],
+                     expected_special_indices[triangle_idx]);
+    return false;
+  }
+
+  const std::int32_t mixed_index = micromap->m_indices[2];
+  if (mixed_index < 0 || micromap->get_referencing_triangles_count() != 1) {
+    WUNDER_ERROR_TAG("Micromap",
+                     "{0} mixed triangle got index {1}, {2} triangles "
+                     "reference data",
+                     get_format_name(format), mixed_index,
+                     micromap->get_referencing_triangles_count());
+    return false;
+  }
+
+  // Texel centres are on integer texel coordinates, the opaque ones are left
+  // of the edge, the transparent ones right of it
+  constexpr float k_edge = static_cast<float>(k_texture_size) / 2.0f - 0.5f;
+  const bool is_four_state =
+      format == wunder::opacity_micromap_format::four_state;
+  std::array<std::uint32_t, 3> checked_counts{};
+  for (std::uint32_t micro_triangle_idx = 0;
+       micro_triangle_idx < (1u << (2 * k_baked_level));
+       ++micro_triangle_idx) {
+    const micro_triangle barycentrics =
+        wunder::opacity_micromap_baker::get_micro_triangle(micro_triangle_idx,
+                                                           k_baked_level);
+    float min_x = static_cast<float>(k_texture_size);
+    float max_x = 0.0f;
+    for (const glm::vec2& corner : barycentrics) {
+      const glm::vec2 uv =
+          k_triangles_uvs[2][0] * (1.0f - corner.x - corner.y) +
+          k_triangles_uvs[2][1] * corner.x + k_triangles_uvs[2][2] * corner.y;
+      const float texel_x = uv.x * static_cast<float>(k_texture_size) - 0.5f;
+      min_x = std::min(min_x, texel_x);
+      max_x = std::max(max_x, texel_x);
+    }
+
+    const wunder::opacity_micromap_state state =
+        get_state(*micromap, mixed_index, micro_triangle_idx);
+    const bool is_unknown =
+        state == wunder::opacity_micromap_state::unknown_opaque ||
+        state == wunder::opacity_micromap_state::unknown_transparent;
+
+    // The footprint reaches a texel further, micro-triangles ending next to
+    // the edge may go either way. 2-state micromaps are never unknown.
+    bool is_expected = is_four_state || !is_unknown;
+    if (max_x + 1.0f < k_edge) {
+      is_expected = state == wunder::opacity_micromap_state::opaque;
+      ++checked_counts[0];
+    } else if (min_x - 1.0f > k_edge) {
+      is_expected = state == wunder::opacity_micromap_state::transparent;
+      ++checked_counts[1];
+    } else if (is_four_state && min_x < k_edge && max_x > k_edge) {
+      is_expected = is_unknown;
+      ++checked_counts[2];
+    }
+    ContinueIf(is_expected);
+
+    WUNDER_ERROR_TAG("Micromap",
+                     "{0} mixed micro-triangle {1} spanning texels {2} to {3} "
+                     "is in state {4}",
+                     get_format_name(format), micro_triangle_idx, min_x, max_x,
+                     static_cast<std::uint32_t>(state));
+    return false;
+  }
+
+  // The uvs are chosen so every case above is hit
+  AssertReturnIf(checked_counts[0] == 0 || checked_counts[1] == 0 ||
+                     (is_four_state && checked_counts[2] == 0),
+                 false);
+
+  WUNDER_INFO_TAG("Micromap",
+                  "{0} mixed bake: opaque and transparent triangles got "
+                  "special indices, {1} opaque {2} transparent {3} edge "
+                  "micro-triangles as expected",
+                  get_format_name(format), checked_counts[0],
+                  checked_counts[1], checked_counts[2]);
+  return true;
+}
+
+/**
+ * Alpha blended at one half everywhere, every micro-triangle is equally
+ * unknown. 4-state micromaps keep the data, so any-hit still runs, 2-state
+ * ones resolve it to opaque.
+ */
+bool check_blended_bake(wunder::opacity_micromap_format format) {
+  const wunder::texture_asset texture =
+      create_alpha_texture([](std::uint32_t) -> std::uint8_t { return 128; });
+  const wunder::material_asset material = create_material(ALPHA_BLEND);
+  constexpr std::array<std::array<glm::vec2, 3>, 1> k_triangles_uvs{
+      {{{{0.1f, 0.1f}, {0.9f, 0.1f}, {0.1f, 0.9f}}}}};
+  const wunder::mesh_asset mesh = create_mesh(k_triangles_uvs);
+
+  const auto micromap = wunder::opacity_micromap_baker::bake(
+      mesh, material, texture, k_baked_level, format);
+  AssertReturnUnless(micromap.has_value(), false);
+
+  const std::int32_t index = micromap->m_indices[0];
+  if (format == wunder::opacity_micromap_format::two_state) {
+    ReturnIf(index == wunder::baked_opacity_micromap::k_fully_opaque_index,
+             true);
+
+    WUNDER_ERROR_TAG("Micromap", "2-state blended triangle got index {0}",
+                     index);
+    return false;
+  }
+
+  bool is_unknown_opaque = index >= 0;
+  for (std::uint32_t micro_triangle_idx = 0;
+       is_unknown_opaque && micro_triangle_idx < (1u << (2 * k_baked_level));
+       ++micro_triangle_idx) {
+    is_unknown_opaque = get_state(*micromap, index, micro_triangle_idx) ==
+                        wunder::opacity_micromap_state::unknown_opaque;
+  }
+
+  if (!is_unknown_opaque) {
+    WUNDER_ERROR_TAG("Micromap",
+                     "4-state blended triangle got index {0}, expected data "
+                     "of unknown opaque micro-triangles",
+                     index);
+    return false;
+  }
+
+  return true;
+}
+}  // namespace
+
+int main(int /*argc*/, char** /*argv*/) {
+  wunder::log::init();
+
+  bool is_succeeded = check_curve_table(k_level_1_curve, 1) &&
+                      check_curve_table(k_level_2_curve, 2);
+  for (std::uint32_t level = 1; level <= k_max_tiled_level && is_succeeded;
+       ++level) {
+    is_succeeded = check_curve_tiling(level);
+  }
+  if (is_succeeded) {
+    WUNDER_INFO_TAG("Micromap",
+                    "Bird curve matches levels 1 and 2, levels up to {0} "
+                    "tile the base triangle",
+                    k_max_tiled_level);
+  }
+
+  for (const auto format : {wunder::opacity_micromap_format::two_state,
+                            wunder::opacity_micromap_format::four_state}) {
+    is_succeeded = check_mixed_bake(format) && is_succeeded;
+    is_succeeded = check_blended_bake(format) && is_succeeded;
+  }
+
+  return is_succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
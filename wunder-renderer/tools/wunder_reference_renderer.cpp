@@ -0,0 +1,142 @@
+/**
+ * Headless reference renderer. Imports a glTF scene and an HDR environment,
+ * path traces them on the CPU with the same host structures and default
+ * RtxState the ray tracing renderer uses and writes the accumulated image, an
+ * EXR for golden image comparisons or a PNG to look at. The camera looks at
+ * the whole scene, as the bounding volume hierarchy benchmark's does.
+ *
+ * usage: wunder-reference-renderer <scene.gltf|glb> <environment.hdr>
+ *            <output.exr|png> [--width n] [--height n] [--samples n]
+ *            [--depth n] [--frames n]
+ */
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "assets/asset_storage.h"
+#include "assets/scene_asset.h"
+#include "core/wunder_logger.h"
+#include "core/wunder_macros.h"
+#include "gla/cpu/cpu_path_tracer.h"
+#include "gla/cpu/cpu_render_target.h"
+#include "gla/cpu/cpu_scene.h"
+#include "headless_rendering.h"
+
+namespace {
+struct render_options {
+  std::filesystem::path m_scene_path;
+  std::filesystem::path m_environment_path;
+  std::filesystem::path m_output_path;
+  std::uint32_t m_width = 512;
+  std::uint32_t m_height = 512;
+  // RtxState defaults of the ray tracing renderer
+  int m_samples = 7;
+  int m_depth = 10;
+  int m_frames = 1;
+};
+
+std::optional<render_options> parse_options(int argc, char** argv) {
+  ReturnIf(argc < 4, std::nullopt);
+
+  render_options options{.m_scene_path = argv[1],
+                         .m_environment_path = argv[2],
+                         .m_output_path = argv[3]};
+  for (int arg_idx = 4; arg_idx < argc; arg_idx += 2) {
+    const std::string_view name = argv[arg_idx];
+    if (arg_idx + 1 == argc) {
+      WUNDER_ERROR_TAG("Reference", "Missing value of {0}", name);
+      return std::nullopt;
+    }
+
+    const std::optional<int> value =
+        wunder::tools::parse_positive(argv[arg_idx + 1]);
+    if (!value.has_value()) {
+      WUNDER_ERROR_TAG("Reference", "Invalid value of {0}: {1}", name,
+                       argv[arg_idx + 1]);
+      return std::nullopt;
+    }
+
+    if (name == "--width") {
+      options.m_width = static_cast<std::uint32_t>(*value);
+    } else if (name == "--height") {
+      options.m_height = static_cast<std::uint32_t>(*value);
+    } else if (name == "--samples") {
+      options.m_samples = *value;
+    } else if (name == "--depth") {
+      options.m_depth = *value;
+    } else if (name == "--frames") {
+      options.m_frames = *value;
+    } else {
+      WUNDER_ERROR_TAG("Reference", "Unknown option {0}", name);
+      return std::nullopt;
+    }
+  }
+
+  return options;
+}
+
+bool render(const render_options& options) {
+  wunder::asset_storage storage;
+  ReturnUnless(wunder::tools::import_scene(options.m_scene_path, storage),
+               false);
+  ReturnUnless(
+      wunder::tools::import_environment(options.m_environment_path, storage),
+      false);
+
+  auto scene_assets = storage.find_assets_of<wunder::scene_asset>();
+  if (scene_assets.empty()) {
+    WUNDER_ERROR_TAG("Reference", "{0} has no scene",
+                     options.m_scene_path.string());
+    return false;
+  }
+
+  wunder::cpu::scene scene;
+  ReturnUnless(scene.load_scene(scene_assets.begin()->second.get(), storage),
+               false);
+
+  const SceneCamera camera = wunder::tools::create_host_camera(
+      wunder::tools::frame_bounds(scene.get_bvh().get_bounds()),
+      options.m_width, options.m_height,
+      static_cast<std::uint32_t>(scene.get_lights().size()));
+
+  RtxState state{};
+  std::memset(&state, 0, sizeof(RtxState));
+  state.maxDepth = options.m_depth;
+  state.maxSamples = options.m_samples;
+  state.fireflyClampThreshold = scene.get_environment_integral();
+  state.hdrMultiplier = 1.7f;
+  state.debugging_mode = DebugMode::eNoDebug;
+  state.size = glm::ivec2(options.m_width, options.m_height);
+
+  wunder::cpu::render_target target(options.m_width, options.m_height);
+  wunder::cpu::path_tracer path_tracer;
+  for (state.frame = 0; state.frame < options.m_frames; ++state.frame) {
+    const wunder::cpu::render_statistics statistics =
+        path_tracer.render(scene, camera, state, target);
+    WUNDER_INFO_TAG("Reference",
+                    "Frame {0}: {1:.1f} ms {2:.2f} Mrays/s {3:.2f} Msamples/s",
+                    state.frame, statistics.m_duration.count() * 1000.0,
+                    statistics.get_mrays_per_second(),
+                    statistics.get_msamples_per_second());
+  }
+
+  return wunder::tools::write_image(target, options.m_output_path);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  const std::optional<render_options> options = parse_options(argc, argv);
+  if (!options.has_value()) {
+    WUNDER_ERROR_TAG("Reference",
+                     "usage: wunder-reference-renderer <scene.gltf|glb> "
+                     "<environment.hdr> <output.exr|png> [--width n] "
+                     "[--height n] [--samples n] [--depth n] [--frames n]");
+    return EXIT_FAILURE;
+  }
+
+  return render(*options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
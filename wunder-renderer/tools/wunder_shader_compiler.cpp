@@ -0,0 +1,72 @@
+/**
+ * Offline shader build. Compiles GLSL sources to optimized SPIR-V and writes
+ * them, together with their reflection data, as artifacts loaded by the
+ * renderer when it's built with WUNDER_PRECOMPILED_SHADERS.
+ *
+ * usage: wunder-shader-compiler <output directory> <shader sources...>
+ */
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "core/parallel_for.h"
+#include "core/wunder_logger.h"
+#include "gla/vulkan/vulkan_shader_artifact.h"
+#include "gla/vulkan/vulkan_shader_compiler.h"
+
+namespace {
+bool compile_shader(const std::filesystem::path& output_directory,
+                    const std::filesystem::path& source_path) {
+  namespace shader_compiler = wunder::vulkan::shader_compiler;
+
+  auto stage = shader_compiler::get_stage_from_extension(source_path);
+  if (!stage.has_value()) {
+    WUNDER_ERROR_TAG("Shaders", "Unknown shader stage of {0}",
+                     source_path.string());
+    return false;
+  }
+
+  auto spirv = shader_compiler::compile(source_path, stage.value(), true);
+  if (!spirv.has_value()) {
+    WUNDER_ERROR_TAG("Shaders", "Failed to compile {0}", source_path.string());
+    return false;
+  }
+
+  wunder::vulkan::shader_binary binary;
+  binary.m_reflection_data = shader_compiler::reflect(spirv.value());
+  binary.m_spirv = std::move(spirv.value());
+
+  return wunder::vulkan::shader_artifact::save(
+      output_directory, source_path.filename().string(), binary);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  wunder::log::init();
+
+  if (argc < 3) {
+    WUNDER_ERROR_TAG("Shaders",
+                     "usage: wunder-shader-compiler <output directory> "
+                     "<shader sources...>");
+    return EXIT_FAILURE;
+  }
+
+  const std::filesystem::path output_directory = argv[1];
+  const std::vector<std::filesystem::path> sources(argv + 2, argv + argc);
+
+  std::atomic<bool> succeeded = true;
+  wunder::parallel_for(
+      sources.size(),
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          if (!compile_shader(output_directory, sources[i])) {
+            succeeded = false;
+          }
+        }
+      },
+      1);
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -74,23 +74,44 @@ void right_side_panel::renderer_tab() {
   PE::begin();
   changed |= PE::slider_int("Samples per pixel", &rtx_config.maxSamples, 1, 25);
   changed |= PE::slider_int("Samples depth", &rtx_config.maxDepth, 1, 25);
-  // changed |=
-  //     PE::selection("Debug Mode", "", &rtx_config.debugging_mode, nullptr,
-  //                   {
-  //                       "No Debug",
-  //                       "BaseColor",
-  //                       "Normal",
-  //                       "Metallic",
-  //                       "Emissive",
-  //                       "Alpha",
-  //                       "Roughness",
-  //                       "TexCoord",
-  //                       "Tangent",
-  //                       "Radiance",
-  //                       "Weight",
-  //                       "RayDir",
-  //                       "HeatMap",
-  //                   });
+  changed |= PE::slider_float("Convergence threshold",
+                              &rtx_config.convergenceThreshold, 0.f, 0.2f);
+  changed |= PE::slider_int("Convergence min frames",
+                            &rtx_config.minConvergenceFrames, 1, 128);
+  changed |=
+      PE::selection("Debug Mode", "", &rtx_config.debugging_mode, nullptr,
+                    {
+                        "No Debug",
+                        "BaseColor",
+                        "Normal",
+                        "Metallic",
+                        "Emissive",
+                        "Alpha",
+                        "Roughness",
+                        "TexCoord",
+                        "Tangent",
+                        "Radiance",
+                        "Weight",
+                        "RayDir",
+                        "HeatMap",
+                    });
+
+  // Huge outputs trace a tile at a time, spread over frames
+  auto& tiling_config = rtx_renderer.mutable_tiling_config();
+  auto tile_size = static_cast<std::int32_t>(tiling_config.m_tile_size);
+  if (PE::slider_int("Tile size", &tile_size, 0, 2048)) {
+    tiling_config.m_tile_size = static_cast<std::uint32_t>(tile_size);
+    changed = true;
+  }
+  auto tile_order = static_cast<std::int32_t>(tiling_config.m_order);
+  if (PE::selection("Tile order", "", &tile_order, nullptr,
+                    {"Scanline", "Hilbert", "Center out"})) {
+    tiling_config.m_order =
+        static_cast<vulkan::rtx_tile_scheduler::tile_order>(tile_order);
+    changed = true;
+  }
+  PE::slider_float("Tiles ms per frame", &tiling_config.m_frame_budget_ms,
+                   1.f, 100.f);
   PE::end();
 
   ReturnUnless(changed);